@@ -94,6 +94,22 @@ void USMeshComponent::CreateMeshSection(
 	MarkRenderStateDirty(); // New section requires recreating scene proxy
 }
 
+void USMeshComponent::ClearMeshSection()
+{
+	check(!IsRegistered());
+	InitDispatchCSOutput.ReleaseDispatch();
+	InitDispatchCSOutput = FSDispatchCSOutput();
+
+	//A cook still running would give the next section the collision of this one
+	for (UBodySetup* OldBody : AsyncBodySetupQueue)
+	{
+		OldBody->AbortPhysicsMeshAsyncCreation();
+	}
+	AsyncBodySetupQueue.Empty();
+	ProcMeshBodySetup = nullptr;
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+}
+
 void USMeshComponent::UpdateLocalBounds(FBoxSphereBounds NewBounds)
 {
 	LocalBounds = NewBounds;
@@ -94,10 +94,7 @@ void FSMeshSceneProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& V
 			
 			BatchElement.PrimitiveUniformBuffer = GetUniformBuffer();
 		
-			BatchElement.FirstIndex = 0;
-			BatchElement.NumPrimitives = InitDispatchCSOutput.NumIndices/3;
-			BatchElement.MinVertexIndex = 0;
-			BatchElement.MaxVertexIndex = InitDispatchCSOutput.NumVertices-1;
+			SetDrawRange(BatchElement);
 			Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
 			Mesh.Type = PT_TriangleList;
 			Mesh.DepthPriorityGroup = SDPG_World;
@@ -126,10 +123,7 @@ void FSMeshSceneProxy::DrawStaticElements(FStaticPrimitiveDrawInterface* PDI)
 	
 	BatchElement.PrimitiveUniformBuffer = GetUniformBuffer();
 
-	BatchElement.FirstIndex = 0;
-	BatchElement.NumPrimitives = InitDispatchCSOutput.NumIndices/3;
-	BatchElement.MinVertexIndex = 0;
-	BatchElement.MaxVertexIndex = InitDispatchCSOutput.NumVertices-1;
+	SetDrawRange(BatchElement);
 	Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
 	Mesh.Type = PT_TriangleList;
 	Mesh.DepthPriorityGroup = SDPG_World;
@@ -142,6 +136,25 @@ void FSMeshSceneProxy::DrawStaticElements(FStaticPrimitiveDrawInterface* PDI)
 	PDI->DrawMesh(Mesh, FLT_MAX);
 }
 
+void FSMeshSceneProxy::SetDrawRange(FMeshBatchElement& BatchElement) const
+{
+	BatchElement.MinVertexIndex = InitDispatchCSOutput.VertexOffset;
+	BatchElement.MaxVertexIndex = InitDispatchCSOutput.VertexOffset + InitDispatchCSOutput.NumVertices-1;
+	
+	//GPU driven chunks never got their counts back, the suballoc pass wrote where they are in the draw arguments
+	if (InitDispatchCSOutput.DrawArgs)
+	{
+		BatchElement.FirstIndex = 0;
+		BatchElement.NumPrimitives = 0;
+		BatchElement.IndirectArgsBuffer = InitDispatchCSOutput.DrawArgs->GetRHI();
+		BatchElement.IndirectArgsOffset = InitDispatchCSOutput.DrawArgsIndex * sizeof(FRHIDrawIndexedIndirectParameters);
+		return;
+	}
+	
+	BatchElement.FirstIndex = InitDispatchCSOutput.IndexOffset;
+	BatchElement.NumPrimitives = InitDispatchCSOutput.NumIndices/3;
+}
+
 FPrimitiveViewRelevance FSMeshSceneProxy::GetViewRelevance(const FSceneView* View) const
 {
 	FPrimitiveViewRelevance Result;
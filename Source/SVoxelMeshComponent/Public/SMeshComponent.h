@@ -34,6 +34,11 @@ public:
 		float Size, int LOD, int Scale,
 		bool bCollisionEnabled, FName CollisionProfileName);
 
+	// Releases the output and collision of an unregistered component so it can be pooled and given a new section
+	void ClearMeshSection();
+
+	const FSDispatchCSOutput& GetDispatchOutput() const { return InitDispatchCSOutput; }
+
 private:
 	FSDispatchCSOutput InitDispatchCSOutput;
 	
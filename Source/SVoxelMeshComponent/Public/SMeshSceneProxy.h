@@ -29,6 +29,9 @@ public:
 	
 	
 private:
+	// Draws the chunk's range of the shared buffers, indirectly for GPU driven chunks
+	void SetDrawRange(FMeshBatchElement& BatchElement) const;
+	
 	FSDispatchCSOutput InitDispatchCSOutput;
 	
 	FSMeshVertexFactory* VertexFactory;
@@ -0,0 +1,97 @@
+﻿#include "SChunkCompletionQueue.h"
+#include "SVoxelStats.h"
+
+void FSChunkCompletionQueue::Enqueue(FSChunkCompletion&& Completion)
+{
+	NumQueued++;
+	Queue.Enqueue(MoveTemp(Completion));
+}
+
+void FSChunkCompletionQueue::Gather(TFunctionRef<void(FSChunkCompletion&)> OnDropped)
+{
+	check(IsInGameThread());
+	
+	FSChunkCompletion Completion;
+	while (Queue.Dequeue(Completion))
+	{
+		NumQueued--;
+		
+		int LOD = Completion.MeshKey.LOD;
+		if(!PendingChunks.IsValidIndex(LOD))
+		{
+			PendingChunks.SetNum(LOD + 1);
+		}
+		FSPendingChunk& Pending = PendingChunks[LOD].FindOrAdd(Completion.MeshKey.ChunkKey);
+		
+		//A spawn that was not applied yet is superseded by the next completion of its key, a delete cancelled it anyway
+		if(Pending.Spawn.IsSet())
+		{
+			OnDropped(Pending.Spawn.GetValue());
+			Pending.Spawn.Reset();
+			NumPending--;
+			INC_DWORD_STAT(STAT_SVoxel_CoalescedCompletions);
+		}
+		
+		if(Completion.bDelete)
+		{
+			Pending.NumDeletes++;
+		}
+		else
+		{
+			Pending.Spawn.Emplace(MoveTemp(Completion));
+		}
+		NumPending++;
+		Completion = FSChunkCompletion();
+	}
+	
+	SET_DWORD_STAT(STAT_SVoxel_CompletionQueueDepth, Num());
+}
+
+int FSChunkCompletionQueue::Drain(const FVector& Location, int SmallestChunkSize, double BudgetSeconds,
+	TFunctionRef<void(const FIntVector& ChunkKey, int LOD, FSPendingChunk& Pending)> Apply)
+{
+	check(IsInGameThread());
+	SCOPE_CYCLE_COUNTER(STAT_SVoxel_DrainCompletions);
+	
+	double StartTime = FPlatformTime::Seconds();
+	
+	struct FOrder
+	{
+		double DistanceSquared;
+		FIntVector ChunkKey;
+		int LOD;
+	};
+	TArray<FOrder> Order;
+	Order.Reserve(NumPending);
+	for(int LOD = 0; LOD < PendingChunks.Num(); LOD++)
+	{
+		double HalfChunkSize = double(SmallestChunkSize) * (1 << LOD) * 0.5;
+		for(const TPair<FIntVector, FSPendingChunk>& Pair : PendingChunks[LOD])
+		{
+			FVector Center = FVector(Pair.Key) + FVector(HalfChunkSize);
+			Order.Add({FVector::DistSquared(Center, Location), Pair.Key, LOD});
+		}
+	}
+	Order.Sort([](const FOrder& A, const FOrder& B)
+	{
+		return A.DistanceSquared < B.DistanceSquared;
+	});
+	
+	int NumApplied = 0;
+	for(const FOrder& Entry : Order)
+	{
+		if(BudgetSeconds > 0.0 && NumApplied > 0 && FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+			break;
+		
+		FSPendingChunk Pending;
+		PendingChunks[Entry.LOD].RemoveAndCopyValue(Entry.ChunkKey, Pending);
+		NumPending -= Pending.NumDeletes + (Pending.Spawn.IsSet() ? 1 : 0);
+		
+		Apply(Entry.ChunkKey, Entry.LOD, Pending);
+		NumApplied++;
+	}
+	
+	SET_DWORD_STAT(STAT_SVoxel_CompletionQueueDepth, Num());
+	SET_FLOAT_STAT(STAT_SVoxel_CompletionDrainMs, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return NumApplied;
+}
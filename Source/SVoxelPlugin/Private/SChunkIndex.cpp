@@ -0,0 +1,236 @@
+﻿#include "SChunkIndex.h"
+#include "SVoxelPlugin.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/BinarySearch.h"
+
+// Spreads the low 19 bits of Value so two zero bits follow each one
+static uint64 SpreadBits(uint64 Value)
+{
+	Value &= 0x1fffff;
+	Value = (Value | Value << 32) & 0x1f00000000ffffull;
+	Value = (Value | Value << 16) & 0x1f0000ff0000ffull;
+	Value = (Value | Value << 8) & 0x100f00f00f00f00full;
+	Value = (Value | Value << 4) & 0x10c30c30c30c30c3ull;
+	Value = (Value | Value << 2) & 0x1249249249249249ull;
+	return Value;
+}
+
+static uint64 CompactBits(uint64 Value)
+{
+	Value &= 0x1249249249249249ull;
+	Value = (Value ^ (Value >> 2)) & 0x10c30c30c30c30c3ull;
+	Value = (Value ^ (Value >> 4)) & 0x100f00f00f00f00full;
+	Value = (Value ^ (Value >> 8)) & 0x1f0000ff0000ffull;
+	Value = (Value ^ (Value >> 16)) & 0x1f00000000ffffull;
+	Value = (Value ^ (Value >> 32)) & 0x1fffff;
+	return Value;
+}
+
+FSChunkIndex FSChunkIndex::FromChunkKey(const FIntVector& ChunkKey, int LOD, int SmallestChunkSize)
+{
+	checkSlow(ChunkKey.X % SmallestChunkSize == 0 && ChunkKey.Y % SmallestChunkSize == 0 && ChunkKey.Z % SmallestChunkSize == 0);
+	return FromCoordinates(ChunkKey / SmallestChunkSize, LOD);
+}
+
+FSChunkIndex FSChunkIndex::FromCoordinates(const FIntVector& Coordinates, int LOD)
+{
+	checkSlow(LOD >= 0 && LOD <= MaxLOD);
+	checkSlow(Coordinates.GetMin() >= MinCoordinate && Coordinates.GetMax() <= MaxCoordinate);
+	
+	//Biased so negative coordinates sort before positive ones
+	uint64 X = uint64(Coordinates.X - MinCoordinate);
+	uint64 Y = uint64(Coordinates.Y - MinCoordinate);
+	uint64 Z = uint64(Coordinates.Z - MinCoordinate);
+	return FSChunkIndex((uint64(LOD) << (BitsPerAxis * 3 + 2)) | SpreadBits(X) | SpreadBits(Y) << 1 | SpreadBits(Z) << 2);
+}
+
+FIntVector FSChunkIndex::GetCoordinates() const
+{
+	//Without the LOD, its bits would be compacted into the axes
+	uint64 Morton = Code & ((uint64(1) << (BitsPerAxis * 3)) - 1);
+	return FIntVector(
+		int(CompactBits(Morton)) + MinCoordinate,
+		int(CompactBits(Morton >> 1)) + MinCoordinate,
+		int(CompactBits(Morton >> 2)) + MinCoordinate);
+}
+
+void FSChunkIndex::SortedDifference(TConstArrayView<FSChunkIndex> SortedA, TConstArrayView<FSChunkIndex> SortedB,
+	TArray<FSChunkIndex>* OutOnlyA, TArray<FSChunkIndex>* OutOnlyB)
+{
+	int A = 0;
+	int B = 0;
+	while (A < SortedA.Num() && B < SortedB.Num())
+	{
+		if (SortedA[A] < SortedB[B])
+		{
+			if (OutOnlyA)
+			{
+				OutOnlyA->Add(SortedA[A]);
+			}
+			A++;
+		}
+		else if (SortedB[B] < SortedA[A])
+		{
+			if (OutOnlyB)
+			{
+				OutOnlyB->Add(SortedB[B]);
+			}
+			B++;
+		}
+		else
+		{
+			A++;
+			B++;
+		}
+	}
+	if (OutOnlyA)
+	{
+		OutOnlyA->Append(SortedA.GetData() + A, SortedA.Num() - A);
+	}
+	if (OutOnlyB)
+	{
+		OutOnlyB->Append(SortedB.GetData() + B, SortedB.Num() - B);
+	}
+}
+
+void FSChunkIndex::SortedMerge(TConstArrayView<FSChunkIndex> Sorted, TConstArrayView<FSChunkIndex> SortedRemove,
+	TConstArrayView<FSChunkIndex> SortedAdd, TArray<FSChunkIndex>& OutSorted)
+{
+	OutSorted.Reset(Sorted.Num() - SortedRemove.Num() + SortedAdd.Num());
+	
+	int Remove = 0;
+	int Add = 0;
+	for (FSChunkIndex Index : Sorted)
+	{
+		while (Remove < SortedRemove.Num() && SortedRemove[Remove] < Index)
+		{
+			Remove++;
+		}
+		if (Remove < SortedRemove.Num() && SortedRemove[Remove] == Index)
+		{
+			Remove++;
+			continue;
+		}
+		
+		while (Add < SortedAdd.Num() && SortedAdd[Add] < Index)
+		{
+			OutSorted.Add(SortedAdd[Add++]);
+		}
+		OutSorted.Add(Index);
+	}
+	OutSorted.Append(SortedAdd.GetData() + Add, SortedAdd.Num() - Add);
+}
+
+bool FSChunkIndex::SortedContains(TConstArrayView<FSChunkIndex> Sorted, FSChunkIndex Index)
+{
+	return Algo::BinarySearch(Sorted, Index) != INDEX_NONE;
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Keys of a cube of chunks around the origin in a scrambled order, like the order chunks complete in
+static void GetBenchmarkChunkKeys(int NumChunks, int ChunkSize, const FIntVector& Offset, TArray<FIntVector>& OutChunkKeys)
+{
+	int Side = FMath::CeilToInt(FMath::Pow(double(NumChunks), 1.0 / 3.0));
+	for (int Index = 0; Index < NumChunks; Index++)
+	{
+		FIntVector Coordinates = FIntVector(Index % Side, Index / Side % Side, Index / (Side * Side)) - FIntVector(Side / 2) + Offset;
+		OutChunkKeys.Add(Coordinates * ChunkSize);
+	}
+	FRandomStream Random(NumChunks);
+	for (int Index = OutChunkKeys.Num() - 1; Index > 0; Index--)
+	{
+		OutChunkKeys.Swap(Index, Random.RandRange(0, Index));
+	}
+}
+
+// Times insert, lookup and a one chunk step set difference of the chunk index containers against TMap and TSet of chunk keys
+static void BenchmarkChunkTable()
+{
+	const int ChunkSize = 3200;
+	for (int NumChunks : {10000, 50000, 100000, 200000})
+	{
+		TArray<FIntVector> ChunkKeys;
+		TArray<FIntVector> MovedChunkKeys;
+		GetBenchmarkChunkKeys(NumChunks, ChunkSize, FIntVector::ZeroValue, ChunkKeys);
+		GetBenchmarkChunkKeys(NumChunks, ChunkSize, FIntVector(1, 0, 0), MovedChunkKeys);
+		
+		TArray<FSChunkIndex> ChunkIndices;
+		for (const FIntVector& ChunkKey : ChunkKeys)
+		{
+			ChunkIndices.Add(FSChunkIndex::FromChunkKey(ChunkKey, 0, ChunkSize));
+		}
+
+		//Insert, the map value stands in for the component pointer and mesh key of a chunk
+		double StartTime = FPlatformTime::Seconds();
+		TMap<FIntVector, uint64> Map;
+		for (int Index = 0; Index < NumChunks; Index++)
+		{
+			Map.Add(ChunkKeys[Index], Index);
+		}
+		double MapInsertTime = FPlatformTime::Seconds() - StartTime;
+
+		StartTime = FPlatformTime::Seconds();
+		TSChunkTable<uint64> Table;
+		for (int Index = 0; Index < NumChunks; Index++)
+		{
+			Table.Add(FSChunkIndex::FromChunkKey(ChunkKeys[Index], 0, ChunkSize), Index);
+		}
+		double TableInsertTime = FPlatformTime::Seconds() - StartTime;
+
+		//Lookup of every key, half of the moved keys miss
+		uint64 MapSum = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (const FIntVector& ChunkKey : MovedChunkKeys)
+		{
+			const uint64* Value = Map.Find(ChunkKey);
+			MapSum += Value ? *Value : 0;
+		}
+		double MapLookupTime = FPlatformTime::Seconds() - StartTime;
+		
+		uint64 TableSum = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (const FIntVector& ChunkKey : MovedChunkKeys)
+		{
+			const uint64* Value = Table.Find(FSChunkIndex::FromChunkKey(ChunkKey, 0, ChunkSize));
+			TableSum += Value ? *Value : 0;
+		}
+		double TableLookupTime = FPlatformTime::Seconds() - StartTime;
+
+		//Difference both ways between the sets before and after a one chunk step, as each container keeps them
+		TSet<FIntVector> Set = TSet<FIntVector>(ChunkKeys);
+		TSet<FIntVector> MovedSet = TSet<FIntVector>(MovedChunkKeys);
+		StartTime = FPlatformTime::Seconds();
+		int NumSetLeaving = Set.Difference(MovedSet).Num();
+		int NumSetEntering = MovedSet.Difference(Set).Num();
+		double SetDifferenceTime = FPlatformTime::Seconds() - StartTime;
+
+		TArray<FSChunkIndex> SortedIndices = ChunkIndices;
+		TArray<FSChunkIndex> MovedSortedIndices;
+		for (const FIntVector& ChunkKey : MovedChunkKeys)
+		{
+			MovedSortedIndices.Add(FSChunkIndex::FromChunkKey(ChunkKey, 0, ChunkSize));
+		}
+		SortedIndices.Sort();
+		MovedSortedIndices.Sort();
+		TArray<FSChunkIndex> Leaving;
+		TArray<FSChunkIndex> Entering;
+		StartTime = FPlatformTime::Seconds();
+		FSChunkIndex::SortedDifference(SortedIndices, MovedSortedIndices, &Leaving, &Entering);
+		double SortedDifferenceTime = FPlatformTime::Seconds() - StartTime;
+
+		bool bMatches = MapSum == TableSum && Map.Num() == Table.Num() && NumSetLeaving == Leaving.Num() && NumSetEntering == Entering.Num();
+		UE_LOG(LogSVoxel, Log, TEXT("%d chunks: insert %.2f / %.2f ms, lookup %.2f / %.2f ms, difference %.2f / %.2f ms, memory %.1f / %.1f MB (TMap and TSet / chunk index)%s"),
+			NumChunks, MapInsertTime * 1000.0, TableInsertTime * 1000.0, MapLookupTime * 1000.0, TableLookupTime * 1000.0,
+			SetDifferenceTime * 1000.0, SortedDifferenceTime * 1000.0,
+			(Map.GetAllocatedSize() + Set.GetAllocatedSize()) / (1024.0 * 1024.0), (Table.GetAllocatedSize() + SortedIndices.GetAllocatedSize()) / (1024.0 * 1024.0),
+			bMatches ? TEXT("") : TEXT(", RESULTS DIFFER"));
+	}
+}
+
+static FAutoConsoleCommand BenchmarkChunkTableCommand(
+	TEXT("SVoxel.BenchmarkChunkTable"),
+	TEXT("Compares insert, lookup and set difference of the chunk index table and sorted arrays with TMap and TSet for 10k to 200k chunks"),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkChunkTable));
+
+#endif
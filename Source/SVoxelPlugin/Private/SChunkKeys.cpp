@@ -0,0 +1,704 @@
+﻿#include "SChunkKeys.h"
+#include "SVoxelPlugin.h"
+#include "SVoxelStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/Accumulate.h"
+
+// Calls Visitor for every cell of the inclusive box A that is outside the inclusive box B.
+// Only the slabs of A outside B are walked on the Z axis, so a thin difference costs its own size plus one face of A.
+static void ForEachInBoxDifference(const FIntVector& AMin, const FIntVector& AMax, const FIntVector& BMin, const FIntVector& BMax,
+	TFunctionRef<void(const FIntVector&)> Visitor)
+{
+	for(int X = AMin.X; X <= AMax.X; X++)
+	{
+		bool bInsideX = X >= BMin.X && X <= BMax.X;
+		for(int Y = AMin.Y; Y <= AMax.Y; Y++)
+		{
+			bool bInsideXY = bInsideX && Y >= BMin.Y && Y <= BMax.Y;
+			if(!bInsideXY)
+			{
+				for(int Z = AMin.Z; Z <= AMax.Z; Z++)
+				{
+					Visitor(FIntVector(X, Y, Z));
+				}
+				continue;
+			}
+
+			int BelowEnd = FMath::Min(AMax.Z, BMin.Z - 1);
+			for(int Z = AMin.Z; Z <= BelowEnd; Z++)
+			{
+				Visitor(FIntVector(X, Y, Z));
+			}
+			int AboveStart = FMath::Max(AMin.Z, BMax.Z + 1);
+			for(int Z = AboveStart; Z <= AMax.Z; Z++)
+			{
+				Visitor(FIntVector(X, Y, Z));
+			}
+		}
+	}
+}
+
+static bool IsInsideBox(const FIntVector& Point, const FIntVector& BoxMin, const FIntVector& BoxMax)
+{
+	return Point.X >= BoxMin.X && Point.X <= BoxMax.X &&
+		Point.Y >= BoxMin.Y && Point.Y <= BoxMax.Y &&
+		Point.Z >= BoxMin.Z && Point.Z <= BoxMax.Z;
+}
+
+static int64 FloorDivide(int64 Value, int64 Divisor)
+{
+	return Value >= 0 ? Value / Divisor : (Value - Divisor + 1) / Divisor;
+}
+
+void FSChunkKeys::GetChunkKeys(const FSChunkKeyParams& Params, TSet<FIntVector>& OutChunkKeys)
+{
+	ForEachChunkKey(Params, [&OutChunkKeys](const FIntVector& ChunkKey)
+	{
+		OutChunkKeys.Add(ChunkKey);
+	});
+}
+
+void FSChunkKeys::GetChunkIndices(const FSChunkKeyParams& Params, TArray<FSChunkIndex>& OutSortedChunkIndices)
+{
+	int SmallestChunkSize = GetSmallestChunkSize(Params);
+	OutSortedChunkIndices.Reset();
+	ForEachChunkKey(Params, [&OutSortedChunkIndices, &Params, SmallestChunkSize](const FIntVector& ChunkKey)
+	{
+		OutSortedChunkIndices.Add(FSChunkIndex::FromChunkKey(ChunkKey, Params.LOD, SmallestChunkSize));
+	});
+	OutSortedChunkIndices.Sort();
+}
+
+void FSChunkKeys::ForEachChunkKey(const FSChunkKeyParams& Params, TFunctionRef<void(const FIntVector&)> Visitor)
+{
+	int drawDistance = Params.DrawDistance;
+	int ChunkSize = Params.ChunkSize;
+	int LOD = Params.LOD;
+	FIntVector BoxOrigin = GetBoxOrigin(Params, LOD);
+	
+	for(int N = 0; N <= (drawDistance-1) * 3; N++)
+	{
+		for(int X = 0; X <= FMath::Min(N, drawDistance-1); X++)
+		{
+			for(int Y = 0; Y <= FMath::Min(N - X, drawDistance-1); Y++)
+			{
+				int Z = N - X - Y;
+				if(Z <= drawDistance-1)
+				{
+					int x0 = X; 
+					for (int i = 0; i >= -1; i--, x0 *= -1)
+					{
+						int y0 = Y;
+						for (int j = 0; j >= -1; j--, y0 *= -1)
+						{
+							int z0 = Z;
+							for (int k = 0; k >= -1; k--, z0 *= -1)
+							{
+								int x = x0 + i; int y = y0 + j; int z = z0 + k;
+
+								FIntVector ChunkPosition = BoxOrigin + FIntVector(x,y,z) * ChunkSize;
+								//The hole follows the finer box, it is not centered on this one
+								if(IsInsideHole(Params, ChunkPosition))
+									continue;
+								
+								int distanceThreshold = GetDistanceThreshold(Params, IsChunkUnderground(Params, ChunkPosition));
+
+								int LODMultiplier = (1 << LOD);
+								if (X * LODMultiplier <= distanceThreshold &&
+									Y * LODMultiplier <= distanceThreshold &&
+									Z * LODMultiplier <= distanceThreshold)
+								{
+									Visitor(ChunkPosition);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+bool FSChunkKeys::ContainsChunkKey(const FSChunkKeyParams& Params, const FIntVector& ChunkKey)
+{
+	if(!IsOnGridOutsideHole(Params, ChunkKey))
+		return false;
+
+	FIntVector DistanceIndex = GetDistanceIndex(Params, ChunkKey);
+	int MaxDistanceIndex = GetMaxDistanceIndex(Params, IsChunkUnderground(Params, ChunkKey));
+	return DistanceIndex.X <= MaxDistanceIndex && DistanceIndex.Y <= MaxDistanceIndex && DistanceIndex.Z <= MaxDistanceIndex;
+}
+
+bool FSChunkKeys::IsOnGridOutsideHole(const FSChunkKeyParams& Params, const FIntVector& ChunkKey)
+{
+	FIntVector Delta = ChunkKey - GetBoxOrigin(Params, Params.LOD);
+	if(Delta.X % Params.ChunkSize != 0 || Delta.Y % Params.ChunkSize != 0 || Delta.Z % Params.ChunkSize != 0)
+		return false;
+
+	return !IsInsideHole(Params, ChunkKey);
+}
+
+FIntVector FSChunkKeys::GetBoxOrigin(const FSChunkKeyParams& Params, int LOD)
+{
+	int64 SmallestChunkSize = GetSmallestChunkSize(Params);
+	int64 Grid = SmallestChunkSize << (LOD + 1);
+	FIntVector BoxOrigin;
+	for(int Axis = 0; Axis < 3; Axis++)
+	{
+		//The origin is truncated towards zero, so the camera chunk lies on the far side of it from zero and spans zero at zero.
+		//Its doubled center is an odd multiple of the smallest chunk size and never ties between two grid points.
+		int64 Origin = Params.OriginLocation[Axis];
+		int64 DoubleCenter = 2 * Origin + FMath::Sign(Origin) * SmallestChunkSize;
+		BoxOrigin[Axis] = int(FloorDivide(DoubleCenter + Grid, 2 * Grid) * Grid);
+	}
+	return BoxOrigin;
+}
+
+FIntVector FSChunkKeys::GetDistanceIndex(const FSChunkKeyParams& Params, const FIntVector& ChunkKey)
+{
+	FIntVector Offset = (ChunkKey - GetBoxOrigin(Params, Params.LOD)) / Params.ChunkSize;
+	return FIntVector(
+		Offset.X >= 0 ? Offset.X : -Offset.X - 1,
+		Offset.Y >= 0 ? Offset.Y : -Offset.Y - 1,
+		Offset.Z >= 0 ? Offset.Z : -Offset.Z - 1);
+}
+
+bool FSChunkKeys::IsInsideHole(const FSChunkKeyParams& Params, const FIntVector& ChunkKey)
+{
+	int LOD = Params.LOD;
+	if(LOD == 0)
+		return false;
+
+	//The finer box origin is on the grid of this LOD, keys are whole chunks away from it
+	FIntVector Offset = (ChunkKey - GetBoxOrigin(Params, LOD - 1)) / Params.ChunkSize;
+	return IsInsideBox(Offset, FIntVector(-LOD), FIntVector(LOD - 1));
+}
+
+FIntVector FSChunkKeys::GetOriginLocation(const FVector& CameraLocation, int ChunkSize, const FIntVector* CurrentOrigin, float HysteresisBand)
+{
+	//Chunk the camera is in, truncated towards zero like the origin always was
+	FIntVector Origin = FIntVector(CameraLocation / ChunkSize) * ChunkSize;
+	if(!CurrentOrigin)
+		return Origin;
+	
+	double Band = double(HysteresisBand) * ChunkSize;
+	for(int Axis = 0; Axis < 3; Axis++)
+	{
+		int Current = (*CurrentOrigin)[Axis];
+		if(Origin[Axis] == Current)
+			continue;
+
+		//Move the camera back towards the current chunk by the band, if that lands in it the axis is kept
+		double Toward = CameraLocation[Axis] > Current ? CameraLocation[Axis] - Band : CameraLocation[Axis] + Band;
+		if(int(Toward / ChunkSize) * ChunkSize == Current)
+		{
+			Origin[Axis] = Current;
+		}
+	}
+	return Origin;
+}
+
+bool FSChunkKeys::GetChunkKeyDelta(const FSChunkKeyParams& OldParams, const FSChunkKeyParams& NewParams,
+	TArray<FIntVector>& OutEnteringChunkKeys, TArray<FIntVector>& OutLeavingChunkKeys)
+{
+	if(OldParams.LOD != NewParams.LOD ||
+		OldParams.ChunkSize != NewParams.ChunkSize ||
+		OldParams.DrawDistance != NewParams.DrawDistance ||
+		OldParams.UndergroundHeight != NewParams.UndergroundHeight ||
+		OldParams.aboveUpperDistance != NewParams.aboveUpperDistance ||
+		OldParams.aboveDownDistance != NewParams.aboveDownDistance ||
+		OldParams.underUpperDistance != NewParams.underUpperDistance ||
+		OldParams.underDownDistance != NewParams.underDownDistance)
+	{
+		return false;
+	}
+
+	//The thresholds depend on which side of the underground height the origin is, every key would have to be checked again
+	if(IsOriginUnderground(OldParams) != IsOriginUnderground(NewParams))
+		return false;
+
+	AddEnteringChunkKeys(OldParams, NewParams, OutEnteringChunkKeys);
+	AddEnteringChunkKeys(NewParams, OldParams, OutLeavingChunkKeys);
+	return true;
+}
+
+void FSChunkKeys::AddEnteringChunkKeys(const FSChunkKeyParams& OldParams, const FSChunkKeyParams& NewParams, TArray<FIntVector>& OutChunkKeys)
+{
+	int ChunkSize = NewParams.ChunkSize;
+	int LOD = NewParams.LOD;
+	FIntVector BoxOrigin = GetBoxOrigin(NewParams, LOD);
+	
+	//Old box origin in chunk offsets from the new one, box origins are on the grid of the next coarser LOD
+	FIntVector Shift = (GetBoxOrigin(OldParams, LOD) - BoxOrigin) / ChunkSize;
+
+	//Per underground state the loaded offsets are a cube minus the LOD hole, a key enters if it leaves the old cube or the old hole
+	auto AddIfEntering = [&](const FIntVector& Offset)
+	{
+		FIntVector ChunkKey = BoxOrigin + Offset * ChunkSize;
+		if(ContainsChunkKey(NewParams, ChunkKey) && !ContainsChunkKey(OldParams, ChunkKey))
+		{
+			OutChunkKeys.Add(ChunkKey);
+		}
+	};
+
+	for(int Underground = 0; Underground <= 1; Underground++)
+	{
+		bool bChunkUnderground = Underground == 1;
+		int MaxDistanceIndex = GetMaxDistanceIndex(NewParams, bChunkUnderground);
+		if(MaxDistanceIndex < 0)
+			continue;
+
+		FIntVector BoxMin = FIntVector(-MaxDistanceIndex - 1);
+		FIntVector BoxMax = FIntVector(MaxDistanceIndex);
+		ForEachInBoxDifference(BoxMin, BoxMax, BoxMin + Shift, BoxMax + Shift, [&](const FIntVector& Offset)
+		{
+			//The other state walks its own cube, skip the keys it owns so none is added twice
+			if(IsChunkUnderground(NewParams, BoxOrigin + Offset * ChunkSize) == bChunkUnderground)
+			{
+				AddIfEntering(Offset);
+			}
+		});
+	}
+
+	if(LOD > 0)
+	{
+		//The holes follow the finer box, which moves on its own grid
+		FIntVector OldHoleCenter = (GetBoxOrigin(OldParams, LOD - 1) - BoxOrigin) / ChunkSize;
+		FIntVector NewHoleCenter = (GetBoxOrigin(NewParams, LOD - 1) - BoxOrigin) / ChunkSize;
+		FIntVector HoleMin = FIntVector(-LOD);
+		FIntVector HoleMax = FIntVector(LOD - 1);
+		ForEachInBoxDifference(OldHoleCenter + HoleMin, OldHoleCenter + HoleMax, NewHoleCenter + HoleMin, NewHoleCenter + HoleMax,
+			[&](const FIntVector& Offset)
+		{
+			//Already walked above if it also left the old cube
+			bool bChunkUnderground = IsChunkUnderground(NewParams, BoxOrigin + Offset * ChunkSize);
+			int MaxDistanceIndex = GetMaxDistanceIndex(NewParams, bChunkUnderground);
+			FIntVector BoxMin = FIntVector(-MaxDistanceIndex - 1);
+			FIntVector BoxMax = FIntVector(MaxDistanceIndex);
+			if(IsInsideBox(Offset, BoxMin, BoxMax) && !IsInsideBox(Offset, BoxMin + Shift, BoxMax + Shift))
+				return;
+			
+			AddIfEntering(Offset);
+		});
+	}
+}
+
+bool FSChunkKeys::IsOriginUnderground(const FSChunkKeyParams& Params)
+{
+	return Params.OriginLocation.Z < Params.UndergroundHeight;
+}
+
+bool FSChunkKeys::IsChunkUnderground(const FSChunkKeyParams& Params, const FIntVector& ChunkKey)
+{
+	return ChunkKey.Z + Params.ChunkSize < Params.UndergroundHeight;
+}
+
+int FSChunkKeys::GetDistanceThreshold(const FSChunkKeyParams& Params, bool bChunkUnderground)
+{
+	return IsOriginUnderground(Params)
+		? (bChunkUnderground ? Params.underDownDistance : Params.underUpperDistance)
+		: (bChunkUnderground ? Params.aboveDownDistance : Params.aboveUpperDistance);
+}
+
+int FSChunkKeys::GetMaxDistanceIndex(const FSChunkKeyParams& Params, bool bChunkUnderground)
+{
+	int DistanceThreshold = GetDistanceThreshold(Params, bChunkUnderground);
+	if(DistanceThreshold < 0)
+		return -1;
+	return FMath::Min(Params.DrawDistance - 1, DistanceThreshold / (1 << Params.LOD));
+}
+
+void FSChunkKeySet::Update(const FSChunkKeyParams& Params, double Time, TConstArrayView<FSChunkKeySet> FinerChunkKeySets, TArray<FSChunkIndex>& ChunkIndices,
+	TArray<FIntVector>& OutNewChunkKeys, TArray<FIntVector>& OutDeleteChunkKeys)
+{
+	int SmallestChunkSize = FSChunkKeys::GetSmallestChunkSize(Params);
+	
+	//Keys that left the load radius, they are kept or deleted below
+	TArray<FIntVector> LeavingChunkKeys;
+	TArray<FIntVector> EnteringChunkKeys;
+	
+	//ChunkIndices is the load set of LastParams plus the retained keys, when the origin moved by whole chunks only the slabs that changed are walked
+	if(LastParams.IsSet() && FSChunkKeys::GetChunkKeyDelta(LastParams.GetValue(), Params, EnteringChunkKeys, LeavingChunkKeys))
+	{
+		for(FSChunkIndex ChunkIndex : RetainedChunkIndices)
+		{
+			FIntVector ChunkKey = ChunkIndex.ToChunkKey(SmallestChunkSize);
+			if(!FSChunkKeys::ContainsChunkKey(Params, ChunkKey))
+			{
+				LeavingChunkKeys.Add(ChunkKey);
+			}
+		}
+		//Held back keys are in the load set of LastParams already, the delta does not walk them again
+		for(FSChunkIndex ChunkIndex : BlockedChunkIndices)
+		{
+			FIntVector ChunkKey = ChunkIndex.ToChunkKey(SmallestChunkSize);
+			if(FSChunkKeys::ContainsChunkKey(Params, ChunkKey))
+			{
+				EnteringChunkKeys.Add(ChunkKey);
+			}
+		}
+	}
+	else
+	{
+		//Both sets are sorted, one merge finds what left and what entered
+		TArray<FSChunkIndex> LoadChunkIndices;
+		TArray<FSChunkIndex> LeavingChunkIndices;
+		TArray<FSChunkIndex> EnteringChunkIndices;
+		FSChunkKeys::GetChunkIndices(Params, LoadChunkIndices);
+		FSChunkIndex::SortedDifference(ChunkIndices, LoadChunkIndices, &LeavingChunkIndices, &EnteringChunkIndices);
+		for(FSChunkIndex ChunkIndex : LeavingChunkIndices)
+		{
+			LeavingChunkKeys.Add(ChunkIndex.ToChunkKey(SmallestChunkSize));
+		}
+		for(FSChunkIndex ChunkIndex : EnteringChunkIndices)
+		{
+			EnteringChunkKeys.Add(ChunkIndex.ToChunkKey(SmallestChunkSize));
+		}
+	}
+	TArray<FSChunkIndex> LastRetainedChunkIndices = MoveTemp(RetainedChunkIndices);
+	RetainedChunkIndices.Reset();
+	TArray<FSChunkIndex> LastBlockedChunkIndices = MoveTemp(BlockedChunkIndices);
+	BlockedChunkIndices.Reset();
+
+	//Keys of this LOD over a key a finer LOD keeps past its load radius, these would draw its space twice
+	TArray<FSChunkIndex> BlockingChunkIndices;
+	int LODChunks = 1 << Params.LOD;
+	for(const FSChunkKeySet& FinerChunkKeySet : FinerChunkKeySets)
+	{
+		for(FSChunkIndex FinerChunkIndex : FinerChunkKeySet.RetainedChunkIndices)
+		{
+			FIntVector Coordinates = FinerChunkIndex.GetCoordinates();
+			FIntVector ChunkCoordinates = FIntVector(
+				int(FloorDivide(Coordinates.X, LODChunks)),
+				int(FloorDivide(Coordinates.Y, LODChunks)),
+				int(FloorDivide(Coordinates.Z, LODChunks))) * LODChunks;
+			BlockingChunkIndices.Add(FSChunkIndex::FromCoordinates(ChunkCoordinates, Params.LOD));
+		}
+	}
+	BlockingChunkIndices.Sort();
+
+	TArray<FSChunkIndex> DeleteChunkIndices;
+	for(const FIntVector& ChunkKey : LeavingChunkKeys)
+	{
+		FSChunkIndex ChunkIndex = FSChunkIndex::FromChunkKey(ChunkKey, Params.LOD, SmallestChunkSize);
+		//A held back key was never generated
+		if(FSChunkIndex::SortedContains(LastBlockedChunkIndices, ChunkIndex))
+			continue;
+		
+		if(ShouldRetain(Params, ChunkKey, ChunkIndex, Time))
+		{
+			RetainedChunkIndices.Add(ChunkIndex);
+			continue;
+		}
+		AddTimes.Remove(ChunkIndex);
+		DeleteTimes.Add(ChunkIndex, Time);
+		DeleteChunkIndices.Add(ChunkIndex);
+		OutDeleteChunkKeys.Add(ChunkKey);
+	}
+
+	TArray<FSChunkIndex> NewChunkIndices;
+	for(const FIntVector& ChunkKey : EnteringChunkKeys)
+	{
+		//A retained key that comes back into the load radius is still loaded, the other entering keys never were
+		FSChunkIndex ChunkIndex = FSChunkIndex::FromChunkKey(ChunkKey, Params.LOD, SmallestChunkSize);
+		if(FSChunkIndex::SortedContains(LastRetainedChunkIndices, ChunkIndex))
+			continue;
+		
+		if(FSChunkIndex::SortedContains(BlockingChunkIndices, ChunkIndex))
+		{
+			BlockedChunkIndices.Add(ChunkIndex);
+			continue;
+		}
+		
+		double DeleteTime;
+		if(DeleteTimes.RemoveAndCopyValue(ChunkIndex, DeleteTime) && Time - DeleteTime < ThrashWindow)
+		{
+			NumThrashes++;
+			INC_DWORD_STAT(STAT_SVoxel_ChunkThrashes);
+			UE_LOG(LogSVoxel, Verbose, TEXT("LOD %d chunk %s generated again %.2f s after its delete"), Params.LOD, *ChunkKey.ToString(), Time - DeleteTime);
+		}
+		AddTimes.Add(ChunkIndex, Time);
+		NewChunkIndices.Add(ChunkIndex);
+		OutNewChunkKeys.Add(ChunkKey);
+	}
+
+	RetainedChunkIndices.Sort();
+	BlockedChunkIndices.Sort();
+	DeleteChunkIndices.Sort();
+	NewChunkIndices.Sort();
+	TArray<FSChunkIndex> LastChunkIndices = MoveTemp(ChunkIndices);
+	FSChunkIndex::SortedMerge(LastChunkIndices, DeleteChunkIndices, NewChunkIndices, ChunkIndices);
+	
+	DeleteTimes.RemoveIf([this, Time](FSChunkIndex ChunkIndex, double DeleteTime)
+	{
+		return Time - DeleteTime >= ThrashWindow;
+	});
+	LastParams = Params;
+}
+
+void FSChunkKeySet::Reset()
+{
+	LastParams.Reset();
+	RetainedChunkIndices.Reset();
+	BlockedChunkIndices.Reset();
+}
+
+bool FSChunkKeySet::ShouldRetain(const FSChunkKeyParams& Params, const FIntVector& ChunkKey, FSChunkIndex ChunkIndex, double Time) const
+{
+	//Off the grid the key overlaps the new keys, in the hole it overlaps the finer LOD
+	if(!FSChunkKeys::IsOnGridOutsideHole(Params, ChunkKey))
+		return false;
+
+	const double* AddTime = AddTimes.Find(ChunkIndex);
+	if(AddTime && Time - *AddTime < MinLifetime)
+		return true;
+	
+	//The box moves in chunks of the next coarser LOD, the margin counts in those so a margin of one absorbs one step of the box.
+	//Thresholds are in LOD 0 chunks, the ones that load nothing keep loading nothing.
+	FSChunkKeyParams UnloadParams = Params;
+	int MarginChunks = UnloadMargin * 2;
+	UnloadParams.DrawDistance += MarginChunks;
+	int MarginDistance = MarginChunks * (1 << Params.LOD);
+	for(int* Distance : {&UnloadParams.aboveUpperDistance, &UnloadParams.aboveDownDistance, &UnloadParams.underUpperDistance, &UnloadParams.underDownDistance})
+	{
+		if(*Distance >= 0)
+		{
+			*Distance += MarginDistance;
+		}
+	}
+	return FSChunkKeys::ContainsChunkKey(UnloadParams, ChunkKey);
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Times a one chunk camera step with the full rebuild plus set differences against the incremental delta
+static void BenchmarkChunkKeys()
+{
+	const int NumFullIterations = 4;
+	const int NumDeltaIterations = 64;
+	
+	for(int DrawDistance = 16; DrawDistance <= 64; DrawDistance += 16)
+	{
+		FSChunkKeyParams OldParams;
+		OldParams.ChunkSize = 100;
+		OldParams.DrawDistance = DrawDistance;
+		OldParams.UndergroundHeight = -1000000000.0f;
+		OldParams.aboveUpperDistance = DrawDistance;
+		OldParams.aboveDownDistance = DrawDistance;
+		OldParams.underUpperDistance = DrawDistance;
+		OldParams.underDownDistance = DrawDistance;
+
+		FSChunkKeyParams NewParams = OldParams;
+		NewParams.OriginLocation.X += NewParams.ChunkSize;
+
+		TSet<FIntVector> OldChunkKeys;
+		FSChunkKeys::GetChunkKeys(OldParams, OldChunkKeys);
+
+		int NumFullNew = 0;
+		int NumFullDelete = 0;
+		double FullStart = FPlatformTime::Seconds();
+		for(int i = 0; i < NumFullIterations; i++)
+		{
+			TSet<FIntVector> CurrentChunkKeys;
+			FSChunkKeys::GetChunkKeys(NewParams, CurrentChunkKeys);
+			NumFullDelete = OldChunkKeys.Difference(CurrentChunkKeys).Num();
+			NumFullNew = CurrentChunkKeys.Difference(OldChunkKeys).Num();
+		}
+		double FullTime = (FPlatformTime::Seconds() - FullStart) * 1000.0 / NumFullIterations;
+
+		int NumDeltaNew = 0;
+		int NumDeltaDelete = 0;
+		double DeltaStart = FPlatformTime::Seconds();
+		for(int i = 0; i < NumDeltaIterations; i++)
+		{
+			TArray<FIntVector> NewChunkKeys;
+			TArray<FIntVector> DeleteChunkKeys;
+			FSChunkKeys::GetChunkKeyDelta(OldParams, NewParams, NewChunkKeys, DeleteChunkKeys);
+			NumDeltaNew = NewChunkKeys.Num();
+			NumDeltaDelete = DeleteChunkKeys.Num();
+		}
+		double DeltaTime = (FPlatformTime::Seconds() - DeltaStart) * 1000.0 / NumDeltaIterations;
+
+		UE_LOG(LogSVoxel, Log, TEXT("Chunk keys draw distance %d (%d keys): full %.3f ms, delta %.3f ms, %d new %d deleted"),
+			DrawDistance, OldChunkKeys.Num(), FullTime, DeltaTime, NumDeltaNew, NumDeltaDelete);
+		if(NumDeltaNew != NumFullNew || NumDeltaDelete != NumFullDelete)
+		{
+			UE_LOG(LogSVoxel, Error, TEXT("Chunk key delta mismatch, full found %d new %d deleted"), NumFullNew, NumFullDelete);
+		}
+	}
+}
+
+static FAutoConsoleCommand BenchmarkChunkKeysCommand(
+	TEXT("SVoxel.BenchmarkChunkKeys"),
+	TEXT("Compares the full chunk key rebuild with the incremental delta for draw distances 16 to 64"),
+	FConsoleCommandDelegate::CreateStatic(&BenchmarkChunkKeys));
+
+struct FSChunkReplayResult
+{
+	int NumPasses = 0;
+	//Per LOD
+	TArray<int64> NumRegenerated;
+	int64 NumThrashes = 0;
+	//LOD 0 chunks covered by more than one loaded key, summed over the passes
+	int64 NumOverlaps = 0;
+};
+
+struct FSChunkReplay
+{
+	const TCHAR* Name;
+	//Chunk border at X the camera moves over, in LOD 0 chunks
+	int Border;
+	double Amplitude;
+	float HysteresisBand;
+	int UnloadMargin;
+	double MinLifetime;
+};
+
+// Moves the camera back and forth over the chunk border at X = Border chunks, Amplitude in chunks, once a second for 20 seconds
+// at 30 frames per second. Passes run like the worker runs them, only when the origin changed.
+static FSChunkReplayResult ReplayCameraJitter(int NumLODs, const FSChunkReplay& Replay)
+{
+	const int ChunkSize = 1600;
+	TArray<FSChunkKeySet> ChunkKeySets;
+	TArray<TArray<FSChunkIndex>> ChunkIndices;
+	ChunkKeySets.SetNum(NumLODs);
+	ChunkIndices.SetNum(NumLODs);
+	for(FSChunkKeySet& ChunkKeySet : ChunkKeySets)
+	{
+		ChunkKeySet.UnloadMargin = Replay.UnloadMargin;
+		ChunkKeySet.MinLifetime = Replay.MinLifetime;
+	}
+
+	FSChunkReplayResult Result;
+	Result.NumRegenerated.SetNumZeroed(NumLODs);
+	TOptional<FIntVector> Origin;
+	//Keys of every LOD generated so far, one that is new again was regenerated
+	TArray<TSet<FIntVector>> GeneratedChunkKeys;
+	GeneratedChunkKeys.SetNum(NumLODs);
+	for(int Frame = 0; Frame < 600; Frame++)
+	{
+		double Time = Frame / 30.0;
+		FVector CameraLocation = FVector(ChunkSize * (Replay.Border + Replay.Amplitude * FMath::Sin(Time * UE_DOUBLE_TWO_PI)), ChunkSize * 0.5, ChunkSize * 0.5);
+		FIntVector NewOrigin = FSChunkKeys::GetOriginLocation(CameraLocation, ChunkSize, Origin.GetPtrOrNull(), Replay.HysteresisBand);
+		if(Origin.IsSet() && NewOrigin == Origin.GetValue())
+			continue;
+		
+		Origin = NewOrigin;
+		Result.NumPasses++;
+		TSet<FSChunkIndex> CoveredChunkIndices;
+		for(int LOD = 0; LOD < NumLODs; LOD++)
+		{
+			FSChunkKeyParams Params;
+			Params.OriginLocation = NewOrigin;
+			Params.LOD = LOD;
+			Params.ChunkSize = ChunkSize << LOD;
+			Params.DrawDistance = (LOD + 1) * 2;
+			Params.UndergroundHeight = -1000000000.0f;
+			Params.aboveUpperDistance = 16;
+			Params.aboveDownDistance = 2;
+			Params.underUpperDistance = 4;
+			Params.underDownDistance = 6;
+			
+			TArray<FIntVector> NewChunkKeys;
+			TArray<FIntVector> DeleteChunkKeys;
+			ChunkKeySets[LOD].Update(Params, Time, TConstArrayView<FSChunkKeySet>(ChunkKeySets.GetData(), LOD), ChunkIndices[LOD],
+				NewChunkKeys, DeleteChunkKeys);
+			for(const FIntVector& ChunkKey : NewChunkKeys)
+			{
+				bool bGenerated = false;
+				GeneratedChunkKeys[LOD].Add(ChunkKey, &bGenerated);
+				Result.NumRegenerated[LOD] += bGenerated;
+			}
+
+			//Every loaded key covers LODChunks LOD 0 chunks on each axis
+			int LODChunks = 1 << LOD;
+			for(FSChunkIndex ChunkIndex : ChunkIndices[LOD])
+			{
+				FIntVector Coordinates = ChunkIndex.GetCoordinates();
+				for(int X = 0; X < LODChunks; X++)
+				{
+					for(int Y = 0; Y < LODChunks; Y++)
+					{
+						for(int Z = 0; Z < LODChunks; Z++)
+						{
+							bool bCovered = false;
+							CoveredChunkIndices.Add(FSChunkIndex::FromCoordinates(Coordinates + FIntVector(X, Y, Z), 0), &bCovered);
+							Result.NumOverlaps += bCovered;
+						}
+					}
+				}
+			}
+		}
+	}
+	for(const FSChunkKeySet& ChunkKeySet : ChunkKeySets)
+	{
+		Result.NumThrashes += ChunkKeySet.GetNumThrashes();
+	}
+	return Result;
+}
+
+static FString FormatPerLOD(const TArray<int64>& Values)
+{
+	return FString::JoinBy(Values, TEXT("/"), [](int64 Value) { return FString::Printf(TEXT("%lld"), Value); });
+}
+
+// Replays a camera stepping back and forth over the borders that move the box of LOD 0, 1 and 2, and checks that with the unload
+// margin or the lifetime alone no LOD generates a chunk twice and no space is drawn by two LODs. The same steps with hard thresholds
+// have to generate chunks again, or the replay did not move the boxes at all.
+static void CheckChunkHysteresis()
+{
+	const int NumLODs = 3;
+	//The lifetime alone has to outlast the replay
+	const FSChunkReplay Replays[] = {
+		{TEXT("LOD 0 steps with the unload margin"), 1, 0.75, 0.25f, 1, 2.0},
+		{TEXT("LOD 1 steps with the unload margin"), 2, 0.75, 0.25f, 1, 2.0},
+		{TEXT("LOD 2 steps with the unload margin"), 4, 0.75, 0.25f, 1, 2.0},
+		{TEXT("LOD 0 steps with the lifetime"), 1, 0.75, 0.25f, 0, 30.0},
+		{TEXT("LOD 1 steps with the lifetime"), 2, 0.75, 0.25f, 0, 30.0},
+		{TEXT("LOD 2 steps with the lifetime"), 4, 0.75, 0.25f, 0, 30.0},
+	};
+
+	bool bPassed = true;
+	for(const FSChunkReplay& Replay : Replays)
+	{
+		FSChunkReplay HardReplay = Replay;
+		HardReplay.HysteresisBand = 0.0f;
+		HardReplay.UnloadMargin = 0;
+		HardReplay.MinLifetime = 0.0;
+		FSChunkReplayResult Result = ReplayCameraJitter(NumLODs, Replay);
+		FSChunkReplayResult HardResult = ReplayCameraJitter(NumLODs, HardReplay);
+		
+		UE_LOG(LogSVoxel, Log, TEXT("Chunk hysteresis, %s: %s chunks generated again, %lld thrashes and %lld overlaps in %d passes, %s, %lld and %lld in %d passes with hard thresholds"),
+			Replay.Name, *FormatPerLOD(Result.NumRegenerated), Result.NumThrashes, Result.NumOverlaps, Result.NumPasses,
+			*FormatPerLOD(HardResult.NumRegenerated), HardResult.NumThrashes, HardResult.NumOverlaps, HardResult.NumPasses);
+		for(int LOD = 0; LOD < NumLODs; LOD++)
+		{
+			if(Result.NumRegenerated[LOD] != 0)
+			{
+				UE_LOG(LogSVoxel, Error, TEXT("Chunk hysteresis, %s: LOD %d chunks were generated again"), Replay.Name, LOD);
+				bPassed = false;
+			}
+		}
+		if(Result.NumThrashes != 0 || Result.NumOverlaps != 0 || HardResult.NumOverlaps != 0)
+		{
+			UE_LOG(LogSVoxel, Error, TEXT("Chunk hysteresis, %s: chunks thrashed or two LODs overlapped"), Replay.Name);
+			bPassed = false;
+		}
+		if(Algo::Accumulate(HardResult.NumRegenerated, int64(0)) == 0)
+		{
+			UE_LOG(LogSVoxel, Error, TEXT("Chunk hysteresis, %s: the replay moved no chunks"), Replay.Name);
+			bPassed = false;
+		}
+	}
+	if(bPassed)
+	{
+		UE_LOG(LogSVoxel, Log, TEXT("Chunk hysteresis check passed"));
+	}
+}
+
+static FAutoConsoleCommand CheckChunkHysteresisCommand(
+	TEXT("SVoxel.CheckChunkHysteresis"),
+	TEXT("Replays a camera stepping back and forth over the chunk borders that move each LOD and checks no chunk is generated twice or drawn by two LODs"),
+	FConsoleCommandDelegate::CreateStatic(&CheckChunkHysteresis));
+
+#endif
@@ -0,0 +1,144 @@
+﻿#include "SChunkMeshCache.h"
+#include "SVoxelStats.h"
+
+FSChunkMeshCache::FSChunkMeshCache(int64 InMaxMemory)
+	: MaxMemory(InMaxMemory)
+{
+}
+
+FSChunkMeshCache::~FSChunkMeshCache()
+{
+	Empty();
+}
+
+int64 FSChunkMeshCache::GetMemorySize(const FSDispatchCSOutput& Output)
+{
+	//The ranges of a GPU driven chunk shrink once its counts are back, the page keeps the current size
+	int NumVertices = Output.NumVertices;
+	int NumIndices = Output.NumIndices;
+	if (Output.Allocation.IsValid())
+	{
+		Output.Allocation->GetSize(NumVertices, NumIndices);
+	}
+	
+	return int64(NumVertices) * (sizeof(FVector3f) * 2 + sizeof(FVector4f)) + int64(NumIndices) * sizeof(uint32)
+		+ Output.Vertices.GetAllocatedSize() + Output.Indices.GetAllocatedSize();
+}
+
+void FSChunkMeshCache::Add(const FSChunkMeshKey& Key, const FSDispatchCSOutput& Output)
+{
+	if (Output.bCancelled || Output.HasOverflowed() || !Output.OutputVertices || !Output.OutputTris)
+		return;
+	
+	AddEntry(Key, Output);
+}
+
+void FSChunkMeshCache::AddEmpty(const FSChunkMeshKey& Key)
+{
+	AddEntry(Key, FSDispatchCSOutput());
+}
+
+void FSChunkMeshCache::AddEntry(const FSChunkMeshKey& Key, const FSDispatchCSOutput& Output)
+{
+	//The bookkeeping is charged as well, so empty chunks count against the budget and are evicted like the others
+	int64 MemorySize = GetMemorySize(Output) + sizeof(FEntry) + sizeof(FSChunkMeshKey) + sizeof(TDoubleLinkedList<FSChunkMeshKey>::TDoubleLinkedListNode);
+	
+	FScopeLock ScopeLock(&Lock);
+	Remove(Key);
+	if (MemorySize > MaxMemory)
+		return;
+
+	while (Memory + MemorySize > MaxMemory)
+	{
+		FSChunkMeshKey LeastRecentKey = AddOrder.GetTail()->GetValue();
+		Remove(LeastRecentKey);
+		NumEvictions++;
+		INC_DWORD_STAT(STAT_SVoxel_MeshCacheEvictions);
+	}
+
+	AddOrder.AddHead(Key);
+	Entries.Add(Key, FEntry(Output, MemorySize, AddOrder.GetHead()));
+	Memory += MemorySize;
+	INC_MEMORY_STAT_BY(STAT_SVoxel_MeshCacheMemory, MemorySize);
+}
+
+bool FSChunkMeshCache::Take(const FSChunkMeshKey& Key, FSDispatchCSOutput& OutOutput)
+{
+	FScopeLock ScopeLock(&Lock);
+	FEntry* Entry = Entries.Find(Key);
+	//A GPU driven output can overflow after it was cached, it draws nothing
+	if (Entry && Entry->Output.HasOverflowed())
+	{
+		Remove(Key);
+		Entry = nullptr;
+	}
+	if (!Entry)
+	{
+		NumMisses++;
+		INC_DWORD_STAT(STAT_SVoxel_MeshCacheMisses);
+		return false;
+	}
+	
+	OutOutput = MoveTemp(Entry->Output);
+	Remove(Key);
+	NumHits++;
+	INC_DWORD_STAT(STAT_SVoxel_MeshCacheHits);
+	return true;
+}
+
+bool FSChunkMeshCache::Contains(const FSChunkMeshKey& Key) const
+{
+	FScopeLock ScopeLock(&Lock);
+	const FEntry* Entry = Entries.Find(Key);
+	return Entry && !Entry->Output.HasOverflowed();
+}
+
+void FSChunkMeshCache::Remove(const FSChunkMeshKey& Key)
+{
+	FEntry Entry;
+	if (Entries.RemoveAndCopyValue(Key, Entry))
+	{
+		AddOrder.RemoveNode(Entry.Node);
+		Memory -= Entry.MemorySize;
+		DEC_MEMORY_STAT_BY(STAT_SVoxel_MeshCacheMemory, Entry.MemorySize);
+	}
+}
+
+void FSChunkMeshCache::Empty()
+{
+	FScopeLock ScopeLock(&Lock);
+	DEC_MEMORY_STAT_BY(STAT_SVoxel_MeshCacheMemory, Memory);
+	Entries.Empty();
+	AddOrder.Empty();
+	Memory = 0;
+}
+
+int64 FSChunkMeshCache::GetMemory() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Memory;
+}
+
+int FSChunkMeshCache::Num() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Entries.Num();
+}
+
+int64 FSChunkMeshCache::GetNumHits() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return NumHits;
+}
+
+int64 FSChunkMeshCache::GetNumMisses() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return NumMisses;
+}
+
+int64 FSChunkMeshCache::GetNumEvictions() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return NumEvictions;
+}
@@ -0,0 +1,45 @@
+﻿#include "SChunkScheduler.h"
+
+void FSChunkScheduler::Reset(const FVector& NewViewLocation, const FVector& NewViewDirection, int NewSmallestChunkSize)
+{
+	Tasks.Reset();
+	
+	ViewLocation = NewViewLocation;
+	ViewDirection = NewViewDirection.GetSafeNormal(UE_SMALL_NUMBER, FVector::ForwardVector);
+	SmallestChunkSize = FMath::Max(NewSmallestChunkSize, 1);
+}
+
+void FSChunkScheduler::Push(const FIntVector& ChunkKey, int LOD, int ChunkSize)
+{
+	Tasks.HeapPush(FSChunkTask(ChunkKey, LOD, GetPriority(ChunkKey, LOD, ChunkSize)), FTaskPredicate());
+}
+
+void FSChunkScheduler::PushPrefetch(const FIntVector& ChunkKey, int LOD, int ChunkSize)
+{
+	Tasks.HeapPush(FSChunkTask(ChunkKey, LOD, GetPriority(ChunkKey, LOD, ChunkSize), true), FTaskPredicate());
+}
+
+bool FSChunkScheduler::Pop(FSChunkTask& OutTask)
+{
+	if(Tasks.IsEmpty())
+		return false;
+	
+	Tasks.HeapPop(OutTask, FTaskPredicate());
+	return true;
+}
+
+float FSChunkScheduler::GetPriority(const FIntVector& ChunkKey, int LOD, int ChunkSize) const
+{
+	//Chunk keys are the min corner of the chunk, measure from its center
+	FVector ChunkCenter = FVector(ChunkKey) + FVector(ChunkSize * 0.5f);
+	FVector ToChunk = ChunkCenter - ViewLocation;
+
+	//Distance in units of the smallest chunk so every LOD shares the same scale
+	float Distance = ToChunk.Size() / SmallestChunkSize;
+
+	//Chunks behind the camera count as up to twice as far away, the chunk the camera is in is always in view.
+	float ViewDot = ToChunk.IsNearlyZero() ? 1.0f : FVector::DotProduct(ToChunk / ToChunk.Size(), ViewDirection);
+	float ViewFactor = FMath::GetMappedRangeValueClamped(FVector2f(-1.0f, 1.0f), FVector2f(2.0f, 1.0f), ViewDot);
+	
+	return Distance * ViewFactor + LOD;
+}
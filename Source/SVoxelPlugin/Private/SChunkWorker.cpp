@@ -2,13 +2,38 @@
 
 #include "SChunkWorker.h" // Change this to reference the header file above
 #include "SDispatchCS.h"
+#include "SVoxelPlugin.h"
+#include "SVoxelStats.h"
+#include "Misc/Paths.h"
+#include "Algo/Unique.h"
+#include "HAL/IConsoleManager.h"
 
-FSChunkWorker::FSChunkWorker(ASChunkWorld* NewChunkWorld, int NewLOD)
+FSChunkWorker::FSChunkWorker(ASChunkWorld* NewChunkWorld)
 {
 	ChunkWorldPointer = NewChunkWorld;
-	LOD = NewLOD;
 	MaxConcurrentTasks = NewChunkWorld->MaxConcurrentTasks;
+	MeshCache = NewChunkWorld->MeshCache;
+	if(!NewChunkWorld->RegionArchiveDirectory.IsEmpty())
+	{
+		FString Directory = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), NewChunkWorld->RegionArchiveDirectory);
+		RegionReader = MakeShared<FSRegionReader, ESPMode::ThreadSafe>(Directory);
+	}
+	StartThread();
+}
+
+FSChunkWorker::FSChunkWorker(int NewMaxConcurrentTasks, FSChunkMeshCacheRef NewMeshCache)
+{
+	MaxConcurrentTasks = NewMaxConcurrentTasks;
+	MeshCache = NewMeshCache;
+	StartThread();
+}
 
+void FSChunkWorker::StartThread()
+{
+	DispatchEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	TaskCompleteEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	
+	bRunThread = true;
 	Thread = FRunnableThread::Create(this, TEXT("SWorkerThread"));
 }
 
@@ -20,6 +45,11 @@ FSChunkWorker::~FSChunkWorker()
 		delete Thread;
 		Thread = nullptr;
 	}
+	
+	FPlatformProcess::ReturnSynchEventToPool(DispatchEvent);
+	DispatchEvent = nullptr;
+	FPlatformProcess::ReturnSynchEventToPool(TaskCompleteEvent);
+	TaskCompleteEvent = nullptr;
 }
 
 void FSChunkWorker::StopAndEnsureCompletion()
@@ -36,141 +66,665 @@ bool FSChunkWorker::Init()
 	return true;
 }
 
-uint32 FSChunkWorker::Run()
+void FSChunkWorker::PublishInput(const FChunkInput& NewChunkInput)
 {
-	bRunThread = true;
+	InputExchange.GetWriteBuffer() = NewChunkInput;
+	InputExchange.Publish();
 	
+	DispatchEvent->Trigger();
+}
+
+bool FSChunkWorker::WaitForTaskSlot()
+{
+	while (NewChunkTasks.GetValue() >= MaxConcurrentTasks)
+	{
+		if(!bRunThread)
+			return false;
+		TaskCompleteEvent->Wait();
+	}
+	return bRunThread;
+}
+
+void FSChunkWorker::OnTaskCompleted()
+{
+	NewChunkTasks.Decrement();
+	TaskCompleteEvent->Trigger();
+}
+
+FSChunkKeyParams FChunkInput::GetChunkKeyParams(int LOD) const
+{
+	FSChunkKeyParams Params;
+	Params.OriginLocation = OriginLocation;
+	Params.LOD = LOD;
+	Params.ChunkSize = GetChunkSize(LOD);
+	Params.DrawDistance = (LOD + 1) * 2;
+	Params.UndergroundHeight = UndergroundHeight;
+	Params.aboveUpperDistance = aboveUpperDistance;
+	Params.aboveDownDistance = aboveDownDistance;
+	Params.underUpperDistance = underUpperDistance;
+	Params.underDownDistance = underDownDistance;
+	return Params;
+}
+
+int FChunkInput::GetChunkSize(int LOD) const
+{
+	return Size * 100 * (1 << LOD) * Scale;
+}
+
+//Index of the chunk from its mesh key alone, callbacks must not read the input of the worker
+static FSChunkIndex GetChunkIndex(const FSChunkMeshKey& MeshKey)
+{
+	return FSChunkIndex::FromChunkKey(MeshKey.ChunkKey, MeshKey.LOD, MeshKey.Size * 100 * MeshKey.Scale);
+}
+
+FSChunkMeshKey FSChunkWorker::GetMeshKey(const FIntVector& ChunkKey, int LOD) const
+{
+	FSChunkMeshKey MeshKey;
+	MeshKey.ChunkKey = ChunkKey;
+	MeshKey.LOD = LOD;
+	MeshKey.WorldSize = ChunkInput.WorldSize;
+	MeshKey.Size = ChunkInput.Size;
+	MeshKey.Scale = ChunkInput.Scale;
+	MeshKey.Isolevel = ChunkInput.Isolevel;
+	MeshKey.Seed = ChunkInput.seed;
+	MeshKey.bCollision = ChunkInput.bCollisionEnabled && LOD == 0;
+	return MeshKey;
+}
+
+uint32 FSChunkWorker::Run()
+{
 	while (bRunThread)
 	{
-		if (bInputReady)
+		NumRunIterations++;
+		
+		//The readbacks wake the thread for the chunks that overflowed, they are generated again between passes
+		RedispatchOverflowedChunks();
+		
+		//Sleep until the chunk world publishes a new origin, Stop() also triggers the event to wake us up.
+		//Inputs published while the last pass ran are skipped, only the newest one is generated.
+		if (!InputExchange.Update())
+		{
+			DispatchEvent->Wait();
+			continue;
+		}
+		ChunkInput = InputExchange.GetReadBuffer();
+
+		int NumLODs = ChunkInput.MaxLOD + 1;
+		
+		TArray<TArray<FIntVector>> DeleteChunkKeys;
+		CurrentChunkIndices.SetNum(NumLODs);
+		DeleteChunkKeys.SetNum(NumLODs);
+		ChunkKeySets.SetNum(NumLODs);
+		double PassTime = FPlatformTime::Seconds();
+		{
+			FScopeLock Lock(&InFlightChunksLock);
+			InFlightChunks.SetNum(NumLODs);
+		}
+		int Pass = PassCounter.Increment();
+
+		//Queue the new chunks of every LOD together so the closest ones are dispatched first
+		Scheduler.Reset(ChunkInput.CameraLocation, ChunkInput.CameraDirection, ChunkInput.GetChunkSize(0));
+		int NumNearFieldChunks = 0;
+		
+		for(int LOD = 0; LOD < NumLODs; LOD++)
 		{
-			if(bDispatched)
+			FSChunkKeyParams KeyParams = ChunkInput.GetChunkKeyParams(LOD);
+			TArray<FIntVector> NewChunkKeys;
+
+			//CurrentChunkIndices holds the sorted keys the key set built last pass, including the keys it keeps past the load radius
+			FSChunkKeySet& ChunkKeySet = ChunkKeySets[LOD];
+			ChunkKeySet.UnloadMargin = ChunkInput.UnloadMargin;
+			ChunkKeySet.MinLifetime = ChunkInput.MinChunkLifetime;
+			ChunkKeySet.Update(KeyParams, PassTime, TConstArrayView<FSChunkKeySet>(ChunkKeySets.GetData(), LOD), CurrentChunkIndices[LOD],
+				NewChunkKeys, DeleteChunkKeys[LOD]);
+
+			CancelInFlightChunks(LOD, DeleteChunkKeys[LOD]);
+			
+			for (const FIntVector& SpawnChunkKey : NewChunkKeys)
 			{
-				if(NewChunkTasks.GetValue() <= 0)
-				{
-					bInputReady = false;
-					bDispatched = false;
-				}
+				Scheduler.Push(SpawnChunkKey, LOD, ChunkInput.GetChunkSize(LOD));
 			}
-			else
+			if(LOD == 0)
 			{
-				TSet<FIntVector> CurrentChunkKeys;
+				NumNearFieldChunks = NewChunkKeys.Num();
+			}
+		}
+		QueuePrefetchChunks();
+		
+		NearFieldTasks.Set(NumNearFieldChunks);
+		bSimulatedPass = ChunkInput.bSimulateDispatch;
+		PassStartTime = FPlatformTime::Seconds();
 
-				int drawDistance = (LOD + 1) * 2;
-				int ChunkSize =  ChunkInput.Size * 100 * (1 << LOD) * ChunkInput.Scale;
+		TArray<FSChunkTask> BatchTasks;
+		FSChunkTask Task;
+		while (Scheduler.Pop(Task))
+		{
+			if(!WaitForTaskSlot())
+				return 0;
+			//Prefetches come last and are dropped once a newer input waits, the next pass predicts the path again
+			if(Task.bPrefetch && InputExchange.IsPending())
+				break;
+			NewChunkTasks.Increment();
+			BatchTasks.Add(Task);
 
-				bool bOriginUnderground = ChunkInput.OriginLocation.Z < ChunkInput.UndergroundHeight;
+			//Keep filling the batch while slots are free, it is generated with one dispatch per stage
+			bool bSlotsFull = NewChunkTasks.GetValue() >= MaxConcurrentTasks;
+			if(bSlotsFull || BatchTasks.Num() >= FSDispatchCSInterface::MaxBatchSize || Scheduler.IsEmpty())
+			{
+				DispatchChunks(BatchTasks, Pass);
+				BatchTasks.Reset();
+			}
+		}
+		if(!BatchTasks.IsEmpty())
+		{
+			DispatchChunks(BatchTasks, Pass);
+		}
+		for(int LOD = 0; LOD < NumLODs; LOD++)
+		{
+			for(FIntVector& DeleteChunkKey : DeleteChunkKeys[LOD])
+			{
+				if(!WaitForTaskSlot())
+					return 0;
+				NewChunkTasks.Increment();
 				
-				for(int N = 0; N <= (drawDistance-1) * 3; N++)
-				{
-					for(int X = 0; X <= FMath::Min(N, drawDistance-1); X++)
-					{
-						for(int Y = 0; Y <= FMath::Min(N - X, drawDistance-1); Y++)
-						{
-							int Z = N - X - Y;
-							if(Z <= drawDistance-1)
-							{
-								if(X < LOD && Y < LOD && Z < LOD)
-									continue;
-
-								int x0 = X; 
-								for (int i = 0; i >= -1; i--, x0 *= -1)
-								{
-									int y0 = Y;
-									for (int j = 0; j >= -1; j--, y0 *= -1)
-									{
-										int z0 = Z;
-										for (int k = 0; k >= -1; k--, z0 *= -1)
-										{
-											int x = x0 + i; int y = y0 + j; int z = z0 + k;
-
-											FIntVector ChunkPosition = ChunkInput.OriginLocation + FIntVector(x,y,z) * ChunkSize;
-											bool bChunkUnderground = ChunkPosition.Z+ChunkSize < ChunkInput.UndergroundHeight;
-											
-											int distanceThreshold = (bOriginUnderground)
-											? (bChunkUnderground ? ChunkInput.underDownDistance : ChunkInput.underUpperDistance)
-											: (bChunkUnderground ? ChunkInput.aboveDownDistance : ChunkInput.aboveUpperDistance);
-
-											int LODMultiplier = (1 << LOD);
-											if (X * LODMultiplier <= distanceThreshold &&
-												Y * LODMultiplier <= distanceThreshold &&
-												Z * LODMultiplier <= distanceThreshold)
-											{
-												CurrentChunkKeys.Add(ChunkPosition);
-											}
-										}
-									}
-								}
-							}
-						}
-					}
-				}
-				TSet<FIntVector> DeleteChunkKeys = ChunkInput.OldChunks.Difference(CurrentChunkKeys);
-				TSet<FIntVector> NewChunkKeys = CurrentChunkKeys.Difference( ChunkInput.OldChunks);
-				TSet<FIntVector> AllChunkKeys = CurrentChunkKeys;
+				FSChunkCompletion Completion;
+				Completion.MeshKey.ChunkKey = DeleteChunkKey;
+				Completion.MeshKey.LOD = LOD;
+				Completion.bDelete = true;
+				CompletionQueue.Enqueue(MoveTemp(Completion));
+			}
+		}
+		//The next input is taken while the last dispatches are still in flight, the ones it deletes get cancelled
+		NumPasses++;
+	}
+	return 0;
+}
 
-				NewChunkTasks.Reset();
-				for (FIntVector& SpawnChunkKey : NewChunkKeys)
+void FSChunkWorker::DispatchChunks(const TArray<FSChunkTask>& Tasks, int Pass)
+{
+	//GPU driven chunks are handed back as soon as they are submitted, they must not wait on a counted batch
+	TArray<FSChunkTask> BatchTasks[2];
+	TArray<FSDispatchCSParams> BatchParams[2];
+	TArray<FSChunkTask> UploadTasks;
+	TArray<FSDispatchCancelToken> UploadCancelTokens;
+	TArray<FSChunkMeshData> UploadMeshes;
+	
+	for(const FSChunkTask& Task : Tasks)
+	{
+		UE_LOG(LogSVoxel, Verbose, TEXT("Dispatching LOD %d chunk %s with priority %f"), Task.LOD, *Task.ChunkKey.ToString(), Task.Priority);
+
+		int LOD = Task.LOD;
+		FIntVector SpawnChunkKey = Task.ChunkKey;
+		FSChunkMeshKey MeshKey = GetMeshKey(SpawnChunkKey, LOD);
+		
+		FSDispatchCancelToken CancelToken;
+		bool bPrefetchedEmpty = false;
+		if(Task.bPrefetch)
+		{
+			if(!StartPrefetch(Task, CancelToken))
+			{
+				OnTaskCompleted();
+				continue;
+			}
+		}
+		else
+		{
+			//The prefetch in flight completes the chunk and keeps its own slot
+			if(TakeOverPrefetch(Task, Pass, bPrefetchedEmpty))
+			{
+				OnTaskCompleted();
+				continue;
+			}
+			
+			CancelToken = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+			FScopeLock Lock(&InFlightChunksLock);
+			InFlightChunks[LOD].Add(SpawnChunkKey, CancelToken);
+		}
+
+		//A chunk deleted or prefetched a moment ago comes back from the cache, it is spawned like a dispatch that completed right away.
+		//A cached or prefetched empty chunk spawns nothing the same way.
+		FSDispatchCSOutput CachedOutput;
+		if(bPrefetchedEmpty || (!Task.bPrefetch && MeshCache && MeshCache->Take(MeshKey, CachedOutput)))
+		{
+			FSChunkCompletion Completion;
+			Completion.MeshKey = MeshKey;
+			Completion.Output = MoveTemp(CachedOutput);
+			Completion.CancelToken = CancelToken;
+			Completion.Pass = Pass;
+			CompletionQueue.Enqueue(MoveTemp(Completion));
+			continue;
+		}
+		
+		if(ChunkInput.bSimulateDispatch)
+		{
+			//CPU only simulation, stand in for the GPU latency without touching the render thread. The empty output
+			//completes the chunk like a dispatch would.
+			float SimulatedDispatchTime = ChunkInput.SimulatedDispatchTime;
+			TWeakPtr<FSChunkWorker, ESPMode::ThreadSafe> WeakWorker = AsShared();
+			AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [WeakWorker, SimulatedDispatchTime, Task, MeshKey, Pass, CancelToken]()
+			{
+				FPlatformProcess::Sleep(SimulatedDispatchTime);
+				if(TSharedPtr<FSChunkWorker, ESPMode::ThreadSafe> Worker = WeakWorker.Pin())
 				{
-					if(!bRunThread)
-						return 0;
-					while (NewChunkTasks.GetValue() >= MaxConcurrentTasks)
-					{
-						if(!bRunThread)
-							return 0;
-						FPlatformProcess::Sleep(0.01f);
-					}
-					NewChunkTasks.Increment();
-					
-					FVector3f VoxelOffset = FVector3f(SpawnChunkKey) / 100;
-            
-					FSDispatchCSParams SDispatchCSParams = FSDispatchCSParams(ChunkInput.WorldSize, ChunkInput.Size, ChunkInput.Isolevel,VoxelOffset,
-						LOD, ChunkInput.Scale, ChunkInput.seed);
-
-					FSDispatchCSInterface::Dispatch(SDispatchCSParams, [this, SpawnChunkKey]
-						(FSDispatchCSOutput SDispatchCSOutput)
-					{
-						if(ChunkWorldPointer.IsValid())
-						{
-							ASChunkWorld* ChunkWorldRef = ChunkWorldPointer.Get();
-							ChunkWorldRef->SpawnChunkMesh(SpawnChunkKey, LOD, SDispatchCSOutput);
-						}
-						NewChunkTasks.Decrement();
-					});
+					TArray<FSDispatchCSOutput> Outputs;
+					Outputs.SetNum(1);
+					Worker->SpawnChunks({Task}, {CancelToken}, {MeshKey}, Outputs, Pass);
 				}
-				for(FIntVector& DeleteChunkKey : DeleteChunkKeys)
-                {
-					if(!bRunThread)
-						return 0;
-
-					while (NewChunkTasks.GetValue() >= MaxConcurrentTasks)
-					{
-						if(!bRunThread)
-							return 0;
-						FPlatformProcess::Sleep(0.01f);
-					}
-					NewChunkTasks.Increment();
-					
-                    AsyncTask(ENamedThreads::GameThread, [this, DeleteChunkKey]()
-                    {
-                    	if(ChunkWorldPointer.IsValid())
-                    	{
-                    		ASChunkWorld* ChunkWorldRef = ChunkWorldPointer.Get();
-                    		ChunkWorldRef->DeleteChunkMesh(DeleteChunkKey, LOD);
-                    	}
-                    	NewChunkTasks.Decrement();
-                     });
-                }
-				CurrentChunks = CurrentChunkKeys;
-				bDispatched = true;
+			});
+			continue;
+		}
+
+		//Baked chunks are read from the mapped region files and only uploaded, empty ones spawn nothing. Only LOD 0 is baked.
+		FSChunkMeshData Mesh;
+		if(LOD == 0 && RegionReader && RegionReader->LoadChunk(MeshKey, Mesh))
+		{
+			UploadTasks.Add(Task);
+			UploadCancelTokens.Add(CancelToken);
+			UploadMeshes.Add(MoveTemp(Mesh));
+			continue;
+		}
+
+		//Collision needs the geometry on the cpp side, which only the counted path reads back. A chunk that overflowed its GPU driven
+		//range once would overflow again.
+		bool bGPUDriven = ChunkInput.bGPUDrivenDispatch && !ChunkInput.bDeterministicDispatch && (LOD > 0 || !ChunkInput.bCollisionEnabled)
+			&& !CountedChunks.Contains(GetChunkIndex(MeshKey));
+		
+		FVector3f VoxelOffset = FVector3f(SpawnChunkKey) / 100;
+		FSDispatchCSParams& Params = BatchParams[bGPUDriven].Add_GetRef(FSDispatchCSParams(ChunkInput.WorldSize, ChunkInput.Size,
+			ChunkInput.Isolevel, VoxelOffset, LOD, ChunkInput.Scale, ChunkInput.seed, CancelToken, bGPUDriven));
+		Params.bDeterministic = ChunkInput.bDeterministicDispatch;
+		BatchTasks[bGPUDriven].Add(Task);
+	}
+
+	for(int Mode = 0; Mode < 2; Mode++)
+	{
+		if(!BatchParams[Mode].IsEmpty())
+		{
+			DispatchBatch(BatchTasks[Mode], BatchParams[Mode], Pass);
+		}
+	}
+	if(!UploadMeshes.IsEmpty())
+	{
+		UploadBatch(UploadTasks, UploadCancelTokens, MoveTemp(UploadMeshes), Pass);
+	}
+}
+
+void FSChunkWorker::DispatchBatch(const TArray<FSChunkTask>& BatchTasks, const TArray<FSDispatchCSParams>& BatchParams, int Pass)
+{
+	TArray<FSDispatchCancelToken> CancelTokens;
+	TArray<FSChunkMeshKey> MeshKeys;
+	for(int ChunkIndex = 0; ChunkIndex < BatchTasks.Num(); ChunkIndex++)
+	{
+		CancelTokens.Add(BatchParams[ChunkIndex].CancelToken);
+		MeshKeys.Add(GetMeshKey(BatchTasks[ChunkIndex].ChunkKey, BatchTasks[ChunkIndex].LOD));
+	}
+	
+	//The outputs only go into the completion queue, they do not need the game thread. The render thread may finish the batch after
+	//the chunk world released the worker.
+	TWeakPtr<FSChunkWorker, ESPMode::ThreadSafe> WeakWorker = AsShared();
+	FSDispatchCSInterface::DispatchBatch(BatchParams, [WeakWorker, BatchTasks, CancelTokens, MeshKeys, Pass]
+		(TArray<FSDispatchCSOutput> SDispatchCSOutputs)
+	{
+		if(TSharedPtr<FSChunkWorker, ESPMode::ThreadSafe> Worker = WeakWorker.Pin())
+		{
+			Worker->SpawnChunks(BatchTasks, CancelTokens, MeshKeys, SDispatchCSOutputs, Pass);
+		}
+	}, ENamedThreads::AnyBackgroundThreadNormalTask, [WeakWorker, MeshKeys](TArray<int> OverflowIndices)
+	{
+		if(TSharedPtr<FSChunkWorker, ESPMode::ThreadSafe> Worker = WeakWorker.Pin())
+		{
+			for(int ChunkIndex : OverflowIndices)
+			{
+				Worker->OverflowedChunks.Enqueue(MeshKeys[ChunkIndex]);
 			}
+			Worker->DispatchEvent->Trigger();
 		}
+	});
+}
+
+void FSChunkWorker::UploadBatch(const TArray<FSChunkTask>& BatchTasks, const TArray<FSDispatchCancelToken>& CancelTokens,
+	TArray<FSChunkMeshData> Meshes, int Pass)
+{
+	TArray<FSChunkMeshKey> MeshKeys;
+	for(const FSChunkTask& Task : BatchTasks)
+	{
+		MeshKeys.Add(GetMeshKey(Task.ChunkKey, Task.LOD));
+	}
+	
+	TWeakPtr<FSChunkWorker, ESPMode::ThreadSafe> WeakWorker = AsShared();
+	FSDispatchCSInterface::UploadBatch(MoveTemp(Meshes), [WeakWorker, BatchTasks, CancelTokens, MeshKeys, Pass]
+		(TArray<FSDispatchCSOutput> Outputs)
+	{
+		if(TSharedPtr<FSChunkWorker, ESPMode::ThreadSafe> Worker = WeakWorker.Pin())
+		{
+			Worker->SpawnChunks(BatchTasks, CancelTokens, MeshKeys, Outputs, Pass);
+		}
+	}, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void FSChunkWorker::SpawnChunks(const TArray<FSChunkTask>& BatchTasks, const TArray<FSDispatchCancelToken>& CancelTokens,
+	const TArray<FSChunkMeshKey>& MeshKeys, TArray<FSDispatchCSOutput>& Outputs, int Pass)
+{
+	for(int ChunkIndex = 0; ChunkIndex < BatchTasks.Num(); ChunkIndex++)
+	{
+		FIntVector SpawnChunkKey = BatchTasks[ChunkIndex].ChunkKey;
+		int LOD = BatchTasks[ChunkIndex].LOD;
+		const FSDispatchCancelToken& CancelToken = CancelTokens[ChunkIndex];
+		
+		//Prefetches no chunk task took over only fill the cache
+		int ChunkPass = Pass;
+		if(BatchTasks[ChunkIndex].bPrefetch && !FinishPrefetch(MeshKeys[ChunkIndex], CancelToken, Outputs[ChunkIndex], ChunkPass))
+			continue;
+		
+		//The delete of a cancelled chunk is queued after its token was set, so it must not spawn anymore. An output that overflowed
+		//already is generated again, it would only replace the new one.
+		if(*CancelToken || Outputs[ChunkIndex].HasOverflowed())
+		{
+			if(!Outputs[ChunkIndex].bCancelled)
+			{
+				INC_DWORD_STAT(STAT_SVoxel_WastedDispatches);
+			}
+			RemoveInFlightChunk(SpawnChunkKey, LOD, CancelToken);
+			OnChunkCompleted(LOD, ChunkPass);
+			continue;
+		}
+		
+		FSChunkCompletion Completion;
+		Completion.MeshKey = MeshKeys[ChunkIndex];
+		Completion.Output = MoveTemp(Outputs[ChunkIndex]);
+		Completion.CancelToken = CancelToken;
+		Completion.Pass = ChunkPass;
+		CompletionQueue.Enqueue(MoveTemp(Completion));
+	}
+}
+
+void FSChunkWorker::DrainCompletions(const FVector& CameraLocation, int SmallestChunkSize, float BudgetMs)
+{
+	ASChunkWorld* ChunkWorldRef = ChunkWorldPointer.Get();
+	
+	CompletionQueue.Gather([this](FSChunkCompletion& Completion)
+	{
+		CompleteSpawn(Completion, nullptr);
+	});
+	CompletionQueue.Drain(CameraLocation, SmallestChunkSize, BudgetMs / 1000.0, [this, ChunkWorldRef]
+		(const FIntVector& ChunkKey, int LOD, FSPendingChunk& Pending)
+	{
+		if(Pending.NumDeletes > 0)
+		{
+			if(ChunkWorldRef)
+			{
+				ChunkWorldRef->DeleteChunkMesh(ChunkKey, LOD);
+			}
+			for(int Index = 0; Index < Pending.NumDeletes; Index++)
+			{
+				OnTaskCompleted();
+			}
+		}
+		if(Pending.Spawn.IsSet())
+		{
+			CompleteSpawn(Pending.Spawn.GetValue(), ChunkWorldRef);
+		}
+	});
+}
+
+void FSChunkWorker::CompleteSpawn(FSChunkCompletion& Completion, ASChunkWorld* ChunkWorldRef)
+{
+	const FSChunkMeshKey& MeshKey = Completion.MeshKey;
+	if(*Completion.CancelToken || !ChunkWorldRef)
+	{
+		if(MeshCache)
+		{
+			MeshCache->Add(MeshKey, Completion.Output);
+		}
+	}
+	else
+	{
+		ChunkWorldRef->SpawnChunkMesh(MeshKey, MoveTemp(Completion.Output));
+	}
+	RemoveInFlightChunk(MeshKey.ChunkKey, MeshKey.LOD, Completion.CancelToken);
+	OnChunkCompleted(MeshKey.LOD, Completion.Pass);
+}
+
+void FSChunkWorker::GetPrefetchChunkIndices(TArray<FSChunkIndex>& OutSortedChunkIndices) const
+{
+	OutSortedChunkIndices.Reset();
+	int SmallestChunkSize = ChunkInput.GetChunkSize(0);
+	FVector Path = ChunkInput.CameraVelocity * ChunkInput.PrefetchHorizon;
+	//One origin per chunk the path crosses
+	int NumSteps = FMath::Min(FMath::CeilToInt(Path.Size() / SmallestChunkSize), MaxPrefetchSteps);
+	
+	FIntVector LastOrigin = ChunkInput.OriginLocation;
+	TArray<FSChunkIndex> StepChunkIndices;
+	for(int Step = 1; Step <= NumSteps; Step++)
+	{
+		FIntVector Origin = FSChunkKeys::GetOriginLocation(ChunkInput.CameraLocation + Path * Step / NumSteps, SmallestChunkSize, nullptr, 0.0f);
+		if(Origin == LastOrigin)
+			continue;
+		LastOrigin = Origin;
+		
+		for(int LOD = 0; LOD < CurrentChunkIndices.Num(); LOD++)
+		{
+			FSChunkKeyParams Params = ChunkInput.GetChunkKeyParams(LOD);
+			Params.OriginLocation = Origin;
+			FSChunkKeys::GetChunkIndices(Params, StepChunkIndices);
+			FSChunkIndex::SortedDifference(StepChunkIndices, CurrentChunkIndices[LOD], &OutSortedChunkIndices, nullptr);
+		}
+	}
+	//Origins next to each other load mostly the same chunks
+	OutSortedChunkIndices.Sort();
+	OutSortedChunkIndices.SetNum(Algo::Unique(OutSortedChunkIndices));
+}
+
+void FSChunkWorker::QueuePrefetchChunks()
+{
+	TArray<FSChunkIndex> PrefetchChunkIndices;
+	GetPrefetchChunkIndices(PrefetchChunkIndices);
+	int SmallestChunkSize = ChunkInput.GetChunkSize(0);
+	
+	FScopeLock Lock(&InFlightChunksLock);
+	//The camera turned away from these. Prefetches a chunk task took over, or whose chunk is loaded now and waits for its task, stay.
+	PrefetchChunks.RemoveIf([this, &PrefetchChunkIndices](FSChunkIndex ChunkIndex, const FSPrefetchChunk& Prefetch)
+	{
+		int LOD = ChunkIndex.GetLOD();
+		if(Prefetch.TakenOverPass != INDEX_NONE || FSChunkIndex::SortedContains(PrefetchChunkIndices, ChunkIndex)
+			|| (CurrentChunkIndices.IsValidIndex(LOD) && FSChunkIndex::SortedContains(CurrentChunkIndices[LOD], ChunkIndex)))
+			return false;
+		
+		if(!Prefetch.bDone)
+		{
+			*Prefetch.CancelToken = true;
+			INC_DWORD_STAT(STAT_SVoxel_CancelledPrefetches);
+		}
+		return true;
+	});
+	
+	for(FSChunkIndex ChunkIndex : PrefetchChunkIndices)
+	{
+		if(!PrefetchChunks.Contains(ChunkIndex))
+		{
+			int LOD = ChunkIndex.GetLOD();
+			Scheduler.PushPrefetch(ChunkIndex.ToChunkKey(SmallestChunkSize), LOD, ChunkInput.GetChunkSize(LOD));
+		}
+	}
+}
+
+bool FSChunkWorker::StartPrefetch(const FSChunkTask& Task, FSDispatchCancelToken& OutCancelToken)
+{
+	FSChunkMeshKey MeshKey = GetMeshKey(Task.ChunkKey, Task.LOD);
+	if(MeshCache && MeshCache->Contains(MeshKey))
+		return false;
+	
+	FSChunkIndex ChunkIndex = GetChunkIndex(MeshKey);
+	FScopeLock Lock(&InFlightChunksLock);
+	if(PrefetchChunks.Contains(ChunkIndex))
+		return false;
+	
+	FSPrefetchChunk Prefetch;
+	Prefetch.CancelToken = MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false);
+	OutCancelToken = Prefetch.CancelToken;
+	PrefetchChunks.Add(ChunkIndex, MoveTemp(Prefetch));
+	INC_DWORD_STAT(STAT_SVoxel_PrefetchedChunks);
+	return true;
+}
+
+bool FSChunkWorker::TakeOverPrefetch(const FSChunkTask& Task, int Pass, bool& bOutEmpty)
+{
+	FSChunkIndex ChunkIndex = FSChunkIndex::FromChunkKey(Task.ChunkKey, Task.LOD, ChunkInput.GetChunkSize(0));
+	FScopeLock Lock(&InFlightChunksLock);
+	FSPrefetchChunk* Prefetch = PrefetchChunks.Find(ChunkIndex);
+	//One taken over before was deleted again, its cancelled output must not complete this task
+	if(!Prefetch || Prefetch->TakenOverPass != INDEX_NONE)
+		return false;
+	
+	INC_DWORD_STAT(STAT_SVoxel_PrefetchHits);
+	if(Prefetch->bDone)
+	{
+		//The mesh waits in the cache, unless it was evicted since
+		bOutEmpty = Prefetch->bEmpty;
+		PrefetchChunks.Remove(ChunkIndex);
+		return false;
+	}
+	
+	//In flight under the token of the prefetch from now on, a delete of the chunk cancels the prefetch
+	Prefetch->TakenOverPass = Pass;
+	InFlightChunks[Task.LOD].Add(Task.ChunkKey, Prefetch->CancelToken);
+	return true;
+}
+
+bool FSChunkWorker::FinishPrefetch(const FSChunkMeshKey& MeshKey, const FSDispatchCancelToken& CancelToken, const FSDispatchCSOutput& Output,
+	int& OutPass)
+{
+	{
+		FScopeLock Lock(&InFlightChunksLock);
+		FSChunkIndex ChunkIndex = GetChunkIndex(MeshKey);
+		FSPrefetchChunk* Prefetch = PrefetchChunks.Find(ChunkIndex);
+		//A cancelled prefetch was removed already, and the chunk may have been prefetched again since
+		if(Prefetch && Prefetch->CancelToken == CancelToken)
+		{
+			if(Prefetch->TakenOverPass != INDEX_NONE)
+			{
+				OutPass = Prefetch->TakenOverPass;
+				PrefetchChunks.Remove(ChunkIndex);
+				return true;
+			}
+			Prefetch->bDone = true;
+			Prefetch->bEmpty = !Output.OutputVertices || !Output.OutputTris;
+		}
+	}
+	
+	if(*CancelToken)
+	{
+		if(!Output.bCancelled)
+		{
+			INC_DWORD_STAT(STAT_SVoxel_WastedDispatches);
+		}
+	}
+	else if(MeshCache)
+	{
+		MeshCache->Add(MeshKey, Output);
+	}
+	OnTaskCompleted();
+	return false;
+}
+
+void FSChunkWorker::CancelInFlightChunks(int LOD, const TArray<FIntVector>& DeleteChunkKeys)
+{
+	FScopeLock Lock(&InFlightChunksLock);
+	for(const FIntVector& DeleteChunkKey : DeleteChunkKeys)
+	{
+		FSDispatchCancelToken CancelToken;
+		if(InFlightChunks[LOD].RemoveAndCopyValue(DeleteChunkKey, CancelToken))
+		{
+			*CancelToken = true;
+		}
+	}
+}
+
+void FSChunkWorker::RemoveInFlightChunk(const FIntVector& ChunkKey, int LOD, const FSDispatchCancelToken& CancelToken)
+{
+	FScopeLock Lock(&InFlightChunksLock);
+	if(!InFlightChunks.IsValidIndex(LOD))
+		return;
+	
+	//The key may have been dispatched again with a new token after this one was cancelled
+	FSDispatchCancelToken* InFlightToken = InFlightChunks[LOD].Find(ChunkKey);
+	if(InFlightToken && *InFlightToken == CancelToken)
+	{
+		InFlightChunks[LOD].Remove(ChunkKey);
+	}
+}
+
+void FSChunkWorker::OnChunkCompleted(int LOD, int Pass)
+{
+	//Chunks of an older pass can still finish after the next one started, only time the current one
+	if(LOD == 0 && Pass == PassCounter.GetValue() && NearFieldTasks.Decrement() == 0)
+	{
+		double FillTime = (FPlatformTime::Seconds() - PassStartTime) * 1000.0;
+		if(bSimulatedPass)
+		{
+			UE_LOG(LogSVoxel, Log, TEXT("Near field filled in %.2f ms"), FillTime);
+		}
+		else
+		{
+			UE_LOG(LogSVoxel, Verbose, TEXT("Near field filled in %.2f ms"), FillTime);
+		}
+	}
+	OnTaskCompleted();
+}
+
+void FSChunkWorker::RedispatchOverflowedChunks()
+{
+	TArray<FSChunkTask> Tasks;
+	FSChunkMeshKey MeshKey;
+	while(OverflowedChunks.Dequeue(MeshKey))
+	{
+		FSChunkIndex ChunkIndex = GetChunkIndex(MeshKey);
+		CountedChunks.Add(ChunkIndex);
+		
+		//Deleted or prefetched chunks and ones of older settings are only regenerated when they are loaded next, the cache never
+		//hands out an overflowed output
+		int LOD = MeshKey.LOD;
+		if(!(MeshKey == GetMeshKey(MeshKey.ChunkKey, LOD)) || !CurrentChunkIndices.IsValidIndex(LOD) ||
+			!FSChunkIndex::SortedContains(CurrentChunkIndices[LOD], ChunkIndex))
+			continue;
+		
+		FSChunkTask Task;
+		Task.ChunkKey = MeshKey.ChunkKey;
+		Task.LOD = LOD;
+		Task.Priority = 0.0f;
+		Tasks.Add(Task);
+	}
+	if(Tasks.IsEmpty())
+		return;
+	
+	UE_LOG(LogSVoxel, Log, TEXT("Generating %d overflowed GPU driven chunks again on the counted path"), Tasks.Num());
+	
+	//Their spawn replaces the overflowed mesh
+	TArray<FSChunkTask> BatchTasks;
+	for(const FSChunkTask& Task : Tasks)
+	{
+		if(!WaitForTaskSlot())
+			return;
+		NewChunkTasks.Increment();
+		BatchTasks.Add(Task);
+		if(BatchTasks.Num() >= FSDispatchCSInterface::MaxBatchSize)
+		{
+			DispatchChunks(BatchTasks, RedispatchPass);
+			BatchTasks.Reset();
+		}
+	}
+	if(!BatchTasks.IsEmpty())
+	{
+		DispatchChunks(BatchTasks, RedispatchPass);
 	}
-	return 0;
 }
 
 void FSChunkWorker::Exit()
 {
+	for(int LOD = 0; LOD < ChunkKeySets.Num(); LOD++)
+	{
+		UE_LOG(LogSVoxel, Log, TEXT("LOD %d chunk thrashes: %lld"), LOD, ChunkKeySets[LOD].GetNumThrashes());
+	}
 }
 
 
@@ -179,4 +733,73 @@ void FSChunkWorker::Stop()
 	ChunkWorldPointer.Reset();
 	
 	bRunThread = false;
-}
\ No newline at end of file
+
+	//Wake the thread up if it is blocked so it can exit
+	DispatchEvent->Trigger();
+	TaskCompleteEvent->Trigger();
+}
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Starts a worker without a chunk world and checks its thread sleeps on the dispatch event, before its first input and again once
+// it generated a simulated pass. A busy-spinning thread goes through its loop thousands of times while idle.
+static void CheckWorkerIdle()
+{
+	constexpr float IdleTime = 0.5f;
+	TSharedPtr<FSChunkWorker, ESPMode::ThreadSafe> Worker = MakeShared<FSChunkWorker, ESPMode::ThreadSafe>(8, nullptr);
+	auto CountIdleIterations = [&Worker, IdleTime]()
+	{
+		int StartIterations = Worker->GetNumRunIterations();
+		FPlatformProcess::Sleep(IdleTime);
+		return Worker->GetNumRunIterations() - StartIterations;
+	};
+
+	//Give the thread time to start and reach the event
+	FPlatformProcess::Sleep(0.1f);
+	int NumIdleIterations = CountIdleIterations();
+
+	FChunkInput ChunkInput;
+	ChunkInput.WorldSize = FIntVector3(200000, 200000, 3000);
+	ChunkInput.UndergroundHeight = -1000000000.0f;
+	ChunkInput.Size = 16;
+	ChunkInput.Scale = 1;
+	ChunkInput.OriginLocation = FIntVector::ZeroValue;
+	ChunkInput.Isolevel = 0.0f;
+	ChunkInput.seed = 1337;
+	ChunkInput.bSimulateDispatch = true;
+	ChunkInput.SimulatedDispatchTime = 0.001f;
+	ChunkInput.PrefetchHorizon = 0.0f;
+	Worker->PublishInput(ChunkInput);
+
+	//The completions wait for the game thread, which is this one
+	const int SmallestChunkSize = ChunkInput.GetChunkSize(0);
+	bool bPassDone = false;
+	double Deadline = FPlatformTime::Seconds() + 10.0;
+	while (!bPassDone && FPlatformTime::Seconds() < Deadline)
+	{
+		Worker->DrainCompletions(FVector::ZeroVector, SmallestChunkSize, 0.0f);
+		bPassDone = Worker->GetNumPasses() > 0;
+		FPlatformProcess::Sleep(0.01f);
+	}
+	//The last simulated dispatches of the pass complete after it
+	for (int Drain = 0; Drain < 10; Drain++)
+	{
+		FPlatformProcess::Sleep(0.01f);
+		Worker->DrainCompletions(FVector::ZeroVector, SmallestChunkSize, 0.0f);
+	}
+	int NumPassIdleIterations = CountIdleIterations();
+
+	Worker->StopAndEnsureCompletion();
+	Worker.Reset();
+
+	bool bPassed = bPassDone && NumIdleIterations == 0 && NumPassIdleIterations == 0;
+	UE_LOG(LogSVoxel, Log, TEXT("Chunk worker idle: %d loop iterations in %.1f s before the first input, %d in %.1f s after a simulated pass%s, %s"),
+		NumIdleIterations, IdleTime, NumPassIdleIterations, IdleTime, bPassDone ? TEXT("") : TEXT(" that never finished"),
+		bPassed ? TEXT("ok") : TEXT("FAILED"));
+}
+
+static FAutoConsoleCommand CheckWorkerIdleCommand(
+	TEXT("SVoxel.CheckWorkerIdle"),
+	TEXT("Runs a chunk worker with simulated dispatches and checks its thread blocks instead of spinning while it has no new input"),
+	FConsoleCommandDelegate::CreateStatic(&CheckWorkerIdle));
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "SChunkWorld.h"
 #include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
 #include "ProceduralMeshComponent.h"
 #include "SMeshComponent.h"
 #include "MCCountVertsCS.h"
@@ -11,6 +12,11 @@
 #include "NoiseCS.h"
 #include "SDispatchCS.h"
 #include "SChunkWorker.h"
+#include "SVoxelPlugin.h"
+#include "SVoxelStats.h"
+#include "UObject/UObjectGlobals.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 
 // Sets default values
 ASChunkWorld::ASChunkWorld()
@@ -32,28 +38,78 @@ void ASChunkWorld::BeginPlay()
 {
 	Super::BeginPlay();
 
-	ChunkWorkers.SetNum(MaxLOD + 1);
-	for(int LOD = 0; LOD <= MaxLOD; LOD++)
+	MeshCache = MakeShared<FSChunkMeshCache, ESPMode::ThreadSafe>(int64(MeshCacheMemoryMB) * 1024 * 1024);
+	ChunkWorker = MakeShared<FSChunkWorker, ESPMode::ThreadSafe>(this);
+	PublishedOrigin.Reset();
+	PublishedPrefetchOrigin.Reset();
+	LastCameraLocation.Reset();
+	CameraVelocity = FVector::ZeroVector;
+	if(bReplayFlythrough)
 	{
-		ChunkWorkers[LOD] = new FSChunkWorker(this, LOD);
+		LoadFlythrough();
 	}
 	
 	ChunkLODs.SetNum(MaxLOD + 1);
+
+	//Created up front so the first burst of chunks does not create components
+	if(bPoolComponents)
+	{
+		for(int Index = 0; Index < PrewarmedComponents; Index++)
+		{
+			ComponentPool.Add(AcquireMeshComponent());
+		}
+		SET_DWORD_STAT(STAT_SVoxel_PooledComponents, ComponentPool.Num());
+	}
+
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddUObject(this, &ASChunkWorld::OnPreGarbageCollect);
+	FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &ASChunkWorld::OnPostGarbageCollect);
 }
 
 void ASChunkWorld::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 	
-	for(int LOD = 0; LOD <= MaxLOD; LOD++)
+	//Dispatches still in flight only hold the worker weakly, the last of them to finish frees it if they outlive this
+	if(ChunkWorker)
 	{
-		if(FSChunkWorker* ChunkWorker = ChunkWorkers[LOD])
-		{
-			ChunkWorker->StopAndEnsureCompletion();
-			delete ChunkWorker;
-			ChunkWorker = nullptr;
-		}
+		ChunkWorker->StopAndEnsureCompletion();
+		ChunkWorker.Reset();
 	}
+
+	if(MeshCache)
+	{
+		UE_LOG(LogSVoxel, Log, TEXT("Mesh cache: %lld hits, %lld misses, %lld evictions"), MeshCache->GetNumHits(), MeshCache->GetNumMisses(),
+			MeshCache->GetNumEvictions());
+		MeshCache->Empty();
+		MeshCache.Reset();
+	}
+
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().RemoveAll(this);
+	FCoreUObjectDelegates::GetPostGarbageCollect().RemoveAll(this);
+	
+	UE_LOG(LogSVoxel, Log, TEXT("Chunk components: %d spawned at %.3f ms, %d deleted at %.3f ms on the game thread, %d created, %d pooled"),
+		NumSpawnedChunks, FPlatformTime::ToMilliseconds64(SpawnCycles) / FMath::Max(NumSpawnedChunks, 1),
+		NumDeletedChunks, FPlatformTime::ToMilliseconds64(DeleteCycles) / FMath::Max(NumDeletedChunks, 1), NumCreatedComponents, ComponentPool.Num());
+	UE_LOG(LogSVoxel, Log, TEXT("Garbage collections while playing: %d, %.2f ms on average"), NumGarbageCollections,
+		GarbageCollectionTime * 1000.0 / FMath::Max(NumGarbageCollections, 1));
+	UE_LOG(LogSVoxel, Log, TEXT("Hole frames: %d of %d (%.1f%%), %lld missing chunks"), NumHoleFrames, NumCheckedFrames,
+		NumHoleFrames * 100.0 / FMath::Max(NumCheckedFrames, 1), NumHoleChunks);
+
+	if(!bReplayFlythrough && !FlythroughFile.IsEmpty())
+	{
+		SaveFlythrough();
+	}
+	FlythroughSamples.Empty();
+	FlythroughStartTime.Reset();
+	FlythroughSample = 0;
+	bFlythroughFinished = false;
+	
+	for(USMeshComponent* MeshComponent : ComponentPool)
+	{
+		MeshComponent->DestroyComponent();
+	}
+	ComponentPool.Empty();
+	SET_DWORD_STAT(STAT_SVoxel_PooledComponents, 0);
 }
 
 void ASChunkWorld::Tick(float DeltaSeconds)
@@ -70,58 +126,316 @@ void ASChunkWorld::UpdateChunks()
 		return;
 	FVector camLocation = viewLocations[0];
 
-	int SmallestChunkSize = Size * 100 * Scale;
-	FIntVector OriginLocation = FIntVector(camLocation/SmallestChunkSize) * SmallestChunkSize;
+	FVector camDirection = FVector::ForwardVector;
+	if(APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0))
+	{
+		camDirection = CameraManager->GetCameraRotation().Vector();
+	}
 	
-	for(int LOD = 0; LOD <= MaxLOD; LOD++)
+	double Time = GetWorld()->GetTimeSeconds();
+	UpdateFlythrough(Time, camLocation, camDirection);
+	UpdateCameraVelocity(Time, camLocation);
+
+	if(ChunkWorker)
 	{
-		FSChunkWorker* ChunkWorker = ChunkWorkers[LOD];
-		if(ChunkWorker)
-		{
-			if(ChunkWorker->bInputReady == false)
-			{
-				ChunkLODs[LOD].CurrentChunkKeys = ChunkWorker->CurrentChunks;
+		int SmallestChunkSize = Size * 100 * Scale;
+		ChunkWorker->DrainCompletions(camLocation, SmallestChunkSize, CompletionBudgetMs);
 		
-				ChunkWorker->ChunkInput = FChunkInput(ChunkLODs[LOD].CurrentChunkKeys,
-					FIntVector3(WorldSize), UndergroundHeight, aboveUpperDistance, aboveDownDistance, underUpperDistance, underDownDistance,
-					Size, Scale, OriginLocation, Isolevel, seed);
+		const FIntVector* CurrentOrigin = PublishedOrigin.IsSet() ? &PublishedOrigin.GetValue() : nullptr;
+		FIntVector OriginLocation = FSChunkKeys::GetOriginLocation(camLocation, SmallestChunkSize, CurrentOrigin, OriginHysteresis);
+		const FIntVector* CurrentPrefetchOrigin = PublishedPrefetchOrigin.IsSet() ? &PublishedPrefetchOrigin.GetValue() : nullptr;
+		FIntVector PrefetchOrigin = FSChunkKeys::GetOriginLocation(camLocation + CameraVelocity * PrefetchHorizon, SmallestChunkSize,
+			CurrentPrefetchOrigin, OriginHysteresis);
 		
-				ChunkWorker->bInputReady = true;
-			}
+		FChunkInput NewChunkInput = FChunkInput(
+			FIntVector3(WorldSize), UndergroundHeight, aboveUpperDistance, aboveDownDistance, underUpperDistance, underDownDistance,
+			Size, Scale, OriginLocation, Isolevel, seed,
+			MaxLOD, camLocation, camDirection, bSimulateDispatch, SimulatedDispatchTime,
+			bGPUDrivenDispatch, bCollisionEnabled);
+		NewChunkInput.UnloadMargin = UnloadMargin;
+		NewChunkInput.MinChunkLifetime = MinChunkLifetime;
+		NewChunkInput.CameraVelocity = CameraVelocity;
+		NewChunkInput.PrefetchHorizon = PrefetchHorizon;
+		NewChunkInput.bDeterministicDispatch = bDeterministicDispatch;
+		CheckHoles(camLocation, NewChunkInput.GetChunkKeyParams(0));
+		
+		//Only wake the worker up when the camera, or where it is headed, moved past the band into a different chunk. The worker
+		//keeps the chunk keys of its last pass itself, a busy worker skips to the newest input once it is done.
+		if(!PublishedOrigin.IsSet() || PublishedOrigin.GetValue() != OriginLocation || PublishedPrefetchOrigin.GetValue() != PrefetchOrigin)
+		{
+			ChunkWorker->PublishInput(NewChunkInput);
+			PublishedOrigin = OriginLocation;
+			PublishedPrefetchOrigin = PrefetchOrigin;
 		}
 	}
 }
 
-void ASChunkWorld::SpawnChunkMesh(FIntVector ChunkKey, int LOD, FSDispatchCSOutput DispatchCSOutput)
+void ASChunkWorld::SpawnChunkMesh(const FSChunkMeshKey& MeshKey, FSDispatchCSOutput DispatchCSOutput)
 {
+	const FIntVector& ChunkKey = MeshKey.ChunkKey;
+	int LOD = MeshKey.LOD;
+	FSChunkIndex ChunkIndex = FSChunkIndex::FromChunkKey(ChunkKey, LOD, Size * 100 * Scale);
+	
+	//Only a chunk generated again after its GPU driven output overflowed is spawned over itself, the old mesh drew nothing
+	if(FChunk* OverflowedChunk = ChunkLODs[LOD].Chunks.Find(ChunkIndex))
+	{
+		if(OverflowedChunk->Mesh)
+		{
+			ReleaseMeshComponent(OverflowedChunk->Mesh);
+		}
+		ChunkLODs[LOD].Chunks.Remove(ChunkIndex);
+	}
+	
 	if(DispatchCSOutput.OutputVertices && DispatchCSOutput.OutputTris)
 	{
+		SCOPE_CYCLE_COUNTER(STAT_SVoxel_SpawnChunkMesh);
+		uint64 StartCycles = FPlatformTime::Cycles64();
+		
 		//If we got to this point then that means vertex and index count is > 0
-		USMeshComponent* Chunk = NewObject<USMeshComponent>(this, NAME_None);
+		USMeshComponent* Chunk = AcquireMeshComponent();
 		if(Chunk)
 		{
-			Chunk->RegisterComponent();
-			Chunk->AttachToComponent(GetRootComponent(), FAttachmentTransformRules::KeepWorldTransform);
+			//The section is set before the component is registered, so its render state is only created once
 			Chunk->SetWorldLocation(FVector(ChunkKey));
 			Chunk->SetBoundsScale(BoundsScale);
                     
 			Chunk->CreateMeshSection(DispatchCSOutput, Material, Size, LOD, Scale, bCollisionEnabled, CollisionProfileName);
+			Chunk->RegisterComponent();
 				
-			ChunkLODs[LOD].Chunks.Add(ChunkKey, FChunk(Chunk));
+			ChunkLODs[LOD].Chunks.Add(ChunkIndex, FChunk(Chunk, MeshKey));
 		}
+		
+		SpawnCycles += FPlatformTime::Cycles64() - StartCycles;
+		NumSpawnedChunks++;
+	}
+	else
+	{
+		//Kept without a mesh so the chunk counts as done, not as a hole
+		ChunkLODs[LOD].Chunks.Add(ChunkIndex, FChunk(nullptr, MeshKey));
 	}
 }
 
 void ASChunkWorld::DeleteChunkMesh(FIntVector ChunkKey, int LOD)
 {
-	if(FChunk* DeleteChunkPointer = ChunkLODs[LOD].Chunks.Find(ChunkKey))
+	FSChunkIndex ChunkIndex = FSChunkIndex::FromChunkKey(ChunkKey, LOD, Size * 100 * Scale);
+	if(FChunk* DeleteChunkPointer = ChunkLODs[LOD].Chunks.Find(ChunkIndex))
 	{
 		FChunk DeleteChunk = *DeleteChunkPointer;
 		if(USMeshComponent* DeleteChunkMesh = DeleteChunk.Mesh)
 		{
-			DeleteChunkMesh->UnregisterComponent();
-			DeleteChunkMesh->DestroyComponent();
+			SCOPE_CYCLE_COUNTER(STAT_SVoxel_DeleteChunkMesh);
+			uint64 StartCycles = FPlatformTime::Cycles64();
+			
+			if(MeshCache)
+			{
+				MeshCache->Add(DeleteChunk.MeshKey, DeleteChunkMesh->GetDispatchOutput());
+			}
+			ReleaseMeshComponent(DeleteChunkMesh);
+			
+			DeleteCycles += FPlatformTime::Cycles64() - StartCycles;
+			NumDeletedChunks++;
+		}
+		else if(MeshCache && !bSimulateDispatch)
+		{
+			//Air and solid chunks come back from the cache as well instead of being generated again, simulated ones are not really empty
+			MeshCache->AddEmpty(DeleteChunk.MeshKey);
+		}
+	}
+	ChunkLODs[LOD].Chunks.Remove(ChunkIndex);
+}
+
+void ASChunkWorld::UpdateCameraVelocity(double Time, const FVector& CameraLocation)
+{
+	double DeltaTime = Time - LastCameraTime;
+	if(LastCameraLocation.IsSet() && DeltaTime > 0.0)
+	{
+		FVector Velocity = (CameraLocation - LastCameraLocation.GetValue()) / DeltaTime;
+		//Exponential smoothing, the same at any frame rate
+		double Alpha = VelocitySmoothing > 0.0f ? 1.0 - FMath::Exp(-DeltaTime / VelocitySmoothing) : 1.0;
+		CameraVelocity = FMath::Lerp(CameraVelocity, Velocity, Alpha);
+	}
+	LastCameraLocation = CameraLocation;
+	LastCameraTime = Time;
+}
+
+void ASChunkWorld::CheckHoles(const FVector& CameraLocation, const FSChunkKeyParams& Params)
+{
+	int ChunkSize = Params.ChunkSize;
+	FIntVector CameraChunk = FIntVector(FMath::FloorToInt(CameraLocation.X / ChunkSize), FMath::FloorToInt(CameraLocation.Y / ChunkSize),
+		FMath::FloorToInt(CameraLocation.Z / ChunkSize));
+	
+	int NumHoles = 0;
+	for(int Z = -HoleCheckRadius; Z <= HoleCheckRadius; Z++)
+	{
+		for(int Y = -HoleCheckRadius; Y <= HoleCheckRadius; Y++)
+		{
+			for(int X = -HoleCheckRadius; X <= HoleCheckRadius; X++)
+			{
+				FIntVector ChunkKey = (CameraChunk + FIntVector(X, Y, Z)) * ChunkSize;
+				bool bSpawned = ChunkLODs[0].Chunks.Contains(FSChunkIndex::FromChunkKey(ChunkKey, 0, ChunkSize));
+				if(!bSpawned && FSChunkKeys::ContainsChunkKey(Params, ChunkKey))
+				{
+					NumHoles++;
+				}
+			}
 		}
 	}
-	ChunkLODs[LOD].Chunks.Remove(ChunkKey);
+	
+	NumCheckedFrames++;
+	NumHoleChunks += NumHoles;
+	if(NumHoles > 0)
+	{
+		NumHoleFrames++;
+		INC_DWORD_STAT(STAT_SVoxel_HoleFrames);
+	}
+	SET_DWORD_STAT(STAT_SVoxel_HoleChunks, NumHoles);
+}
+
+void ASChunkWorld::UpdateFlythrough(double Time, FVector& CameraLocation, FVector& CameraDirection)
+{
+	if(FlythroughFile.IsEmpty())
+		return;
+	
+	if(!FlythroughStartTime.IsSet())
+	{
+		FlythroughStartTime = Time;
+	}
+	double FlythroughTime = Time - FlythroughStartTime.GetValue();
+	
+	if(!bReplayFlythrough)
+	{
+		FlythroughSamples.Add(FSFlythroughSample(FlythroughTime, CameraLocation, CameraDirection));
+		return;
+	}
+	if(FlythroughSamples.IsEmpty())
+		return;
+
+	while(FlythroughSample + 1 < FlythroughSamples.Num() && FlythroughSamples[FlythroughSample + 1].Time <= FlythroughTime)
+	{
+		FlythroughSample++;
+	}
+	const FSFlythroughSample& Sample = FlythroughSamples[FlythroughSample];
+	if(FlythroughSample + 1 == FlythroughSamples.Num())
+	{
+		//The camera stays at the end of the path afterwards
+		if(!bFlythroughFinished)
+		{
+			bFlythroughFinished = true;
+			UE_LOG(LogSVoxel, Log, TEXT("Flythrough replay finished after %.2f s: %d of %d frames had holes, %lld missing chunks"), Sample.Time,
+				NumHoleFrames, NumCheckedFrames, NumHoleChunks);
+		}
+		CameraLocation = Sample.Location;
+		CameraDirection = Sample.Direction;
+		return;
+	}
+	
+	const FSFlythroughSample& NextSample = FlythroughSamples[FlythroughSample + 1];
+	double Alpha = FMath::Clamp((FlythroughTime - Sample.Time) / FMath::Max(NextSample.Time - Sample.Time, UE_SMALL_NUMBER), 0.0, 1.0);
+	CameraLocation = FMath::Lerp(Sample.Location, NextSample.Location, Alpha);
+	CameraDirection = FMath::Lerp(Sample.Direction, NextSample.Direction, Alpha).GetSafeNormal(UE_SMALL_NUMBER, Sample.Direction);
+}
+
+FString ASChunkWorld::GetFlythroughPath() const
+{
+	return FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), FlythroughFile);
+}
+
+void ASChunkWorld::LoadFlythrough()
+{
+	FlythroughSamples.Reset();
+	FlythroughStartTime.Reset();
+	FlythroughSample = 0;
+	bFlythroughFinished = false;
+	
+	TArray<FString> Lines;
+	if(FlythroughFile.IsEmpty() || !FFileHelper::LoadFileToStringArray(Lines, *GetFlythroughPath()))
+	{
+		UE_LOG(LogSVoxel, Warning, TEXT("Could not load the flythrough %s, the camera is used instead"), *FlythroughFile);
+		return;
+	}
+
+	//One sample per line: time, location and direction
+	for(const FString& Line : Lines)
+	{
+		TArray<FString> Values;
+		if(Line.ParseIntoArray(Values, TEXT(",")) != 7)
+			continue;
+		
+		FSFlythroughSample Sample;
+		Sample.Time = FCString::Atod(*Values[0]);
+		Sample.Location = FVector(FCString::Atod(*Values[1]), FCString::Atod(*Values[2]), FCString::Atod(*Values[3]));
+		Sample.Direction = FVector(FCString::Atod(*Values[4]), FCString::Atod(*Values[5]), FCString::Atod(*Values[6]));
+		FlythroughSamples.Add(Sample);
+	}
+	UE_LOG(LogSVoxel, Log, TEXT("Replaying %d flythrough samples from %s"), FlythroughSamples.Num(), *FlythroughFile);
+}
+
+void ASChunkWorld::SaveFlythrough() const
+{
+	TArray<FString> Lines;
+	for(const FSFlythroughSample& Sample : FlythroughSamples)
+	{
+		Lines.Add(FString::Printf(TEXT("%f,%f,%f,%f,%f,%f,%f"), Sample.Time, Sample.Location.X, Sample.Location.Y, Sample.Location.Z,
+			Sample.Direction.X, Sample.Direction.Y, Sample.Direction.Z));
+	}
+	if(!FFileHelper::SaveStringArrayToFile(Lines, *GetFlythroughPath()))
+	{
+		UE_LOG(LogSVoxel, Warning, TEXT("Could not save the flythrough to %s"), *FlythroughFile);
+		return;
+	}
+	UE_LOG(LogSVoxel, Log, TEXT("Saved %d flythrough samples to %s"), Lines.Num(), *FlythroughFile);
+}
+
+USMeshComponent* ASChunkWorld::AcquireMeshComponent()
+{
+	USMeshComponent* MeshComponent;
+	if(ComponentPool.Num() > 0)
+	{
+		MeshComponent = ComponentPool.Pop(false);
+		SET_DWORD_STAT(STAT_SVoxel_PooledComponents, ComponentPool.Num());
+	}
+	else
+	{
+		MeshComponent = NewObject<USMeshComponent>(this, NAME_None);
+		NumCreatedComponents++;
+		INC_DWORD_STAT(STAT_SVoxel_CreatedComponents);
+	}
+	
+	if(MeshComponent->GetAttachParent() != GetRootComponent())
+	{
+		MeshComponent->SetupAttachment(GetRootComponent());
+	}
+	return MeshComponent;
+}
+
+void ASChunkWorld::ReleaseMeshComponent(USMeshComponent* MeshComponent)
+{
+	MeshComponent->UnregisterComponent();
+	if(!bPoolComponents || ComponentPool.Num() >= MaxPooledComponents)
+	{
+		MeshComponent->DestroyComponent();
+		return;
+	}
+	
+	MeshComponent->ClearMeshSection();
+	ComponentPool.Add(MeshComponent);
+	SET_DWORD_STAT(STAT_SVoxel_PooledComponents, ComponentPool.Num());
+}
+
+void ASChunkWorld::OnPreGarbageCollect()
+{
+	GarbageCollectionStartTime = FPlatformTime::Seconds();
+}
+
+void ASChunkWorld::OnPostGarbageCollect()
+{
+	if(GarbageCollectionStartTime == 0.0)
+		return;
+	
+	double Time = FPlatformTime::Seconds() - GarbageCollectionStartTime;
+	GarbageCollectionStartTime = 0.0;
+	GarbageCollectionTime += Time;
+	NumGarbageCollections++;
+	SET_FLOAT_STAT(STAT_SVoxel_GarbageCollectionMs, Time * 1000.0);
+	UE_LOG(LogSVoxel, Verbose, TEXT("Garbage collection took %.2f ms"), Time * 1000.0);
 }
@@ -0,0 +1,531 @@
+﻿#include "SRegionArchive.h"
+#include "SVoxelPlugin.h"
+#include "SVoxelStats.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/FileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Algo/BinarySearch.h"
+#include "SMarchingCPU.h"
+#include "SDensityCPU.h"
+#include "HAL/IConsoleManager.h"
+
+//A mapped region file, or the whole file read into memory on platforms that cannot map it
+struct FSMappedRegion
+{
+	//Declared first so the mapping is released before its file
+	TUniquePtr<IMappedFileHandle> Handle;
+	TUniquePtr<IMappedFileRegion> Mapping;
+	TArray<uint8> FileData;
+	
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+	
+	const FSRegionArchive::FHeader* Header = nullptr;
+	TConstArrayView<FSRegionArchive::FChunkEntry> Chunks;
+};
+
+static bool IsChunkKeyLess(const FIntVector& A, const FIntVector& B)
+{
+	if (A.X != B.X)
+		return A.X < B.X;
+	if (A.Y != B.Y)
+		return A.Y < B.Y;
+	return A.Z < B.Z;
+}
+
+static int FloorDivide(int Value, int Divisor)
+{
+	return Value >= 0 ? Value / Divisor : (Value - Divisor + 1) / Divisor;
+}
+
+FIntVector FSRegionArchive::GetRegion(const FSChunkMeshKey& MeshKey)
+{
+	int RegionSize = MeshKey.Size * 100 * (1 << MeshKey.LOD) * MeshKey.Scale * RegionChunks;
+	return FIntVector(FloorDivide(MeshKey.ChunkKey.X, RegionSize), FloorDivide(MeshKey.ChunkKey.Y, RegionSize),
+		FloorDivide(MeshKey.ChunkKey.Z, RegionSize));
+}
+
+FString FSRegionArchive::GetRegionPath(const FString& Directory, const FSChunkMeshKey& MeshKey, const FIntVector& Region)
+{
+	uint32 IsolevelBits;
+	FMemory::Memcpy(&IsolevelBits, &MeshKey.Isolevel, sizeof(uint32));
+	
+	FString Settings = FString::Printf(TEXT("S%d_N%d_X%d_I%08X_L%d_W%d_%d_%d"), MeshKey.Seed, MeshKey.Size, MeshKey.Scale, IsolevelBits,
+		MeshKey.LOD, MeshKey.WorldSize.X, MeshKey.WorldSize.Y, MeshKey.WorldSize.Z);
+	return FPaths::Combine(Directory, Settings, FString::Printf(TEXT("%d_%d_%d.svregion"), Region.X, Region.Y, Region.Z));
+}
+
+uint32 FSRegionArchive::GetRawSize(uint32 NumVertices, uint32 NumIndices, uint32 NumVoxels)
+{
+	return NumVertices * (sizeof(FVector3f) * 2 + sizeof(FVector4f)) + NumIndices * sizeof(uint32) + NumVoxels * sizeof(float);
+}
+
+bool FSRegionArchive::IsMatchingHeader(const FHeader& Header, const FSChunkMeshKey& MeshKey)
+{
+	return Header.Magic == Magic && Header.Version == Version && Header.WorldSize == MeshKey.WorldSize && Header.Size == MeshKey.Size
+		&& Header.Scale == MeshKey.Scale && Header.Isolevel == MeshKey.Isolevel && Header.Seed == MeshKey.Seed && Header.LOD == MeshKey.LOD;
+}
+
+bool FSRegionArchive::IsRegionBaked(const FString& Directory, const FSChunkMeshKey& MeshKey)
+{
+	FIntVector Region = GetRegion(MeshKey);
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*GetRegionPath(Directory, MeshKey, Region)));
+	if (!Reader.IsValid() || Reader->TotalSize() < int64(sizeof(FHeader)))
+		return false;
+	
+	FHeader Header;
+	Reader->Serialize(&Header, sizeof(Header));
+	return !Reader->IsError() && IsMatchingHeader(Header, MeshKey) && Header.Region == Region;
+}
+
+FSRegionWriter::FSRegionWriter(const FString& InDirectory, bool bInCompress)
+	: Directory(InDirectory), bCompress(bInCompress)
+{
+}
+
+FSChunkMeshKey FSRegionWriter::GetRegionMeshKey(const FSChunkMeshKey& MeshKey)
+{
+	FSChunkMeshKey RegionMeshKey = MeshKey;
+	RegionMeshKey.ChunkKey = FIntVector::ZeroValue;
+	RegionMeshKey.bCollision = false;
+	return RegionMeshKey;
+}
+
+template<typename T>
+static void AppendBlob(TArray<uint8>& Blob, TConstArrayView<T> Data)
+{
+	Blob.Append(reinterpret_cast<const uint8*>(Data.GetData()), Data.Num() * sizeof(T));
+}
+
+void FSRegionWriter::AddChunk(const FSChunkMeshKey& MeshKey, const FSChunkMeshData& Mesh, TConstArrayView<float> Voxels)
+{
+	FPendingChunk Chunk;
+	Chunk.ChunkKey = MeshKey.ChunkKey;
+	if (!Mesh.Vertices.IsEmpty() && !Mesh.Indices.IsEmpty())
+	{
+		check(Mesh.Normals.Num() == Mesh.Vertices.Num() && Mesh.Colors.Num() == Mesh.Vertices.Num());
+		Chunk.NumVertices = Mesh.Vertices.Num();
+		Chunk.NumIndices = Mesh.Indices.Num();
+		Chunk.ContentHash = FSDispatchCSOutput::GetContentHash(Mesh.Vertices, Mesh.Normals, Mesh.Colors, Mesh.Indices);
+	}
+	Chunk.NumVoxels = Voxels.Num();
+	Chunk.RawSize = FSRegionArchive::GetRawSize(Chunk.NumVertices, Chunk.NumIndices, Chunk.NumVoxels);
+	if (Chunk.NumVoxels > 0)
+	{
+		Chunk.Flags |= FSRegionArchive::HasVoxels;
+	}
+
+	if (Chunk.RawSize > 0)
+	{
+		TArray<uint8> RawBlob;
+		RawBlob.Reserve(Chunk.RawSize);
+		if (Chunk.NumVertices > 0)
+		{
+			AppendBlob(RawBlob, MakeArrayView(Mesh.Vertices));
+			AppendBlob(RawBlob, MakeArrayView(Mesh.Normals));
+			AppendBlob(RawBlob, MakeArrayView(Mesh.Colors));
+			AppendBlob(RawBlob, MakeArrayView(Mesh.Indices));
+		}
+		AppendBlob(RawBlob, Voxels);
+
+		//Kept raw when compressing does not pay off, the reader can then hand out views into the mapping
+		int32 CompressedSize = bCompress ? FCompression::CompressMemoryBound(NAME_Oodle, Chunk.RawSize) : 0;
+		if (bCompress)
+		{
+			Chunk.Blob.SetNumUninitialized(CompressedSize);
+		}
+		if (bCompress && FCompression::CompressMemory(NAME_Oodle, Chunk.Blob.GetData(), CompressedSize, RawBlob.GetData(), Chunk.RawSize)
+			&& uint32(CompressedSize) < Chunk.RawSize)
+		{
+			Chunk.Blob.SetNum(CompressedSize);
+			Chunk.Flags |= FSRegionArchive::Compressed;
+		}
+		else
+		{
+			Chunk.Blob = MoveTemp(RawBlob);
+		}
+	}
+
+	FSChunkMeshKey RegionMeshKey = GetRegionMeshKey(MeshKey);
+	FIntVector Region = FSRegionArchive::GetRegion(MeshKey);
+	FPendingRegion& PendingRegion = PendingRegions.FindOrAdd(TPair<FSChunkMeshKey, FIntVector>(RegionMeshKey, Region));
+	PendingRegion.MeshKey = RegionMeshKey;
+	PendingRegion.Region = Region;
+	PendingRegion.Chunks.Add(MoveTemp(Chunk));
+}
+
+bool FSRegionWriter::Flush()
+{
+	bool bWritten = true;
+	for (const TPair<TPair<FSChunkMeshKey, FIntVector>, FPendingRegion>& PendingRegion : PendingRegions)
+	{
+		bWritten &= WriteRegionFile(PendingRegion.Value);
+	}
+	PendingRegions.Empty();
+	return bWritten;
+}
+
+bool FSRegionWriter::WriteRegion(const FSChunkMeshKey& MeshKey)
+{
+	FPendingRegion PendingRegion;
+	if (!PendingRegions.RemoveAndCopyValue(TPair<FSChunkMeshKey, FIntVector>(GetRegionMeshKey(MeshKey), FSRegionArchive::GetRegion(MeshKey)), PendingRegion))
+		return false;
+	return WriteRegionFile(PendingRegion);
+}
+
+bool FSRegionWriter::WriteRegionFile(const FPendingRegion& PendingRegion)
+{
+	TArray<const FPendingChunk*> Chunks;
+	for (const FPendingChunk& Chunk : PendingRegion.Chunks)
+	{
+		Chunks.Add(&Chunk);
+	}
+	//Sorted so the reader finds a chunk with a binary search
+	Chunks.Sort([](const FPendingChunk& A, const FPendingChunk& B)
+	{
+		return IsChunkKeyLess(A.ChunkKey, B.ChunkKey);
+	});
+
+	FSRegionArchive::FHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = FSRegionArchive::Magic;
+	Header.Version = FSRegionArchive::Version;
+	Header.WorldSize = PendingRegion.MeshKey.WorldSize;
+	Header.Size = PendingRegion.MeshKey.Size;
+	Header.Scale = PendingRegion.MeshKey.Scale;
+	Header.Isolevel = PendingRegion.MeshKey.Isolevel;
+	Header.Seed = PendingRegion.MeshKey.Seed;
+	Header.LOD = PendingRegion.MeshKey.LOD;
+	Header.Region = PendingRegion.Region;
+	Header.NumChunks = Chunks.Num();
+
+	TArray<FSRegionArchive::FChunkEntry> Entries;
+	Entries.SetNumZeroed(Chunks.Num());
+	uint64 Offset = Align(sizeof(FSRegionArchive::FHeader) + Entries.Num() * sizeof(FSRegionArchive::FChunkEntry), FSRegionArchive::BlobAlignment);
+	for (int ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+	{
+		const FPendingChunk& Chunk = *Chunks[ChunkIndex];
+		FSRegionArchive::FChunkEntry& Entry = Entries[ChunkIndex];
+		Entry.ChunkKey = Chunk.ChunkKey;
+		Entry.Flags = Chunk.Flags;
+		Entry.Offset = Offset;
+		Entry.StoredSize = Chunk.Blob.Num();
+		Entry.RawSize = Chunk.RawSize;
+		Entry.NumVertices = Chunk.NumVertices;
+		Entry.NumIndices = Chunk.NumIndices;
+		Entry.NumVoxels = Chunk.NumVoxels;
+		Entry.ContentHash = Chunk.ContentHash;
+		Offset = Align(Offset + Entry.StoredSize, FSRegionArchive::BlobAlignment);
+	}
+
+	TArray<uint8> Data;
+	Data.SetNumZeroed(int32(Offset));
+	FMemory::Memcpy(Data.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(Data.GetData() + sizeof(Header), Entries.GetData(), Entries.Num() * sizeof(FSRegionArchive::FChunkEntry));
+	for (int ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+	{
+		FMemory::Memcpy(Data.GetData() + Entries[ChunkIndex].Offset, Chunks[ChunkIndex]->Blob.GetData(), Chunks[ChunkIndex]->Blob.Num());
+	}
+
+	//Written next to the file and moved over it, an interrupted write never leaves a broken region behind
+	FString Path = FSRegionArchive::GetRegionPath(Directory, PendingRegion.MeshKey, PendingRegion.Region);
+	FString TempPath = Path + TEXT(".tmp");
+	if (!FFileHelper::SaveArrayToFile(Data, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true))
+	{
+		UE_LOG(LogSVoxel, Warning, TEXT("Could not write region file %s"), *Path);
+		return false;
+	}
+	WrittenBytes += Data.Num();
+	return true;
+}
+
+FSRegionReader::FSRegionReader(const FString& InDirectory)
+	: Directory(InDirectory)
+{
+}
+
+FSRegionReader::~FSRegionReader()
+{
+	Empty();
+}
+
+void FSRegionReader::Empty()
+{
+	FScopeLock ScopeLock(&Lock);
+	MappedRegions.Empty();
+	MapOrder.Empty();
+}
+
+static TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> MapRegionFile(const FString& Path, const FSChunkMeshKey& MeshKey)
+{
+	TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> MappedRegion = MakeShared<FSMappedRegion, ESPMode::ThreadSafe>();
+	
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Path))
+		return nullptr;
+	
+	MappedRegion->Handle.Reset(PlatformFile.OpenMapped(*Path));
+	if (MappedRegion->Handle.IsValid())
+	{
+		MappedRegion->Mapping.Reset(MappedRegion->Handle->MapRegion());
+	}
+	if (MappedRegion->Mapping.IsValid())
+	{
+		MappedRegion->Data = MappedRegion->Mapping->GetMappedPtr();
+		MappedRegion->Size = MappedRegion->Mapping->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(MappedRegion->FileData, *Path))
+	{
+		MappedRegion->Data = MappedRegion->FileData.GetData();
+		MappedRegion->Size = MappedRegion->FileData.Num();
+	}
+	
+	if (MappedRegion->Size < int64(sizeof(FSRegionArchive::FHeader)))
+	{
+		UE_LOG(LogSVoxel, Warning, TEXT("Could not read region file %s"), *Path);
+		return nullptr;
+	}
+	
+	const FSRegionArchive::FHeader* Header = reinterpret_cast<const FSRegionArchive::FHeader*>(MappedRegion->Data);
+	int64 HeaderSize = sizeof(FSRegionArchive::FHeader) + int64(Header->NumChunks) * sizeof(FSRegionArchive::FChunkEntry);
+	if (!FSRegionArchive::IsMatchingHeader(*Header, MeshKey) || HeaderSize > MappedRegion->Size)
+	{
+		UE_LOG(LogSVoxel, Warning, TEXT("Region file %s does not match the chunk settings or is a different version"), *Path);
+		return nullptr;
+	}
+	MappedRegion->Header = Header;
+	MappedRegion->Chunks = MakeArrayView(reinterpret_cast<const FSRegionArchive::FChunkEntry*>(Header + 1), Header->NumChunks);
+	return MappedRegion;
+}
+
+TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> FSRegionReader::GetMappedRegion(const FSChunkMeshKey& MeshKey)
+{
+	FString Path = FSRegionArchive::GetRegionPath(Directory, MeshKey, FSRegionArchive::GetRegion(MeshKey));
+	
+	FScopeLock ScopeLock(&Lock);
+	if (TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe>* MappedRegion = MappedRegions.Find(Path))
+		return *MappedRegion;
+
+	if (MapOrder.Num() >= MaxMappedRegions)
+	{
+		MappedRegions.Remove(MapOrder[0]);
+		MapOrder.RemoveAt(0);
+	}
+	TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> MappedRegion = MapRegionFile(Path, MeshKey);
+	MappedRegions.Add(Path, MappedRegion);
+	MapOrder.Add(Path);
+	return MappedRegion;
+}
+
+bool FSRegionReader::FindChunk(const FSChunkMeshKey& MeshKey, FSRegionChunkView& OutView)
+{
+	TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> MappedRegion = GetMappedRegion(MeshKey);
+	if (!MappedRegion.IsValid())
+		return false;
+
+	int32 ChunkIndex = Algo::LowerBoundBy(MappedRegion->Chunks, MeshKey.ChunkKey, &FSRegionArchive::FChunkEntry::ChunkKey, IsChunkKeyLess);
+	if (!MappedRegion->Chunks.IsValidIndex(ChunkIndex) || MappedRegion->Chunks[ChunkIndex].ChunkKey != MeshKey.ChunkKey)
+		return false;
+	
+	const FSRegionArchive::FChunkEntry& Entry = MappedRegion->Chunks[ChunkIndex];
+	bool bCompressed = (Entry.Flags & FSRegionArchive::Compressed) != 0;
+	uint32 RawSize = FSRegionArchive::GetRawSize(Entry.NumVertices, Entry.NumIndices, Entry.NumVoxels);
+	if (Entry.Offset + Entry.StoredSize > uint64(MappedRegion->Size) || Entry.RawSize != RawSize || (!bCompressed && Entry.StoredSize != RawSize))
+	{
+		UE_LOG(LogSVoxel, Warning, TEXT("Chunk %s of a region file is out of bounds"), *MeshKey.ChunkKey.ToString());
+		return false;
+	}
+
+	OutView = FSRegionChunkView();
+	OutView.NumVertices = Entry.NumVertices;
+	OutView.NumIndices = Entry.NumIndices;
+	OutView.NumVoxels = Entry.NumVoxels;
+	OutView.ContentHash = Entry.ContentHash;
+	OutView.bCompressed = bCompressed;
+	OutView.Blob = MakeArrayView(MappedRegion->Data + Entry.Offset, Entry.StoredSize);
+	if (!bCompressed)
+	{
+		const uint8* Blob = OutView.Blob.GetData();
+		OutView.Vertices = MakeArrayView(reinterpret_cast<const FVector3f*>(Blob), Entry.NumVertices);
+		Blob += Entry.NumVertices * sizeof(FVector3f);
+		OutView.Normals = MakeArrayView(reinterpret_cast<const FVector3f*>(Blob), Entry.NumVertices);
+		Blob += Entry.NumVertices * sizeof(FVector3f);
+		OutView.Colors = MakeArrayView(reinterpret_cast<const FVector4f*>(Blob), Entry.NumVertices);
+		Blob += Entry.NumVertices * sizeof(FVector4f);
+		OutView.Indices = MakeArrayView(reinterpret_cast<const uint32*>(Blob), Entry.NumIndices);
+		Blob += Entry.NumIndices * sizeof(uint32);
+		OutView.Voxels = MakeArrayView(reinterpret_cast<const float*>(Blob), Entry.NumVoxels);
+	}
+	OutView.MappedRegion = MappedRegion;
+	return true;
+}
+
+template<typename T>
+static const uint8* ReadBlob(const uint8* Blob, int32 Num, TArray<T>& OutData)
+{
+	OutData.SetNumUninitialized(Num);
+	FMemory::Memcpy(OutData.GetData(), Blob, Num * sizeof(T));
+	return Blob + Num * sizeof(T);
+}
+
+bool FSRegionReader::LoadChunk(const FSChunkMeshKey& MeshKey, FSChunkMeshData& OutMesh, TArray<float>* OutVoxels)
+{
+	FSRegionChunkView View;
+	if (!FindChunk(MeshKey, View))
+	{
+		INC_DWORD_STAT(STAT_SVoxel_RegionArchiveMisses);
+		return false;
+	}
+	
+	OutMesh = FSChunkMeshData();
+	OutMesh.bCollision = MeshKey.bCollision;
+	if (OutVoxels)
+	{
+		OutVoxels->Reset();
+	}
+	
+	//Compressed blobs are inflated straight from the mapping
+	TArray<uint8> RawBlob;
+	const uint8* Blob = View.Blob.GetData();
+	if (View.bCompressed)
+	{
+		int32 RawSize = FSRegionArchive::GetRawSize(View.NumVertices, View.NumIndices, View.NumVoxels);
+		RawBlob.SetNumUninitialized(RawSize);
+		if (!FCompression::UncompressMemory(NAME_Oodle, RawBlob.GetData(), RawSize, View.Blob.GetData(), View.Blob.Num()))
+		{
+			UE_LOG(LogSVoxel, Warning, TEXT("Could not decompress chunk %s of a region file"), *MeshKey.ChunkKey.ToString());
+			INC_DWORD_STAT(STAT_SVoxel_RegionArchiveMisses);
+			return false;
+		}
+		Blob = RawBlob.GetData();
+	}
+
+	Blob = ReadBlob(Blob, View.NumVertices, OutMesh.Vertices);
+	Blob = ReadBlob(Blob, View.NumVertices, OutMesh.Normals);
+	Blob = ReadBlob(Blob, View.NumVertices, OutMesh.Colors);
+	Blob = ReadBlob(Blob, View.NumIndices, OutMesh.Indices);
+	if (OutVoxels)
+	{
+		ReadBlob(Blob, View.NumVoxels, *OutVoxels);
+	}
+
+	//A damaged file is generated over instead of drawn, the upload takes the hash from the mesh
+	if (!View.IsEmpty())
+	{
+		OutMesh.ContentHash = FSDispatchCSOutput::GetContentHash(OutMesh.Vertices, OutMesh.Normals, OutMesh.Colors, OutMesh.Indices);
+		if (OutMesh.ContentHash != View.ContentHash)
+		{
+			UE_LOG(LogSVoxel, Warning, TEXT("Chunk %s of a region file does not match its content hash"), *MeshKey.ChunkKey.ToString());
+			INC_DWORD_STAT(STAT_SVoxel_RegionArchiveMisses);
+			return false;
+		}
+	}
+	
+	INC_DWORD_STAT(STAT_SVoxel_RegionArchiveHits);
+	INC_DWORD_STAT_BY(STAT_SVoxel_RegionArchiveReadBytes, View.Blob.Num());
+	return true;
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+static void BenchmarkRegionArchive(const TArray<FString>& Args)
+{
+	int32 NumChunks = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 64;
+	int32 Size = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 32;
+	const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("SVoxelRegionBenchmark"));
+
+	TArray<FSChunkMeshKey> MeshKeys;
+	TArray<FSChunkMeshData> Meshes;
+	TArray<TArray<float>> Voxels;
+	double GenerationTime = 0.0;
+	for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+	{
+		//A row along the surface, so every chunk has geometry
+		FSChunkMeshKey& MeshKey = MeshKeys.AddDefaulted_GetRef();
+		MeshKey.ChunkKey = FIntVector(Chunk * Size * 100, 0, -Size * 50);
+		MeshKey.WorldSize = FIntVector3(200000, 200000, 3000);
+		MeshKey.Size = Size;
+		MeshKey.Scale = 1;
+		MeshKey.Seed = 1337;
+
+		FSDispatchCSParams Params = FSDispatchCSParams(MeshKey.WorldSize, Size, MeshKey.Isolevel, FVector3f(MeshKey.ChunkKey) / 100, 0,
+			MeshKey.Scale, MeshKey.Seed);
+		TArray<float>& ChunkVoxels = Voxels.AddDefaulted_GetRef();
+		ChunkVoxels.SetNumUninitialized((Size + 4) * (Size + 4) * (Size + 4));
+		FSMarchingCPUOutput Output;
+		
+		double StartTime = FPlatformTime::Seconds();
+		FSDensityCPU::GetChunkDensity(Params.WorldSize, Params.seed, Size, Params.Scale, Params.LOD, Params.Position, ChunkVoxels);
+		FSMarchingCPU::March(Params, ChunkVoxels, Output);
+		GenerationTime += FPlatformTime::Seconds() - StartTime;
+
+		FSChunkMeshData& Mesh = Meshes.AddDefaulted_GetRef();
+		Mesh.Vertices = MoveTemp(Output.Vertices);
+		Mesh.Normals = MoveTemp(Output.Normals);
+		Mesh.Colors = MoveTemp(Output.Colors);
+		Mesh.Indices = MoveTemp(Output.Indices);
+	}
+
+	//Compressed and raw archives, with and without the voxels
+	for (int32 Mode = 0; Mode < 4; Mode++)
+	{
+		bool bCompress = (Mode & 1) == 0;
+		bool bVoxels = (Mode & 2) != 0;
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+		
+		FSRegionWriter Writer(Directory, bCompress);
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			Writer.AddChunk(MeshKeys[Chunk], Meshes[Chunk], bVoxels ? TConstArrayView<float>(Voxels[Chunk]) : TConstArrayView<float>());
+		}
+		Writer.Flush();
+		double WriteTime = FPlatformTime::Seconds() - StartTime;
+
+		//A new reader maps the files again, the first pass pays for the page faults
+		FSRegionReader Reader(Directory);
+		FSChunkMeshData Mesh;
+		TArray<float> ChunkVoxels;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			Reader.LoadChunk(MeshKeys[Chunk], Mesh, bVoxels ? &ChunkVoxels : nullptr);
+		}
+		double ColdLoadTime = FPlatformTime::Seconds() - StartTime;
+		
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			Reader.LoadChunk(MeshKeys[Chunk], Mesh, bVoxels ? &ChunkVoxels : nullptr);
+		}
+		double LoadTime = FPlatformTime::Seconds() - StartTime;
+
+		FSRegionChunkView View;
+		int64 NumViewIndices = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			if (Reader.FindChunk(MeshKeys[Chunk], View))
+			{
+				NumViewIndices += View.Indices.Num();
+			}
+		}
+		double ViewTime = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogSVoxel, Log, TEXT("Region archive of %d chunks of size %d, %s%s: %lld bytes, write %.3f ms, cold load %.3f ms, load %.3f ms, find %.4f ms per chunk (%lld view indices), generation %.3f ms per chunk"),
+			NumChunks, Size, bCompress ? TEXT("compressed") : TEXT("raw"), bVoxels ? TEXT(" with voxels") : TEXT(""), Writer.GetWrittenBytes(),
+			WriteTime * 1000.0 / NumChunks, ColdLoadTime * 1000.0 / NumChunks, LoadTime * 1000.0 / NumChunks, ViewTime * 1000.0 / NumChunks,
+			NumViewIndices, GenerationTime * 1000.0 / NumChunks);
+	}
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+}
+
+static FAutoConsoleCommand BenchmarkRegionArchiveCommand(
+	TEXT("SVoxel.BenchmarkRegionArchive"),
+	TEXT("Compares loading chunks from the region archive with generating them on the CPU, takes the number of chunks and their size"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRegionArchive));
+
+#endif
@@ -0,0 +1,287 @@
+﻿#include "SRegionBakeCommandlet.h"
+#include "SRegionArchive.h"
+#include "SChunkWorld.h"
+#include "SDensityCPU.h"
+#include "SMarchingCPU.h"
+#include "SVoxelPlugin.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+struct FSBakeSettings
+{
+	FString Directory;
+	bool bVoxels = false;
+	bool bCompress = true;
+};
+
+//Regions a worker bakes, it takes them from the back and other workers steal them from the front
+struct FSBakeQueue
+{
+	FCriticalSection Lock;
+	//Key of the first chunk of each region, with the settings it is baked with
+	TArray<FSChunkMeshKey> Regions;
+};
+
+struct FSBakeProgress
+{
+	std::atomic<int64> NumChunks {0};
+	std::atomic<int64> NumRegions {0};
+	std::atomic<int64> NumSteals {0};
+	std::atomic<int64> WrittenBytes {0};
+	std::atomic<bool> bFailed {false};
+	
+	int64 TotalRegions = 0;
+	double StartTime = 0.0;
+	double LastReportTime = 0.0;
+	FCriticalSection ReportLock;
+};
+
+static bool PopRegion(TArray<FSBakeQueue>& Queues, int Worker, FSChunkMeshKey& OutRegion, FSBakeProgress& Progress)
+{
+	{
+		FSBakeQueue& Queue = Queues[Worker];
+		FScopeLock Lock(&Queue.Lock);
+		if (!Queue.Regions.IsEmpty())
+		{
+			OutRegion = Queue.Regions.Pop();
+			return true;
+		}
+	}
+	
+	//Nothing new is queued once the bake started, so a worker with nothing left to steal is done
+	for (int Offset = 1; Offset < Queues.Num(); Offset++)
+	{
+		FSBakeQueue& Victim = Queues[(Worker + Offset) % Queues.Num()];
+		FScopeLock Lock(&Victim.Lock);
+		if (!Victim.Regions.IsEmpty())
+		{
+			OutRegion = Victim.Regions[0];
+			Victim.Regions.RemoveAt(0);
+			Progress.NumSteals++;
+			return true;
+		}
+	}
+	return false;
+}
+
+static int GetChunkSize(const FSChunkMeshKey& MeshKey)
+{
+	return MeshKey.Size * 100 * (1 << MeshKey.LOD) * MeshKey.Scale;
+}
+
+// First and last chunk key of the LOD that overlap the baked volume on each axis
+static void GetChunkKeyBounds(const FSChunkMeshKey& MeshKey, FIntVector& OutFirst, FIntVector& OutLast)
+{
+	int ChunkSize = GetChunkSize(MeshKey);
+	FIntVector Min = FIntVector(-MeshKey.WorldSize.X, -MeshKey.WorldSize.Y, -MeshKey.WorldSize.Z - USRegionBakeCommandlet::UnderworldDepth) * 100;
+	FIntVector Max = FIntVector(MeshKey.WorldSize.X, MeshKey.WorldSize.Y, MeshKey.WorldSize.Z) * 100;
+	for (int Axis = 0; Axis < 3; Axis++)
+	{
+		OutFirst[Axis] = FMath::FloorToInt(double(Min[Axis]) / ChunkSize) * ChunkSize;
+		OutLast[Axis] = (FMath::CeilToInt(double(Max[Axis]) / ChunkSize) - 1) * ChunkSize;
+	}
+}
+
+// Generates the chunks of the region inside the baked volume and writes its file
+static void BakeRegion(const FSChunkMeshKey& RegionKey, const FSBakeSettings& Settings, TArray<float>& Voxels, FSBakeProgress& Progress)
+{
+	int ChunkSize = GetChunkSize(RegionKey);
+	FIntVector First, Last;
+	GetChunkKeyBounds(RegionKey, First, Last);
+	
+	FSRegionWriter Writer(Settings.Directory, Settings.bCompress);
+	Voxels.SetNumUninitialized((RegionKey.Size + 4) * (RegionKey.Size + 4) * (RegionKey.Size + 4));
+	FSMarchingCPUOutput Output;
+	int NumChunks = 0;
+	for (int X = 0; X < FSRegionArchive::RegionChunks; X++)
+	{
+		for (int Y = 0; Y < FSRegionArchive::RegionChunks; Y++)
+		{
+			for (int Z = 0; Z < FSRegionArchive::RegionChunks; Z++)
+			{
+				FSChunkMeshKey MeshKey = RegionKey;
+				MeshKey.ChunkKey = RegionKey.ChunkKey + FIntVector(X, Y, Z) * ChunkSize;
+				if (MeshKey.ChunkKey.X < First.X || MeshKey.ChunkKey.Y < First.Y || MeshKey.ChunkKey.Z < First.Z ||
+					MeshKey.ChunkKey.X > Last.X || MeshKey.ChunkKey.Y > Last.Y || MeshKey.ChunkKey.Z > Last.Z)
+					continue;
+
+				FSDispatchCSParams Params = FSDispatchCSParams(MeshKey.WorldSize, MeshKey.Size, MeshKey.Isolevel, FVector3f(MeshKey.ChunkKey) / 100,
+					MeshKey.LOD, MeshKey.Scale, MeshKey.Seed);
+				FSDensityCPU::GetChunkDensity(Params.WorldSize, Params.seed, Params.Size, Params.Scale, Params.LOD, Params.Position, Voxels);
+				FSMarchingCPU::March(Params, Voxels, Output);
+
+				FSChunkMeshData Mesh;
+				Mesh.Vertices = MoveTemp(Output.Vertices);
+				Mesh.Normals = MoveTemp(Output.Normals);
+				Mesh.Colors = MoveTemp(Output.Colors);
+				Mesh.Indices = MoveTemp(Output.Indices);
+				Writer.AddChunk(MeshKey, Mesh, Settings.bVoxels ? TConstArrayView<float>(Voxels) : TConstArrayView<float>());
+				NumChunks++;
+			}
+		}
+	}
+	
+	if (!Writer.Flush())
+	{
+		Progress.bFailed = true;
+	}
+	Progress.NumChunks += NumChunks;
+	Progress.WrittenBytes += Writer.GetWrittenBytes();
+	Progress.NumRegions++;
+}
+
+static void ReportProgress(FSBakeProgress& Progress)
+{
+	double Time = FPlatformTime::Seconds();
+	if (Time - Progress.LastReportTime < USRegionBakeCommandlet::ReportInterval)
+		return;
+	
+	FScopeLock Lock(&Progress.ReportLock);
+	if (Time - Progress.LastReportTime < USRegionBakeCommandlet::ReportInterval)
+		return;
+	Progress.LastReportTime = Time;
+	
+	double ElapsedTime = Time - Progress.StartTime;
+	UE_LOG(LogSVoxel, Display, TEXT("Baked %lld of %lld regions, %lld chunks at %.1f chunks/s"), Progress.NumRegions.load(), Progress.TotalRegions,
+		Progress.NumChunks.load(), Progress.NumChunks.load() / FMath::Max(ElapsedTime, 0.001));
+}
+
+static bool ParseIntVector(const FString& Params, const TCHAR* Match, FIntVector& OutValue)
+{
+	FString Value;
+	if (!FParse::Value(*Params, Match, Value, false))
+		return false;
+	
+	TArray<FString> Components;
+	Value.ParseIntoArray(Components, TEXT(","));
+	if (Components.Num() != 3)
+		return false;
+	OutValue = FIntVector(FCString::Atoi(*Components[0]), FCString::Atoi(*Components[1]), FCString::Atoi(*Components[2]));
+	return true;
+}
+
+USRegionBakeCommandlet::USRegionBakeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 USRegionBakeCommandlet::Main(const FString& Params)
+{
+	const ASChunkWorld* ChunkWorld = GetDefault<ASChunkWorld>();
+	
+	FSChunkMeshKey Settings;
+	Settings.WorldSize = ChunkWorld->WorldSize;
+	Settings.Size = ChunkWorld->Size;
+	Settings.Scale = FMath::Max(ChunkWorld->Scale, 1);
+	Settings.Isolevel = ChunkWorld->Isolevel;
+	Settings.Seed = ChunkWorld->seed;
+	FString Directory = ChunkWorld->RegionArchiveDirectory;
+	int NumWorkers = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	
+	FParse::Value(*Params, TEXT("Output="), Directory);
+	FParse::Value(*Params, TEXT("Seed="), Settings.Seed);
+	FParse::Value(*Params, TEXT("Size="), Settings.Size);
+	FParse::Value(*Params, TEXT("Scale="), Settings.Scale);
+	FParse::Value(*Params, TEXT("Isolevel="), Settings.Isolevel);
+	FParse::Value(*Params, TEXT("Threads="), NumWorkers);
+	ParseIntVector(Params, TEXT("WorldSize="), Settings.WorldSize);
+	
+	FSBakeSettings BakeSettings;
+	BakeSettings.bVoxels = FParse::Param(*Params, TEXT("Voxels"));
+	BakeSettings.bCompress = !FParse::Param(*Params, TEXT("NoCompress"));
+	bool bRestart = FParse::Param(*Params, TEXT("Restart"));
+	
+	if (Directory.IsEmpty() || Settings.Size <= 0 || Settings.Scale <= 0 || Settings.WorldSize.GetMin() <= 0)
+	{
+		UE_LOG(LogSVoxel, Error, TEXT("Region bake needs an output directory and a positive Size, Scale and WorldSize"));
+		return 1;
+	}
+	BakeSettings.Directory = FPaths::ConvertRelativePathToFull(FPaths::ProjectDir(), Directory);
+	NumWorkers = FMath::Max(NumWorkers, 1);
+
+	//Only LOD 0 is baked. Every LOD is laid out around an origin on the LOD 0 grid, so the keys of the coarser LODs move with the
+	//camera and would not land on a grid that can be baked ahead of time.
+	//Regions are in key order so each worker starts out with a block of neighbours.
+	TArray<FSChunkMeshKey> Regions;
+	int NumSkippedRegions = 0;
+	FSChunkMeshKey BakeKey = Settings;
+	BakeKey.LOD = 0;
+	FString RegionDirectory = FPaths::GetPath(FSRegionArchive::GetRegionPath(BakeSettings.Directory, BakeKey, FIntVector::ZeroValue));
+	
+	int RegionSize = GetChunkSize(BakeKey) * FSRegionArchive::RegionChunks;
+	FIntVector First, Last;
+	GetChunkKeyBounds(BakeKey, First, Last);
+	BakeKey.ChunkKey = First;
+	FIntVector FirstRegion = FSRegionArchive::GetRegion(BakeKey);
+	BakeKey.ChunkKey = Last;
+	FIntVector LastRegion = FSRegionArchive::GetRegion(BakeKey);
+	
+	for (int X = FirstRegion.X; X <= LastRegion.X; X++)
+	{
+		for (int Y = FirstRegion.Y; Y <= LastRegion.Y; Y++)
+		{
+			for (int Z = FirstRegion.Z; Z <= LastRegion.Z; Z++)
+			{
+				BakeKey.ChunkKey = FIntVector(X, Y, Z) * RegionSize;
+				if (!bRestart && FSRegionArchive::IsRegionBaked(BakeSettings.Directory, BakeKey))
+				{
+					NumSkippedRegions++;
+					continue;
+				}
+				Regions.Add(BakeKey);
+			}
+		}
+	}
+
+	TArray<FSBakeQueue> Queues;
+	Queues.SetNum(NumWorkers);
+	for (int RegionIndex = 0; RegionIndex < Regions.Num(); RegionIndex++)
+	{
+		Queues[int64(RegionIndex) * NumWorkers / Regions.Num()].Regions.Add(Regions[RegionIndex]);
+	}
+	
+	UE_LOG(LogSVoxel, Display, TEXT("Baking %d regions of LOD 0 on %d workers into %s, %d regions were already baked"), Regions.Num(),
+		NumWorkers, *BakeSettings.Directory, NumSkippedRegions);
+	
+	FSBakeProgress Progress;
+	Progress.TotalRegions = Regions.Num();
+	Progress.StartTime = FPlatformTime::Seconds();
+	Progress.LastReportTime = Progress.StartTime;
+	ParallelFor(NumWorkers, [&](int32 Worker)
+	{
+		TArray<float> Voxels;
+		FSChunkMeshKey RegionKey;
+		while (PopRegion(Queues, Worker, RegionKey, Progress))
+		{
+			BakeRegion(RegionKey, BakeSettings, Voxels, Progress);
+			ReportProgress(Progress);
+		}
+	});
+	double BakeTime = FPlatformTime::Seconds() - Progress.StartTime;
+
+	//Size of every region with these settings, including the ones baked before a resume
+	int64 ArchiveSize = 0;
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *FPaths::Combine(RegionDirectory, TEXT("*.svregion")), true, false);
+	for (const FString& File : Files)
+	{
+		ArchiveSize += IFileManager::Get().FileSize(*FPaths::Combine(RegionDirectory, File));
+	}
+	int NumRegionFiles = Files.Num();
+
+	UE_LOG(LogSVoxel, Display, TEXT("Baked %lld chunks in %lld regions in %.1f s, %.1f chunks/s, %lld regions were stolen"), Progress.NumChunks.load(),
+		Progress.NumRegions.load(), BakeTime, Progress.NumChunks.load() / FMath::Max(BakeTime, 0.001), Progress.NumSteals.load());
+	UE_LOG(LogSVoxel, Display, TEXT("Archive is %d region files, %.2f MB, %.2f MB written by this bake"), NumRegionFiles,
+		ArchiveSize / (1024.0 * 1024.0), Progress.WrittenBytes.load() / (1024.0 * 1024.0));
+	
+	if (Progress.bFailed)
+	{
+		UE_LOG(LogSVoxel, Error, TEXT("Some region files could not be written, run the bake again to retry them"));
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+﻿#include "SSnapshotExchange.h"
+#include "SVoxelPlugin.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Publishes numbered snapshots from a thread while this one takes them, every snapshot must be whole and newer than the last one
+static void StressSnapshotExchange(const TArray<FString>& Args)
+{
+	int NumSnapshots = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200000;
+	
+	struct FSnapshot
+	{
+		int Version = 0;
+		TArray<int> Values;
+	};
+	TSSnapshotExchange<FSnapshot> Exchange;
+	constexpr int NumValues = 64;
+
+	double StartTime = FPlatformTime::Seconds();
+	TFuture<void> Writer = Async(EAsyncExecution::Thread, [&Exchange, NumSnapshots]()
+	{
+		for (int Version = 1; Version <= NumSnapshots; Version++)
+		{
+			FSnapshot& Snapshot = Exchange.GetWriteBuffer();
+			Snapshot.Version = Version;
+			Snapshot.Values.Init(Version, NumValues);
+			Exchange.Publish();
+		}
+	});
+
+	int LastVersion = 0;
+	int NumTaken = 0;
+	int NumTorn = 0;
+	int NumStale = 0;
+	while (LastVersion < NumSnapshots)
+	{
+		if (!Exchange.Update())
+		{
+			FPlatformProcess::Yield();
+			continue;
+		}
+		
+		//The reader may move from its snapshot, the writer gets the slot back and fills it again
+		FSnapshot Snapshot = MoveTemp(Exchange.GetReadBuffer());
+		NumTaken++;
+		if (Snapshot.Version <= LastVersion)
+		{
+			NumStale++;
+		}
+		if (Snapshot.Values.Num() != NumValues || Snapshot.Values.ContainsByPredicate([&Snapshot](int Value) { return Value != Snapshot.Version; }))
+		{
+			NumTorn++;
+		}
+		LastVersion = FMath::Max(LastVersion, Snapshot.Version);
+	}
+	Writer.Wait();
+
+	bool bFailed = NumTorn > 0 || NumStale > 0 || Exchange.Update();
+	UE_LOG(LogSVoxel, Log, TEXT("Snapshot exchange: %d published, %d taken, %d torn, %d stale in %.2f ms%s"), NumSnapshots, NumTaken,
+		NumTorn, NumStale, (FPlatformTime::Seconds() - StartTime) * 1000.0, bFailed ? TEXT(", FAILED") : TEXT(""));
+}
+
+static FAutoConsoleCommand StressSnapshotExchangeCommand(
+	TEXT("SVoxel.StressSnapshotExchange"),
+	TEXT("Hands snapshots between two threads through the lock free exchange the chunk world and worker use, optionally takes the snapshot count"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&StressSnapshotExchange));
+
+#endif
@@ -2,6 +2,8 @@
 
 #define LOCTEXT_NAMESPACE "FSVoxelPluginGeneratorModule"
 
+DEFINE_LOG_CATEGORY(LogSVoxel);
+
 void FSVoxelPluginModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
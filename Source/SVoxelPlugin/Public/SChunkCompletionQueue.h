@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SDispatchCS.h"
+#include "SChunkMeshCache.h"
+#include "Containers/Queue.h"
+#include <atomic>
+
+//A chunk the worker is done with, spawned or deleted on the game thread
+struct SVOXELPLUGIN_API FSChunkCompletion
+{
+	//Only the chunk key and LOD are set for a delete
+	FSChunkMeshKey MeshKey;
+	bool bDelete = false;
+
+	FSDispatchCSOutput Output;
+	FSDispatchCancelToken CancelToken;
+	//Pass the chunk was dispatched in
+	int Pass = 0;
+};
+
+//Completions of one chunk key that were not applied yet. The deletes are applied before the spawn, so a chunk
+//that is deleted and spawned again is replaced within one frame.
+struct SVOXELPLUGIN_API FSPendingChunk
+{
+	int NumDeletes = 0;
+	TOptional<FSChunkCompletion> Spawn;
+};
+
+/**
+ * Spawns and deletes handed to the game thread by the worker and the dispatch callbacks.
+ * Any thread pushes into a lock free queue. The game thread gathers it into one pending entry per chunk key, then applies
+ * the entries nearest to the camera first until its frame budget is spent, the rest waits for the next frame.
+ */
+class SVOXELPLUGIN_API FSChunkCompletionQueue
+{
+public:
+	// Any thread
+	void Enqueue(FSChunkCompletion&& Completion);
+
+	// Game thread. Moves the enqueued completions into the pending entries, a spawn followed by a delete of the same key
+	// never reaches the chunk world and is handed to OnDropped instead.
+	void Gather(TFunctionRef<void(FSChunkCompletion&)> OnDropped);
+	
+	// Game thread. Applies the pending entries nearest to Location until BudgetSeconds passed, at least one is applied per call
+	// and all of them without a budget. SmallestChunkSize places the chunk centers. Returns the number of entries applied.
+	int Drain(const FVector& Location, int SmallestChunkSize, double BudgetSeconds,
+		TFunctionRef<void(const FIntVector& ChunkKey, int LOD, FSPendingChunk& Pending)> Apply);
+
+	// Completions waiting in the queue or in a pending entry
+	int Num() const { return NumQueued.load() + NumPending; }
+
+private:
+	TQueue<FSChunkCompletion, EQueueMode::Mpsc> Queue;
+	std::atomic<int> NumQueued = 0;
+	
+	//Game thread only, per LOD
+	TArray<TMap<FIntVector, FSPendingChunk>> PendingChunks;
+	int NumPending = 0;
+};
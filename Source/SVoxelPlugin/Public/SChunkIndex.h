@@ -0,0 +1,273 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Chunk key and LOD packed into 64 bits. The key is counted in LOD 0 chunks from the world origin and its axes are interleaved
+ * into a Morton code, the LOD sits above it. Sorting orders the indices by LOD first, then along the Morton curve, so chunks
+ * close to each other end up close in sorted arrays and tables.
+ */
+struct SVOXELPLUGIN_API FSChunkIndex
+{
+	uint64 Code = 0;
+
+	//Each axis covers this many LOD 0 chunks on both sides of the world origin
+	static constexpr int BitsPerAxis = 19;
+	static constexpr int MaxCoordinate = (1 << (BitsPerAxis - 1)) - 1;
+	static constexpr int MinCoordinate = -(1 << (BitsPerAxis - 1));
+	static constexpr int MaxLOD = 14;
+	
+	FSChunkIndex() = default;
+	explicit FSChunkIndex(uint64 InCode) : Code(InCode) {}
+
+	// SmallestChunkSize is the size of a LOD 0 chunk, every chunk key is a multiple of it
+	static FSChunkIndex FromChunkKey(const FIntVector& ChunkKey, int LOD, int SmallestChunkSize);
+	static FSChunkIndex FromCoordinates(const FIntVector& Coordinates, int LOD);
+	
+	FIntVector ToChunkKey(int SmallestChunkSize) const { return GetCoordinates() * SmallestChunkSize; }
+	FIntVector GetCoordinates() const;
+	int GetLOD() const { return int(Code >> (BitsPerAxis * 3 + 2)); }
+
+	bool operator==(const FSChunkIndex& Other) const { return Code == Other.Code; }
+	bool operator!=(const FSChunkIndex& Other) const { return Code != Other.Code; }
+	bool operator<(const FSChunkIndex& Other) const { return Code < Other.Code; }
+
+	friend uint32 GetTypeHash(const FSChunkIndex& Index)
+	{
+		return GetTypeHash(Index.Code);
+	}
+
+	// Walks both sorted arrays once and adds the indices only in A to OutOnlyA and the ones only in B to OutOnlyB, either may be null
+	static void SortedDifference(TConstArrayView<FSChunkIndex> SortedA, TConstArrayView<FSChunkIndex> SortedB,
+		TArray<FSChunkIndex>* OutOnlyA, TArray<FSChunkIndex>* OutOnlyB);
+	// Sorted merge of Sorted without SortedRemove and with SortedAdd, SortedAdd must not overlap Sorted
+	static void SortedMerge(TConstArrayView<FSChunkIndex> Sorted, TConstArrayView<FSChunkIndex> SortedRemove,
+		TConstArrayView<FSChunkIndex> SortedAdd, TArray<FSChunkIndex>& OutSorted);
+	// True if Index is in the sorted array
+	static bool SortedContains(TConstArrayView<FSChunkIndex> Sorted, FSChunkIndex Index);
+};
+
+/**
+ * Flat hash table from chunk indices to values, for per chunk state that is looked up by key. Codes and values live in two arrays
+ * probed linearly from a multiplicative hash of the code, removal shifts the following entries back instead of leaving tombstones.
+ * It grows past 70% occupancy. Pointers to values are invalidated by Add and Remove.
+ */
+template<typename ValueType>
+class TSChunkTable
+{
+public:
+	int Num() const { return NumEntries; }
+	bool IsEmpty() const { return NumEntries == 0; }
+	
+	void Reserve(int Number)
+	{
+		int Capacity = MinCapacity;
+		while (Number * 10 > Capacity * 7)
+		{
+			Capacity *= 2;
+		}
+		if (Capacity > Codes.Num())
+		{
+			Rehash(Capacity);
+		}
+	}
+	
+	// Keeps the memory
+	void Reset()
+	{
+		for (int Slot = 0; Slot < Codes.Num(); Slot++)
+		{
+			if (Codes[Slot] != EmptyCode)
+			{
+				Codes[Slot] = EmptyCode;
+				Values[Slot] = ValueType();
+			}
+		}
+		NumEntries = 0;
+	}
+	
+	void Empty()
+	{
+		Codes.Empty();
+		Values.Empty();
+		NumEntries = 0;
+		Shift = 64;
+	}
+
+	ValueType* Find(FSChunkIndex Index)
+	{
+		int Slot = FindSlot(Index.Code);
+		return Slot != INDEX_NONE ? &Values[Slot] : nullptr;
+	}
+	
+	const ValueType* Find(FSChunkIndex Index) const
+	{
+		int Slot = FindSlot(Index.Code);
+		return Slot != INDEX_NONE ? &Values[Slot] : nullptr;
+	}
+	
+	bool Contains(FSChunkIndex Index) const
+	{
+		return FindSlot(Index.Code) != INDEX_NONE;
+	}
+
+	// Adds the value or overwrites the one of the index
+	ValueType& Add(FSChunkIndex Index, ValueType Value)
+	{
+		check(Index.Code != EmptyCode);
+		if ((NumEntries + 1) * 10 > Codes.Num() * 7)
+		{
+			Rehash(FMath::Max(MinCapacity, Codes.Num() * 2));
+		}
+		
+		uint32 Mask = Codes.Num() - 1;
+		for (uint32 Slot = GetHomeSlot(Index.Code);; Slot = (Slot + 1) & Mask)
+		{
+			if (Codes[Slot] == EmptyCode)
+			{
+				Codes[Slot] = Index.Code;
+				NumEntries++;
+			}
+			else if (Codes[Slot] != Index.Code)
+			{
+				continue;
+			}
+			Values[Slot] = MoveTemp(Value);
+			return Values[Slot];
+		}
+	}
+
+	bool Remove(FSChunkIndex Index)
+	{
+		int Slot = FindSlot(Index.Code);
+		if (Slot == INDEX_NONE)
+			return false;
+		
+		RemoveSlot(Slot);
+		return true;
+	}
+	
+	bool RemoveAndCopyValue(FSChunkIndex Index, ValueType& OutValue)
+	{
+		int Slot = FindSlot(Index.Code);
+		if (Slot == INDEX_NONE)
+			return false;
+
+		OutValue = MoveTemp(Values[Slot]);
+		RemoveSlot(Slot);
+		return true;
+	}
+
+	// Calls Visitor(FSChunkIndex, ValueType&) for every entry in slot order
+	template<typename VisitorType>
+	void ForEach(VisitorType&& Visitor)
+	{
+		for (int Slot = 0; Slot < Codes.Num(); Slot++)
+		{
+			if (Codes[Slot] != EmptyCode)
+			{
+				Visitor(FSChunkIndex(Codes[Slot]), Values[Slot]);
+			}
+		}
+	}
+	
+	// Removes every entry Predicate(FSChunkIndex, const ValueType&) returns true for
+	template<typename PredicateType>
+	void RemoveIf(PredicateType&& Predicate)
+	{
+		TArray<uint64, TInlineAllocator<64>> RemoveCodes;
+		for (int Slot = 0; Slot < Codes.Num(); Slot++)
+		{
+			if (Codes[Slot] != EmptyCode && Predicate(FSChunkIndex(Codes[Slot]), static_cast<const ValueType&>(Values[Slot])))
+			{
+				RemoveCodes.Add(Codes[Slot]);
+			}
+		}
+		for (uint64 Code : RemoveCodes)
+		{
+			RemoveSlot(FindSlot(Code));
+		}
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Codes.GetAllocatedSize() + Values.GetAllocatedSize();
+	}
+
+private:
+	static constexpr uint64 EmptyCode = ~uint64(0);
+	static constexpr int MinCapacity = 16;
+	
+	uint32 GetHomeSlot(uint64 Code) const
+	{
+		//Fibonacci hashing, neighboring Morton codes land far apart
+		return uint32((Code * 0x9E3779B97F4A7C15ull) >> Shift);
+	}
+
+	int FindSlot(uint64 Code) const
+	{
+		if (NumEntries == 0)
+			return INDEX_NONE;
+		
+		uint32 Mask = Codes.Num() - 1;
+		for (uint32 Slot = GetHomeSlot(Code);; Slot = (Slot + 1) & Mask)
+		{
+			if (Codes[Slot] == Code)
+				return Slot;
+			if (Codes[Slot] == EmptyCode)
+				return INDEX_NONE;
+		}
+	}
+
+	void RemoveSlot(uint32 Hole)
+	{
+		uint32 Mask = Codes.Num() - 1;
+		//Entries after the hole move into it unless their home slot lies between the hole and them
+		for (uint32 Slot = (Hole + 1) & Mask; Codes[Slot] != EmptyCode; Slot = (Slot + 1) & Mask)
+		{
+			uint32 HomeSlot = GetHomeSlot(Codes[Slot]);
+			if (((Slot - HomeSlot) & Mask) >= ((Slot - Hole) & Mask))
+			{
+				Codes[Hole] = Codes[Slot];
+				Values[Hole] = MoveTemp(Values[Slot]);
+				Hole = Slot;
+			}
+		}
+		Codes[Hole] = EmptyCode;
+		Values[Hole] = ValueType();
+		NumEntries--;
+	}
+
+	void Rehash(int Capacity)
+	{
+		TArray<uint64> OldCodes = MoveTemp(Codes);
+		TArray<ValueType> OldValues = MoveTemp(Values);
+		
+		Codes.Init(EmptyCode, Capacity);
+		Values.SetNum(Capacity);
+		Shift = 64 - FMath::FloorLog2(uint32(Capacity));
+		NumEntries = 0;
+		
+		uint32 Mask = Capacity - 1;
+		for (int OldSlot = 0; OldSlot < OldCodes.Num(); OldSlot++)
+		{
+			if (OldCodes[OldSlot] == EmptyCode)
+				continue;
+			
+			uint32 Slot = GetHomeSlot(OldCodes[OldSlot]);
+			while (Codes[Slot] != EmptyCode)
+			{
+				Slot = (Slot + 1) & Mask;
+			}
+			Codes[Slot] = OldCodes[OldSlot];
+			Values[Slot] = MoveTemp(OldValues[OldSlot]);
+			NumEntries++;
+		}
+	}
+
+	//EmptyCode marks a free slot, the capacity is a power of two
+	TArray<uint64> Codes;
+	TArray<ValueType> Values;
+	int NumEntries = 0;
+	int Shift = 64;
+};
@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SChunkIndex.h"
+
+/**
+ * Everything that decides which chunk keys of a LOD are loaded around an origin.
+ * OriginLocation is the LOD 0 chunk the camera is in for every LOD. The keys of a LOD are laid around its box origin, the multiple
+ * of the next coarser chunk size nearest to the camera chunk, so the box of a LOD is exactly the hole of the next coarser one and
+ * a LOD only moves once the camera crossed a chunk of the next coarser LOD.
+ */
+struct SVOXELPLUGIN_API FSChunkKeyParams
+{
+	FIntVector OriginLocation = FIntVector::ZeroValue;
+	int LOD = 0;
+	int ChunkSize = 1;
+	//Chunks loaded in each direction from the box origin, before the distance thresholds are applied
+	int DrawDistance = 0;
+	
+	float UndergroundHeight = 0.0f;
+	int aboveUpperDistance = 0;
+	int aboveDownDistance = 0;
+	int underUpperDistance = 0;
+	int underDownDistance = 0;
+};
+
+/**
+ * Chunk key set of a LOD, either built in full or as the delta between two origins.
+ * The delta only walks the slabs that enter or leave the draw distance, so a camera crossing one chunk boundary
+ * costs a slab instead of the whole volume plus two set differences.
+ */
+class SVOXELPLUGIN_API FSChunkKeys
+{
+public:
+	// Adds every chunk key loaded around Params.OriginLocation to OutChunkKeys
+	static void GetChunkKeys(const FSChunkKeyParams& Params, TSet<FIntVector>& OutChunkKeys);
+	// Replaces OutSortedChunkIndices with the same keys as chunk indices, sorted
+	static void GetChunkIndices(const FSChunkKeyParams& Params, TArray<FSChunkIndex>& OutSortedChunkIndices);
+	// Size of a LOD 0 chunk, chunk indices count in it
+	static int GetSmallestChunkSize(const FSChunkKeyParams& Params) { return Params.ChunkSize >> Params.LOD; }
+
+	// True if ChunkKey is loaded around Params.OriginLocation, matches GetChunkKeys exactly
+	static bool ContainsChunkKey(const FSChunkKeyParams& Params, const FIntVector& ChunkKey);
+	// True if ChunkKey is on the key grid of Params and outside the hole the finer LOD fills, at any distance
+	static bool IsOnGridOutsideHole(const FSChunkKeyParams& Params, const FIntVector& ChunkKey);
+	// Origin the keys of LOD are laid around, the multiple of the chunk size of LOD + 1 nearest to the center of the camera chunk
+	static FIntVector GetBoxOrigin(const FSChunkKeyParams& Params, int LOD);
+
+	// Origin of the chunks around the camera. An axis of the current origin is kept until the camera moved further than
+	// HysteresisBand chunks past the border of its chunk on that axis, so hovering over a border does not move it back and forth.
+	static FIntVector GetOriginLocation(const FVector& CameraLocation, int ChunkSize, const FIntVector* CurrentOrigin, float HysteresisBand);
+
+	// Adds the keys entering and leaving the set when moving from OldParams to NewParams.
+	// Returns false without touching the arrays if the delta can't be computed incrementally (origin crossed the underground height
+	// or any other setting changed), the caller should rebuild the set in full instead.
+	static bool GetChunkKeyDelta(const FSChunkKeyParams& OldParams, const FSChunkKeyParams& NewParams,
+		TArray<FIntVector>& OutEnteringChunkKeys, TArray<FIntVector>& OutLeavingChunkKeys);
+
+private:
+	static void ForEachChunkKey(const FSChunkKeyParams& Params, TFunctionRef<void(const FIntVector&)> Visitor);
+	
+	// Undoes the sign expansion of GetChunkKeys, offsets -1 and 0 both come from distance index 0
+	static FIntVector GetDistanceIndex(const FSChunkKeyParams& Params, const FIntVector& ChunkKey);
+	// True if the key is inside the box of the finer LOD, which spans LOD chunks on each side of the finer box origin
+	static bool IsInsideHole(const FSChunkKeyParams& Params, const FIntVector& ChunkKey);
+	
+	static bool IsOriginUnderground(const FSChunkKeyParams& Params);
+	static bool IsChunkUnderground(const FSChunkKeyParams& Params, const FIntVector& ChunkKey);
+	static int GetDistanceThreshold(const FSChunkKeyParams& Params, bool bChunkUnderground);
+
+	// Largest distance index of a chunk on each axis, -1 if no chunk is in range
+	static int GetMaxDistanceIndex(const FSChunkKeyParams& Params, bool bChunkUnderground);
+
+	// Walks the keys of NewParams that are not in OldParams
+	static void AddEnteringChunkKeys(const FSChunkKeyParams& OldParams, const FSChunkKeyParams& NewParams, TArray<FIntVector>& OutChunkKeys);
+};
+
+/**
+ * Loaded chunk keys of one LOD. A key that leaves the load radius stays loaded while it is inside the unload radius, which is
+ * UnloadMargin steps of the box further out, or while it is younger than MinLifetime. Kept keys are checked again on the next update.
+ * Keys off the new key grid or inside the hole of the finer LOD are always deleted, their space is generated again.
+ * An entering key over a key a finer LOD keeps is held back until that key is deleted, so the two never draw the same space.
+ */
+class SVOXELPLUGIN_API FSChunkKeySet
+{
+public:
+	// Moves ChunkIndices, the sorted loaded keys of the last update, to the keys of Params. OutNewChunkKeys have to be generated,
+	// OutDeleteChunkKeys deleted. Time is in seconds. FinerChunkKeySets are the sets of the finer LODs, updated for the same origin already.
+	void Update(const FSChunkKeyParams& Params, double Time, TConstArrayView<FSChunkKeySet> FinerChunkKeySets, TArray<FSChunkIndex>& ChunkIndices,
+		TArray<FIntVector>& OutNewChunkKeys, TArray<FIntVector>& OutDeleteChunkKeys);
+	
+	// Forgets the last update, the next one rebuilds the set in full
+	void Reset();
+
+	int UnloadMargin = 0;
+	double MinLifetime = 0.0;
+	
+	//Keys generated again this soon after their delete count as a thrash
+	double ThrashWindow = 10.0;
+	int64 GetNumThrashes() const { return NumThrashes; }
+	int GetNumRetained() const { return RetainedChunkIndices.Num(); }
+
+private:
+	bool ShouldRetain(const FSChunkKeyParams& Params, const FIntVector& ChunkKey, FSChunkIndex ChunkIndex, double Time) const;
+	
+	TOptional<FSChunkKeyParams> LastParams;
+	//Loaded keys outside the load radius, sorted
+	TArray<FSChunkIndex> RetainedChunkIndices;
+	//Keys in the load radius that wait for a retained key of a finer LOD, not loaded and not in ChunkIndices, sorted
+	TArray<FSChunkIndex> BlockedChunkIndices;
+	TSChunkTable<double> AddTimes;
+	TSChunkTable<double> DeleteTimes;
+	int64 NumThrashes = 0;
+};
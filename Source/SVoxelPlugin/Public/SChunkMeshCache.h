@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SDispatchCS.h"
+#include "Containers/List.h"
+
+//Everything a chunk mesh was generated from, a cached mesh is only reused with the same settings
+struct SVOXELPLUGIN_API FSChunkMeshKey
+{
+	FIntVector ChunkKey;
+	int LOD = 0;
+	
+	FIntVector3 WorldSize;
+	int Size = 0;
+	int Scale = 0;
+	float Isolevel = 0.0f;
+	int32 Seed = 0;
+
+	//LOD 0 meshes spawned with collision have their geometry on the cpp side
+	bool bCollision = false;
+
+	bool operator==(const FSChunkMeshKey& Other) const
+	{
+		return ChunkKey == Other.ChunkKey && LOD == Other.LOD && WorldSize == Other.WorldSize && Size == Other.Size && Scale == Other.Scale
+			&& Isolevel == Other.Isolevel && Seed == Other.Seed && bCollision == Other.bCollision;
+	}
+
+	friend uint32 GetTypeHash(const FSChunkMeshKey& Key)
+	{
+		uint32 Hash = HashCombine(GetTypeHash(Key.ChunkKey), GetTypeHash(Key.LOD));
+		Hash = HashCombine(Hash, GetTypeHash(Key.WorldSize));
+		Hash = HashCombine(Hash, GetTypeHash(Key.Size));
+		Hash = HashCombine(Hash, GetTypeHash(Key.Scale));
+		Hash = HashCombine(Hash, GetTypeHash(Key.Isolevel));
+		Hash = HashCombine(Hash, GetTypeHash(Key.Seed));
+		return HashCombine(Hash, GetTypeHash(Key.bCollision));
+	}
+};
+
+/**
+ * Meshes of deleted chunks, kept so a chunk that comes back into view is spawned again without generating it.
+ * A mesh leaves the cache when it is spawned, so the least recently deleted one is the least recently used and is evicted first
+ * once the cache is over its memory budget. Its ranges of the chunk buffer pool stay allocated while it is cached. Empty chunks are
+ * kept as entries without a mesh. Thread safe.
+ */
+class SVOXELPLUGIN_API FSChunkMeshCache
+{
+public:
+	explicit FSChunkMeshCache(int64 InMaxMemory);
+	~FSChunkMeshCache();
+	
+	// Keeps the mesh of a deleted chunk, cancelled and overflowed outputs are not cached and empty ones go through AddEmpty
+	void Add(const FSChunkMeshKey& Key, const FSDispatchCSOutput& Output);
+	// Keeps a deleted chunk that has no geometry, Take hands it back as an empty output
+	void AddEmpty(const FSChunkMeshKey& Key);
+	// Removes the mesh of the chunk from the cache into OutOutput, false on a miss. A mesh that overflowed since it was cached is a miss.
+	bool Take(const FSChunkMeshKey& Key, FSDispatchCSOutput& OutOutput);
+	// True if the mesh of the chunk is cached, does not count as a hit or miss
+	bool Contains(const FSChunkMeshKey& Key) const;
+	
+	void Empty();
+
+	int64 GetMemory() const;
+	int64 GetMaxMemory() const { return MaxMemory; }
+	int Num() const;
+	
+	// Counters since the cache was created
+	int64 GetNumHits() const;
+	int64 GetNumMisses() const;
+	int64 GetNumEvictions() const;
+
+	// GPU and CPU memory a cached output keeps alive, pooled outputs are charged for the current size of their ranges
+	static int64 GetMemorySize(const FSDispatchCSOutput& Output);
+
+private:
+	void AddEntry(const FSChunkMeshKey& Key, const FSDispatchCSOutput& Output);
+	void Remove(const FSChunkMeshKey& Key);
+	
+	struct FEntry
+	{
+		FSDispatchCSOutput Output;
+		int64 MemorySize;
+		TDoubleLinkedList<FSChunkMeshKey>::TDoubleLinkedListNode* Node;
+	};
+	TMap<FSChunkMeshKey, FEntry> Entries;
+	//Most recently added at the head, evicted from the tail
+	TDoubleLinkedList<FSChunkMeshKey> AddOrder;
+	mutable FCriticalSection Lock;
+
+	int64 Memory = 0;
+	int64 MaxMemory;
+
+	int64 NumHits = 0;
+	int64 NumMisses = 0;
+	int64 NumEvictions = 0;
+};
+
+typedef TSharedPtr<FSChunkMeshCache, ESPMode::ThreadSafe> FSChunkMeshCacheRef;
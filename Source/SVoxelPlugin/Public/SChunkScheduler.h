@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct SVOXELPLUGIN_API FSChunkTask
+{
+	FIntVector ChunkKey;
+	int LOD;
+	
+	//Lower values are dispatched first
+	float Priority;
+
+	//Generated ahead of the camera into the mesh cache instead of being spawned
+	bool bPrefetch = false;
+};
+
+/**
+ * Priority queue of chunks waiting to be generated, shared by every LOD.
+ * Chunks close to the camera and in front of it come out first, the LOD only breaks ties. Prefetched chunks come out after all others.
+ */
+class SVOXELPLUGIN_API FSChunkScheduler
+{
+public:
+	// Clears the queue and sets the view used to prioritize the chunks pushed afterwards
+	void Reset(const FVector& NewViewLocation, const FVector& NewViewDirection, int NewSmallestChunkSize);
+
+	void Push(const FIntVector& ChunkKey, int LOD, int ChunkSize);
+	void PushPrefetch(const FIntVector& ChunkKey, int LOD, int ChunkSize);
+	bool Pop(FSChunkTask& OutTask);
+	
+	int Num() const { return Tasks.Num(); }
+	bool IsEmpty() const { return Tasks.IsEmpty(); }
+
+	float GetPriority(const FIntVector& ChunkKey, int LOD, int ChunkSize) const;
+
+private:
+	struct FTaskPredicate
+	{
+		bool operator()(const FSChunkTask& A, const FSChunkTask& B) const
+		{
+			if(A.bPrefetch != B.bPrefetch)
+				return B.bPrefetch;
+			return A.Priority < B.Priority;
+		}
+	};
+	
+	TArray<FSChunkTask> Tasks;
+
+	FVector ViewLocation = FVector::ZeroVector;
+	FVector ViewDirection = FVector::ForwardVector;
+	int SmallestChunkSize = 1;
+};
@@ -2,12 +2,17 @@
 
 #include "CoreMinimal.h"
 #include "SChunkWorld.h"
+#include "SChunkScheduler.h"
+#include "SChunkKeys.h"
+#include "SDispatchCS.h"
+#include "SChunkMeshCache.h"
+#include "SRegionArchive.h"
+#include "SChunkCompletionQueue.h"
+#include "SSnapshotExchange.h"
 #include "HAL/Runnable.h"
 
 struct SVOXELPLUGIN_API FChunkInput
 {
-	TSet<FIntVector> OldChunks;
-
 	FIntVector3 WorldSize;
 	float UndergroundHeight;
 	int aboveUpperDistance = 0;
@@ -22,15 +27,56 @@ struct SVOXELPLUGIN_API FChunkInput
 	
 	float Isolevel;
 	int32 seed;
+
+	int MaxLOD = 0;
+	FVector CameraLocation = FVector::ZeroVector;
+	FVector CameraDirection = FVector::ForwardVector;
+
+	//Skip the compute shaders and complete every chunk after SimulatedDispatchTime seconds
+	bool bSimulateDispatch = false;
+	float SimulatedDispatchTime = 0.0f;
+
+	//Generate chunks without reading their counts back, LOD 0 keeps the counted path while it needs collision
+	bool bGPUDrivenDispatch = false;
+	bool bCollisionEnabled = true;
+	//Generate chunks with the same buffer layout on every run, these always take the counted path
+	bool bDeterministicDispatch = false;
+
+	//Chunks past the load radius of their LOD that are kept, and the time a chunk is kept at least
+	int UnloadMargin = 0;
+	float MinChunkLifetime = 0.0f;
+
+	//Smoothed camera velocity, the chunks it reaches within PrefetchHorizon seconds are generated ahead into the mesh cache.
+	//0 disables the prefetch.
+	FVector CameraVelocity = FVector::ZeroVector;
+	float PrefetchHorizon = 0.0f;
+
+	// Chunk key settings of a LOD around OriginLocation, the keys snap the box of each LOD to the grid of the next coarser one
+	FSChunkKeyParams GetChunkKeyParams(int LOD) const;
+	int GetChunkSize(int LOD) const;
+};
+
+//A chunk generated ahead of the camera, its output goes into the mesh cache unless a chunk task takes it over while it is in flight
+struct SVOXELPLUGIN_API FSPrefetchChunk
+{
+	FSDispatchCancelToken CancelToken;
+	//Pass of the chunk task that took the prefetch over, it completes that task like the task's own dispatch would
+	int TakenOverPass = INDEX_NONE;
+	//The output is in the mesh cache, or was empty and is not generated again
+	bool bDone = false;
+	bool bEmpty = false;
 };
 
 /**
- *
+ * Owned through a shared pointer. The dispatch callbacks only hold it weakly, the ones that complete after the chunk world let go
+ * of the worker drop their outputs.
  */
-class SVOXELPLUGIN_API FSChunkWorker : public FRunnable
+class SVOXELPLUGIN_API FSChunkWorker : public FRunnable, public TSharedFromThis<FSChunkWorker, ESPMode::ThreadSafe>
 {
 public:
-	FSChunkWorker(ASChunkWorld* NewChunkWorld, int NewLOD);
+	FSChunkWorker(ASChunkWorld* NewChunkWorld);
+	// Worker without a chunk world, its completions are only cached. Drives the dev checks.
+	FSChunkWorker(int NewMaxConcurrentTasks, FSChunkMeshCacheRef NewMeshCache);
 	virtual ~FSChunkWorker() override;
 	
 	bool Init() override;
@@ -39,26 +85,115 @@ public:
 	virtual void Exit() override;
 	void Stop() override;
 	
+	// Joins the thread. Dispatches still in flight complete into a worker that is stopped, or no worker at all once it is released.
 	void StopAndEnsureCompletion();
 
+	// Game thread. Hands a new input to the worker and wakes it up, an input the worker did not start on yet is replaced
+	void PublishInput(const FChunkInput& NewChunkInput);
+
+	// Game thread. Spawns and deletes the completed chunks nearest to the camera first, until BudgetMs passed
+	void DrainCompletions(const FVector& CameraLocation, int SmallestChunkSize, float BudgetMs);
+
+	// Times the thread went through its loop, it must not go on counting while it has no new input
+	int GetNumRunIterations() const { return NumRunIterations; }
+	// Passes the thread finished, a pass is done once all of its chunks were dispatched
+	int GetNumPasses() const { return NumPasses; }
+
 private:
+	void StartThread();
+	
+	// Settings of the current input a chunk is generated with
+	FSChunkMeshKey GetMeshKey(const FIntVector& ChunkKey, int LOD) const;
+
+	// Generates the chunks of the tasks as one batch per dispatch mode
+	void DispatchChunks(const TArray<FSChunkTask>& Tasks, int Pass);
+	void DispatchBatch(const TArray<FSChunkTask>& BatchTasks, const TArray<FSDispatchCSParams>& BatchParams, int Pass);
+	// Uploads the chunks loaded from the region archive
+	void UploadBatch(const TArray<FSChunkTask>& BatchTasks, const TArray<FSDispatchCancelToken>& CancelTokens, TArray<FSChunkMeshData> Meshes, int Pass);
+	// Queues the outputs of a batch to be spawned, the ones whose chunk was deleted meanwhile are dropped
+	void SpawnChunks(const TArray<FSChunkTask>& BatchTasks, const TArray<FSDispatchCancelToken>& CancelTokens,
+		const TArray<FSChunkMeshKey>& MeshKeys, TArray<FSDispatchCSOutput>& Outputs, int Pass);
+	// Game thread. Spawns a queued chunk, or keeps its mesh in the cache if the chunk was deleted while it waited
+	void CompleteSpawn(FSChunkCompletion& Completion, ASChunkWorld* ChunkWorldRef);
+	void OnChunkCompleted(int LOD, int Pass);
+	// Generates the loaded chunks whose GPU driven output overflowed again on the counted path
+	void RedispatchOverflowedChunks();
+
+	// Sorted chunks of every LOD the camera loads along its velocity within the prefetch horizon that are not loaded yet
+	void GetPrefetchChunkIndices(TArray<FSChunkIndex>& OutSortedChunkIndices) const;
+	// Cancels the prefetches that left the predicted path and queues the new ones behind the chunk tasks
+	void QueuePrefetchChunks();
+	// Registers a prefetch about to be dispatched, false if its chunk is cached or prefetched already
+	bool StartPrefetch(const FSChunkTask& Task, FSDispatchCancelToken& OutCancelToken);
+	// Hands an in flight prefetch of the task's chunk over to the task, true if the prefetch completes the task.
+	// bOutEmpty is set when the chunk was prefetched already and is empty.
+	bool TakeOverPrefetch(const FSChunkTask& Task, int Pass, bool& bOutEmpty);
+	// Any thread. Caches the output of a prefetch, or returns true with the pass of the chunk task that took it over
+	bool FinishPrefetch(const FSChunkMeshKey& MeshKey, const FSDispatchCancelToken& CancelToken, const FSDispatchCSOutput& Output, int& OutPass);
+
+	// Sets the cancellation token of the deleted chunks that are still being generated
+	void CancelInFlightChunks(int LOD, const TArray<FIntVector>& DeleteChunkKeys);
+	void RemoveInFlightChunk(const FIntVector& ChunkKey, int LOD, const FSDispatchCancelToken& CancelToken);
+	
+	// Blocks until a task slot is free, returns false if the thread was stopped while waiting
+	bool WaitForTaskSlot();
+	void OnTaskCompleted();
+	
 	FRunnableThread* Thread;
-	bool bRunThread;
+	std::atomic<bool> bRunThread;
+	std::atomic<int> NumRunIterations = 0;
+	std::atomic<int> NumPasses = 0;
 
-public:
-	bool bInputReady = false;
-	bool bDispatched = false;
+	//Inputs from the game thread
+	TSSnapshotExchange<FChunkInput> InputExchange;
 
+	//Input of the current pass and the chunk keys of every LOD it built, worker thread only
 	FChunkInput ChunkInput;
-	TSet<FIntVector> CurrentChunks;
+	TArray<TArray<FSChunkIndex>> CurrentChunkIndices;
 
-private:
+	//Single in flight budget shared by all LODs
 	FThreadSafeCounter NewChunkTasks;
-	
+
+	FSChunkScheduler Scheduler;
+
+	//Builds CurrentChunkIndices per LOD with the hysteresis of the unload radius and chunk lifetime
+	TArray<FSChunkKeySet> ChunkKeySets;
+
+	//LOD 0 chunks of the current pass that are not generated yet, used to time how long the near field takes to fill
+	FThreadSafeCounter NearFieldTasks;
+	std::atomic<double> PassStartTime = 0.0;
+	std::atomic<bool> bSimulatedPass = false;
+	FThreadSafeCounter PassCounter;
+
+	//Cancellation token of every dispatched chunk that did not complete yet, per LOD
+	TArray<TMap<FIntVector, FSDispatchCancelToken>> InFlightChunks;
+	FCriticalSection InFlightChunksLock;
+	//Prefetched chunks of every LOD, guarded by InFlightChunksLock since they are handed over to in flight chunks
+	TSChunkTable<FSPrefetchChunk> PrefetchChunks;
+
+	//Chunks whose GPU driven output overflowed, pushed by the readbacks
+	TQueue<FSChunkMeshKey, EQueueMode::Mpsc> OverflowedChunks;
+	//Every chunk that overflowed once, worker thread only. These always take the counted path.
+	TSet<FSChunkIndex> CountedChunks;
+	//Pass of the chunks dispatched again between passes, passes count from 1 so it is never the current one
+	static constexpr int RedispatchPass = 0;
+	//Origins along the predicted path that are prefetched at most
+	static constexpr int MaxPrefetchSteps = 8;
+
+	//Signaled when a new input is published
 	FEvent* DispatchEvent;
+	//Signaled every time an in flight task finishes and frees its slot
+	FEvent* TaskCompleteEvent;
 	
 	TWeakObjectPtr<ASChunkWorld> ChunkWorldPointer;
 	
-	int LOD;
+	//Spawns and deletes waiting for the game thread, they keep their task slot until they are applied
+	FSChunkCompletionQueue CompletionQueue;
+	
+	//Meshes of deleted chunks, shared with the chunk world that fills it
+	FSChunkMeshCacheRef MeshCache;
+	//Baked chunks, read before a chunk is generated. Unset without an archive directory.
+	FSRegionReaderRef RegionReader;
+	
 	int MaxConcurrentTasks = 8;
 };
\ No newline at end of file
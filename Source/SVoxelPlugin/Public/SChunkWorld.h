@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "SDispatchCS.h"
+#include "SChunkMeshCache.h"
+#include "SChunkIndex.h"
 #include "GameFramework/Actor.h"
 #include "SChunkWorld.generated.h"
 
@@ -14,6 +16,7 @@ struct FMeshData;
 struct FSDispatchCSOutput;
 class FSChunkWorker;
 class FSVertexWorker;
+struct FSChunkKeyParams;
 
 USTRUCT()
 struct SVOXELPLUGIN_API FChunk
@@ -22,12 +25,23 @@ struct SVOXELPLUGIN_API FChunk
 public:
 	UPROPERTY()
 	USMeshComponent* Mesh;
+
+	//Settings the mesh was generated with, it is cached under them when the chunk is deleted
+	FSChunkMeshKey MeshKey;
 };
 
 struct SVOXELPLUGIN_API FChunkLOD
 {
-	TSet<FIntVector> CurrentChunkKeys;
-    TMap<FIntVector, FChunk> Chunks;
+	//Spawned chunks, empty ones have no mesh
+	TSChunkTable<FChunk> Chunks;
+};
+
+//Camera of one frame of a recorded flythrough, Time counts from the first frame
+struct SVOXELPLUGIN_API FSFlythroughSample
+{
+	double Time;
+	FVector Location;
+	FVector Direction;
 };
 
 UCLASS()
@@ -48,8 +62,43 @@ public:
 	virtual void Tick( float DeltaSeconds ) override;
 
 private:
-	TArray<FSChunkWorker*> ChunkWorkers;
+	TSharedPtr<FSChunkWorker, ESPMode::ThreadSafe> ChunkWorker;
 	TArray<FChunkLOD> ChunkLODs;
+	FSChunkMeshCacheRef MeshCache;
+	//Origin of the last input handed to the worker, unset until the first one
+	TOptional<FIntVector> PublishedOrigin;
+	//Origin the camera reaches within the prefetch horizon when the last input was handed over
+	TOptional<FIntVector> PublishedPrefetchOrigin;
+	
+	//Smoothed velocity of the camera and where it was at the last update
+	FVector CameraVelocity = FVector::ZeroVector;
+	TOptional<FVector> LastCameraLocation;
+	double LastCameraTime = 0.0;
+
+	//Frames checked for holes, the ones with a hole and the missing chunks summed over them
+	int NumCheckedFrames = 0;
+	int NumHoleFrames = 0;
+	int64 NumHoleChunks = 0;
+
+	//Camera path recorded or replayed, and the time and sample the replay is at
+	TArray<FSFlythroughSample> FlythroughSamples;
+	TOptional<double> FlythroughStartTime;
+	int FlythroughSample = 0;
+	bool bFlythroughFinished = false;
+
+	//Unregistered mesh components of deleted chunks, the next spawns take them instead of creating new ones
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<USMeshComponent>> ComponentPool;
+
+	//Spawn and delete cost on the game thread and the garbage collections while playing, logged at EndPlay
+	int NumSpawnedChunks = 0;
+	int NumDeletedChunks = 0;
+	int NumCreatedComponents = 0;
+	uint64 SpawnCycles = 0;
+	uint64 DeleteCycles = 0;
+	int NumGarbageCollections = 0;
+	double GarbageCollectionTime = 0.0;
+	double GarbageCollectionStartTime = 0.0;
 	
 public:
 
@@ -72,10 +121,84 @@ public:
 	int underUpperDistance = 4;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorld")
 	int underDownDistance = 6;
+
+	//Share of a LOD 0 chunk the camera has to move past a chunk border before the chunks are updated around it
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorld", meta = (ClampMin = "0", ClampMax = "1"))
+	float OriginHysteresis = 0.25f;
+
+	//Steps of the box of each LOD a chunk may be past the load radius of its LOD before it is deleted, a box steps by two of its chunks
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorld", meta = (ClampMin = "0"))
+	int UnloadMargin = 1;
+
+	//Seconds a chunk stays loaded at least, even once it left the unload radius
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorld", meta = (ClampMin = "0"))
+	float MinChunkLifetime = 2.0f;
 	
+	//Chunks in flight at once, shared by every LOD
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker")
 	int MaxConcurrentTasks = 8;
 
+	//Skip the compute shaders and only simulate the scheduling, the time to fill the near field is logged every pass
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker")
+	bool bSimulateDispatch = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (EditCondition = "bSimulateDispatch"))
+	float SimulatedDispatchTime = 0.005f;
+
+	//Keep the vertex and index counts on the GPU and draw chunks with indirect args, a chunk is spawned as soon as it is submitted.
+	//LOD 0 keeps reading its geometry back while collision is enabled. SVoxel.ReportDispatchLatency compares both paths.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker")
+	bool bGPUDrivenDispatch = false;
+
+	//Lay out the vertices and indices of every chunk in cell order, the same chunk then gets the same buffers on every run.
+	//Costs a scan pass per chunk and always takes the counted path.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker")
+	bool bDeterministicDispatch = false;
+
+	//Memory the meshes of deleted chunks may keep, a chunk that comes back into view is spawned from them without a dispatch. 0 disables the cache.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0"))
+	int MeshCacheMemoryMB = 256;
+
+	//Game thread time spent spawning and deleting completed chunks per frame, the nearest ones go first and the rest waits. 0 applies all of them.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0"))
+	float CompletionBudgetMs = 2.0f;
+
+	//Reuse the mesh components of deleted chunks instead of destroying them and creating new ones
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker")
+	bool bPoolComponents = true;
+
+	//Components created at BeginPlay, and the most the pool keeps once chunks are deleted
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0", EditCondition = "bPoolComponents"))
+	int PrewarmedComponents = 256;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0", EditCondition = "bPoolComponents"))
+	int MaxPooledComponents = 1024;
+
+	//Seconds ahead of the camera its velocity is followed, the chunks loaded along the way are generated into the mesh cache after
+	//all others and spawned from it once they are loaded. Prefetches the camera turned away from are cancelled. 0 disables the prefetch.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0"))
+	float PrefetchHorizon = 1.0f;
+
+	//Seconds the camera velocity is smoothed over
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0"))
+	float VelocitySmoothing = 0.25f;
+
+	//Region archive of baked LOD 0 chunks, relative to the project directory. Chunks found in it are loaded instead of generated, empty disables it.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker")
+	FString RegionArchiveDirectory;
+
+	//LOD 0 chunks around the one the camera is in that are checked every frame, a frame where one of them is loaded but not spawned
+	//yet has a hole. The hole frames are logged at EndPlay.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "ChunkWorker", meta = (ClampMin = "0"))
+	int HoleCheckRadius = 1;
+
+	//Camera path relative to the project directory. It is recorded while playing and saved at EndPlay, or replayed in place of
+	//the camera with bReplayFlythrough so the hole frames of different settings can be compared. Empty disables both.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flythrough")
+	FString FlythroughFile;
+	
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Flythrough")
+	bool bReplayFlythrough = false;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Chunk")
 	int Size = 16;
 
@@ -109,7 +232,25 @@ public:
 protected:
 //ChunkWorld
 	void UpdateChunks();
+	// Smooths the camera velocity the worker prefetches along
+	void UpdateCameraVelocity(double Time, const FVector& CameraLocation);
+	// Counts the LOD 0 chunks around the camera that Params loads but that are not spawned yet
+	void CheckHoles(const FVector& CameraLocation, const FSChunkKeyParams& Params);
+	
+	// Records the camera, or replaces it with the replayed flythrough
+	void UpdateFlythrough(double Time, FVector& CameraLocation, FVector& CameraDirection);
+	FString GetFlythroughPath() const;
+	void LoadFlythrough();
+	void SaveFlythrough() const;
+
+	// Takes a component from the pool or creates one, it is attached but not registered
+	USMeshComponent* AcquireMeshComponent();
+	// Unregisters the component and pools it, or destroys it once the pool is full
+	void ReleaseMeshComponent(USMeshComponent* MeshComponent);
+	
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
 public:
-	void SpawnChunkMesh(FIntVector ChunkKey, int LOD, FSDispatchCSOutput DispatchCSOutput);
+	void SpawnChunkMesh(const FSChunkMeshKey& MeshKey, FSDispatchCSOutput DispatchCSOutput);
 	void DeleteChunkMesh(FIntVector ChunkKey, int LOD);
 };
@@ -0,0 +1,182 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SDispatchCS.h"
+#include "SChunkMeshCache.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+struct FSMappedRegion;
+
+/**
+ * Baked chunks are stored in region files, one per block of RegionChunks^3 chunks of a LOD. A region file is a header, the table
+ * of its chunks sorted by chunk key and then the blob of every chunk: vertices, normals, colors, indices and optionally the voxels
+ * of the noise pass, each blob 16 byte aligned. Blobs are compressed unless that does not make them smaller. Chunks without
+ * geometry are recorded too, so they are known to be empty without generating them. The table keeps the content hash of every
+ * mesh, a loaded mesh that does not hash to it is treated as not baked and generated instead.
+ *
+ * Files live in Directory/<settings>/X_Y_Z.svregion, the settings folder is the seed, Size, Scale, Isolevel and LOD of the chunks.
+ */
+struct SVOXELPLUGIN_API FSRegionArchive
+{
+	static constexpr uint32 Magic = 0x41525653; //SVRA
+	static constexpr uint32 Version = 2;
+	static constexpr int RegionChunks = 8;
+	static constexpr int BlobAlignment = 16;
+
+	enum EChunkFlags : uint32
+	{
+		Compressed = 1 << 0,
+		HasVoxels = 1 << 1,
+	};
+
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		FIntVector WorldSize;
+		int32 Size;
+		int32 Scale;
+		float Isolevel;
+		int32 Seed;
+		int32 LOD;
+		FIntVector Region;
+		uint32 NumChunks;
+	};
+
+	struct FChunkEntry
+	{
+		FIntVector ChunkKey;
+		uint32 Flags;
+		uint64 Offset;
+		uint32 StoredSize;
+		uint32 RawSize;
+		uint32 NumVertices;
+		uint32 NumIndices;
+		uint32 NumVoxels;
+		uint32 Padding;
+		//FSDispatchCSOutput::ContentHash of the mesh, 0 for empty chunks
+		uint64 ContentHash;
+	};
+
+	// Region of a chunk key, keys of a LOD are multiples of its chunk size apart
+	static FIntVector GetRegion(const FSChunkMeshKey& MeshKey);
+	static FString GetRegionPath(const FString& Directory, const FSChunkMeshKey& MeshKey, const FIntVector& Region);
+	// Bytes of a blob before compression
+	static uint32 GetRawSize(uint32 NumVertices, uint32 NumIndices, uint32 NumVoxels);
+	// True if the header was written for the settings of the key
+	static bool IsMatchingHeader(const FHeader& Header, const FSChunkMeshKey& MeshKey);
+	// True if the region file of the chunk exists and was written for its settings, reads the header only
+	static bool IsRegionBaked(const FString& Directory, const FSChunkMeshKey& MeshKey);
+};
+
+/**
+ * Collects baked chunks per region and writes their region files. A region is written whole, an existing file of it is replaced.
+ */
+class SVOXELPLUGIN_API FSRegionWriter
+{
+public:
+	explicit FSRegionWriter(const FString& InDirectory, bool bInCompress = true);
+
+	// Keeps the chunk until its region is written, Voxels may be empty. The collision flag of the key is ignored.
+	void AddChunk(const FSChunkMeshKey& MeshKey, const FSChunkMeshData& Mesh, TConstArrayView<float> Voxels = TConstArrayView<float>());
+	
+	// Writes the region files of every chunk added so far, false if one could not be written
+	bool Flush();
+	// Writes the region file of the chunk added with MeshKey, false if it could not be written
+	bool WriteRegion(const FSChunkMeshKey& MeshKey);
+	
+	// Bytes written since the writer was created
+	int64 GetWrittenBytes() const { return WrittenBytes; }
+
+private:
+	struct FPendingChunk
+	{
+		FIntVector ChunkKey;
+		uint32 Flags = 0;
+		uint32 RawSize = 0;
+		uint32 NumVertices = 0;
+		uint32 NumIndices = 0;
+		uint32 NumVoxels = 0;
+		uint64 ContentHash = 0;
+		TArray<uint8> Blob;
+	};
+
+	struct FPendingRegion
+	{
+		FSChunkMeshKey MeshKey;
+		FIntVector Region;
+		TArray<FPendingChunk> Chunks;
+	};
+
+	// The settings and region of a key, the chunk key and collision flag do not matter
+	static FSChunkMeshKey GetRegionMeshKey(const FSChunkMeshKey& MeshKey);
+	bool WriteRegionFile(const FPendingRegion& PendingRegion);
+	
+	FString Directory;
+	bool bCompress;
+	TMap<TPair<FSChunkMeshKey, FIntVector>, FPendingRegion> PendingRegions;
+	int64 WrittenBytes = 0;
+};
+
+/**
+ * Baked chunk of a mapped region file. The views point into the mapping and are only set when the blob is stored uncompressed,
+ * they stay valid while the view is held.
+ */
+struct SVOXELPLUGIN_API FSRegionChunkView
+{
+	uint32 NumVertices = 0;
+	uint32 NumIndices = 0;
+	uint32 NumVoxels = 0;
+	uint64 ContentHash = 0;
+	bool bCompressed = false;
+
+	TConstArrayView<FVector3f> Vertices;
+	TConstArrayView<FVector3f> Normals;
+	TConstArrayView<FVector4f> Colors;
+	TConstArrayView<uint32> Indices;
+	TConstArrayView<float> Voxels;
+
+	//The stored blob, compressed or not
+	TConstArrayView<uint8> Blob;
+
+	bool IsEmpty() const { return NumVertices == 0 || NumIndices == 0; }
+
+private:
+	friend class FSRegionReader;
+	TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> MappedRegion;
+};
+
+/**
+ * Reads baked chunks from memory mapped region files. Files are mapped the first time one of their chunks is asked for and stay
+ * mapped, missing files are remembered so they are only looked up once. Thread safe.
+ */
+class SVOXELPLUGIN_API FSRegionReader
+{
+public:
+	explicit FSRegionReader(const FString& InDirectory);
+	~FSRegionReader();
+
+	// Finds the chunk without copying or decompressing it, false if it was not baked
+	bool FindChunk(const FSChunkMeshKey& MeshKey, FSRegionChunkView& OutView);
+	// Fills the mesh of the chunk, and its voxels when OutVoxels is set and they were baked. False if it was not baked or the mesh
+	// does not match its content hash.
+	bool LoadChunk(const FSChunkMeshKey& MeshKey, FSChunkMeshData& OutMesh, TArray<float>* OutVoxels = nullptr);
+
+	// Unmaps every file, held views keep theirs mapped
+	void Empty();
+
+	//Mapped files past this are unmapped, the least recently mapped first
+	static constexpr int MaxMappedRegions = 256;
+
+private:
+	TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe> GetMappedRegion(const FSChunkMeshKey& MeshKey);
+	
+	FString Directory;
+	//Null for files that do not exist or are not valid
+	TMap<FString, TSharedPtr<FSMappedRegion, ESPMode::ThreadSafe>> MappedRegions;
+	TArray<FString> MapOrder;
+	FCriticalSection Lock;
+};
+
+typedef TSharedPtr<FSRegionReader, ESPMode::ThreadSafe> FSRegionReaderRef;
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SRegionBakeCommandlet.generated.h"
+
+/**
+ * Bakes every LOD 0 chunk of the world volume into a region archive for the chunk world to load instead of generating it.
+ * Coarser LODs are laid out around an origin on the LOD 0 grid, their keys follow the camera and are always generated.
+ * The density and meshing run on the CPU on all cores, a region file is the unit of work. Each worker owns a queue of regions
+ * and steals from the others once it runs dry, so workers that only got air do not idle while others mesh the surface.
+ * Regions that are already baked with the same settings are skipped, an interrupted bake picks up where it stopped.
+ *
+ * -run=SRegionBake [-Output=Dir] [-Seed=] [-Size=] [-Scale=] [-Isolevel=] [-WorldSize=X,Y,Z] [-Threads=] [-Voxels] [-NoCompress] [-Restart]
+ * Settings not given are taken from the ASChunkWorld defaults.
+ */
+UCLASS()
+class SVOXELPLUGIN_API USRegionBakeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	USRegionBakeCommandlet();
+	
+	virtual int32 Main(const FString& Params) override;
+
+	//Depth under -WorldSize.Z that is baked too, the density only turns into air some way below it
+	static constexpr int UnderworldDepth = 256;
+
+	//Seconds between two progress logs
+	static constexpr double ReportInterval = 5.0;
+};
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Hands the latest snapshot of a T from one writer thread to one reader thread without locks. The writer fills its back slot and
+ * publishes it with a single atomic exchange, the reader swaps the published slot with its front slot when it wants the newest one.
+ * A third slot sits between them so neither side ever waits on the other. The reader only sees whole snapshots, snapshots it
+ * skipped are overwritten and nothing is copied by the exchange itself.
+ */
+template<typename T>
+class TSSnapshotExchange
+{
+public:
+	// Writer thread. Slot of the next snapshot, it holds an older snapshot or one the reader moved from
+	T& GetWriteBuffer() { return Slots[Back]; }
+	
+	// Writer thread. Makes the write buffer the newest snapshot
+	void Publish()
+	{
+		Back = Middle.exchange(Back | DirtyBit, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// Reader thread. Takes the newest snapshot, false if none was published since the last call
+	bool Update()
+	{
+		if (!(Middle.load(std::memory_order_relaxed) & DirtyBit))
+			return false;
+		
+		Front = Middle.exchange(Front, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+	
+	// Reader thread. True if Update would take a new snapshot
+	bool IsPending() const
+	{
+		return Middle.load(std::memory_order_relaxed) & DirtyBit;
+	}
+	
+	// Reader thread. Snapshot taken by the last Update, it may be moved from
+	T& GetReadBuffer() { return Slots[Front]; }
+
+private:
+	static constexpr uint8 IndexMask = 3;
+	static constexpr uint8 DirtyBit = 4;
+	
+	T Slots[3];
+	//Only touched by the writer
+	uint8 Back = 0;
+	//Slot between the two sides, DirtyBit is set while the reader did not take it
+	std::atomic<uint8> Middle = 1;
+	//Only touched by the reader
+	uint8 Front = 2;
+};
@@ -3,6 +3,8 @@
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogSVoxel, Log, All);
+
 class SVOXELPLUGIN_API FSVoxelPluginModule : public IModuleInterface
 {
 public:
@@ -6,6 +6,7 @@
 #include "RenderGraphResources.h"
 #include "GlobalShader.h"
 #include "RHIGPUReadback.h"
+#include "SReadbackManager.h"
 
 #define NUM_THREADS_BaseCS 1
 
@@ -130,30 +131,18 @@ void FBaseCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList
 			FRHIGPUBufferReadback* GPUBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteBaseCSOutput"));
 			AddEnqueueCopyPass(GraphBuilder, GPUBufferReadback, OutputBuffer, 0u);
 
-			auto RunnerFunc = [GPUBufferReadback, AsyncCallback](auto&& RunnerFunc) -> void
+			FSReadbackManager::Get().Add({GPUBufferReadback}, [GPUBufferReadback, AsyncCallback]()
 			{
-				if (GPUBufferReadback->IsReady()) {
-					
-					int32* Buffer = (int32*)GPUBufferReadback->Lock(1);
-					int OutVal = Buffer[0];
-					
-					GPUBufferReadback->Unlock();
-
-					AsyncTask(ENamedThreads::GameThread, [AsyncCallback, OutVal]() {
-						AsyncCallback(OutVal);
-					});
-
-					delete GPUBufferReadback;
-				} else {
-					AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]() {
-						RunnerFunc(RunnerFunc);
-					});
-				}
-			};
-
-			AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-			{
-				RunnerFunc(RunnerFunc);
+				int32* Buffer = (int32*)GPUBufferReadback->Lock(1);
+				int OutVal = Buffer[0];
+				
+				GPUBufferReadback->Unlock();
+
+				AsyncTask(ENamedThreads::GameThread, [AsyncCallback, OutVal]() {
+					AsyncCallback(OutVal);
+				});
+
+				delete GPUBufferReadback;
 			});
 			
 		}
@@ -12,74 +12,59 @@
 //                            ShaderType                            ShaderPath                     Shader function name    Type
 IMPLEMENT_GLOBAL_SHADER(FMCAllocVertsCS, "/Shaders/Private/MCAllocVertsCS.usf", "March", SF_Compute);
 
-void FMCAllocVertsCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FMCAllocVertsCSDispatchParams Params,
-	TFunction<void(FMCAllocVertsCSOutput Output)> AsyncCallback)
+FMCAllocVertsCSOutput FMCAllocVertsCSInterface::AddPass(FRDGBuilder& GraphBuilder, const FMCAllocVertsCSDispatchParams& Params)
 {
-	FRDGBuilder GraphBuilder(RHICmdList);
-	
-	TShaderMapRef<FMCAllocVertsCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FMCAllocVertsCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FMCAllocVertsCS::FActiveCellsDim>(Params.ActiveCells.IsValid());
+	TShaderMapRef<FMCAllocVertsCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	FMCAllocVertsCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FMCAllocVertsCS::FParameters>();
 
 	PassParameters->Size = Params.Size;
+	PassParameters->Chunks = GraphBuilder.CreateSRV(Params.InChunks);
 	
-	FRDGBufferRef CellMasksBuffer = GraphBuilder.RegisterExternalBuffer(Params.InCellMasks);
-	PassParameters->cellMasks = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(CellMasksBuffer, PF_R32_SINT));
-	
-	FRDGBufferRef NumAllocatedVertsBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("NumAllocatedVertsBuffer"),
-		sizeof(uint32_t),
-		1,
-		TArray<uint32_t>({0}).GetData(), //count starts at zero 
-		sizeof(uint32_t) * 1
-		);
-	
+	PassParameters->cellMasks = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.InCellMasks, PF_R32_SINT));
+
+	//count starts at zero, cleared on the GPU
+	FRDGBufferRef NumAllocatedVertsBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("NumAllocatedVertsBuffer"));
 	PassParameters->NumAllocatedVerts = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(NumAllocatedVertsBuffer, PF_R32_SINT));
+	AddClearUAVPass(GraphBuilder, PassParameters->NumAllocatedVerts, 0u);
+
+	if (Params.ActiveCells.IsValid())
+	{
+		PassParameters->ActiveCells = GraphBuilder.CreateSRV(Params.ActiveCells.Cells);
+		PassParameters->NumActiveCells = GraphBuilder.CreateSRV(Params.ActiveCells.NumCells);
+		PassParameters->NumChunks = Params.NumChunks;
+		PassParameters->ActiveCellsArgs = Params.ActiveCells.Args;
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("ExecuteMCAllocVertsCS (active cells)"),
+			Params.bAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute,
+			ComputeShader,
+			PassParameters,
+			Params.ActiveCells.Args,
+			0);
+
+		return FMCAllocVertsCSOutput(NumAllocatedVertsBuffer);
+	}
 	
-	//so the total number of iterations is Size + 1
+	//so the total number of iterations is Size + 1, the chunks of the batch are stacked along z
 	auto GroupCount = FComputeShaderUtils::GetGroupCount(
 		FIntVector(Params.Size+1, Params.Size+1, Params.Size+1),
 		FIntVector(8, 8, 8));
+	PassParameters->ChunkThreadsZ = GroupCount.Z * 8;
+	GroupCount.Z *= Params.NumChunks;
 	
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("ExecuteMCAllocVertsCS"),
 		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[&PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
+		Params.bAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute,
+		[PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
 	{
 		FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters, GroupCount);
 	});
 
-	FRHIGPUBufferReadback* GPUNumAllocatedVertsBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCAllocVertsCSOutput"));
-	AddEnqueueCopyPass(GraphBuilder, GPUNumAllocatedVertsBufferReadback, NumAllocatedVertsBuffer, 0u);
-	
-	TRefCountPtr<FRDGPooledBuffer> OutCellMasks;
-	GraphBuilder.QueueBufferExtraction(CellMasksBuffer, &OutCellMasks);
-	
-	GraphBuilder.Execute();
-
-	auto RunnerFunc = [GPUNumAllocatedVertsBufferReadback, OutCellMasks, AsyncCallback](auto&& RunnerFunc) -> void
-	{
-		if (GPUNumAllocatedVertsBufferReadback->IsReady())
-		{
-			uint32_t* NumAllocatedVertsBuffer = (uint32_t*)GPUNumAllocatedVertsBufferReadback->Lock(1);
-			uint32_t NumAllocatedVerts = NumAllocatedVertsBuffer[0];
-			
-			AsyncCallback(FMCAllocVertsCSOutput(OutCellMasks, NumAllocatedVerts));
-
-			GPUNumAllocatedVertsBufferReadback->Unlock();
-			delete GPUNumAllocatedVertsBufferReadback;
-		}
-		else
-		{
-			AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-			{
-				RunnerFunc(RunnerFunc);
-			});
-		}
-	};
-	AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-	{
-		RunnerFunc(RunnerFunc);
-	});
+	return FMCAllocVertsCSOutput(NumAllocatedVertsBuffer);
 }
\ No newline at end of file
@@ -12,99 +12,77 @@
 //                            ShaderType                            ShaderPath                     Shader function name    Type
 IMPLEMENT_GLOBAL_SHADER(FMCCountVertsCS, "/Shaders/Private/MCCountVertsCS.usf", "March", SF_Compute);
 
-void FMCCountVertsCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FMCCountVertsCSDispatchParams Params,
-	TFunction<void(FMCCountVertsCSOutput Output)> AsyncCallback)
+FMCCountVertsCSOutput FMCCountVertsCSInterface::AddPass(FRDGBuilder& GraphBuilder, const FMCCountVertsCSDispatchParams& Params)
 {
-	FRDGBuilder GraphBuilder(RHICmdList);
-	
-	TShaderMapRef<FMCCountVertsCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FMCCountVertsCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FMCCountVertsCS::FVoxelTileDim>(Params.bVoxelTile);
+	TShaderMapRef<FMCCountVertsCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	FMCCountVertsCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FMCCountVertsCS::FParameters>();
 
 	PassParameters->Size = Params.Size;
 	PassParameters->isolevel = Params.isolevel;
+	PassParameters->Chunks = GraphBuilder.CreateSRV(Params.InChunks);
 	
-	FRDGBufferRef InVoxelsBuffer = GraphBuilder.RegisterExternalBuffer(Params.InVoxels);
-	PassParameters->InVoxels = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(InVoxelsBuffer, PF_R32_SINT));
+	PassParameters->InVoxels = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(Params.InVoxels, PF_R32_SINT));
 
-	TArray<uint32_t> InCellMasks;
-	InCellMasks.Init(0, (Params.Size+1)*(Params.Size+1)*(Params.Size+1));
-	FRDGBufferRef CellMasksBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("CellMasksBuffer"),
-		sizeof(uint32_t),
-		InCellMasks.Num(),
-		InCellMasks.GetData(),
-		sizeof(uint32_t) * InCellMasks.Num()
-		);
-	
+	//cell masks are or'ed into and counts start at zero, they are cleared on the GPU
+	FRDGBufferRef CellMasksBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), (Params.Size+1)*(Params.Size+1)*(Params.Size+1) * Params.NumChunks),
+		TEXT("CellMasksBuffer"));
 	PassParameters->cellMasks = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(CellMasksBuffer, PF_R32_SINT));
-	FRDGBufferRef VertexCountBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("VertexCountBuffer"),
-		sizeof(uint32_t),
-		1,
-		TArray<int>({0}).GetData(), //count starts at zero
-		sizeof(uint32_t) * 1
-		);
-	
+	AddClearUAVPass(GraphBuilder, PassParameters->cellMasks, 0u);
+
+	FRDGBufferRef VertexCountBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("VertexCountBuffer"));
 	PassParameters->VertexCount = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(VertexCountBuffer, PF_R32_SINT));
-	FRDGBufferRef IndicesCountBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("IndicesCountBuffer"),
-		sizeof(uint32_t),
-		1,
-		TArray<int>({0}).GetData(), //count starts at zero
-		sizeof(uint32_t) * 1
-		);
+	AddClearUAVPass(GraphBuilder, PassParameters->VertexCount, 0u);
 	
+	FRDGBufferRef IndicesCountBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("IndicesCountBuffer"));
 	PassParameters->IndicesCount = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(IndicesCountBuffer, PF_R32_SINT));
+	AddClearUAVPass(GraphBuilder, PassParameters->IndicesCount, 0u);
+
+	//Every list has room for all the cells of its chunk, only the counts are cleared
+	FMCActiveCells ActiveCells;
+	ActiveCells.Cells = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), (Params.Size+1)*(Params.Size+1)*(Params.Size+1) * Params.NumChunks),
+		TEXT("ActiveCellsBuffer"));
+	PassParameters->ActiveCells = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(ActiveCells.Cells, PF_R32_SINT));
+	
+	ActiveCells.NumCells = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("NumActiveCellsBuffer"));
+	PassParameters->NumActiveCells = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(ActiveCells.NumCells, PF_R32_SINT));
+	AddClearUAVPass(GraphBuilder, PassParameters->NumActiveCells, 0u);
+
+	//Starts without groups and a row per chunk, the pass raises the group count to the longest list
+	ActiveCells.Args = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateIndirectDesc<FRHIDispatchIndirectParameters>(1),
+		TEXT("ActiveCellsArgsBuffer"));
+	FRHIDispatchIndirectParameters InitialArgs;
+	InitialArgs.ThreadGroupCountX = 0;
+	InitialArgs.ThreadGroupCountY = 1;
+	InitialArgs.ThreadGroupCountZ = Params.NumChunks;
+	GraphBuilder.QueueBufferUpload(ActiveCells.Args, &InitialArgs, sizeof(InitialArgs));
+	PassParameters->ActiveCellsArgs = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(ActiveCells.Args, PF_R32_UINT));
 	
-	//so the total number of iterations is Size + 1
+	//so the total number of iterations is Size + 1, the chunks of the batch are stacked along z
 	auto GroupCount = FComputeShaderUtils::GetGroupCount(
 		FIntVector(Params.Size+1, Params.Size+1, Params.Size+1),
 		FIntVector(8, 8, 8));
+	PassParameters->ChunkThreadsZ = GroupCount.Z * 8;
+	GroupCount.Z *= Params.NumChunks;
 	
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("ExecuteMCCountVertsCS"),
 		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[&PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
+		Params.bAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute,
+		[PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
 	{
 		FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters, GroupCount);
 	});
 
-	FRHIGPUBufferReadback* GPUIndicesCountBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCCountVertsCSOutput"));
-	AddEnqueueCopyPass(GraphBuilder, GPUIndicesCountBufferReadback, IndicesCountBuffer, 0u);
-	
-	TRefCountPtr<FRDGPooledBuffer> OutCellMasks;
-	GraphBuilder.QueueBufferExtraction(CellMasksBuffer, &OutCellMasks);
-	
-	GraphBuilder.Execute();
-	
-    auto RunnerFunc = [GPUIndicesCountBufferReadback, OutCellMasks, AsyncCallback](auto&& RunnerFunc) -> void
-    {
-    	if (GPUIndicesCountBufferReadback->IsReady())
-    	{
-    		uint32_t* IndicesCountBufferReadback = (uint32_t*)GPUIndicesCountBufferReadback->Lock(1);
-    		uint32_t IndicesCount = IndicesCountBufferReadback[0];
-
-    		AsyncCallback(FMCCountVertsCSOutput(OutCellMasks, IndicesCount));
-
-    		GPUIndicesCountBufferReadback->Unlock();
-    		delete GPUIndicesCountBufferReadback;
-    	}
-    	else 
-    	{
-    		AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-    		{
-    			RunnerFunc(RunnerFunc);
-    		});
-    	}
-    };
-    AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-    {
-    	RunnerFunc(RunnerFunc);
-    });
-
-	
+	return FMCCountVertsCSOutput(CellMasksBuffer, IndicesCountBuffer, ActiveCells);
 }
\ No newline at end of file
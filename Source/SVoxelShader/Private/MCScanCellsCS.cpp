@@ -0,0 +1,87 @@
+﻿#include "MCScanCellsCS.h"
+#include "PixelShaderUtils.h"
+#include "Runtime/RenderCore/Public/RenderGraphUtils.h"
+#include "MeshPassProcessor.inl"
+#include "StaticMeshResources.h"
+#include "RenderGraphResources.h"
+#include "GlobalShader.h"
+#include "RHIGPUReadback.h"
+
+
+// This will tell the engine to create the shader and where the shader entry point is.
+//                            ShaderType                            ShaderPath                     Shader function name    Type
+IMPLEMENT_GLOBAL_SHADER(FMCScanCellsCS, "/Shaders/Private/MCScanCellsCS.usf", "ScanCells", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FMCScanGroupsCS, "/Shaders/Private/MCScanCellsCS.usf", "ScanGroups", SF_Compute);
+
+FMCScanCellsCSOutput FMCScanCellsCSInterface::AddPass(FRDGBuilder& GraphBuilder, const FMCScanCellsCSDispatchParams& Params)
+{
+	const int NumCells = (Params.Size + 1) * (Params.Size + 1) * (Params.Size + 1);
+	const int GroupsPerChunk = FMath::DivideAndRoundUp(NumCells, GroupSize);
+
+	//Every entry is written before it is read, nothing to clear
+	FRDGBufferRef GroupSumsBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), 2 * GroupsPerChunk * Params.NumChunks),
+		TEXT("ScanGroupSumsBuffer"));
+	FRDGBufferRef CellIndexStartsBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), NumCells * Params.NumChunks),
+		TEXT("CellIndexStartsBuffer"));
+	FRDGBufferRef NumAllocatedVertsBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("NumAllocatedVertsBuffer"));
+	FRDGBufferRef NumIndicesBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("NumScannedIndicesBuffer"));
+
+	//one row of groups per chunk
+	const FIntVector CellGroupCount = FIntVector(GroupsPerChunk, 1, Params.NumChunks);
+	auto AddScanCellsPass = [&](bool bApply)
+	{
+		FMCScanCellsCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FMCScanCellsCS::FApplyDim>(bApply);
+		TShaderMapRef<FMCScanCellsCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		FMCScanCellsCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FMCScanCellsCS::FParameters>();
+
+		PassParameters->Size = Params.Size;
+		PassParameters->isolevel = Params.isolevel;
+		PassParameters->Chunks = GraphBuilder.CreateSRV(Params.InChunks);
+		PassParameters->InVoxels = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(Params.InVoxels, PF_R32_SINT));
+		PassParameters->cellMasks = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.InCellMasks, PF_R32_SINT));
+		PassParameters->GroupSums = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(GroupSumsBuffer, PF_R32_UINT));
+		PassParameters->GroupsPerChunk = GroupsPerChunk;
+		PassParameters->CellIndexStarts = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(CellIndexStartsBuffer, PF_R32_UINT));
+
+		GraphBuilder.AddPass(
+			bApply ? RDG_EVENT_NAME("ExecuteMCScanCellsCS (apply)") : RDG_EVENT_NAME("ExecuteMCScanCellsCS (sum)"),
+			PassParameters,
+			ERDGPassFlags::AsyncCompute,
+			[PassParameters, ComputeShader, CellGroupCount](FRHIComputeCommandList& RHICmdList)
+		{
+			FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters, CellGroupCount);
+		});
+	};
+
+	AddScanCellsPass(false);
+
+	TShaderMapRef<FMCScanGroupsCS> GroupsShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FMCScanGroupsCS::FParameters* GroupsParameters = GraphBuilder.AllocParameters<FMCScanGroupsCS::FParameters>();
+	
+	GroupsParameters->GroupSums = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(GroupSumsBuffer, PF_R32_UINT));
+	GroupsParameters->GroupsPerChunk = GroupsPerChunk;
+	GroupsParameters->NumAllocatedVerts = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(NumAllocatedVertsBuffer, PF_R32_UINT));
+	GroupsParameters->NumIndices = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(NumIndicesBuffer, PF_R32_UINT));
+
+	//one group per chunk
+	const FIntVector GroupsGroupCount = FIntVector(Params.NumChunks, 1, 1);
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteMCScanGroupsCS"),
+		GroupsParameters,
+		ERDGPassFlags::AsyncCompute,
+		[GroupsParameters, GroupsShader, GroupsGroupCount](FRHIComputeCommandList& RHICmdList)
+	{
+		FComputeShaderUtils::Dispatch(RHICmdList, GroupsShader, *GroupsParameters, GroupsGroupCount);
+	});
+
+	AddScanCellsPass(true);
+
+	return FMCScanCellsCSOutput(NumAllocatedVertsBuffer, NumIndicesBuffer, CellIndexStartsBuffer);
+}
@@ -0,0 +1,47 @@
+﻿#include "MCSuballocCS.h"
+#include "PixelShaderUtils.h"
+#include "Runtime/RenderCore/Public/RenderGraphUtils.h"
+#include "MeshPassProcessor.inl"
+#include "StaticMeshResources.h"
+#include "RenderGraphResources.h"
+#include "GlobalShader.h"
+#include "RHIGPUReadback.h"
+
+
+// This will tell the engine to create the shader and where the shader entry point is.
+//                            ShaderType                            ShaderPath                     Shader function name    Type
+IMPLEMENT_GLOBAL_SHADER(FMCSuballocCS, "/Shaders/Private/MCSuballocCS.usf", "Suballoc", SF_Compute);
+
+FMCSuballocCSOutput FMCSuballocCSInterface::AddPass(FRDGBuilder& GraphBuilder, const FMCSuballocCSDispatchParams& Params)
+{
+	TShaderMapRef<FMCSuballocCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FMCSuballocCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FMCSuballocCS::FParameters>();
+
+	PassParameters->NumChunks = Params.NumChunks;
+	PassParameters->VertexCapacity = Params.VertexCapacity;
+	PassParameters->IndexCapacity = Params.IndexCapacity;
+	
+	PassParameters->NumAllocatedVerts = GraphBuilder.CreateSRV(Params.InNumAllocatedVerts);
+	PassParameters->IndicesCount = GraphBuilder.CreateSRV(Params.InIndicesCount);
+	PassParameters->OutChunks = GraphBuilder.CreateUAV(Params.InChunks);
+
+	//Every entry is written by the pass, nothing to upload
+	FRDGBufferRef DrawArgsBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateIndirectDesc<FRHIDrawIndexedIndirectParameters>(Params.NumChunks),
+		TEXT("DrawArgsBuffer"));
+	PassParameters->OutDrawArgs = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(DrawArgsBuffer, PF_R32_UINT));
+
+	//one thread per chunk
+	FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(Params.NumChunks, 64);
+	
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("ExecuteMCSuballocCS"),
+		PassParameters,
+		ERDGPassFlags::AsyncCompute,
+		[PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
+	{
+		FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters, GroupCount);
+	});
+
+	return FMCSuballocCSOutput(DrawArgsBuffer);
+}
@@ -12,163 +12,85 @@
 //                            ShaderType                            ShaderPath                     Shader function name    Type
 IMPLEMENT_GLOBAL_SHADER(FMarchingCS, "/Shaders/Private/MarchingCS.usf", "March", SF_Compute);
 
-void FMarchingCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FMarchingCSDispatchParams Params,
-	TFunction<void(FMarchingCSOutput Output)> AsyncCallback)
+FMarchingCSOutput FMarchingCSInterface::AddPass(FRDGBuilder& GraphBuilder, const FMarchingCSDispatchParams& Params)
 {
-	FRDGBuilder GraphBuilder(RHICmdList);
-	
-	TShaderMapRef<FMarchingCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FMarchingCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FMarchingCS::FVoxelTileDim>(Params.bVoxelTile && !Params.ActiveCells.IsValid());
+	PermutationVector.Set<FMarchingCS::FActiveCellsDim>(Params.ActiveCells.IsValid());
+	PermutationVector.Set<FMarchingCS::FDeterministicDim>(Params.InCellIndexStarts != nullptr);
+	TShaderMapRef<FMarchingCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	FMarchingCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FMarchingCS::FParameters>();
 
 	PassParameters->WorldSize = Params.WorldSize;
 	PassParameters->Size = Params.Size;
 	PassParameters->isolevel = Params.isolevel;
-	PassParameters->LOD = Params.LOD;
 	PassParameters->Scale = Params.Scale;
 
-	PassParameters->Position = Params.Position;
 	PassParameters->seed = Params.seed;
+	PassParameters->Chunks = GraphBuilder.CreateSRV(Params.InChunks);
 
-	FRDGBufferRef InVoxelsBuffer = GraphBuilder.RegisterExternalBuffer(Params.InVoxels);
-	PassParameters->InVoxels = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(InVoxelsBuffer, PF_R32_SINT));
-
-	FRDGBufferRef InCellMasksBuffer = GraphBuilder.RegisterExternalBuffer(Params.InCellMasks);
-	PassParameters->cellMasks = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(InCellMasksBuffer, PF_R32_SINT));
+	PassParameters->InVoxels = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(Params.InVoxels, PF_R32_SINT));
+	PassParameters->cellMasks = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.InCellMasks, PF_R32_SINT));
 
-	FRDGBufferRef NumEmittedIndicesBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("NumEmittedVertsBuffer"),
-		sizeof(uint32_t),
-		1,
-		TArray<int>({0}).GetData(), //count starts at zero
-		sizeof(uint32_t) * 1
-		);
+	//counts start at zero, cleared on the GPU
+	FRDGBufferRef NumEmittedIndicesBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), Params.NumChunks),
+		TEXT("NumEmittedVertsBuffer"));
 	PassParameters->NumEmittedIndices = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(NumEmittedIndicesBuffer, PF_R32_SINT));
+	AddClearUAVPass(GraphBuilder, PassParameters->NumEmittedIndices, 0u);
 	
-	TArray<FVector3f> InVertices;
-	InVertices.Init(FVector3f(-1,-1,-1), Params.VertexCount);
-	
-	FRDGBufferRef OutVerticesBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("OutVerticesBuffer"),
-		sizeof(FVector3f),
-		Params.VertexCount,
-		InVertices.GetData(),
-		sizeof(FVector3f) * Params.VertexCount
-		);
-	PassParameters->OutVertices = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(OutVerticesBuffer, PF_R32_SINT));
-	
-	TArray<uint32> InTris;
-	InTris.Init(0, Params.IndicesCount);
-	FRDGBufferRef OutTrisBuffer = GraphBuilder.CreateBuffer(
-		FRDGBufferDesc::CreateBufferDesc(
-			sizeof(uint32),
-			Params.IndicesCount),
-			TEXT("OutTrisBuffer"));
-	GraphBuilder.QueueBufferUpload(OutTrisBuffer, InTris.GetData(),
-		sizeof(uint32) * Params.IndicesCount, ERDGInitialDataFlags::None);
-	PassParameters->OutTris = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(OutTrisBuffer, PF_R32_SINT));
-
-	TArray<FVector3f> InNormals;
-	InNormals.Init(FVector3f(0, 0, 0), Params.VertexCount);
-	FRDGBufferRef OutNormalsBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("OutNormalsBuffer"),
-		sizeof(FVector3f),
-		Params.VertexCount,
-		InNormals.GetData(),
-		sizeof(FVector3f) * Params.VertexCount
-		);
-	PassParameters->OutNormals = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(OutNormalsBuffer, PF_R32_SINT));
+	//Every chunk writes its whole range, the pool buffers need no clearing
+	PassParameters->OutVertices = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.OutputVertices, PF_R32_SINT));
+	PassParameters->OutTris = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.OutputTris, PF_R32_SINT));
+	PassParameters->OutNormals = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.OutNormals, PF_R32_SINT));
+	PassParameters->OutColor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Params.OutColor, PF_R32_SINT));
+
+	//The hash lanes are sums, they start at zero
+	FMarchingCSOutput Output;
+	if (Params.InCellIndexStarts)
+	{
+		PassParameters->CellIndexStarts = GraphBuilder.CreateSRV(Params.InCellIndexStarts);
+		Output.OutContentHashes = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateStructuredDesc(sizeof(uint32_t), 2 * Params.NumChunks),
+			TEXT("ContentHashesBuffer"));
+		PassParameters->ContentHashes = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Output.OutContentHashes, PF_R32_UINT));
+		AddClearUAVPass(GraphBuilder, PassParameters->ContentHashes, 0u);
+	}
 
-	TArray<FVector4f> InColor;
-	InColor.Init(FVector4f(0, 0, 0, 0), Params.VertexCount);
-	FRDGBufferRef OutColorBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("OutColorBuffer"),
-		sizeof(FVector4f),
-		Params.VertexCount,
-		InColor.GetData(),
-		sizeof(FVector4f) * Params.VertexCount
-		);
-	PassParameters->OutColor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(OutColorBuffer, PF_R32_SINT));
+	//The arguments have a row for every chunk of the batch, the rows past the chunks of this pass return right away
+	if (Params.ActiveCells.IsValid())
+	{
+		PassParameters->ActiveCells = GraphBuilder.CreateSRV(Params.ActiveCells.Cells);
+		PassParameters->NumActiveCells = GraphBuilder.CreateSRV(Params.ActiveCells.NumCells);
+		PassParameters->NumChunks = Params.NumChunks;
+		PassParameters->ActiveCellsArgs = Params.ActiveCells.Args;
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("ExecuteMarchingCS (active cells)"),
+			Params.bAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute,
+			ComputeShader,
+			PassParameters,
+			Params.ActiveCells.Args,
+			0);
+		return Output;
+	}
 
-	//so the total number of iterations is Size + 1
+	//so the total number of iterations is Size + 1, the chunks of the batch are stacked along z
 	auto GroupCount = FComputeShaderUtils::GetGroupCount(
 		FIntVector(Params.Size + 1, Params.Size + 1, Params.Size + 1),
 		FIntVector(8, 8, 8));
+	PassParameters->ChunkThreadsZ = GroupCount.Z * 8;
+	GroupCount.Z *= Params.NumChunks;
 	
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("ExecuteMarchingCS"),
 		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[&PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
+		Params.bAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute,
+		[PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
 	{
 		FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters, GroupCount);
 	});
-	
-	TRefCountPtr<FRDGPooledBuffer> OutVertices;
-	TRefCountPtr<FRDGPooledBuffer> OutTris;
-	TRefCountPtr<FRDGPooledBuffer> OutNormals;
-	TRefCountPtr<FRDGPooledBuffer> OutColor;
-	
-	GraphBuilder.QueueBufferExtraction(OutVerticesBuffer, &OutVertices);
-	GraphBuilder.QueueBufferExtraction(OutTrisBuffer, &OutTris);
-	GraphBuilder.QueueBufferExtraction(OutNormalsBuffer, &OutNormals);
-	GraphBuilder.QueueBufferExtraction(OutColorBuffer, &OutColor);
-
-	FRHIGPUBufferReadback* GPUOutVerticesBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMarchingCSOutput"));
-	AddEnqueueCopyPass(GraphBuilder, GPUOutVerticesBufferReadback, OutVerticesBuffer, 0u);
-	FRHIGPUBufferReadback* GPUOutTrisBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMarchingCSOutput"));
-	AddEnqueueCopyPass(GraphBuilder, GPUOutTrisBufferReadback, OutTrisBuffer, 0u);
-	
-	GraphBuilder.Execute();
-
-	if(Params.LOD == 0)
-	{
-		auto RunnerFunc = [GPUOutVerticesBufferReadback, GPUOutTrisBufferReadback, AsyncCallback, Params,
-			OutVertices, OutTris, OutNormals, OutColor](auto&& RunnerFunc) -> void
-		{
-			if (GPUOutVerticesBufferReadback->IsReady() && GPUOutTrisBufferReadback->IsReady())
-			{
-				FVector3f* VerticesData = (FVector3f*)GPUOutVerticesBufferReadback->Lock(1);
-				TArray<FVector3f> Vertices = TArray(VerticesData, Params.VertexCount);
 
-				uint32* TrisData = (uint32*)GPUOutTrisBufferReadback->Lock(1);
-				TArray<uint32> Tris = TArray(TrisData, Params.IndicesCount);
-
-				TArray<FTriIndices> Indices;
-				for (int32 TriIdx = 0; TriIdx < Params.IndicesCount/3; TriIdx++)
-				{
-					// Need to add base offset for indices
-					FTriIndices Triangle;
-					Triangle.v0 = Tris[(TriIdx * 3) + 0];
-					Triangle.v1 = Tris[(TriIdx * 3) + 1];
-					Triangle.v2 = Tris[(TriIdx * 3) + 2];
-					Indices.Add(Triangle);
-				}
-				AsyncCallback(FMarchingCSOutput(OutVertices, OutTris, OutNormals, OutColor, Vertices, Indices));
-
-				GPUOutVerticesBufferReadback->Unlock();
-				GPUOutTrisBufferReadback->Unlock();
-				delete GPUOutVerticesBufferReadback;
-				delete GPUOutTrisBufferReadback;
-			}
-			else
-			{
-				AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-				{
-					RunnerFunc(RunnerFunc);
-				});
-			}
-		};
-		AsyncTask(ENamedThreads::ActualRenderingThread, [RunnerFunc]()
-		{
-			RunnerFunc(RunnerFunc);
-		});
-	}
-	else
-	{
-		AsyncCallback(FMarchingCSOutput(OutVertices, OutTris, OutNormals, OutColor));
-	}
+	return Output;
 }
\ No newline at end of file
@@ -6,63 +6,146 @@
 #include "RenderGraphResources.h"
 #include "GlobalShader.h"
 #include "RHIGPUReadback.h"
+#include "HAL/IConsoleManager.h"
+#include "SDispatchCSBatch.h"
+#include "SPassBenchmark.h"
 
 
 // This will tell the engine to create the shader and where the shader entry point is.
 //                            ShaderType                            ShaderPath                     Shader function name    Type
 IMPLEMENT_GLOBAL_SHADER(FNoiseCS, "/Shaders/Private/NoiseCS.usf", "GetNoise", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FNoiseColumnCS, "/Shaders/Private/NoiseCS.usf", "GetColumnNoise", SF_Compute);
 
-void FNoiseCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FNoiseCSDispatchParams Params,
-	TFunction<void(FNoiseCSOutput Output)> AsyncCallback)
+DECLARE_GPU_STAT_NAMED(SVoxelNoise, TEXT("SVoxel Noise"));
+
+FNoiseCSOutput FNoiseCSInterface::AddPass(FRDGBuilder& GraphBuilder, const FNoiseCSDispatchParams& Params)
 {
-	FRDGBuilder GraphBuilder(RHICmdList);
-	
-	TShaderMapRef<FNoiseCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	RDG_EVENT_SCOPE(GraphBuilder, "SVoxelNoise");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, SVoxelNoise);
+
+	ERDGPassFlags PassFlags = Params.bAsyncCompute ? ERDGPassFlags::AsyncCompute : ERDGPassFlags::Compute;
+
+	FRDGBufferSRVRef ColumnsSRV = nullptr;
+	if (Params.bColumnPass)
+	{
+		TShaderMapRef<FNoiseColumnCS> ColumnShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+		FNoiseColumnCS::FParameters* ColumnParameters = GraphBuilder.AllocParameters<FNoiseColumnCS::FParameters>();
+
+		ColumnParameters->WorldSize = Params.WorldSize;
+		ColumnParameters->Size = Params.Size;
+		ColumnParameters->Scale = Params.Scale;
+
+		ColumnParameters->seed = Params.seed;
+		ColumnParameters->Chunks = GraphBuilder.CreateSRV(Params.InChunks);
+
+		//Columns outside of the world are never written nor read
+		int NumColumns = (Params.Size + 4) * (Params.Size + 4) * Params.NumChunks;
+		FRDGBufferRef ColumnsBuffer = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector2f), NumColumns),
+			TEXT("NoiseColumnsBuffer"));
+
+		ColumnParameters->OutColumns = GraphBuilder.CreateUAV(ColumnsBuffer);
+
+		//One thread per column, the chunks of the batch are stacked along z
+		auto ColumnGroupCount = FComputeShaderUtils::GetGroupCount(
+			FIntVector(Params.Size + 4, Params.Size + 4, 1),
+			FIntVector(8, 8, 1));
+		ColumnParameters->ChunkThreadsZ = 1;
+		ColumnGroupCount.Z *= Params.NumChunks;
+
+		GraphBuilder.AddPass(
+			RDG_EVENT_NAME("ExecuteNoiseColumnCS"),
+			ColumnParameters,
+			PassFlags,
+			[ColumnParameters, ColumnShader, ColumnGroupCount](FRHIComputeCommandList& RHICmdList)
+		{
+			FComputeShaderUtils::Dispatch(RHICmdList, ColumnShader, *ColumnParameters, ColumnGroupCount);
+		});
+
+		ColumnsSRV = GraphBuilder.CreateSRV(ColumnsBuffer);
+	}
+
+	FNoiseCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FNoiseCS::FColumnsDim>(Params.bColumnPass);
+	TShaderMapRef<FNoiseCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	FNoiseCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FNoiseCS::FParameters>();
 
 	PassParameters->WorldSize = Params.WorldSize;
 	PassParameters->Size = Params.Size;
-	PassParameters->Position = Params.Position;
-	PassParameters->LOD = Params.LOD;
 	PassParameters->Scale = Params.Scale;
 
 	PassParameters->seed = Params.seed;
+	PassParameters->Chunks = GraphBuilder.CreateSRV(Params.InChunks);
+	PassParameters->Columns = ColumnsSRV;
 
 	//Max Number of Voxels (Size + 3 as need access to ring around the marching cube)
-	int NumVoxels = (Params.Size + 4) * (Params.Size + 4) * (Params.Size + 4);
+	int NumVoxels = (Params.Size + 4) * (Params.Size + 4) * (Params.Size + 4) * Params.NumChunks;
 
-	TArray<float> InVoxels;
-	InVoxels.Init(0, NumVoxels);
-			
-	FRDGBufferRef OutVoxelsBuffer = CreateStructuredBuffer(
-		GraphBuilder,
-		TEXT("OutVoxelsBuffer"),
-		sizeof(float),
-		NumVoxels,
-		InVoxels.GetData(),
-		sizeof(float) * NumVoxels);
+	//Every voxel is written by the pass, the buffer is left uninitialized
+	FRDGBufferRef OutVoxelsBuffer = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(float), NumVoxels),
+		TEXT("OutVoxelsBuffer"));
 
 	PassParameters->OutVoxels = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(OutVoxelsBuffer, PF_R32_SINT));
 
-	//The total number of iterations is Size + 5
+	//The total number of iterations is Size + 5, the chunks of the batch are stacked along z
 	auto GroupCount = FComputeShaderUtils::GetGroupCount(
 		FIntVector(Params.Size + 4, Params.Size + 4, Params.Size + 4),
 		FIntVector(8, 8, 8));
+	PassParameters->ChunkThreadsZ = GroupCount.Z * 8;
+	GroupCount.Z *= Params.NumChunks;
 			
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("ExecuteNoiseCS"),
 		PassParameters,
-		ERDGPassFlags::AsyncCompute,
-		[&PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
+		PassFlags,
+		[PassParameters, ComputeShader, GroupCount](FRHIComputeCommandList& RHICmdList)
 	{
 		FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters, GroupCount);
 	});
 
-	TRefCountPtr<FRDGPooledBuffer> OutVoxels;
-	GraphBuilder.QueueBufferExtraction(OutVoxelsBuffer, &OutVoxels);
-	
-	GraphBuilder.Execute();
+	return FNoiseCSOutput(OutVoxelsBuffer);
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 
-	AsyncCallback(FNoiseCSOutput(OutVoxels));
+static void BenchmarkNoise(const TArray<FString>& Args)
+{
+	int32 NumChunks = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 16;
+	int32 Iterations = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 8;
 	
-}
\ No newline at end of file
+	ENQUEUE_RENDER_COMMAND(BenchmarkNoise)([NumChunks, Iterations](FRHICommandListImmediate& RHICmdList)
+	{
+		const FIntVector3 WorldSize = FIntVector3(200000, 200000, 3000);
+		
+		for (int32 Size : {16, 32, 64})
+		{
+			double Times[2] = {};
+			for (bool bColumnPass : {false, true})
+			{
+				//Keeps the passes from being culled
+				TRefCountPtr<FRDGPooledBuffer> Voxels;
+				Times[bColumnPass] = FSPassBenchmark::Run(RHICmdList, Size, NumChunks, Iterations, Size * 100.0f, -Size * 50.0f, false, [&](FSPassBenchmark& Benchmark)
+				{
+					FNoiseCSDispatchParams Params = FNoiseCSDispatchParams(WorldSize, Size, 1, 1337, Benchmark.Chunks, NumChunks);
+					Params.bColumnPass = bColumnPass;
+					Params.bAsyncCompute = false;
+					Benchmark.AddTimestamp(0);
+					FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(Benchmark.GraphBuilder, Params);
+					Benchmark.AddTimestamp(1);
+					Benchmark.GraphBuilder.QueueBufferExtraction(NoiseCSOutput.OutVoxels, &Voxels);
+				})[0];
+			}
+			
+			UE_LOG(LogTemp, Log, TEXT("Noise stage, %d chunks of Size %d: %.3f ms per voxel pass, %.3f ms with the column pass, %.2fx"),
+				NumChunks, Size, Times[0], Times[1], Times[0] / FMath::Max(Times[1], 0.001));
+		}
+	});
+}
+
+static FAutoConsoleCommand BenchmarkNoiseCommand(
+	TEXT("SVoxel.BenchmarkNoise"),
+	TEXT("Measures the GPU time of the noise stage with and without the column pass for Size 16, 32 and 64, takes the number of chunks and iterations"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkNoise));
+
+#endif
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+/**
+ * Failed checks of a dev console command. Each failure is logged as it happens, Finish logs how many there were.
+ */
+class FSCheckSuite
+{
+public:
+	explicit FSCheckSuite(const TCHAR* InName)
+		: Name(InName)
+	{
+	}
+
+	void Check(bool bCondition, const TCHAR* What)
+	{
+		if (!bCondition)
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s check failed: %s"), Name, What);
+			NumErrors++;
+		}
+	}
+
+	void Finish() const
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s checks finished with %d errors"), Name, NumErrors);
+	}
+
+private:
+	const TCHAR* Name;
+	int NumErrors = 0;
+};
+
+#endif
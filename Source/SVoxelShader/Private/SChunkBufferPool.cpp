@@ -0,0 +1,166 @@
+﻿#include "SChunkBufferPool.h"
+#include "RenderGraphUtils.h"
+#include "RenderingThread.h"
+#include "SVoxelStats.h"
+
+FSChunkBufferAllocation::~FSChunkBufferAllocation()
+{
+	if (Page.IsValid())
+	{
+		Page->DeferFree(VertexOffset, IndexOffset);
+	}
+}
+
+void FSChunkBufferAllocation::GetSize(int& OutNumVertices, int& OutNumIndices) const
+{
+	OutNumVertices = NumVertices;
+	OutNumIndices = NumIndices;
+	if (Page.IsValid())
+	{
+		Page->GetAllocationSize(VertexOffset, IndexOffset, OutNumVertices, OutNumIndices);
+	}
+}
+
+FSChunkBufferPage::FSChunkBufferPage(int InVertexCapacity, int InIndexCapacity)
+	: VertexAllocator(InVertexCapacity)
+	, IndexAllocator(InIndexCapacity)
+{
+	check(IsInRenderingThread());
+	
+	Vertices = AllocatePooledBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), InVertexCapacity), TEXT("ChunkPoolVertices"));
+	Normals = AllocatePooledBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), InVertexCapacity), TEXT("ChunkPoolNormals"));
+	Colors = AllocatePooledBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector4f), InVertexCapacity), TEXT("ChunkPoolColors"));
+	
+	FRDGBufferDesc IndicesDesc = FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), InIndexCapacity);
+	IndicesDesc.Usage |= EBufferUsageFlags::IndexBuffer;
+	Indices = AllocatePooledBuffer(IndicesDesc, TEXT("ChunkPoolIndices"));
+
+	INC_MEMORY_STAT_BY(STAT_SVoxel_ChunkPoolMemory, InVertexCapacity * (sizeof(FVector3f) * 2 + sizeof(FVector4f)) + InIndexCapacity * sizeof(uint32));
+}
+
+FSChunkBufferPage::~FSChunkBufferPage()
+{
+	DEC_MEMORY_STAT_BY(STAT_SVoxel_ChunkPoolMemory,
+		VertexAllocator.GetCapacity() * (sizeof(FVector3f) * 2 + sizeof(FVector4f)) + IndexAllocator.GetCapacity() * sizeof(uint32));
+}
+
+bool FSChunkBufferPage::Allocate(int NumVertices, int NumIndices, int& OutVertexOffset, int& OutIndexOffset)
+{
+	ProcessDeferredFrees();
+
+	FScopeLock ScopeLock(&Lock);
+	OutVertexOffset = VertexAllocator.Allocate(NumVertices);
+	if (OutVertexOffset == INDEX_NONE)
+		return false;
+	
+	OutIndexOffset = IndexAllocator.Allocate(NumIndices);
+	if (OutIndexOffset == INDEX_NONE)
+	{
+		VertexAllocator.Free(OutVertexOffset);
+		return false;
+	}
+	
+	INC_DWORD_STAT_BY(STAT_SVoxel_ChunkPoolVertices, NumVertices);
+	INC_DWORD_STAT_BY(STAT_SVoxel_ChunkPoolIndices, NumIndices);
+	return true;
+}
+
+void FSChunkBufferPage::Shrink(int VertexOffset, int NumVertices, int IndexOffset, int NumIndices)
+{
+	//An allocation never shrinks to nothing, it is freed with the chunk
+	NumVertices = FMath::Max(NumVertices, 1);
+	NumIndices = FMath::Max(NumIndices, 1);
+
+	FScopeLock ScopeLock(&Lock);
+	DEC_DWORD_STAT_BY(STAT_SVoxel_ChunkPoolVertices, VertexAllocator.GetAllocationSize(VertexOffset) - NumVertices);
+	DEC_DWORD_STAT_BY(STAT_SVoxel_ChunkPoolIndices, IndexAllocator.GetAllocationSize(IndexOffset) - NumIndices);
+	VertexAllocator.Shrink(VertexOffset, NumVertices);
+	IndexAllocator.Shrink(IndexOffset, NumIndices);
+}
+
+void FSChunkBufferPage::DeferFree(int VertexOffset, int IndexOffset)
+{
+	FScopeLock ScopeLock(&Lock);
+	DeferredFrees.Add(FDeferredFree(VertexOffset, IndexOffset, GFrameCounterRenderThread));
+}
+
+void FSChunkBufferPage::GetAllocationSize(int VertexOffset, int IndexOffset, int& OutNumVertices, int& OutNumIndices)
+{
+	FScopeLock ScopeLock(&Lock);
+	OutNumVertices = VertexAllocator.GetAllocationSize(VertexOffset);
+	OutNumIndices = IndexAllocator.GetAllocationSize(IndexOffset);
+}
+
+bool FSChunkBufferPage::IsEmpty()
+{
+	ProcessDeferredFrees();
+
+	FScopeLock ScopeLock(&Lock);
+	return VertexAllocator.GetNumAllocations() == 0 && DeferredFrees.IsEmpty();
+}
+
+void FSChunkBufferPage::ProcessDeferredFrees()
+{
+	FScopeLock ScopeLock(&Lock);
+	
+	//Frees are queued in frame order
+	int NumFreed = 0;
+	for (; NumFreed < DeferredFrees.Num(); NumFreed++)
+	{
+		const FDeferredFree& DeferredFree = DeferredFrees[NumFreed];
+		if (GFrameCounterRenderThread < DeferredFree.Frame + FSChunkBufferPool::FreeLatencyFrames)
+			break;
+
+		DEC_DWORD_STAT_BY(STAT_SVoxel_ChunkPoolVertices, VertexAllocator.GetAllocationSize(DeferredFree.VertexOffset));
+		DEC_DWORD_STAT_BY(STAT_SVoxel_ChunkPoolIndices, IndexAllocator.GetAllocationSize(DeferredFree.IndexOffset));
+		VertexAllocator.Free(DeferredFree.VertexOffset);
+		IndexAllocator.Free(DeferredFree.IndexOffset);
+	}
+	DeferredFrees.RemoveAt(0, NumFreed);
+}
+
+static TGlobalResource<FSChunkBufferPool> GSChunkBufferPool;
+
+FSChunkBufferPool& FSChunkBufferPool::Get()
+{
+	return GSChunkBufferPool;
+}
+
+void FSChunkBufferPool::ReleaseRHI()
+{
+	Pages.Empty();
+}
+
+FSChunkBufferAllocationRef FSChunkBufferPool::Allocate(int NumVertices, int NumIndices)
+{
+	check(IsInRenderingThread());
+	
+	FSChunkBufferAllocationRef Allocation = MakeShared<FSChunkBufferAllocation, ESPMode::ThreadSafe>();
+	Allocation->NumVertices = NumVertices;
+	Allocation->NumIndices = NumIndices;
+
+	//Pages added for a burst are dropped again once their chunks are gone, the first one stays
+	for (int PageIndex = Pages.Num() - 1; PageIndex > 0; PageIndex--)
+	{
+		if (Pages[PageIndex]->IsEmpty())
+		{
+			Pages.RemoveAt(PageIndex);
+		}
+	}
+	
+	for (const TSharedPtr<FSChunkBufferPage, ESPMode::ThreadSafe>& Page : Pages)
+	{
+		if (Page->Allocate(NumVertices, NumIndices, Allocation->VertexOffset, Allocation->IndexOffset))
+		{
+			Allocation->Page = Page;
+			return Allocation;
+		}
+	}
+
+	TSharedPtr<FSChunkBufferPage, ESPMode::ThreadSafe> Page = MakeShared<FSChunkBufferPage, ESPMode::ThreadSafe>(
+		FMath::Max(PageVertices, NumVertices), FMath::Max(PageIndices, NumIndices));
+	Pages.Add(Page);
+	verify(Page->Allocate(NumVertices, NumIndices, Allocation->VertexOffset, Allocation->IndexOffset));
+	Allocation->Page = Page;
+	return Allocation;
+}
@@ -0,0 +1,677 @@
+﻿#include "SDensityCPU.h"
+#include "SDensityCPUSIMD.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "NoiseCS.h"
+#include "SDispatchCSBatch.h"
+
+#if SVOXEL_DENSITY_SSE4
+#include <immintrin.h>
+#endif
+
+#include "SDensityCPUKernel.inl"
+
+//Only sampled by the vertex colors of MarchingCS.usf
+static constexpr FSNoiseLayer TemperatureLayer = {1284, 0.001f, 1, false};
+static constexpr FSNoiseLayer DirtStoneLayer = {1288, 0.02f, 1, false};
+
+// Scalar kernel, the shader code ported as it is
+
+static FORCEINLINE int32 FastFloor(float F)
+{
+	return F >= 0 ? (int32)F : (int32)F - 1;
+}
+
+static FORCEINLINE int32 FastRound(float F)
+{
+	return F >= 0 ? (int32)(F + 0.5f) : (int32)(F - 0.5f);
+}
+
+static FORCEINLINE float GradCoord2D(int32 Seed, int32 XPrimed, int32 YPrimed, float XD, float YD)
+{
+	int32 Hash = MulWrap(Seed ^ XPrimed ^ YPrimed, HashMultiplier);
+	Hash ^= Hash >> 15;
+	Hash &= 127 << 1;
+	return XD * Gradients2D[Hash] + YD * Gradients2D[Hash | 1];
+}
+
+static FORCEINLINE float GradCoord3D(int32 Seed, int32 XPrimed, int32 YPrimed, int32 ZPrimed, float XD, float YD, float ZD)
+{
+	int32 Hash = MulWrap(Seed ^ XPrimed ^ YPrimed ^ ZPrimed, HashMultiplier);
+	Hash ^= Hash >> 15;
+	Hash &= 63 << 2;
+	return XD * Gradients3D[Hash] + YD * Gradients3D[Hash | 1] + ZD * Gradients3D[Hash | 2];
+}
+
+// _fnlSingleSimplex2D, the coordinates are already skewed
+static float SingleSimplex2D(int32 Seed, float X, float Y)
+{
+	int32 I = FastFloor(X);
+	int32 J = FastFloor(Y);
+	float XI = X - I;
+	float YI = Y - J;
+
+	float T = (XI + YI) * G2;
+	float X0 = XI - T;
+	float Y0 = YI - T;
+
+	I = MulWrap(I, PrimeX);
+	J = MulWrap(J, PrimeY);
+
+	float N0, N1, N2;
+
+	float A = 0.5f - X0 * X0 - Y0 * Y0;
+	if (A <= 0)
+	{
+		N0 = 0;
+	}
+	else
+	{
+		N0 = (A * A) * (A * A) * GradCoord2D(Seed, I, J, X0, Y0);
+	}
+
+	float C = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2)) * T + ((float)(-2 * (1 - 2 * G2) * (1 - 2 * G2)) + A);
+	if (C <= 0)
+	{
+		N2 = 0;
+	}
+	else
+	{
+		float X2 = X0 + (2 * G2 - 1);
+		float Y2 = Y0 + (2 * G2 - 1);
+		N2 = (C * C) * (C * C) * GradCoord2D(Seed, AddWrap(I, PrimeX), AddWrap(J, PrimeY), X2, Y2);
+	}
+
+	if (Y0 > X0)
+	{
+		float X1 = X0 + G2;
+		float Y1 = Y0 + (G2 - 1);
+		float B = 0.5f - X1 * X1 - Y1 * Y1;
+		N1 = B <= 0 ? 0 : (B * B) * (B * B) * GradCoord2D(Seed, I, AddWrap(J, PrimeY), X1, Y1);
+	}
+	else
+	{
+		float X1 = X0 + (G2 - 1);
+		float Y1 = Y0 + G2;
+		float B = 0.5f - X1 * X1 - Y1 * Y1;
+		N1 = B <= 0 ? 0 : (B * B) * (B * B) * GradCoord2D(Seed, AddWrap(I, PrimeX), J, X1, Y1);
+	}
+
+	return (N0 + N1 + N2) * 99.83685446303647f;
+}
+
+// _fnlSingleOpenSimplex23D, the coordinates are already rotated
+static float SingleOpenSimplex23D(int32 Seed, float X, float Y, float Z)
+{
+	int32 I = FastRound(X);
+	int32 J = FastRound(Y);
+	int32 K = FastRound(Z);
+	float X0 = X - I;
+	float Y0 = Y - J;
+	float Z0 = Z - K;
+
+	int32 XNSign = (int32)(-1.0f - X0) | 1;
+	int32 YNSign = (int32)(-1.0f - Y0) | 1;
+	int32 ZNSign = (int32)(-1.0f - Z0) | 1;
+
+	float AX0 = XNSign * -X0;
+	float AY0 = YNSign * -Y0;
+	float AZ0 = ZNSign * -Z0;
+
+	I = MulWrap(I, PrimeX);
+	J = MulWrap(J, PrimeY);
+	K = MulWrap(K, PrimeZ);
+
+	float Value = 0;
+	float A = (0.6f - X0 * X0) - (Y0 * Y0 + Z0 * Z0);
+
+	for (int32 L = 0; ; L++)
+	{
+		if (A > 0)
+		{
+			Value += (A * A) * (A * A) * GradCoord3D(Seed, I, J, K, X0, Y0, Z0);
+		}
+
+		float B = A + 1;
+		int32 I1 = I;
+		int32 J1 = J;
+		int32 K1 = K;
+		float X1 = X0;
+		float Y1 = Y0;
+		float Z1 = Z0;
+		if (AX0 >= AY0 && AX0 >= AZ0)
+		{
+			X1 += XNSign;
+			B -= XNSign * 2 * X1;
+			I1 = AddWrap(I1, -MulWrap(XNSign, PrimeX));
+		}
+		else if (AY0 > AX0 && AY0 >= AZ0)
+		{
+			Y1 += YNSign;
+			B -= YNSign * 2 * Y1;
+			J1 = AddWrap(J1, -MulWrap(YNSign, PrimeY));
+		}
+		else
+		{
+			Z1 += ZNSign;
+			B -= ZNSign * 2 * Z1;
+			K1 = AddWrap(K1, -MulWrap(ZNSign, PrimeZ));
+		}
+
+		if (B > 0)
+		{
+			Value += (B * B) * (B * B) * GradCoord3D(Seed, I1, J1, K1, X1, Y1, Z1);
+		}
+
+		if (L == 1)
+			break;
+
+		AX0 = 0.5f - AX0;
+		AY0 = 0.5f - AY0;
+		AZ0 = 0.5f - AZ0;
+
+		X0 = XNSign * AX0;
+		Y0 = YNSign * AY0;
+		Z0 = ZNSign * AZ0;
+
+		A += (0.75f - AX0) - (AY0 + AZ0);
+
+		I = AddWrap(I, (XNSign >> 1) & PrimeX);
+		J = AddWrap(J, (YNSign >> 1) & PrimeY);
+		K = AddWrap(K, (ZNSign >> 1) & PrimeZ);
+
+		XNSign = -XNSign;
+		YNSign = -YNSign;
+		ZNSign = -ZNSign;
+
+		Seed = ~Seed;
+	}
+
+	return Value * 32.69428253173828125f;
+}
+
+// fnlGetNoise2D of a layer
+static float GetNoise2D(const FSNoiseLayer& Layer, int32 WorldSeed, float X, float Y)
+{
+	X *= Layer.Frequency;
+	Y *= Layer.Frequency;
+	float T = (X + Y) * F2;
+	X += T;
+	Y += T;
+
+	int32 Seed = AddWrap(WorldSeed, Layer.SeedOffset);
+	if (!Layer.bFBm)
+		return SingleSimplex2D(Seed, X, Y);
+
+	float Sum = 0;
+	float Amp = Layer.GetFractalBounding();
+	for (int32 Octave = 0; Octave < Layer.Octaves; Octave++)
+	{
+		float Noise = SingleSimplex2D(Seed, X, Y);
+		Seed = AddWrap(Seed, 1);
+		Sum += Noise * Amp;
+
+		X *= 2.0f;
+		Y *= 2.0f;
+		Amp *= 0.5f;
+	}
+	return Sum;
+}
+
+// fnlGetNoise3D of a layer
+static float GetNoise3D(const FSNoiseLayer& Layer, int32 WorldSeed, float X, float Y, float Z)
+{
+	X *= Layer.Frequency;
+	Y *= Layer.Frequency;
+	Z *= Layer.Frequency;
+	float R = (X + Y + Z) * R3;
+	X = R - X;
+	Y = R - Y;
+	Z = R - Z;
+
+	int32 Seed = AddWrap(WorldSeed, Layer.SeedOffset);
+	if (!Layer.bFBm)
+		return SingleOpenSimplex23D(Seed, X, Y, Z);
+
+	float Sum = 0;
+	float Amp = Layer.GetFractalBounding();
+	for (int32 Octave = 0; Octave < Layer.Octaves; Octave++)
+	{
+		float Noise = SingleOpenSimplex23D(Seed, X, Y, Z);
+		Seed = AddWrap(Seed, 1);
+		Sum += Noise * Amp;
+
+		X *= 2.0f;
+		Y *= 2.0f;
+		Z *= 2.0f;
+		Amp *= 0.5f;
+	}
+	return Sum;
+}
+
+struct FSKeyPoint
+{
+	float Value;
+	float Height;
+};
+
+// lerp with fade of NoiseCS.usf
+static FORCEINLINE float LerpFade(float A, float B, float T, float Fade)
+{
+	return T < Fade ? A + T * (B - A) / Fade : B;
+}
+
+// GetTerrainHeight3 and GetTerrainHeight2
+static float GetTerrainHeight(float Value, const FSKeyPoint* Points, int32 NumPoints, float Fade)
+{
+	for (int32 Index = 0; Index < NumPoints - 1; Index++)
+	{
+		if (Value >= Points[Index].Value && Value <= Points[Index + 1].Value)
+		{
+			float T = (Value - Points[Index].Value) / (Points[Index + 1].Value - Points[Index].Value);
+			return LerpFade(Points[Index].Height, Points[Index + 1].Height, T, Fade);
+		}
+	}
+	return Value < Points[0].Value ? Points[0].Height : Points[NumPoints - 1].Height;
+}
+
+static float GetSquashingFactor(float Height, float MinHeight, float MaxHeight, float MinSquash, float MaxSquash)
+{
+	if (Height <= MinHeight)
+		return MinSquash;
+	if (Height >= MaxHeight)
+		return MaxSquash;
+
+	float T = (Height - MinHeight) / (MaxHeight - MinHeight);
+	return MinSquash + T * (MaxSquash - MinSquash);
+}
+
+float FSDensityCPU::GetDensity(const FIntVector3& WorldSize, int32 Seed, const FVector3f& Position)
+{
+	if (FMath::Abs(Position.X) > WorldSize.X || FMath::Abs(Position.Y) > WorldSize.Y || Position.Z > WorldSize.Z)
+		return 1.0f;
+
+	float Density = Position.Z;
+	float Height = 0;
+
+	float Lowlands = GetNoise2D(LowlandsLayer, Seed, Position.X, Position.Y) * LowlandsAmplitude - 20.0f;
+	float Highlands = GetNoise2D(HighlandsLayer, Seed, Position.X, Position.Y) * HighlandsAmplitude;
+	float Mountains = GetNoise2D(MountainsLayer, Seed, Position.X, Position.Y) * MountainsAmplitude;
+	const FSKeyPoint Points[3] =
+	{
+		{-0.6f, Lowlands},
+		{0.4f, Highlands},
+		{1.0f, Mountains}
+	};
+	float BaseHeight = GetTerrainHeight(GetNoise2D(ContinentalnessLayer, Seed, Position.X, Position.Y), Points, 3, HeightFade);
+	Height += BaseHeight;
+	Density -= Height;
+
+	float Chaos = GetNoise3D(ChaosLayer, Seed, Position.X, Position.Y, Position.Z) * ChaosAmplitude;
+	const FSKeyPoint ChaosPoints[2] =
+	{
+		{-0.6f, Chaos},
+		{1.0f, 0.0f}
+	};
+	Density -= GetTerrainHeight(GetNoise2D(ChaosSelectLayer, Seed, Position.X, Position.Y), ChaosPoints, 2, HeightFade);
+
+	//ridges will be near one
+	float CaveZ = Position.Z * 1.35f;
+	float Cave1 = GetNoise3D(CavesLayer, Seed, Position.X, Position.Y, CaveZ);
+	float Cave2 = GetNoise3D(Caves2Layer, Seed, Position.X, Position.Y, CaveZ);
+
+	float Caves = (1 - FMath::Abs(Cave1)) * (1 - FMath::Abs(Cave2));
+	Caves = Caves * 2 - 1.4f;
+	Caves -= GetSquashingFactor(Position.Z, -400.0f, 0, 0.1f, 0.32f);
+
+	float Cheese = GetNoise3D(CheeseLayer, Seed, Position.X, Position.Y, Position.Z) - 0.25f;
+	Cheese -= GetSquashingFactor(Position.Z, -400.0f, 0, 0.1f, 0.55f);
+
+	Caves = FMath::Max(Caves, Cheese);
+	Density = FMath::Max(Caves, Density);
+
+	Density += FMath::Max(-(WorldSize.Z + Position.Z) / 128, 0.0f);
+
+	float Underworld = Position.Z + WorldSize.Z + 128;
+	Underworld += BaseHeight;
+	return FMath::Min(Underworld, Density);
+}
+
+// GetBiome2 and GetBiome3 of MarchingCS.usf
+static int32 GetBiome(float Value, const float* Points, int32 NumPoints)
+{
+	for (int32 Index = 0; Index < NumPoints - 1; Index++)
+	{
+		if (Value >= Points[Index] && Value <= Points[Index + 1])
+			return Index + 1;
+	}
+	return Value < Points[0] ? 0 : NumPoints - 1;
+}
+
+FVector4f FSDensityCPU::GetBiomeColor(const FIntVector3& WorldSize, int32 Seed, const FVector3f& Position)
+{
+	const FVector4f Red(1, 0, 0, 1), Green(0, 1, 0, 1), Blue(0, 0, 1, 1), Black(0, 0, 0, 1), Yellow(1, 1, 0, 1), Purple(1, 0, 1, 1),
+		Grey(0.5f, 0.5f, 0.5f, 1), Brown(0.5f, 0.5f, 0, 1), DarkBlue(0, 0, 0.5f, 1), DarkRed(0.5f, 0, 0, 1);
+
+	const float ContinentalnessPoints[3] = {-0.6f, 0.4f, 1.0f};
+	const float ChaosPoints[2] = {-0.6f, 1.0f};
+	const float TemperaturePoints[3] = {-0.3f, 0.3f, 1.0f};
+	const float UndergroundBiomePoints[2] = {0.0f, 1.0f};
+
+	int32 Continentalness = GetBiome(GetNoise2D(ContinentalnessLayer, Seed, Position.X, Position.Y), ContinentalnessPoints, 3);
+	int32 Chaos = GetBiome(GetNoise2D(ChaosSelectLayer, Seed, Position.X, Position.Y), ChaosPoints, 2);
+	int32 Temperature = GetBiome(GetNoise2D(TemperatureLayer, Seed, Position.X, Position.Y), TemperaturePoints, 3);
+	bool bUnderground = Position.Z < -48;
+	int32 UndergroundBiome = GetBiome(GetNoise3D(CheeseLayer, Seed, Position.X, Position.Y, Position.Z) - 0.25f, UndergroundBiomePoints, 2);
+	float Underworld = Position.Z + WorldSize.Z;
+	bool bDirt = GetNoise3D(DirtStoneLayer, Seed, Position.X, Position.Y, Position.Z) < 0.0f;
+
+	FVector4f Overworld = bUnderground ? (bDirt ? Brown : Grey) : Black;
+	FVector4f DryOverworld = bUnderground ? (bDirt ? Brown : Grey) : Red;
+
+	if (Underworld < 0)
+		return DarkRed;
+	if (Position.Z < -96 && UndergroundBiome == 1)
+		return DarkBlue;
+
+	//Temperature per row, chaos picks the column
+	const FVector4f Colors[3][3][2] =
+	{
+		{{Overworld, Purple}, {Green, Overworld}, {Yellow, DryOverworld}},
+		{{Blue, Overworld}, {Green, DryOverworld}, {Yellow, Green}},
+		{{Blue, Blue}, {Purple, Purple}, {Green, Green}}
+	};
+	return Colors[Continentalness][Temperature][Chaos];
+}
+
+// Lane types of the SSE4 kernel, the AVX2 ones are in SDensityCPUAVX2.cpp
+
+#if SVOXEL_DENSITY_SSE4
+
+struct FSInt4
+{
+	__m128i V;
+
+	FSInt4() = default;
+	FSInt4(__m128i In) : V(In) {}
+	explicit FSInt4(int32 I) : V(_mm_set1_epi32(I)) {}
+};
+
+static FORCEINLINE FSInt4 operator+(FSInt4 A, FSInt4 B) { return _mm_add_epi32(A.V, B.V); }
+static FORCEINLINE FSInt4 operator-(FSInt4 A, FSInt4 B) { return _mm_sub_epi32(A.V, B.V); }
+static FORCEINLINE FSInt4 operator*(FSInt4 A, FSInt4 B) { return _mm_mullo_epi32(A.V, B.V); }
+static FORCEINLINE FSInt4 operator&(FSInt4 A, FSInt4 B) { return _mm_and_si128(A.V, B.V); }
+static FORCEINLINE FSInt4 operator|(FSInt4 A, FSInt4 B) { return _mm_or_si128(A.V, B.V); }
+static FORCEINLINE FSInt4 operator^(FSInt4 A, FSInt4 B) { return _mm_xor_si128(A.V, B.V); }
+static FORCEINLINE FSInt4 operator>>(FSInt4 A, int32 Shift) { return _mm_sra_epi32(A.V, _mm_cvtsi32_si128(Shift)); }
+
+struct FSFloat4
+{
+	static constexpr int32 NumLanes = 4;
+	using FInt = FSInt4;
+	
+	__m128 V;
+
+	FSFloat4() = default;
+	FSFloat4(__m128 In) : V(In) {}
+	explicit FSFloat4(float F) : V(_mm_set1_ps(F)) {}
+
+	static FSFloat4 Load(const float* Data) { return _mm_loadu_ps(Data); }
+	void Store(float* Data) const { _mm_storeu_ps(Data, V); }
+	
+	static FSFloat4 AllOnes() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+	static FSInt4 TruncToInt(FSFloat4 F) { return _mm_cvttps_epi32(F.V); }
+	static FSFloat4 FromInt(FSInt4 I) { return _mm_cvtepi32_ps(I.V); }
+	
+	static FSFloat4 Gather(const float* Table, FSInt4 Index)
+	{
+		alignas(16) int32 Indices[4];
+		_mm_store_si128((__m128i*)Indices, Index.V);
+		return _mm_setr_ps(Table[Indices[0]], Table[Indices[1]], Table[Indices[2]], Table[Indices[3]]);
+	}
+};
+
+static FORCEINLINE FSFloat4 operator+(FSFloat4 A, FSFloat4 B) { return _mm_add_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator-(FSFloat4 A, FSFloat4 B) { return _mm_sub_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator*(FSFloat4 A, FSFloat4 B) { return _mm_mul_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator/(FSFloat4 A, FSFloat4 B) { return _mm_div_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator-(FSFloat4 A) { return _mm_xor_ps(A.V, _mm_set1_ps(-0.0f)); }
+static FORCEINLINE FSFloat4 operator&(FSFloat4 A, FSFloat4 B) { return _mm_and_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator|(FSFloat4 A, FSFloat4 B) { return _mm_or_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator<(FSFloat4 A, FSFloat4 B) { return _mm_cmplt_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator<=(FSFloat4 A, FSFloat4 B) { return _mm_cmple_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator>(FSFloat4 A, FSFloat4 B) { return _mm_cmpgt_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 operator>=(FSFloat4 A, FSFloat4 B) { return _mm_cmpge_ps(A.V, B.V); }
+//~Mask & B
+static FORCEINLINE FSFloat4 AndNot(FSFloat4 Mask, FSFloat4 B) { return _mm_andnot_ps(Mask.V, B.V); }
+static FORCEINLINE FSFloat4 Abs(FSFloat4 A) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), A.V); }
+static FORCEINLINE FSFloat4 Min(FSFloat4 A, FSFloat4 B) { return _mm_min_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 Max(FSFloat4 A, FSFloat4 B) { return _mm_max_ps(A.V, B.V); }
+static FORCEINLINE FSFloat4 Select(FSFloat4 Mask, FSFloat4 A, FSFloat4 B) { return _mm_blendv_ps(B.V, A.V, Mask.V); }
+static FORCEINLINE FSInt4 Select(FSFloat4 Mask, FSInt4 A, FSInt4 B) { return _mm_blendv_epi8(B.V, A.V, _mm_castps_si128(Mask.V)); }
+
+#endif
+
+void FSDensityCPU::GetChunkDensity(const FIntVector3& WorldSize, int32 Seed, int32 Size, int32 Scale, int32 LOD, const FVector3f& Position,
+	TArrayView<float> OutVoxels, ESDensityKernel Kernel)
+{
+	int32 NumSide = Size + 4;
+	check(OutVoxels.Num() >= NumSide * NumSide * NumSide);
+	
+	if (!IsKernelSupported(Kernel))
+	{
+		Kernel = GetBestKernel();
+	}
+
+	//Same float math as the shader, float3(id) * (LODMultiplier * Scale) + Position
+	float Step = float(1 << LOD) * Scale;
+	for (int32 Z = 0; Z < NumSide; Z++)
+	{
+		for (int32 Y = 0; Y < NumSide; Y++)
+		{
+			float* Row = OutVoxels.GetData() + (Z * NumSide + Y) * NumSide;
+			float RowY = float(Y) * Step + Position.Y;
+			float RowZ = float(Z) * Step + Position.Z;
+			
+			switch (Kernel)
+			{
+#if SVOXEL_DENSITY_AVX2
+			case ESDensityKernel::AVX2:
+				FSDensityCPUAVX2::GetRowDensity(WorldSize, Seed, Row, NumSide, Step, Position.X, RowY, RowZ);
+				break;
+#endif
+#if SVOXEL_DENSITY_SSE4
+			case ESDensityKernel::SSE4:
+				GetRowDensity<FSFloat4>(WorldSize, Seed, Row, NumSide, Step, Position.X, RowY, RowZ);
+				break;
+#endif
+			default:
+				for (int32 X = 0; X < NumSide; X++)
+				{
+					Row[X] = GetDensity(WorldSize, Seed, FVector3f(float(X) * Step + Position.X, RowY, RowZ));
+				}
+				break;
+			}
+		}
+	}
+}
+
+bool FSDensityCPU::IsKernelSupported(ESDensityKernel Kernel)
+{
+	switch (Kernel)
+	{
+	case ESDensityKernel::AVX2:
+#if SVOXEL_DENSITY_AVX2
+		return FSDensityCPUAVX2::IsSupported();
+#else
+		return false;
+#endif
+	case ESDensityKernel::SSE4:
+		return SVOXEL_DENSITY_SSE4;
+	default:
+		return true;
+	}
+}
+
+ESDensityKernel FSDensityCPU::GetBestKernel()
+{
+	if (IsKernelSupported(ESDensityKernel::AVX2))
+		return ESDensityKernel::AVX2;
+	if (IsKernelSupported(ESDensityKernel::SSE4))
+		return ESDensityKernel::SSE4;
+	return ESDensityKernel::Scalar;
+}
+
+const TCHAR* FSDensityCPU::GetKernelName(ESDensityKernel Kernel)
+{
+	switch (Kernel)
+	{
+	case ESDensityKernel::AVX2:
+		return TEXT("AVX2");
+	case ESDensityKernel::SSE4:
+		return TEXT("SSE4");
+	default:
+		return TEXT("Scalar");
+	}
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+static const FIntVector3 CheckWorldSize = FIntVector3(200000, 200000, 3000);
+
+// Largest difference between the voxels and the reference, relative to the reference below magnitudes of 1
+static float GetMaxDensityError(TConstArrayView<float> Voxels, TConstArrayView<float> Reference)
+{
+	float MaxError = 0.0f;
+	for (int32 Index = 0; Index < Reference.Num(); Index++)
+	{
+		MaxError = FMath::Max(MaxError, FMath::Abs(Voxels[Index] - Reference[Index]) / FMath::Max(1.0f, FMath::Abs(Reference[Index])));
+	}
+	return MaxError;
+}
+
+// Checks the SIMD kernels against the scalar one on random chunks, then the scalar one against the noise pass
+static void CheckDensity()
+{
+	const int32 Size = 32;
+	const int32 NumVoxels = (Size + 4) * (Size + 4) * (Size + 4);
+	const float Tolerance = 1e-3f;
+	
+	FRandomStream Random(1337);
+	TArray<float> Reference;
+	TArray<float> Voxels;
+	Reference.SetNumUninitialized(NumVoxels);
+	Voxels.SetNumUninitialized(NumVoxels);
+
+	float MaxErrors[3] = {};
+	for (int32 Chunk = 0; Chunk < 16; Chunk++)
+	{
+		int32 Seed = Random.RandRange(0, 100000);
+		int32 LOD = Chunk % 4;
+		FVector3f Position = FVector3f(Random.FRandRange(-30000.0f, 30000.0f), Random.FRandRange(-30000.0f, 30000.0f), Random.FRandRange(-3500.0f, 500.0f));
+		FSDensityCPU::GetChunkDensity(CheckWorldSize, Seed, Size, 1, LOD, Position, Reference, ESDensityKernel::Scalar);
+		
+		for (ESDensityKernel Kernel : {ESDensityKernel::SSE4, ESDensityKernel::AVX2})
+		{
+			if (FSDensityCPU::IsKernelSupported(Kernel))
+			{
+				FSDensityCPU::GetChunkDensity(CheckWorldSize, Seed, Size, 1, LOD, Position, Voxels, Kernel);
+				MaxErrors[(int32)Kernel] = FMath::Max(MaxErrors[(int32)Kernel], GetMaxDensityError(Voxels, Reference));
+			}
+		}
+	}
+	for (ESDensityKernel Kernel : {ESDensityKernel::SSE4, ESDensityKernel::AVX2})
+	{
+		if (!FSDensityCPU::IsKernelSupported(Kernel))
+		{
+			UE_LOG(LogTemp, Log, TEXT("%s density kernel is not supported here"), FSDensityCPU::GetKernelName(Kernel));
+			continue;
+		}
+		UE_LOG(LogTemp, Log, TEXT("%s density kernel: max error %g against the scalar one, %s"), FSDensityCPU::GetKernelName(Kernel),
+			MaxErrors[(int32)Kernel], MaxErrors[(int32)Kernel] <= Tolerance ? TEXT("ok") : TEXT("FAILED"));
+	}
+
+	//The GPU may fuse multiply adds, so it only has to be close
+	const float GPUTolerance = 1e-2f;
+	const int32 Seed = 1337;
+	const FVector3f Position = FVector3f(1234.0f, -5678.0f, -300.0f);
+	FSDensityCPU::GetChunkDensity(CheckWorldSize, Seed, Size, 1, 0, Position, Reference, ESDensityKernel::Scalar);
+	
+	ENQUEUE_RENDER_COMMAND(CheckDensity)([Reference, Size, NumVoxels, Seed, Position, GPUTolerance](FRHICommandListImmediate& RHICmdList)
+	{
+		for (bool bColumnPass : {false, true})
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+			
+			FSChunkDispatchData ChunkData = FSChunkDispatchData(Position, 0, 0, 0, 0);
+			FRDGBufferRef ChunksBuffer = CreateStructuredBuffer(GraphBuilder, TEXT("CheckDensityChunks"), sizeof(FSChunkDispatchData), 1,
+				&ChunkData, sizeof(FSChunkDispatchData));
+			FNoiseCSDispatchParams NoiseCSDispatchParams = FNoiseCSDispatchParams(CheckWorldSize, Size, 1, Seed, ChunksBuffer, 1);
+			NoiseCSDispatchParams.bColumnPass = bColumnPass;
+			FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, NoiseCSDispatchParams);
+			
+			FRHIGPUBufferReadback Readback(TEXT("CheckDensityVoxels"));
+			AddEnqueueCopyPass(GraphBuilder, &Readback, NoiseCSOutput.OutVoxels, 0u);
+			GraphBuilder.Execute();
+
+			//Only a console check, stalling is fine
+			RHICmdList.SubmitCommandsAndFlushGPU();
+			RHICmdList.BlockUntilGPUIdle();
+			
+			const float* GPUVoxels = (const float*)Readback.Lock(sizeof(float) * NumVoxels);
+			float MaxError = GetMaxDensityError(MakeArrayView(GPUVoxels, NumVoxels), Reference);
+			Readback.Unlock();
+			
+			UE_LOG(LogTemp, Log, TEXT("Scalar density kernel: max error %g against the noise pass%s, %s"), MaxError,
+				bColumnPass ? TEXT(" with the column pass") : TEXT(""), MaxError <= GPUTolerance ? TEXT("ok") : TEXT("FAILED"));
+		}
+	});
+}
+
+static FAutoConsoleCommand CheckDensityCommand(
+	TEXT("SVoxel.CheckDensity"),
+	TEXT("Compares the CPU density kernels with each other and with the noise pass"),
+	FConsoleCommandDelegate::CreateStatic(&CheckDensity));
+
+static void BenchmarkDensity(const TArray<FString>& Args)
+{
+	int32 NumChunks = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 16;
+	int32 Size = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 32;
+	int32 NumVoxels = (Size + 4) * (Size + 4) * (Size + 4);
+	
+	TArray<float> Voxels;
+	Voxels.SetNumUninitialized(NumVoxels);
+
+	//Runs on the calling thread, so the rate is per core
+	double ScalarRate = 0.0;
+	for (ESDensityKernel Kernel : {ESDensityKernel::Scalar, ESDensityKernel::SSE4, ESDensityKernel::AVX2})
+	{
+		if (!FSDensityCPU::IsKernelSupported(Kernel))
+			continue;
+
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			FVector3f Position = FVector3f(Chunk * Size * 100.0f, 0.0f, -Size * 50.0f);
+			FSDensityCPU::GetChunkDensity(CheckWorldSize, 1337, Size, 1, 0, Position, Voxels, Kernel);
+		}
+		double Time = FPlatformTime::Seconds() - StartTime;
+		
+		double Rate = double(NumChunks) * NumVoxels / Time;
+		if (Kernel == ESDensityKernel::Scalar)
+		{
+			ScalarRate = Rate;
+		}
+		UE_LOG(LogTemp, Log, TEXT("%s density kernel: %d chunks of %d voxels in %.2f ms, %.2f M voxels/s per core, %.2fx scalar"),
+			FSDensityCPU::GetKernelName(Kernel), NumChunks, NumVoxels, Time * 1000.0, Rate / 1000000.0, Rate / ScalarRate);
+	}
+}
+
+static FAutoConsoleCommand BenchmarkDensityCommand(
+	TEXT("SVoxel.BenchmarkDensity"),
+	TEXT("Measures the voxels per second per core of every CPU density kernel, takes the number of chunks and their size"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkDensity));
+
+#endif
@@ -0,0 +1,147 @@
+﻿#include "SDensityCPUSIMD.h"
+
+#if SVOXEL_DENSITY_AVX2
+
+#include <immintrin.h>
+#if !PLATFORM_ALWAYS_HAS_AVX_2 && (defined(__clang__) || defined(__GNUC__))
+#include <cpuid.h>
+#elif !PLATFORM_ALWAYS_HAS_AVX_2 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//Every function below is compiled for AVX2, the rest of the module keeps the minimum instruction set of the target.
+//MSVC takes AVX2 intrinsics in any function and needs nothing.
+#if !PLATFORM_ALWAYS_HAS_AVX_2
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+#endif
+
+//Own namespace, so a unity build that also pulls in SDensityCPU.cpp keeps the two copies of the kernel apart
+namespace SDensityCPUAVX2
+{
+
+#include "SDensityCPUKernel.inl"
+
+struct FSInt8
+{
+	__m256i V;
+
+	FSInt8() = default;
+	FSInt8(__m256i In) : V(In) {}
+	explicit FSInt8(int32 I) : V(_mm256_set1_epi32(I)) {}
+};
+
+static FORCEINLINE FSInt8 operator+(FSInt8 A, FSInt8 B) { return _mm256_add_epi32(A.V, B.V); }
+static FORCEINLINE FSInt8 operator-(FSInt8 A, FSInt8 B) { return _mm256_sub_epi32(A.V, B.V); }
+static FORCEINLINE FSInt8 operator*(FSInt8 A, FSInt8 B) { return _mm256_mullo_epi32(A.V, B.V); }
+static FORCEINLINE FSInt8 operator&(FSInt8 A, FSInt8 B) { return _mm256_and_si256(A.V, B.V); }
+static FORCEINLINE FSInt8 operator|(FSInt8 A, FSInt8 B) { return _mm256_or_si256(A.V, B.V); }
+static FORCEINLINE FSInt8 operator^(FSInt8 A, FSInt8 B) { return _mm256_xor_si256(A.V, B.V); }
+static FORCEINLINE FSInt8 operator>>(FSInt8 A, int32 Shift) { return _mm256_sra_epi32(A.V, _mm_cvtsi32_si128(Shift)); }
+
+struct FSFloat8
+{
+	static constexpr int32 NumLanes = 8;
+	using FInt = FSInt8;
+	
+	__m256 V;
+
+	FSFloat8() = default;
+	FSFloat8(__m256 In) : V(In) {}
+	explicit FSFloat8(float F) : V(_mm256_set1_ps(F)) {}
+
+	static FSFloat8 Load(const float* Data) { return _mm256_loadu_ps(Data); }
+	void Store(float* Data) const { _mm256_storeu_ps(Data, V); }
+	
+	static FSFloat8 AllOnes() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+	static FSInt8 TruncToInt(FSFloat8 F) { return _mm256_cvttps_epi32(F.V); }
+	static FSFloat8 FromInt(FSInt8 I) { return _mm256_cvtepi32_ps(I.V); }
+	static FSFloat8 Gather(const float* Table, FSInt8 Index) { return _mm256_i32gather_ps(Table, Index.V, 4); }
+};
+
+static FORCEINLINE FSFloat8 operator+(FSFloat8 A, FSFloat8 B) { return _mm256_add_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 operator-(FSFloat8 A, FSFloat8 B) { return _mm256_sub_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 operator*(FSFloat8 A, FSFloat8 B) { return _mm256_mul_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 operator/(FSFloat8 A, FSFloat8 B) { return _mm256_div_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 operator-(FSFloat8 A) { return _mm256_xor_ps(A.V, _mm256_set1_ps(-0.0f)); }
+static FORCEINLINE FSFloat8 operator&(FSFloat8 A, FSFloat8 B) { return _mm256_and_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 operator|(FSFloat8 A, FSFloat8 B) { return _mm256_or_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 operator<(FSFloat8 A, FSFloat8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ); }
+static FORCEINLINE FSFloat8 operator<=(FSFloat8 A, FSFloat8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_LE_OQ); }
+static FORCEINLINE FSFloat8 operator>(FSFloat8 A, FSFloat8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ); }
+static FORCEINLINE FSFloat8 operator>=(FSFloat8 A, FSFloat8 B) { return _mm256_cmp_ps(A.V, B.V, _CMP_GE_OQ); }
+//~Mask & B
+static FORCEINLINE FSFloat8 AndNot(FSFloat8 Mask, FSFloat8 B) { return _mm256_andnot_ps(Mask.V, B.V); }
+static FORCEINLINE FSFloat8 Abs(FSFloat8 A) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), A.V); }
+static FORCEINLINE FSFloat8 Min(FSFloat8 A, FSFloat8 B) { return _mm256_min_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 Max(FSFloat8 A, FSFloat8 B) { return _mm256_max_ps(A.V, B.V); }
+static FORCEINLINE FSFloat8 Select(FSFloat8 Mask, FSFloat8 A, FSFloat8 B) { return _mm256_blendv_ps(B.V, A.V, Mask.V); }
+static FORCEINLINE FSInt8 Select(FSFloat8 Mask, FSInt8 A, FSInt8 B) { return _mm256_blendv_epi8(B.V, A.V, _mm256_castps_si256(Mask.V)); }
+
+}
+
+void FSDensityCPUAVX2::GetRowDensity(const FIntVector3& WorldSize, int32 Seed, float* OutRow, int32 NumVoxels, float Step, float StartX,
+	float Y, float Z)
+{
+	SDensityCPUAVX2::GetRowDensity<SDensityCPUAVX2::FSFloat8>(WorldSize, Seed, OutRow, NumVoxels, Step, StartX, Y, Z);
+	
+	//The caller runs SSE code, which is slow while the upper halves of the registers are dirty
+	_mm256_zeroupper();
+}
+
+#if !PLATFORM_ALWAYS_HAS_AVX_2
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
+
+// CPUID and XGETBV, the OS has to save the ymm registers too
+static bool HasAVX2()
+{
+#if PLATFORM_ALWAYS_HAS_AVX_2
+	return true;
+#elif defined(__clang__) || defined(__GNUC__)
+	unsigned int EAX, EBX, ECX, EDX;
+	if (!__get_cpuid(1, &EAX, &EBX, &ECX, &EDX))
+		return false;
+	bool bOSXSAVE = (ECX & (1u << 27)) != 0;
+	bool bAVX = (ECX & (1u << 28)) != 0;
+	if (!bOSXSAVE || !bAVX)
+		return false;
+
+	unsigned int XCR0Low, XCR0High;
+	__asm__ volatile("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+	if ((XCR0Low & 6) != 6)
+		return false;
+
+	if (!__get_cpuid_count(7, 0, &EAX, &EBX, &ECX, &EDX))
+		return false;
+	return (EBX & (1u << 5)) != 0;
+#elif defined(_MSC_VER)
+	int Info[4];
+	__cpuid(Info, 1);
+	bool bOSXSAVE = (Info[2] & (1 << 27)) != 0;
+	bool bAVX = (Info[2] & (1 << 28)) != 0;
+	if (!bOSXSAVE || !bAVX || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(Info, 7, 0);
+	return (Info[1] & (1 << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+bool FSDensityCPUAVX2::IsSupported()
+{
+	static const bool bSupported = HasAVX2();
+	return bSupported;
+}
+
+#endif
@@ -0,0 +1,442 @@
+﻿//Tables and SIMD kernels of the CPU density. SDensityCPU.cpp includes them at file scope, SDensityCPUAVX2.cpp includes them
+//again inside its own namespace with AVX2 enabled for every function, which is why this file has no include guard and no includes.
+
+// fnl.ush tables and constants, only what OpenSimplex2 needs
+
+static const float Gradients2D[] =
+{
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+	0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+	0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+	-0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+	-0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+	-0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+	0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+	-0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f
+};
+
+static const float Gradients3D[] =
+{
+	0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f,
+	1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f,
+	1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f,
+	1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f,
+	1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f,
+	1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f,
+	1.0f, 1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f,
+	1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f
+};
+static constexpr int32 PrimeX = 501125321;
+static constexpr int32 PrimeY = 1136930381;
+static constexpr int32 PrimeZ = 1720413743;
+static constexpr int32 HashMultiplier = 0x27d4eb2d;
+
+static constexpr float SQRT3 = 1.7320508075688772935274463415059f;
+//Skew of the 2D noise coordinates and unskew of the simplex
+static constexpr float F2 = 0.5f * (SQRT3 - 1);
+static constexpr float G2 = (3 - SQRT3) / 6;
+//Rotation of the 3D noise coordinates
+static constexpr float R3 = 2.0f / 3.0f;
+
+//Noise states NoiseCS.usf creates, the seed is added to the world seed. All of them are OpenSimplex2 with the fnlCreateState
+//defaults, which means a lacunarity of 2, a gain of 0.5 and no weighted strength.
+struct FSNoiseLayer
+{
+	int32 SeedOffset;
+	float Frequency;
+	int32 Octaves;
+	bool bFBm;
+	
+	//1 / the sum of the octave amplitudes, _fnlCalculateFractalBounding
+	float GetFractalBounding() const
+	{
+		float Amp = 0.5f;
+		float AmpFractal = 1.0f;
+		for (int32 Octave = 1; Octave < Octaves; Octave++)
+		{
+			AmpFractal += Amp;
+			Amp *= 0.5f;
+		}
+		return 1.0f / AmpFractal;
+	}
+};
+
+static constexpr FSNoiseLayer LowlandsLayer = {21411, 0.005f, 4, true};
+static constexpr FSNoiseLayer HighlandsLayer = {223424, 0.01f, 5, true};
+static constexpr FSNoiseLayer MountainsLayer = {325235, 0.005f, 4, true};
+static constexpr FSNoiseLayer ContinentalnessLayer = {422, 0.001f, 1, false};
+static constexpr FSNoiseLayer ChaosSelectLayer = {1238, 0.001f, 1, false};
+static constexpr FSNoiseLayer ChaosLayer = {325235, 0.01f, 3, true};
+static constexpr FSNoiseLayer CavesLayer = {552356, 0.005f, 4, true};
+static constexpr FSNoiseLayer Caves2Layer = {12414, 0.005f, 4, true};
+static constexpr FSNoiseLayer CheeseLayer = {2838428, 0.0025f, 3, true};
+
+//Amplitudes and key points of the terrain height
+static constexpr float LowlandsAmplitude = 8.0f;
+static constexpr float HighlandsAmplitude = 15.0f;
+static constexpr float MountainsAmplitude = 70.0f;
+static constexpr float ChaosAmplitude = 50.0f;
+static constexpr float HeightFade = 0.1f;
+
+//Integer math of the shader wraps, signed overflow does not in C++
+static FORCEINLINE int32 MulWrap(int32 A, int32 B)
+{
+	return int32(uint32(A) * uint32(B));
+}
+
+static FORCEINLINE int32 AddWrap(int32 A, int32 B)
+{
+	return int32(uint32(A) + uint32(B));
+}
+
+// SIMD kernels, the scalar kernel with its branches turned into selects. FFloatN is a lane type of the including file with an FInt of the same width.
+
+template<typename FFloatN>
+static FORCEINLINE FFloatN GradCoord2D(typename FFloatN::FInt Seed, typename FFloatN::FInt XPrimed, typename FFloatN::FInt YPrimed,
+	FFloatN XD, FFloatN YD)
+{
+	using FIntN = typename FFloatN::FInt;
+	FIntN Hash = (Seed ^ XPrimed ^ YPrimed) * FIntN(HashMultiplier);
+	Hash = Hash ^ (Hash >> 15);
+	Hash = Hash & FIntN(127 << 1);
+	return XD * FFloatN::Gather(Gradients2D, Hash) + YD * FFloatN::Gather(Gradients2D, Hash | FIntN(1));
+}
+
+template<typename FFloatN>
+static FORCEINLINE FFloatN GradCoord3D(typename FFloatN::FInt Seed, typename FFloatN::FInt XPrimed, typename FFloatN::FInt YPrimed,
+	typename FFloatN::FInt ZPrimed, FFloatN XD, FFloatN YD, FFloatN ZD)
+{
+	using FIntN = typename FFloatN::FInt;
+	FIntN Hash = (Seed ^ XPrimed ^ YPrimed ^ ZPrimed) * FIntN(HashMultiplier);
+	Hash = Hash ^ (Hash >> 15);
+	Hash = Hash & FIntN(63 << 2);
+	return XD * FFloatN::Gather(Gradients3D, Hash) + YD * FFloatN::Gather(Gradients3D, Hash | FIntN(1))
+		+ ZD * FFloatN::Gather(Gradients3D, Hash | FIntN(2));
+}
+
+template<typename FFloatN>
+static FORCEINLINE typename FFloatN::FInt FastFloor(FFloatN F)
+{
+	//Truncation minus one below zero, whole negative numbers included like the shader
+	using FIntN = typename FFloatN::FInt;
+	return FFloatN::TruncToInt(F) + Select(F >= FFloatN(0.0f), FIntN(0), FIntN(-1));
+}
+
+template<typename FFloatN>
+static FORCEINLINE typename FFloatN::FInt FastRound(FFloatN F)
+{
+	return FFloatN::TruncToInt(F + Select(F >= FFloatN(0.0f), FFloatN(0.5f), FFloatN(-0.5f)));
+}
+
+template<typename FFloatN>
+static FFloatN SingleSimplex2D(int32 ScalarSeed, FFloatN X, FFloatN Y)
+{
+	using FIntN = typename FFloatN::FInt;
+	FIntN Seed = FIntN(ScalarSeed);
+	
+	FIntN I = FastFloor(X);
+	FIntN J = FastFloor(Y);
+	FFloatN XI = X - FFloatN::FromInt(I);
+	FFloatN YI = Y - FFloatN::FromInt(J);
+
+	FFloatN T = (XI + YI) * FFloatN(G2);
+	FFloatN X0 = XI - T;
+	FFloatN Y0 = YI - T;
+
+	I = I * FIntN(PrimeX);
+	J = J * FIntN(PrimeY);
+
+	FFloatN Zero = FFloatN(0.0f);
+	
+	FFloatN A = FFloatN(0.5f) - X0 * X0 - Y0 * Y0;
+	FFloatN N0 = Select(A <= Zero, Zero, (A * A) * (A * A) * GradCoord2D(Seed, I, J, X0, Y0));
+
+	FFloatN C = FFloatN((float)(2 * (1 - 2 * G2) * (1 / G2 - 2))) * T + (FFloatN((float)(-2 * (1 - 2 * G2) * (1 - 2 * G2))) + A);
+	FFloatN X2 = X0 + FFloatN(2 * G2 - 1);
+	FFloatN Y2 = Y0 + FFloatN(2 * G2 - 1);
+	FFloatN N2 = Select(C <= Zero, Zero, (C * C) * (C * C) * GradCoord2D(Seed, I + FIntN(PrimeX), J + FIntN(PrimeY), X2, Y2));
+
+	FFloatN Upper = Y0 > X0;
+	FFloatN X1 = X0 + Select(Upper, FFloatN(G2), FFloatN(G2 - 1));
+	FFloatN Y1 = Y0 + Select(Upper, FFloatN(G2 - 1), FFloatN(G2));
+	FIntN I1 = I + Select(Upper, FIntN(0), FIntN(PrimeX));
+	FIntN J1 = J + Select(Upper, FIntN(PrimeY), FIntN(0));
+	FFloatN B = FFloatN(0.5f) - X1 * X1 - Y1 * Y1;
+	FFloatN N1 = Select(B <= Zero, Zero, (B * B) * (B * B) * GradCoord2D(Seed, I1, J1, X1, Y1));
+
+	return (N0 + N1 + N2) * FFloatN(99.83685446303647f);
+}
+
+template<typename FFloatN>
+static FFloatN SingleOpenSimplex23D(int32 ScalarSeed, FFloatN X, FFloatN Y, FFloatN Z)
+{
+	using FIntN = typename FFloatN::FInt;
+	
+	FIntN I = FastRound(X);
+	FIntN J = FastRound(Y);
+	FIntN K = FastRound(Z);
+	FFloatN X0 = X - FFloatN::FromInt(I);
+	FFloatN Y0 = Y - FFloatN::FromInt(J);
+	FFloatN Z0 = Z - FFloatN::FromInt(K);
+
+	FIntN XNSign = FFloatN::TruncToInt(FFloatN(-1.0f) - X0) | FIntN(1);
+	FIntN YNSign = FFloatN::TruncToInt(FFloatN(-1.0f) - Y0) | FIntN(1);
+	FIntN ZNSign = FFloatN::TruncToInt(FFloatN(-1.0f) - Z0) | FIntN(1);
+	FFloatN XSign = FFloatN::FromInt(XNSign);
+	FFloatN YSign = FFloatN::FromInt(YNSign);
+	FFloatN ZSign = FFloatN::FromInt(ZNSign);
+
+	FFloatN AX0 = XSign * -X0;
+	FFloatN AY0 = YSign * -Y0;
+	FFloatN AZ0 = ZSign * -Z0;
+
+	I = I * FIntN(PrimeX);
+	J = J * FIntN(PrimeY);
+	K = K * FIntN(PrimeZ);
+
+	FFloatN Zero = FFloatN(0.0f);
+	FFloatN Value = Zero;
+	FFloatN A = (FFloatN(0.6f) - X0 * X0) - (Y0 * Y0 + Z0 * Z0);
+
+	for (int32 L = 0; ; L++)
+	{
+		FIntN Seed = FIntN(ScalarSeed);
+		Value = Value + Select(A > Zero, (A * A) * (A * A) * GradCoord3D(Seed, I, J, K, X0, Y0, Z0), Zero);
+
+		//Step towards the closest of the three axes
+		FFloatN StepX = (AX0 >= AY0) & (AX0 >= AZ0);
+		FFloatN StepY = AndNot(StepX, (AY0 > AX0) & (AY0 >= AZ0));
+		FFloatN StepZ = AndNot(StepX | StepY, FFloatN::AllOnes());
+		
+		FFloatN X1 = X0 + (StepX & XSign);
+		FFloatN Y1 = Y0 + (StepY & YSign);
+		FFloatN Z1 = Z0 + (StepZ & ZSign);
+		FFloatN B = A + FFloatN(1.0f) - Select(StepX, XSign * FFloatN(2.0f) * X1, Select(StepY, YSign * FFloatN(2.0f) * Y1, ZSign * FFloatN(2.0f) * Z1));
+		FIntN I1 = I - Select(StepX, XNSign * FIntN(PrimeX), FIntN(0));
+		FIntN J1 = J - Select(StepY, YNSign * FIntN(PrimeY), FIntN(0));
+		FIntN K1 = K - Select(StepZ, ZNSign * FIntN(PrimeZ), FIntN(0));
+
+		Value = Value + Select(B > Zero, (B * B) * (B * B) * GradCoord3D(Seed, I1, J1, K1, X1, Y1, Z1), Zero);
+
+		if (L == 1)
+			break;
+
+		AX0 = FFloatN(0.5f) - AX0;
+		AY0 = FFloatN(0.5f) - AY0;
+		AZ0 = FFloatN(0.5f) - AZ0;
+
+		X0 = XSign * AX0;
+		Y0 = YSign * AY0;
+		Z0 = ZSign * AZ0;
+
+		A = A + ((FFloatN(0.75f) - AX0) - (AY0 + AZ0));
+
+		I = I + ((XNSign >> 1) & FIntN(PrimeX));
+		J = J + ((YNSign >> 1) & FIntN(PrimeY));
+		K = K + ((ZNSign >> 1) & FIntN(PrimeZ));
+
+		XNSign = FIntN(0) - XNSign;
+		YNSign = FIntN(0) - YNSign;
+		ZNSign = FIntN(0) - ZNSign;
+		XSign = -XSign;
+		YSign = -YSign;
+		ZSign = -ZSign;
+
+		ScalarSeed = ~ScalarSeed;
+	}
+
+	return Value * FFloatN(32.69428253173828125f);
+}
+
+template<typename FFloatN>
+static FFloatN GetNoise2D(const FSNoiseLayer& Layer, int32 WorldSeed, FFloatN X, FFloatN Y)
+{
+	X = X * FFloatN(Layer.Frequency);
+	Y = Y * FFloatN(Layer.Frequency);
+	FFloatN T = (X + Y) * FFloatN(F2);
+	X = X + T;
+	Y = Y + T;
+
+	int32 Seed = AddWrap(WorldSeed, Layer.SeedOffset);
+	if (!Layer.bFBm)
+		return SingleSimplex2D(Seed, X, Y);
+
+	FFloatN Sum = FFloatN(0.0f);
+	float Amp = Layer.GetFractalBounding();
+	for (int32 Octave = 0; Octave < Layer.Octaves; Octave++)
+	{
+		Sum = Sum + SingleSimplex2D(Seed, X, Y) * FFloatN(Amp);
+		Seed = AddWrap(Seed, 1);
+
+		X = X * FFloatN(2.0f);
+		Y = Y * FFloatN(2.0f);
+		Amp *= 0.5f;
+	}
+	return Sum;
+}
+
+template<typename FFloatN>
+static FFloatN GetNoise3D(const FSNoiseLayer& Layer, int32 WorldSeed, FFloatN X, FFloatN Y, FFloatN Z)
+{
+	X = X * FFloatN(Layer.Frequency);
+	Y = Y * FFloatN(Layer.Frequency);
+	Z = Z * FFloatN(Layer.Frequency);
+	FFloatN R = (X + Y + Z) * FFloatN(R3);
+	X = R - X;
+	Y = R - Y;
+	Z = R - Z;
+
+	int32 Seed = AddWrap(WorldSeed, Layer.SeedOffset);
+	if (!Layer.bFBm)
+		return SingleOpenSimplex23D(Seed, X, Y, Z);
+
+	FFloatN Sum = FFloatN(0.0f);
+	float Amp = Layer.GetFractalBounding();
+	for (int32 Octave = 0; Octave < Layer.Octaves; Octave++)
+	{
+		Sum = Sum + SingleOpenSimplex23D(Seed, X, Y, Z) * FFloatN(Amp);
+		Seed = AddWrap(Seed, 1);
+
+		X = X * FFloatN(2.0f);
+		Y = Y * FFloatN(2.0f);
+		Z = Z * FFloatN(2.0f);
+		Amp *= 0.5f;
+	}
+	return Sum;
+}
+
+template<typename FFloatN>
+static FORCEINLINE FFloatN LerpFade(FFloatN A, FFloatN B, FFloatN T, float Fade)
+{
+	return Select(T < FFloatN(Fade), A + T * (B - A) / FFloatN(Fade), B);
+}
+
+// GetTerrainHeight with the key point values shared by every lane and the heights per lane
+template<typename FFloatN>
+static FFloatN GetTerrainHeight(FFloatN Value, const float* PointValues, const FFloatN* PointHeights, int32 NumPoints, float Fade)
+{
+	FFloatN Height = Select(Value < FFloatN(PointValues[0]), PointHeights[0], PointHeights[NumPoints - 1]);
+	
+	//The first segment containing the value wins, so they are applied back to front
+	for (int32 Index = NumPoints - 2; Index >= 0; Index--)
+	{
+		FFloatN Start = FFloatN(PointValues[Index]);
+		FFloatN End = FFloatN(PointValues[Index + 1]);
+		FFloatN T = (Value - Start) / (End - Start);
+		FFloatN Segment = LerpFade(PointHeights[Index], PointHeights[Index + 1], T, Fade);
+		Height = Select((Value >= Start) & (Value <= End), Segment, Height);
+	}
+	return Height;
+}
+
+template<typename FFloatN>
+static FORCEINLINE FFloatN GetSquashingFactor(FFloatN Height, float MinHeight, float MaxHeight, float MinSquash, float MaxSquash)
+{
+	FFloatN T = (Height - FFloatN(MinHeight)) / FFloatN(MaxHeight - MinHeight);
+	FFloatN Squash = FFloatN(MinSquash) + T * FFloatN(MaxSquash - MinSquash);
+	Squash = Select(Height >= FFloatN(MaxHeight), FFloatN(MaxSquash), Squash);
+	return Select(Height <= FFloatN(MinHeight), FFloatN(MinSquash), Squash);
+}
+
+template<typename FFloatN>
+static FFloatN GetDensityLanes(const FIntVector3& WorldSize, int32 Seed, FFloatN X, FFloatN Y, FFloatN Z)
+{
+	FFloatN Density = Z;
+
+	FFloatN Lowlands = GetNoise2D(LowlandsLayer, Seed, X, Y) * FFloatN(LowlandsAmplitude) - FFloatN(20.0f);
+	FFloatN Highlands = GetNoise2D(HighlandsLayer, Seed, X, Y) * FFloatN(HighlandsAmplitude);
+	FFloatN Mountains = GetNoise2D(MountainsLayer, Seed, X, Y) * FFloatN(MountainsAmplitude);
+	const float PointValues[3] = {-0.6f, 0.4f, 1.0f};
+	const FFloatN PointHeights[3] = {Lowlands, Highlands, Mountains};
+	FFloatN BaseHeight = GetTerrainHeight(GetNoise2D(ContinentalnessLayer, Seed, X, Y), PointValues, PointHeights, 3, HeightFade);
+	Density = Density - BaseHeight;
+
+	FFloatN Chaos = GetNoise3D(ChaosLayer, Seed, X, Y, Z) * FFloatN(ChaosAmplitude);
+	const float ChaosValues[2] = {-0.6f, 1.0f};
+	const FFloatN ChaosHeights[2] = {Chaos, FFloatN(0.0f)};
+	Density = Density - GetTerrainHeight(GetNoise2D(ChaosSelectLayer, Seed, X, Y), ChaosValues, ChaosHeights, 2, HeightFade);
+
+	FFloatN CaveZ = Z * FFloatN(1.35f);
+	FFloatN Cave1 = GetNoise3D(CavesLayer, Seed, X, Y, CaveZ);
+	FFloatN Cave2 = GetNoise3D(Caves2Layer, Seed, X, Y, CaveZ);
+
+	FFloatN One = FFloatN(1.0f);
+	FFloatN Caves = (One - Abs(Cave1)) * (One - Abs(Cave2));
+	Caves = Caves * FFloatN(2.0f) - FFloatN(1.4f);
+	Caves = Caves - GetSquashingFactor(Z, -400.0f, 0, 0.1f, 0.32f);
+
+	FFloatN Cheese = GetNoise3D(CheeseLayer, Seed, X, Y, Z) - FFloatN(0.25f);
+	Cheese = Cheese - GetSquashingFactor(Z, -400.0f, 0, 0.1f, 0.55f);
+
+	Caves = Max(Caves, Cheese);
+	Density = Max(Caves, Density);
+
+	Density = Density + Max(-(FFloatN(float(WorldSize.Z)) + Z) / FFloatN(128.0f), FFloatN(0.0f));
+
+	FFloatN Underworld = Z + FFloatN(float(WorldSize.Z)) + FFloatN(128.0f);
+	Underworld = Underworld + BaseHeight;
+	Density = Min(Underworld, Density);
+
+	//Outside of the world is air
+	FFloatN Outside = (Abs(X) > FFloatN(float(WorldSize.X))) | (Abs(Y) > FFloatN(float(WorldSize.Y))) | (Z > FFloatN(float(WorldSize.Z)));
+	return Select(Outside, One, Density);
+}
+
+// One row of voxels along x, the lanes past the end of the row are computed and dropped
+template<typename FFloatN>
+static void GetRowDensity(const FIntVector3& WorldSize, int32 Seed, float* OutRow, int32 NumVoxels, float Step, float StartX, float Y, float Z)
+{
+	constexpr int32 NumLanes = FFloatN::NumLanes;
+	alignas(32) float Lanes[NumLanes];
+	
+	for (int32 X = 0; X < NumVoxels; X += NumLanes)
+	{
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			Lanes[Lane] = float(X + Lane) * Step + StartX;
+		}
+		
+		FFloatN Density = GetDensityLanes(WorldSize, Seed, FFloatN::Load(Lanes), FFloatN(Y), FFloatN(Z));
+		if (X + NumLanes <= NumVoxels)
+		{
+			Density.Store(OutRow + X);
+		}
+		else
+		{
+			Density.Store(Lanes);
+			FMemory::Memcpy(OutRow + X, Lanes, sizeof(float) * (NumVoxels - X));
+		}
+	}
+}
@@ -0,0 +1,22 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+//SSE4 is compiled in when the target always has it. AVX2 is compiled in on every x86 target, in SDensityCPUAVX2.cpp with the
+//instruction set enabled per function, and only run on CPUs that report it. Targets that always have AVX2 skip the check.
+#define SVOXEL_DENSITY_SSE4 (PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_ALWAYS_HAS_SSE4_1)
+#define SVOXEL_DENSITY_AVX2 (PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY)
+
+#if SVOXEL_DENSITY_AVX2
+
+// The AVX2 density kernel, compiled apart from the rest so only it uses the instruction set
+struct FSDensityCPUAVX2
+{
+	// True if the CPU and the OS support AVX2, checked once
+	static bool IsSupported();
+	
+	// One row of voxels along x, like GetRowDensity. Only call it if IsSupported.
+	static void GetRowDensity(const FIntVector3& WorldSize, int32 Seed, float* OutRow, int32 NumVoxels, float Step, float StartX, float Y, float Z);
+};
+
+#endif
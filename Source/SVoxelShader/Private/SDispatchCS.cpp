@@ -9,64 +9,985 @@
 #include "NoiseCS.h"
 #include "MCCountVertsCS.h"
 #include "MCAllocVertsCS.h"
+#include "MCSuballocCS.h"
+#include "MCScanCellsCS.h"
 #include "MarchingCS.h"
+#include "SDispatchCSBatch.h"
+#include "SChunkBufferPool.h"
+#include "SReadbackManager.h"
+#include "SVoxelStats.h"
+#include "SPassBenchmark.h"
+#include "HAL/IConsoleManager.h"
 
-void FSDispatchCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FSDispatchCSParams Params,
-	TFunction<void(FSDispatchCSOutput Output)> AsyncCallback)
+//Outputs of one DispatchBatch call, shared by the batches it was split into. Only touched on the render thread until the callback.
+struct FSDispatchCSBatchResults
+{
+	TArray<FSDispatchCSParams> Params;
+	TArray<FSDispatchCSOutput> Outputs;
+	TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback;
+	ENamedThreads::Type CallbackThread = ENamedThreads::GameThread;
+	FSDispatchOverflowCallback OverflowCallback;
+	
+	int NumPendingBatches = 0;
+
+	//When the batches were dispatched, on the render thread
+	double StartTime = 0.0;
+	uint64 StartFrame = 0;
+
+	//Bytes the batches uploaded from the CPU
+	int64 UploadedBytes = 0;
+};
+
+//Dispatch latency of every batch since startup per mode, only touched on the render thread
+struct FSDispatchLatency
 {
-	FNoiseCSDispatchParams NoiseCSDispatchParams = FNoiseCSDispatchParams(Params.WorldSize, Params.Size, Params.Position, Params.LOD, Params.Scale,
-		Params.seed);
+	double TotalTime = 0.0;
+	uint64 TotalFrames = 0;
+	int NumBatches = 0;
+};
+static FSDispatchLatency DispatchLatency[2];
 
-	// Dispatch the compute shader and wait until it completes
-	FNoiseCSInterface::DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(), NoiseCSDispatchParams,
-		[AsyncCallback, Params](FNoiseCSOutput NoiseCSOutput)
+// Records how long the batch took from being dispatched to its outputs being ready to spawn
+static void RecordDispatchLatency(const FSDispatchCSBatchResults& Results, bool bGPUDriven)
+{
+	double LatencyTime = (FPlatformTime::Seconds() - Results.StartTime) * 1000.0;
+	uint64 LatencyFrames = GFrameCounterRenderThread - Results.StartFrame;
+	SET_FLOAT_STAT(STAT_SVoxel_DispatchLatencyMs, LatencyTime);
+	SET_DWORD_STAT(STAT_SVoxel_DispatchLatencyFrames, LatencyFrames);
+
+	FSDispatchLatency& Latency = DispatchLatency[bGPUDriven ? 1 : 0];
+	Latency.TotalTime += LatencyTime;
+	Latency.TotalFrames += LatencyFrames;
+	Latency.NumBatches++;
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+static void ReportDispatchLatency()
+{
+	ENQUEUE_RENDER_COMMAND(ReportDispatchLatency)([](FRHICommandListImmediate& RHICmdList)
 	{
-		FMCCountVertsCSDispatchParams MCCountVertsCSDispatchParams = FMCCountVertsCSDispatchParams(Params.Size, 
-		Params.isolevel,  NoiseCSOutput.OutVoxels);
+		for (int Mode = 0; Mode < 2; Mode++)
+		{
+			const FSDispatchLatency& Latency = DispatchLatency[Mode];
+			const TCHAR* ModeName = Mode ? TEXT("GPU driven") : TEXT("Counted");
+			if (Latency.NumBatches == 0)
+			{
+				UE_LOG(LogTemp, Log, TEXT("%s dispatch: no batches yet"), ModeName);
+				continue;
+			}
+			UE_LOG(LogTemp, Log, TEXT("%s dispatch: %d batches, %.2f ms and %.2f frames from dispatch to spawn on average"), ModeName,
+				Latency.NumBatches, Latency.TotalTime / Latency.NumBatches, double(Latency.TotalFrames) / Latency.NumBatches);
+		}
+	});
+}
+
+static FAutoConsoleCommand ReportDispatchLatencyCommand(
+	TEXT("SVoxel.ReportDispatchLatency"),
+	TEXT("Logs the average time from dispatch to spawn of the counted and GPU driven dispatches"),
+	FConsoleCommandDelegate::CreateStatic(&ReportDispatchLatency));
 
-		FMCCountVertsCSInterface::DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(), MCCountVertsCSDispatchParams,
-	[AsyncCallback, Params, NoiseCSOutput](FMCCountVertsCSOutput MCCountVertsCSOutput)
+static void BenchmarkMarchPasses(const TArray<FString>& Args)
+{
+	int32 NumChunks = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 4;
+	int32 Iterations = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 8;
+	
+	ENQUEUE_RENDER_COMMAND(BenchmarkMarchPasses)([NumChunks, Iterations](FRHICommandListImmediate& RHICmdList)
+	{
+		const FIntVector3 WorldSize = FIntVector3(200000, 200000, 3000);
+		
+		for (int32 Size : {16, 32, 64})
 		{
-			if(MCCountVertsCSOutput.IndicesCount <= 0)
+			int32 NumCells = (Size + 1) * (Size + 1) * (Size + 1);
+
+			double CountTimes[2] = {};
+			double MarchingTimes[2] = {};
+			for (bool bVoxelTile : {false, true})
 			{
-				AsyncTask(ENamedThreads::GameThread, [AsyncCallback]()
+				//Across the surface so the chunks have triangles
+				TArray<double> Times = FSPassBenchmark::Run(RHICmdList, Size, NumChunks, Iterations, Size, -Size / 2, true, [&](FSPassBenchmark& Benchmark)
 				{
-					AsyncCallback(FSDispatchCSOutput());
+					FRDGBuilder& GraphBuilder = Benchmark.GraphBuilder;
+					FNoiseCSDispatchParams NoiseCSDispatchParams = FNoiseCSDispatchParams(WorldSize, Size, 1, 1337, Benchmark.Chunks, NumChunks);
+					NoiseCSDispatchParams.bAsyncCompute = false;
+					FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, NoiseCSDispatchParams);
+
+					FMCCountVertsCSDispatchParams MCCountVertsCSDispatchParams = FMCCountVertsCSDispatchParams(Size, 0.0f,
+						NoiseCSOutput.OutVoxels, Benchmark.Chunks, NumChunks);
+					MCCountVertsCSDispatchParams.bVoxelTile = bVoxelTile;
+					MCCountVertsCSDispatchParams.bAsyncCompute = false;
+					Benchmark.AddTimestamp(0);
+					FMCCountVertsCSOutput MCCountVertsCSOutput = FMCCountVertsCSInterface::AddPass(GraphBuilder, MCCountVertsCSDispatchParams);
+					Benchmark.AddTimestamp(1);
+
+					//On the graphics pipe as well so the march timestamps do not wait on an asynchronous allocation
+					FMCAllocVertsCSDispatchParams MCAllocVertsCSDispatchParams = FMCAllocVertsCSDispatchParams(Size, MCCountVertsCSOutput.OutCellMasks,
+						Benchmark.Chunks, NumChunks);
+					MCAllocVertsCSDispatchParams.bAsyncCompute = false;
+					FMCAllocVertsCSInterface::AddPass(GraphBuilder, MCAllocVertsCSDispatchParams);
+					
+					FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(WorldSize, Size, 0.0f, 1, 1337,
+						NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, Benchmark.Chunks, NumChunks,
+						Benchmark.Vertices, Benchmark.Indices, Benchmark.Normals, Benchmark.Colors);
+					MarchingCSDispatchParams.bVoxelTile = bVoxelTile;
+					MarchingCSDispatchParams.bAsyncCompute = false;
+					Benchmark.AddTimestamp(2);
+					FMarchingCSInterface::AddPass(GraphBuilder, MarchingCSDispatchParams);
+					Benchmark.AddTimestamp(3);
 				});
-				return;
+
+				CountTimes[bVoxelTile] = Times[0];
+				MarchingTimes[bVoxelTile] = Times[1];
 			}
+
+			//Voxel buffer traffic, the tiles load the corners of every group once, plus the ring for the normals when marching.
+			//Per thread the corners alone are 8 fetches, the march adds 14 per emitted vertex on top.
+			int32 GroupsPerAxis = FMath::DivideAndRoundUp(Size + 1, 8);
+			double NumGroups = double(GroupsPerAxis) * GroupsPerAxis * GroupsPerAxis * NumChunks;
+			double ThreadBytes = 8.0 * sizeof(float) * NumCells * NumChunks;
+			double CountTileBytes = 9.0 * 9.0 * 9.0 * sizeof(float) * NumGroups;
+			double MarchingTileBytes = 11.0 * 11.0 * 11.0 * sizeof(float) * NumGroups;
+
+			UE_LOG(LogTemp, Log, TEXT("Count pass, %d chunks of Size %d: %.3f ms per thread (%.2f MB, %.1f GB/s), %.3f ms tiled (%.2f MB, %.1f GB/s), %.2fx"),
+				NumChunks, Size, CountTimes[0], ThreadBytes / 1000000.0, ThreadBytes / (CountTimes[0] * 1000000.0),
+				CountTimes[1], CountTileBytes / 1000000.0, CountTileBytes / (CountTimes[1] * 1000000.0), CountTimes[0] / FMath::Max(CountTimes[1], 0.001));
+			UE_LOG(LogTemp, Log, TEXT("March pass, %d chunks of Size %d: %.3f ms per thread (at least %.2f MB, %.1f GB/s), %.3f ms tiled (%.2f MB, %.1f GB/s), %.2fx"),
+				NumChunks, Size, MarchingTimes[0], ThreadBytes / 1000000.0, ThreadBytes / (MarchingTimes[0] * 1000000.0),
+				MarchingTimes[1], MarchingTileBytes / 1000000.0, MarchingTileBytes / (MarchingTimes[1] * 1000000.0), MarchingTimes[0] / FMath::Max(MarchingTimes[1], 0.001));
+		}
+	});
+}
+
+static FAutoConsoleCommand BenchmarkMarchPassesCommand(
+	TEXT("SVoxel.BenchmarkMarchPasses"),
+	TEXT("Measures the GPU time and voxel traffic of the count and march passes with and without groupshared voxel tiles, takes the number of chunks and iterations"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkMarchPasses));
+
+static void BenchmarkActiveCells(const TArray<FString>& Args)
+{
+	int32 NumChunks = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 4;
+	int32 Iterations = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 8;
+	
+	ENQUEUE_RENDER_COMMAND(BenchmarkActiveCells)([NumChunks, Iterations](FRHICommandListImmediate& RHICmdList)
+	{
+		const FIntVector3 WorldSize = FIntVector3(200000, 200000, 3000);
+
+		//Heights of the chunks, across the surface, deep underground and high above it
+		const TCHAR* TerrainNames[] = {TEXT("overworld"), TEXT("cave"), TEXT("air")};
 		
-			FMCAllocVertsCSDispatchParams MCAllocVertsCSDispatchParams = FMCAllocVertsCSDispatchParams(Params.Size, MCCountVertsCSOutput.OutCellMasks);
+		for (int32 Size : {16, 32, 64})
+		{
+			int32 NumCells = (Size + 1) * (Size + 1) * (Size + 1);
+			const float TerrainHeights[] = {-Size / 2.0f, -1500.0f, 1000.0f};
 
-			FMCAllocVertsCSInterface::DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(), MCAllocVertsCSDispatchParams,
-[AsyncCallback, Params, NoiseCSOutput, MCCountVertsCSOutput](FMCAllocVertsCSOutput MCAllocVertsCSOutput)
+			for (int32 Terrain = 0; Terrain < UE_ARRAY_COUNT(TerrainHeights); Terrain++)
 			{
-				if(MCAllocVertsCSOutput.NumAllocatedVerts <= 0)
+				double Times[2] = {};
+				FRHIGPUBufferReadback* NumActiveCellsReadback = new FRHIGPUBufferReadback(TEXT("BenchmarkNumActiveCells"));
+				for (bool bActiveCells : {false, true})
 				{
-					AsyncTask(ENamedThreads::GameThread, [AsyncCallback]()
+					Times[bActiveCells] = FSPassBenchmark::Run(RHICmdList, Size, NumChunks, Iterations, Size, TerrainHeights[Terrain], true, [&](FSPassBenchmark& Benchmark)
 					{
-						AsyncCallback(FSDispatchCSOutput());
-					});
-					return;
+						FRDGBuilder& GraphBuilder = Benchmark.GraphBuilder;
+						FNoiseCSDispatchParams NoiseCSDispatchParams = FNoiseCSDispatchParams(WorldSize, Size, 1, 1337, Benchmark.Chunks, NumChunks);
+						NoiseCSDispatchParams.bAsyncCompute = false;
+						FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, NoiseCSDispatchParams);
+
+						FMCCountVertsCSDispatchParams MCCountVertsCSDispatchParams = FMCCountVertsCSDispatchParams(Size, 0.0f,
+							NoiseCSOutput.OutVoxels, Benchmark.Chunks, NumChunks);
+						MCCountVertsCSDispatchParams.bAsyncCompute = false;
+						FMCCountVertsCSOutput MCCountVertsCSOutput = FMCCountVertsCSInterface::AddPass(GraphBuilder, MCCountVertsCSDispatchParams);
+						if (bActiveCells && Benchmark.Iteration == 0)
+						{
+							AddEnqueueCopyPass(GraphBuilder, NumActiveCellsReadback, MCCountVertsCSOutput.ActiveCells.NumCells, 0u);
+						}
+						
+						//The allocation and the march are what the lists save on, the count builds them either way
+						FMCActiveCells ActiveCells = bActiveCells ? MCCountVertsCSOutput.ActiveCells : FMCActiveCells();
+						Benchmark.AddTimestamp(0);
+						FMCAllocVertsCSDispatchParams MCAllocVertsCSDispatchParams = FMCAllocVertsCSDispatchParams(Size, MCCountVertsCSOutput.OutCellMasks,
+							Benchmark.Chunks, NumChunks);
+						MCAllocVertsCSDispatchParams.ActiveCells = ActiveCells;
+						MCAllocVertsCSDispatchParams.bAsyncCompute = false;
+						FMCAllocVertsCSInterface::AddPass(GraphBuilder, MCAllocVertsCSDispatchParams);
+						
+						FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(WorldSize, Size, 0.0f, 1, 1337,
+							NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, Benchmark.Chunks, NumChunks,
+							Benchmark.Vertices, Benchmark.Indices, Benchmark.Normals, Benchmark.Colors);
+						MarchingCSDispatchParams.ActiveCells = ActiveCells;
+						MarchingCSDispatchParams.bAsyncCompute = false;
+						FMarchingCSInterface::AddPass(GraphBuilder, MarchingCSDispatchParams);
+						Benchmark.AddTimestamp(1);
+					})[0];
 				}
+
+				uint32* NumActiveCellsData = (uint32*)NumActiveCellsReadback->Lock(sizeof(uint32) * NumChunks);
+				int64 NumActiveCells = 0;
+				for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+				{
+					NumActiveCells += NumActiveCellsData[Chunk];
+				}
+				NumActiveCellsReadback->Unlock();
+				delete NumActiveCellsReadback;
+
+				UE_LOG(LogTemp, Log, TEXT("Alloc and march, %d %s chunks of Size %d: %.2f%% of the cells active, %.3f ms over every cell, %.3f ms over the active cells, %.2fx"),
+					NumChunks, TerrainNames[Terrain], Size, 100.0 * NumActiveCells / (double(NumCells) * NumChunks),
+					Times[0], Times[1], Times[0] / FMath::Max(Times[1], 0.001));
+			}
+		}
+	});
+}
+
+static FAutoConsoleCommand BenchmarkActiveCellsCommand(
+	TEXT("SVoxel.BenchmarkActiveCells"),
+	TEXT("Measures the cell occupancy and the GPU time of the alloc and march passes over every cell and over the active cells only, for chunks across the surface, underground and in the air"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkActiveCells));
+
+#endif
+
+//Murmur3 finalizer, MixHash in ContentHash.ush
+static uint32 MixContentHash(uint32 Hash)
+{
+	Hash ^= Hash >> 16;
+	Hash *= 0x85EBCA6Bu;
+	Hash ^= Hash >> 13;
+	Hash *= 0xC2B2AE35u;
+	Hash ^= Hash >> 16;
+	return Hash;
+}
+
+// Adds the hash of a value at a slot of the chunk to both lanes, HashSlot in ContentHash.ush
+static void AddContentHashSlot(uint32 Slot, uint32 Value, uint32 (&Lanes)[2])
+{
+	Lanes[0] += MixContentHash(MixContentHash(Slot) ^ Value);
+	Lanes[1] += MixContentHash(MixContentHash(Slot + 0x9E3779B9u) + Value);
+}
+
+static uint32 FloatToBits(float Value)
+{
+	uint32 Bits;
+	FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+	return Bits;
+}
+
+uint64 FSDispatchCSOutput::GetContentHash(TConstArrayView<FVector3f> Vertices, TConstArrayView<FVector3f> Normals,
+	TConstArrayView<FVector4f> Colors, TConstArrayView<uint32> Indices)
+{
+	check(Normals.Num() == Vertices.Num() && Colors.Num() == Vertices.Num());
+	
+	//16 slots per vertex, 3 position, 3 normal and 4 color components, and the last one for the index of the same number
+	uint32 Lanes[2] = {};
+	for (int32 Vertex = 0; Vertex < Vertices.Num(); Vertex++)
+	{
+		const float Components[10] = {
+			Vertices[Vertex].X, Vertices[Vertex].Y, Vertices[Vertex].Z,
+			Normals[Vertex].X, Normals[Vertex].Y, Normals[Vertex].Z,
+			Colors[Vertex].X, Colors[Vertex].Y, Colors[Vertex].Z, Colors[Vertex].W};
+		for (int32 Component = 0; Component < UE_ARRAY_COUNT(Components); Component++)
+		{
+			AddContentHashSlot(Vertex * 16 + Component, FloatToBits(Components[Component]), Lanes);
+		}
+	}
+	for (int32 Index = 0; Index < Indices.Num(); Index++)
+	{
+		AddContentHashSlot(Index * 16 + 15, Indices[Index], Lanes);
+	}
+	return (uint64(Lanes[0]) << 32) | Lanes[1];
+}
+
+// Runs OnReady on the render thread in the first frame every readback is ready
+static void WaitForReadbacks(TArray<FRHIGPUBufferReadback*> Readbacks, TFunction<void()> OnReady)
+{
+	FSReadbackManager::Get().Add(MoveTemp(Readbacks), MoveTemp(OnReady));
+}
+
+// Hands every output to the callback thread once the last batch is done
+static void FinishBatch(const TSharedRef<FSDispatchCSBatchResults>& Results)
+{
+	if (--Results->NumPendingBatches > 0)
+		return;
+
+	SET_DWORD_STAT(STAT_SVoxel_UploadedBytesPerChunk, Results->Params.IsEmpty() ? 0 : Results->UploadedBytes / Results->Params.Num());
+	
+	AsyncTask(Results->CallbackThread, [Results]()
+	{
+		Results->AsyncCallback(MoveTemp(Results->Outputs));
+	});
+}
+
+// Flags the output of a cancelled chunk, returns false if the chunk is still wanted
+static bool CancelChunk(FSDispatchCSBatchResults& Results, int ChunkIndex, int NumRemainingPasses)
+{
+	if (!Results.Params[ChunkIndex].IsCancelled())
+		return false;
+
+	INC_DWORD_STAT(STAT_SVoxel_CancelledDispatches);
+	INC_DWORD_STAT_BY(STAT_SVoxel_SkippedPasses, NumRemainingPasses);
+	Results.Outputs[ChunkIndex].bCancelled = true;
+	return true;
+}
+
+// Uploads the per chunk data of a pass, the only data the dispatches send from the CPU
+static FRDGBufferRef CreateChunksBuffer(FRDGBuilder& GraphBuilder, FSDispatchCSBatchResults& Results, const TCHAR* Name,
+	const TArray<FSChunkDispatchData>& ChunkData)
+{
+	uint32 NumBytes = sizeof(FSChunkDispatchData) * ChunkData.Num();
+	Results.UploadedBytes += NumBytes;
+	INC_DWORD_STAT_BY(STAT_SVoxel_UploadedBytes, NumBytes);
+	
+	return CreateStructuredBuffer(
+		GraphBuilder,
+		Name,
+		sizeof(FSChunkDispatchData),
+		ChunkData.Num(),
+		ChunkData.GetData(),
+		NumBytes);
+}
+
+//Chunks of a batch that were given ranges in the same page of the chunk buffer pool
+struct FSChunkPageGroup
+{
+	FSChunkBufferPage* Page = nullptr;
+	TArray<int> BatchIndices;
+	
+	//FSChunkDispatchData of the chunks with the offsets of their ranges
+	FRDGBufferRef ChunksBuffer = nullptr;
+	FRDGBufferRef Vertices = nullptr;
+	FRDGBufferRef Tris = nullptr;
+	FRDGBufferRef Normals = nullptr;
+	FRDGBufferRef Colors = nullptr;
+};
+
+//Active cell lists of a batch, kept from the count graph for the march graph
+struct FSPooledActiveCells
+{
+	TRefCountPtr<FRDGPooledBuffer> Cells;
+	TRefCountPtr<FRDGPooledBuffer> NumCells;
+	TRefCountPtr<FRDGPooledBuffer> Args;
+
+	void Extract(FRDGBuilder& GraphBuilder, const FMCActiveCells& ActiveCells)
+	{
+		GraphBuilder.QueueBufferExtraction(ActiveCells.Cells, &Cells);
+		GraphBuilder.QueueBufferExtraction(ActiveCells.NumCells, &NumCells);
+		GraphBuilder.QueueBufferExtraction(ActiveCells.Args, &Args, ERHIAccess::IndirectArgs);
+	}
+
+	FMCActiveCells Register(FRDGBuilder& GraphBuilder) const
+	{
+		FMCActiveCells ActiveCells;
+		ActiveCells.Cells = GraphBuilder.RegisterExternalBuffer(Cells);
+		ActiveCells.NumCells = GraphBuilder.RegisterExternalBuffer(NumCells);
+		ActiveCells.Args = GraphBuilder.RegisterExternalBuffer(Args);
+		return ActiveCells;
+	}
+};
+
+// Groups the allocated chunks by page and registers the page buffers, chunks without an allocation are left out
+static void GroupByPage(FRDGBuilder& GraphBuilder, FSDispatchCSBatchResults& Results, const TArray<int>& Chunks,
+	const TArray<FSChunkBufferAllocationRef>& Allocations, TArray<FSChunkPageGroup>& OutGroups)
+{
+	for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+	{
+		if (!Allocations[BatchIndex].IsValid())
+			continue;
+		
+		FSChunkBufferPage* Page = Allocations[BatchIndex]->Page.Get();
+		FSChunkPageGroup* Group = OutGroups.FindByPredicate([Page](const FSChunkPageGroup& Other)
+		{
+			return Other.Page == Page;
+		});
+		if (!Group)
+		{
+			Group = &OutGroups.AddDefaulted_GetRef();
+			Group->Page = Page;
+		}
+		Group->BatchIndices.Add(BatchIndex);
+	}
+
+	for (FSChunkPageGroup& Group : OutGroups)
+	{
+		TArray<FSChunkDispatchData> ChunkData;
+		for (int BatchIndex : Group.BatchIndices)
+		{
+			const FSDispatchCSParams& ChunkParams = Results.Params[Chunks[BatchIndex]];
+			const FSChunkBufferAllocation& Allocation = *Allocations[BatchIndex];
+			ChunkData.Add(FSChunkDispatchData(ChunkParams.Position, ChunkParams.LOD, BatchIndex, Allocation.VertexOffset, Allocation.IndexOffset));
+		}
+		
+		Group.ChunksBuffer = CreateChunksBuffer(GraphBuilder, Results, TEXT("PageChunksBuffer"), ChunkData);
+
+		Group.Vertices = GraphBuilder.RegisterExternalBuffer(Group.Page->Vertices);
+		Group.Tris = GraphBuilder.RegisterExternalBuffer(Group.Page->Indices);
+		Group.Normals = GraphBuilder.RegisterExternalBuffer(Group.Page->Normals);
+		Group.Colors = GraphBuilder.RegisterExternalBuffer(Group.Page->Colors);
+
+		//The vertex factory reads the page once the graph is done
+		GraphBuilder.SetBufferAccessFinal(Group.Vertices, ERHIAccess::SRVMask);
+		GraphBuilder.SetBufferAccessFinal(Group.Tris, ERHIAccess::VertexOrIndexBuffer | ERHIAccess::SRVMask);
+		GraphBuilder.SetBufferAccessFinal(Group.Normals, ERHIAccess::SRVMask);
+		GraphBuilder.SetBufferAccessFinal(Group.Colors, ERHIAccess::SRVMask);
+	}
+}
+
+// Hands the ranges of a chunk to its output
+static void FillOutput(FSDispatchCSOutput& Output, const FSChunkBufferAllocationRef& Allocation)
+{
+	Output.OutputVertices = Allocation->Page->Vertices;
+	Output.OutputTris = Allocation->Page->Indices;
+	Output.OutNormals = Allocation->Page->Normals;
+	Output.OutColor = Allocation->Page->Colors;
+	Output.Allocation = Allocation;
+	Output.NumVertices = Allocation->NumVertices;
+	Output.NumIndices = Allocation->NumIndices;
+	Output.VertexOffset = Allocation->VertexOffset;
+	Output.IndexOffset = Allocation->IndexOffset;
+}
+
+// Marches the chunks that have geometry straight into their ranges of the chunk buffer pool
+static void MarchBatch(FRHICommandListImmediate& RHICmdList, TSharedRef<FSDispatchCSBatchResults> Results, const TArray<int>& Chunks,
+	const TArray<uint32>& VertexCounts, const TArray<uint32>& IndicesCounts,
+	TRefCountPtr<FRDGPooledBuffer> Voxels, TRefCountPtr<FRDGPooledBuffer> CellMasks, FSPooledActiveCells ActiveCells,
+	TRefCountPtr<FRDGPooledBuffer> CellIndexStarts)
+{
+	const FSDispatchCSParams& Params = Results->Params[Chunks[0]];
+
+	TArray<FSChunkBufferAllocationRef> Allocations;
+	Allocations.SetNum(Chunks.Num());
+	
+	//LOD 0 chunks are also copied back to back into a small buffer for collision
+	TArray<uint32> CollisionVertexCounts;
+	TArray<uint32> CollisionIndicesCounts;
+	CollisionVertexCounts.SetNumZeroed(Chunks.Num());
+	CollisionIndicesCounts.SetNumZeroed(Chunks.Num());
+	
+	bool bHasGeometry = false;
+	for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+	{
+		if (VertexCounts[BatchIndex] == 0 || IndicesCounts[BatchIndex] == 0)
+			continue;
+		
+		Allocations[BatchIndex] = FSChunkBufferPool::Get().Allocate(VertexCounts[BatchIndex], IndicesCounts[BatchIndex]);
+		bHasGeometry = true;
+		
+		if (Results->Params[Chunks[BatchIndex]].LOD == 0)
+		{
+			CollisionVertexCounts[BatchIndex] = VertexCounts[BatchIndex];
+			CollisionIndicesCounts[BatchIndex] = IndicesCounts[BatchIndex];
+		}
+	}
+	if (!bHasGeometry)
+	{
+		FinishBatch(Results);
+		return;
+	}
+
+	TArray<FSDispatchCSSlice> CollisionSlices;
+	int NumCollisionVertices = 0;
+	int NumCollisionIndices = 0;
+	FSDispatchCSBatching::BuildSlices(CollisionVertexCounts, CollisionIndicesCounts, CollisionSlices, NumCollisionVertices, NumCollisionIndices);
+	
+	FRDGBuilder GraphBuilder(RHICmdList);
+
+	TArray<FSChunkPageGroup> Groups;
+	GroupByPage(GraphBuilder, *Results, Chunks, Allocations, Groups);
+
+	FRDGBufferRef VoxelsBuffer = GraphBuilder.RegisterExternalBuffer(Voxels);
+	FRDGBufferRef CellMasksBuffer = GraphBuilder.RegisterExternalBuffer(CellMasks);
+	FMCActiveCells ActiveCellsBuffers = ActiveCells.Register(GraphBuilder);
+	FRDGBufferRef CellIndexStartsBuffer = CellIndexStarts.IsValid() ? GraphBuilder.RegisterExternalBuffer(CellIndexStarts) : nullptr;
+	
+	//Deterministic batches read the content hashes of every page group back, with the batch indices of its chunks
+	TArray<FRHIGPUBufferReadback*> HashReadbacks;
+	TArray<TArray<int>> HashBatchIndices;
+	for (const FSChunkPageGroup& Group : Groups)
+	{
+		FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(Params.WorldSize, Params.Size, Params.isolevel, Params.Scale,
+			Params.seed, VoxelsBuffer, CellMasksBuffer, Group.ChunksBuffer, Group.BatchIndices.Num(),
+			Group.Vertices, Group.Tris, Group.Normals, Group.Colors);
+		MarchingCSDispatchParams.ActiveCells = ActiveCellsBuffers;
+		MarchingCSDispatchParams.InCellIndexStarts = CellIndexStartsBuffer;
+		FMarchingCSOutput MarchingCSOutput = FMarchingCSInterface::AddPass(GraphBuilder, MarchingCSDispatchParams);
+		
+		if (MarchingCSOutput.OutContentHashes)
+		{
+			FRHIGPUBufferReadback* HashReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMarchingCSContentHashes"));
+			AddEnqueueCopyPass(GraphBuilder, HashReadback, MarchingCSOutput.OutContentHashes, 0u);
+			HashReadbacks.Add(HashReadback);
+			HashBatchIndices.Add(Group.BatchIndices);
+		}
+	}
+
+	//LOD 0 chunks need their geometry on the cpp side for collision, only their ranges are read back
+	FRHIGPUBufferReadback* GPUOutVerticesBufferReadback = nullptr;
+	FRHIGPUBufferReadback* GPUOutTrisBufferReadback = nullptr;
+	if (!CollisionSlices.IsEmpty())
+	{
+		FRDGBufferRef CollisionVertices = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), NumCollisionVertices),
+			TEXT("CollisionVerticesBuffer"));
+		FRDGBufferRef CollisionTris = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumCollisionIndices),
+			TEXT("CollisionTrisBuffer"));
+		
+		for (const FSDispatchCSSlice& Slice : CollisionSlices)
+		{
+			const FSChunkBufferAllocation& Allocation = *Allocations[Slice.BatchIndex];
+			const FSChunkPageGroup* Group = Groups.FindByPredicate([&Allocation](const FSChunkPageGroup& Other)
+			{
+				return Other.Page == Allocation.Page.Get();
+			});
+			AddCopyBufferPass(GraphBuilder, CollisionVertices, sizeof(FVector3f) * Slice.VertexOffset,
+				Group->Vertices, sizeof(FVector3f) * Allocation.VertexOffset, sizeof(FVector3f) * Slice.NumVertices);
+			AddCopyBufferPass(GraphBuilder, CollisionTris, sizeof(uint32) * Slice.IndexOffset,
+				Group->Tris, sizeof(uint32) * Allocation.IndexOffset, sizeof(uint32) * Slice.NumIndices);
+		}
+		
+		GPUOutVerticesBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMarchingCSOutput"));
+		AddEnqueueCopyPass(GraphBuilder, GPUOutVerticesBufferReadback, CollisionVertices, 0u);
+		GPUOutTrisBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMarchingCSOutput"));
+		AddEnqueueCopyPass(GraphBuilder, GPUOutTrisBufferReadback, CollisionTris, 0u);
+	}
+	
+	GraphBuilder.Execute();
+
+	for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+	{
+		if (Allocations[BatchIndex].IsValid())
+		{
+			FillOutput(Results->Outputs[Chunks[BatchIndex]], Allocations[BatchIndex]);
+		}
+	}
+
+	if (CollisionSlices.IsEmpty() && HashReadbacks.IsEmpty())
+	{
+		RecordDispatchLatency(*Results, false);
+		FinishBatch(Results);
+		return;
+	}
+
+	TArray<FRHIGPUBufferReadback*> Readbacks = HashReadbacks;
+	if (!CollisionSlices.IsEmpty())
+	{
+		Readbacks.Add(GPUOutVerticesBufferReadback);
+		Readbacks.Add(GPUOutTrisBufferReadback);
+	}
+
+	WaitForReadbacks(MoveTemp(Readbacks),
+		[Results, Chunks, CollisionSlices, NumCollisionVertices, NumCollisionIndices, GPUOutVerticesBufferReadback, GPUOutTrisBufferReadback,
+		HashReadbacks, HashBatchIndices]()
+	{
+		for (int GroupIndex = 0; GroupIndex < HashReadbacks.Num(); GroupIndex++)
+		{
+			const TArray<int>& BatchIndices = HashBatchIndices[GroupIndex];
+			uint32* HashData = (uint32*)HashReadbacks[GroupIndex]->Lock(sizeof(uint32) * 2 * BatchIndices.Num());
+			for (int GroupChunk = 0; GroupChunk < BatchIndices.Num(); GroupChunk++)
+			{
+				Results->Outputs[Chunks[BatchIndices[GroupChunk]]].ContentHash = (uint64(HashData[2 * GroupChunk]) << 32) | HashData[2 * GroupChunk + 1];
+			}
+			HashReadbacks[GroupIndex]->Unlock();
+			delete HashReadbacks[GroupIndex];
+		}
+
+		if (CollisionSlices.IsEmpty())
+		{
+			RecordDispatchLatency(*Results, false);
+			FinishBatch(Results);
+			return;
+		}
+		
+		FVector3f* VerticesData = (FVector3f*)GPUOutVerticesBufferReadback->Lock(sizeof(FVector3f) * NumCollisionVertices);
+		uint32* TrisData = (uint32*)GPUOutTrisBufferReadback->Lock(sizeof(uint32) * NumCollisionIndices);
+		TConstArrayView<FVector3f> CollisionVertices = MakeArrayView(VerticesData, NumCollisionVertices);
+		TConstArrayView<uint32> CollisionTris = MakeArrayView(TrisData, NumCollisionIndices);
+		
+		for (const FSDispatchCSSlice& Slice : CollisionSlices)
+		{
+			FSDispatchCSOutput& Output = Results->Outputs[Chunks[Slice.BatchIndex]];
+			FSDispatchCSBatching::SliceCollision(CollisionVertices.Slice(Slice.VertexOffset, Slice.NumVertices),
+				CollisionTris.Slice(Slice.IndexOffset, Slice.NumIndices), Output.VertexOffset, Output.Vertices, Output.Indices);
+		}
+
+		GPUOutVerticesBufferReadback->Unlock();
+		GPUOutTrisBufferReadback->Unlock();
+		delete GPUOutVerticesBufferReadback;
+		delete GPUOutTrisBufferReadback;
+		
+		RecordDispatchLatency(*Results, false);
+		FinishBatch(Results);
+	});
+}
+
+static void GenerateBatch(FRHICommandListImmediate& RHICmdList, TSharedRef<FSDispatchCSBatchResults> Results, const TArray<int>& Batch)
+{
+	TArray<int> Chunks;
+	for (int ChunkIndex : Batch)
+	{
+		if (!CancelChunk(*Results, ChunkIndex, 4))
+		{
+			Chunks.Add(ChunkIndex);
+		}
+	}
+	if (Chunks.IsEmpty())
+	{
+		FinishBatch(Results);
+		return;
+	}
+	
+	const FSDispatchCSParams& Params = Results->Params[Chunks[0]];
+
+	TArray<FSChunkDispatchData> ChunkData;
+	for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+	{
+		const FSDispatchCSParams& ChunkParams = Results->Params[Chunks[BatchIndex]];
+		ChunkData.Add(FSChunkDispatchData(ChunkParams.Position, ChunkParams.LOD, BatchIndex, 0, 0));
+	}
+	
+	//Noise, count and alloc of every chunk go in one graph, only the march has to wait for the counts
+	FRDGBuilder GraphBuilder(RHICmdList);
+	
+	FRDGBufferRef ChunksBuffer = CreateChunksBuffer(GraphBuilder, *Results, TEXT("ChunksBuffer"), ChunkData);
+	
+	FNoiseCSDispatchParams NoiseCSDispatchParams = FNoiseCSDispatchParams(Params.WorldSize, Params.Size, Params.Scale, Params.seed,
+		ChunksBuffer, Chunks.Num());
+	FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, NoiseCSDispatchParams);
+
+	FMCCountVertsCSDispatchParams MCCountVertsCSDispatchParams = FMCCountVertsCSDispatchParams(Params.Size, Params.isolevel,
+		NoiseCSOutput.OutVoxels, ChunksBuffer, Chunks.Num());
+	FMCCountVertsCSOutput MCCountVertsCSOutput = FMCCountVertsCSInterface::AddPass(GraphBuilder, MCCountVertsCSDispatchParams);
+
+	//Deterministic batches scan the cells in order instead of handing out the slots with atomics
+	FRDGBufferRef NumAllocatedVerts = nullptr;
+	FRDGBufferRef IndicesCount = MCCountVertsCSOutput.OutIndicesCount;
+	TRefCountPtr<FRDGPooledBuffer> CellIndexStarts;
+	if (Params.bDeterministic)
+	{
+		FMCScanCellsCSDispatchParams MCScanCellsCSDispatchParams = FMCScanCellsCSDispatchParams(Params.Size, Params.isolevel,
+			NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, ChunksBuffer, Chunks.Num());
+		FMCScanCellsCSOutput MCScanCellsCSOutput = FMCScanCellsCSInterface::AddPass(GraphBuilder, MCScanCellsCSDispatchParams);
+		NumAllocatedVerts = MCScanCellsCSOutput.OutNumAllocatedVerts;
+		IndicesCount = MCScanCellsCSOutput.OutNumIndices;
+		GraphBuilder.QueueBufferExtraction(MCScanCellsCSOutput.OutCellIndexStarts, &CellIndexStarts);
+	}
+	else
+	{
+		FMCAllocVertsCSDispatchParams MCAllocVertsCSDispatchParams = FMCAllocVertsCSDispatchParams(Params.Size, MCCountVertsCSOutput.OutCellMasks,
+			ChunksBuffer, Chunks.Num());
+		MCAllocVertsCSDispatchParams.ActiveCells = MCCountVertsCSOutput.ActiveCells;
+		FMCAllocVertsCSOutput MCAllocVertsCSOutput = FMCAllocVertsCSInterface::AddPass(GraphBuilder, MCAllocVertsCSDispatchParams);
+		NumAllocatedVerts = MCAllocVertsCSOutput.OutNumAllocatedVerts;
+	}
+
+	FRHIGPUBufferReadback* GPUIndicesCountBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCCountVertsCSOutput"));
+	AddEnqueueCopyPass(GraphBuilder, GPUIndicesCountBufferReadback, IndicesCount, 0u);
+	FRHIGPUBufferReadback* GPUNumAllocatedVertsBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCAllocVertsCSOutput"));
+	AddEnqueueCopyPass(GraphBuilder, GPUNumAllocatedVertsBufferReadback, NumAllocatedVerts, 0u);
+	FRHIGPUBufferReadback* GPUNumActiveCellsBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCCountVertsCSActiveCells"));
+	AddEnqueueCopyPass(GraphBuilder, GPUNumActiveCellsBufferReadback, MCCountVertsCSOutput.ActiveCells.NumCells, 0u);
+
+	TRefCountPtr<FRDGPooledBuffer> Voxels;
+	TRefCountPtr<FRDGPooledBuffer> CellMasks;
+	FSPooledActiveCells ActiveCells;
+	GraphBuilder.QueueBufferExtraction(NoiseCSOutput.OutVoxels, &Voxels);
+	GraphBuilder.QueueBufferExtraction(MCCountVertsCSOutput.OutCellMasks, &CellMasks);
+	ActiveCells.Extract(GraphBuilder, MCCountVertsCSOutput.ActiveCells);
+	
+	GraphBuilder.Execute();
+
+	WaitForReadbacks({GPUIndicesCountBufferReadback, GPUNumAllocatedVertsBufferReadback, GPUNumActiveCellsBufferReadback},
+		[Results, Chunks, Voxels, CellMasks, ActiveCells, CellIndexStarts, GPUIndicesCountBufferReadback, GPUNumAllocatedVertsBufferReadback, GPUNumActiveCellsBufferReadback]()
+	{
+		uint32* IndicesCountData = (uint32*)GPUIndicesCountBufferReadback->Lock(sizeof(uint32) * Chunks.Num());
+		uint32* NumAllocatedVertsData = (uint32*)GPUNumAllocatedVertsBufferReadback->Lock(sizeof(uint32) * Chunks.Num());
+		uint32* NumActiveCellsData = (uint32*)GPUNumActiveCellsBufferReadback->Lock(sizeof(uint32) * Chunks.Num());
+		
+		TArray<uint32> IndicesCounts = TArray<uint32>(IndicesCountData, Chunks.Num());
+		TArray<uint32> VertexCounts = TArray<uint32>(NumAllocatedVertsData, Chunks.Num());
+		
+		//Share of the cells the march runs over
+		const int NumCells = (Results->Params[Chunks[0]].Size + 1) * (Results->Params[Chunks[0]].Size + 1) * (Results->Params[Chunks[0]].Size + 1);
+		int NumActiveCells = 0;
+		for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+		{
+			Results->Outputs[Chunks[BatchIndex]].NumActiveCells = NumActiveCellsData[BatchIndex];
+			NumActiveCells += NumActiveCellsData[BatchIndex];
+		}
+		SET_FLOAT_STAT(STAT_SVoxel_CellOccupancy, 100.0f * NumActiveCells / (NumCells * Chunks.Num()));
+		
+		GPUIndicesCountBufferReadback->Unlock();
+		GPUNumAllocatedVertsBufferReadback->Unlock();
+		GPUNumActiveCellsBufferReadback->Unlock();
+		delete GPUIndicesCountBufferReadback;
+		delete GPUNumAllocatedVertsBufferReadback;
+		delete GPUNumActiveCellsBufferReadback;
+
+		//Chunks cancelled while the counts were in flight are left out of the march
+		for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+		{
+			if (CancelChunk(*Results, Chunks[BatchIndex], 1))
+			{
+				IndicesCounts[BatchIndex] = 0;
+				VertexCounts[BatchIndex] = 0;
+			}
+		}
+
+		MarchBatch(GetImmediateCommandList_ForRenderCommand(), Results, Chunks, VertexCounts, IndicesCounts, Voxels, CellMasks, ActiveCells,
+			CellIndexStarts);
+	});
+}
+
+// Noise to march in one graph, the counts never leave the GPU. Every chunk gets a worst case range from the chunk buffer pool and the
+// suballoc pass writes its draw arguments, so the outputs are handed back as soon as the graph is submitted.
+static void GenerateBatchGPUDriven(FRHICommandListImmediate& RHICmdList, TSharedRef<FSDispatchCSBatchResults> Results, const TArray<int>& Batch)
+{
+	TArray<int> Chunks;
+	for (int ChunkIndex : Batch)
+	{
+		if (!CancelChunk(*Results, ChunkIndex, 5))
+		{
+			Chunks.Add(ChunkIndex);
+		}
+	}
+	if (Chunks.IsEmpty())
+	{
+		FinishBatch(Results);
+		return;
+	}
+	
+	const FSDispatchCSParams& Params = Results->Params[Chunks[0]];
+
+	int VertexCapacity = 0;
+	int IndexCapacity = 0;
+	FSDispatchCSBatching::GetGPUDrivenCapacity(Params.Size, VertexCapacity, IndexCapacity);
+
+	TArray<FSChunkDispatchData> ChunkData;
+	TArray<FSChunkBufferAllocationRef> Allocations;
+	TArray<TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe>> OverflowFlags;
+	for (int BatchIndex = 0; BatchIndex < Chunks.Num(); BatchIndex++)
+	{
+		const FSDispatchCSParams& ChunkParams = Results->Params[Chunks[BatchIndex]];
+		ChunkData.Add(FSChunkDispatchData(ChunkParams.Position, ChunkParams.LOD, BatchIndex, 0, 0));
+		Allocations.Add(FSChunkBufferPool::Get().Allocate(VertexCapacity, IndexCapacity));
+		OverflowFlags.Add(MakeShared<FThreadSafeBool, ESPMode::ThreadSafe>(false));
+	}
+	
+	FRDGBuilder GraphBuilder(RHICmdList);
+	
+	FRDGBufferRef ChunksBuffer = CreateChunksBuffer(GraphBuilder, *Results, TEXT("ChunksBuffer"), ChunkData);
 	
-				FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(Params.WorldSize, Params.Size, Params.isolevel, Params.LOD, Params.Scale,
-					Params.Position, Params.seed, NoiseCSOutput.OutVoxels, MCAllocVertsCSOutput.OutCellMasks, MCAllocVertsCSOutput.NumAllocatedVerts,
-					MCCountVertsCSOutput.IndicesCount);
+	FNoiseCSDispatchParams NoiseCSDispatchParams = FNoiseCSDispatchParams(Params.WorldSize, Params.Size, Params.Scale, Params.seed,
+		ChunksBuffer, Chunks.Num());
+	FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, NoiseCSDispatchParams);
+
+	FMCCountVertsCSDispatchParams MCCountVertsCSDispatchParams = FMCCountVertsCSDispatchParams(Params.Size, Params.isolevel,
+		NoiseCSOutput.OutVoxels, ChunksBuffer, Chunks.Num());
+	FMCCountVertsCSOutput MCCountVertsCSOutput = FMCCountVertsCSInterface::AddPass(GraphBuilder, MCCountVertsCSDispatchParams);
+
+	FMCAllocVertsCSDispatchParams MCAllocVertsCSDispatchParams = FMCAllocVertsCSDispatchParams(Params.Size, MCCountVertsCSOutput.OutCellMasks,
+		ChunksBuffer, Chunks.Num());
+	MCAllocVertsCSDispatchParams.ActiveCells = MCCountVertsCSOutput.ActiveCells;
+	FMCAllocVertsCSOutput MCAllocVertsCSOutput = FMCAllocVertsCSInterface::AddPass(GraphBuilder, MCAllocVertsCSDispatchParams);
+
+	TArray<FSChunkPageGroup> Groups;
+	GroupByPage(GraphBuilder, *Results, Chunks, Allocations, Groups);
+
+	//Draw arguments of every page group, indexed like the chunks of the group
+	TArray<TRefCountPtr<FRDGPooledBuffer>> DrawArgs;
+	DrawArgs.SetNum(Groups.Num());
+	for (int GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
+	{
+		const FSChunkPageGroup& Group = Groups[GroupIndex];
+		
+		FMCSuballocCSDispatchParams MCSuballocCSDispatchParams = FMCSuballocCSDispatchParams(MCAllocVertsCSOutput.OutNumAllocatedVerts,
+			MCCountVertsCSOutput.OutIndicesCount, Group.ChunksBuffer, Group.BatchIndices.Num(), VertexCapacity, IndexCapacity);
+		FMCSuballocCSOutput MCSuballocCSOutput = FMCSuballocCSInterface::AddPass(GraphBuilder, MCSuballocCSDispatchParams);
+		GraphBuilder.QueueBufferExtraction(MCSuballocCSOutput.OutDrawArgs, &DrawArgs[GroupIndex], ERHIAccess::IndirectArgs);
+
+		FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(Params.WorldSize, Params.Size, Params.isolevel, Params.Scale,
+			Params.seed, NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, Group.ChunksBuffer, Group.BatchIndices.Num(),
+			Group.Vertices, Group.Tris, Group.Normals, Group.Colors);
+		MarchingCSDispatchParams.ActiveCells = MCCountVertsCSOutput.ActiveCells;
+		FMarchingCSInterface::AddPass(GraphBuilder, MarchingCSDispatchParams);
+	}
+
+	//Nothing waits on these, they give the unused end of the ranges back and tell if the capacity was too small
+	FRHIGPUBufferReadback* GPUIndicesCountBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCCountVertsCSOutput"));
+	AddEnqueueCopyPass(GraphBuilder, GPUIndicesCountBufferReadback, MCCountVertsCSOutput.OutIndicesCount, 0u);
+	FRHIGPUBufferReadback* GPUNumAllocatedVertsBufferReadback = new FRHIGPUBufferReadback(TEXT("ExecuteMCAllocVertsCSOutput"));
+	AddEnqueueCopyPass(GraphBuilder, GPUNumAllocatedVertsBufferReadback, MCAllocVertsCSOutput.OutNumAllocatedVerts, 0u);
+	
+	GraphBuilder.Execute();
+
+	for (int GroupIndex = 0; GroupIndex < Groups.Num(); GroupIndex++)
+	{
+		const FSChunkPageGroup& Group = Groups[GroupIndex];
+		for (int GroupChunk = 0; GroupChunk < Group.BatchIndices.Num(); GroupChunk++)
+		{
+			int BatchIndex = Group.BatchIndices[GroupChunk];
+			FSDispatchCSOutput& Output = Results->Outputs[Chunks[BatchIndex]];
+			FillOutput(Output, Allocations[BatchIndex]);
+			Output.DrawArgs = DrawArgs[GroupIndex];
+			Output.DrawArgsIndex = GroupChunk;
+			Output.NumIndices = 0;
+			Output.OverflowFlag = OverflowFlags[BatchIndex];
+		}
+	}
+	RecordDispatchLatency(*Results, true);
+	FinishBatch(Results);
+
+	//The allocations are held until the counts are back so the ranges are not freed while they shrink
+	WaitForReadbacks({GPUIndicesCountBufferReadback, GPUNumAllocatedVertsBufferReadback},
+		[Allocations, OverflowFlags, Chunks, VertexCapacity, IndexCapacity, GPUIndicesCountBufferReadback, GPUNumAllocatedVertsBufferReadback,
+		OverflowCallback = Results->OverflowCallback, CallbackThread = Results->CallbackThread]()
+	{
+		uint32* IndicesCountData = (uint32*)GPUIndicesCountBufferReadback->Lock(sizeof(uint32) * Allocations.Num());
+		uint32* NumAllocatedVertsData = (uint32*)GPUNumAllocatedVertsBufferReadback->Lock(sizeof(uint32) * Allocations.Num());
+		
+		TArray<int> OverflowIndices;
+		for (int BatchIndex = 0; BatchIndex < Allocations.Num(); BatchIndex++)
+		{
+			int NumVertices = NumAllocatedVertsData[BatchIndex];
+			int NumIndices = IndicesCountData[BatchIndex];
+			
+			//Overflowing chunks draw nothing, their ranges are shrunk as if they were empty and their outputs flagged so no one keeps them
+			if (NumVertices > VertexCapacity || NumIndices > IndexCapacity)
+			{
+				*OverflowFlags[BatchIndex] = true;
+				OverflowIndices.Add(Chunks[BatchIndex]);
+				NumVertices = 0;
+				NumIndices = 0;
+			}
+			
+			//The allocation is already handed out, the shrunk size is only kept by the page
+			const FSChunkBufferAllocation& Allocation = *Allocations[BatchIndex];
+			Allocation.Page->Shrink(Allocation.VertexOffset, NumVertices, Allocation.IndexOffset, NumIndices);
+		}
+		
+		GPUIndicesCountBufferReadback->Unlock();
+		GPUNumAllocatedVertsBufferReadback->Unlock();
+		delete GPUIndicesCountBufferReadback;
+		delete GPUNumAllocatedVertsBufferReadback;
 
-				FMarchingCSInterface::DispatchRenderThread(GetImmediateCommandList_ForRenderCommand(), MarchingCSDispatchParams,
-			[AsyncCallback, MCAllocVertsCSOutput, MCCountVertsCSOutput](FMarchingCSOutput MarchingCSOutput)
+		if (!OverflowIndices.IsEmpty())
+		{
+			INC_DWORD_STAT_BY(STAT_SVoxel_GPUDrivenOverflows, OverflowIndices.Num());
+			UE_LOG(LogTemp, Warning, TEXT("%d of %d GPU driven chunks did not fit in their pool ranges, raise GPUDrivenCapacity"),
+				OverflowIndices.Num(), Allocations.Num());
+			if (OverflowCallback)
+			{
+				AsyncTask(CallbackThread, [OverflowCallback, OverflowIndices = MoveTemp(OverflowIndices)]()
 				{
-					AsyncTask(ENamedThreads::GameThread, [AsyncCallback, MarchingCSOutput, MCAllocVertsCSOutput, MCCountVertsCSOutput]()
-					{
-						AsyncCallback(FSDispatchCSOutput(MarchingCSOutput.OutputVertices,
-							MarchingCSOutput.OutputTris,MarchingCSOutput.OutNormals, MarchingCSOutput.OutColor,
-							MCAllocVertsCSOutput.NumAllocatedVerts, MCCountVertsCSOutput.IndicesCount, MarchingCSOutput.Vertices, MarchingCSOutput.Indices));
-					});
+					OverflowCallback(OverflowIndices);
 				});
-				
-			});
-		});
+			}
+		}
+	});
+}
+
+void FSDispatchCSInterface::DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FSDispatchCSParams Params,
+	TFunction<void(FSDispatchCSOutput Output)> AsyncCallback)
+{
+	DispatchBatchRenderThread(RHICmdList, {Params}, [AsyncCallback](TArray<FSDispatchCSOutput> Outputs)
+	{
+		AsyncCallback(Outputs[0]);
+	});
+}
+
+void FSDispatchCSInterface::DispatchBatchRenderThread(FRHICommandListImmediate& RHICmdList, TArray<FSDispatchCSParams> Params,
+	TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback, ENamedThreads::Type CallbackThread, FSDispatchOverflowCallback OverflowCallback)
+{
+	TSharedRef<FSDispatchCSBatchResults> Results = MakeShared<FSDispatchCSBatchResults>();
+	Results->Outputs.SetNum(Params.Num());
+	Results->Params = MoveTemp(Params);
+	Results->AsyncCallback = AsyncCallback;
+	Results->CallbackThread = CallbackThread;
+	Results->OverflowCallback = MoveTemp(OverflowCallback);
+	Results->StartTime = FPlatformTime::Seconds();
+	Results->StartFrame = GFrameCounterRenderThread;
+
+	TArray<TArray<int>> Batches;
+	FSDispatchCSBatching::BuildBatches(Results->Params, MaxBatchSize, Batches);
+	
+	Results->NumPendingBatches = Batches.Num();
+	if (Batches.IsEmpty())
+	{
+		Results->NumPendingBatches = 1;
+		FinishBatch(Results);
+		return;
+	}
+	
+	for (const TArray<int>& Batch : Batches)
+	{
+		//Deterministic chunks need their content hashes back, they always take the counted path
+		const FSDispatchCSParams& BatchParams = Results->Params[Batch[0]];
+		if (BatchParams.bGPUDriven && !BatchParams.bDeterministic)
+		{
+			GenerateBatchGPUDriven(RHICmdList, Results, Batch);
+		}
+		else
+		{
+			GenerateBatch(RHICmdList, Results, Batch);
+		}
+	}
+}
+
+// Copies one array into a range of a pool buffer
+template<typename T>
+static void AddUploadRangePass(FRDGBuilder& GraphBuilder, const TRefCountPtr<FRDGPooledBuffer>& PoolBuffer, int Offset, const TArray<T>& Data,
+	ERHIAccess AccessFinal)
+{
+	FRDGBufferRef Buffer = GraphBuilder.RegisterExternalBuffer(PoolBuffer);
+	GraphBuilder.SetBufferAccessFinal(Buffer, AccessFinal);
+	
+	//The meshes outlive the graph, no copy of the data is needed
+	FRDGBufferRef UploadBuffer = CreateStructuredBuffer(GraphBuilder, TEXT("ChunkUploadBuffer"), sizeof(T), Data.Num(), Data.GetData(),
+		Data.Num() * sizeof(T), ERDGInitialDataFlags::NoCopy);
+	AddCopyBufferPass(GraphBuilder, Buffer, Offset * sizeof(T), UploadBuffer, 0, Data.Num() * sizeof(T));
+}
+
+void FSDispatchCSInterface::UploadBatchRenderThread(FRHICommandListImmediate& RHICmdList, TArray<FSChunkMeshData> Meshes,
+	TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback, ENamedThreads::Type CallbackThread)
+{
+	TArray<FSDispatchCSOutput> Outputs;
+	Outputs.SetNum(Meshes.Num());
+	
+	FRDGBuilder GraphBuilder(RHICmdList);
+	int64 UploadedBytes = 0;
+	for (int ChunkIndex = 0; ChunkIndex < Meshes.Num(); ChunkIndex++)
+	{
+		FSChunkMeshData& Mesh = Meshes[ChunkIndex];
+		if (Mesh.Vertices.IsEmpty() || Mesh.Indices.IsEmpty())
+			continue;
+		check(Mesh.Normals.Num() == Mesh.Vertices.Num() && Mesh.Colors.Num() == Mesh.Vertices.Num());
+
+		FSDispatchCSOutput& Output = Outputs[ChunkIndex];
+		FSChunkBufferAllocationRef Allocation = FSChunkBufferPool::Get().Allocate(Mesh.Vertices.Num(), Mesh.Indices.Num());
+		FillOutput(Output, Allocation);
+		Output.ContentHash = Mesh.ContentHash != 0 ? Mesh.ContentHash
+			: FSDispatchCSOutput::GetContentHash(Mesh.Vertices, Mesh.Normals, Mesh.Colors, Mesh.Indices);
+		if (Mesh.bCollision)
+		{
+			FSDispatchCSBatching::SliceCollision(Mesh.Vertices, Mesh.Indices, 0, Output.Vertices, Output.Indices);
+		}
+
+		//Indices in the pool include the offset of the chunk
+		for (uint32& Index : Mesh.Indices)
+		{
+			Index += Allocation->VertexOffset;
+		}
 		
+		const FSChunkBufferPage& Page = *Allocation->Page;
+		AddUploadRangePass(GraphBuilder, Page.Vertices, Allocation->VertexOffset, Mesh.Vertices, ERHIAccess::SRVMask);
+		AddUploadRangePass(GraphBuilder, Page.Normals, Allocation->VertexOffset, Mesh.Normals, ERHIAccess::SRVMask);
+		AddUploadRangePass(GraphBuilder, Page.Colors, Allocation->VertexOffset, Mesh.Colors, ERHIAccess::SRVMask);
+		AddUploadRangePass(GraphBuilder, Page.Indices, Allocation->IndexOffset, Mesh.Indices, ERHIAccess::VertexOrIndexBuffer | ERHIAccess::SRVMask);
+		UploadedBytes += Mesh.Vertices.Num() * (sizeof(FVector3f) * 2 + sizeof(FVector4f)) + Mesh.Indices.Num() * sizeof(uint32);
+	}
+	GraphBuilder.Execute();
+	
+	INC_DWORD_STAT_BY(STAT_SVoxel_UploadedBytes, UploadedBytes);
+	
+	AsyncTask(CallbackThread, [Outputs = MoveTemp(Outputs), AsyncCallback]() mutable
+	{
+		AsyncCallback(MoveTemp(Outputs));
 	});
-}
\ No newline at end of file
+}
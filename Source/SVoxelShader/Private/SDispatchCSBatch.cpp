@@ -0,0 +1,177 @@
+﻿#include "SDispatchCSBatch.h"
+#include "HAL/IConsoleManager.h"
+#include "SCheckSuite.h"
+
+bool FSDispatchCSBatching::CanBatch(const FSDispatchCSParams& A, const FSDispatchCSParams& B)
+{
+	return A.WorldSize == B.WorldSize &&
+		A.Size == B.Size &&
+		A.isolevel == B.isolevel &&
+		A.Scale == B.Scale &&
+		A.seed == B.seed &&
+		A.bGPUDriven == B.bGPUDriven &&
+		A.bDeterministic == B.bDeterministic;
+}
+
+void FSDispatchCSBatching::BuildBatches(const TArray<FSDispatchCSParams>& Params, int MaxBatchSize, TArray<TArray<int>>& OutBatches)
+{
+	MaxBatchSize = FMath::Max(MaxBatchSize, 1);
+	
+	//Batches that still have room, a chunk joins the first compatible one so the dispatch order is kept
+	TArray<int> OpenBatches;
+	for(int ChunkIndex = 0; ChunkIndex < Params.Num(); ChunkIndex++)
+	{
+		int OpenIndex = OpenBatches.IndexOfByPredicate([&](int BatchIndex)
+		{
+			return CanBatch(Params[OutBatches[BatchIndex][0]], Params[ChunkIndex]);
+		});
+		
+		if(OpenIndex == INDEX_NONE)
+		{
+			OpenIndex = OpenBatches.Add(OutBatches.AddDefaulted());
+		}
+
+		TArray<int>& Batch = OutBatches[OpenBatches[OpenIndex]];
+		Batch.Add(ChunkIndex);
+		if(Batch.Num() >= MaxBatchSize)
+		{
+			OpenBatches.RemoveAt(OpenIndex);
+		}
+	}
+}
+
+void FSDispatchCSBatching::BuildSlices(TConstArrayView<uint32> VertexCounts, TConstArrayView<uint32> IndexCounts,
+	TArray<FSDispatchCSSlice>& OutSlices, int& OutNumVertices, int& OutNumIndices)
+{
+	check(VertexCounts.Num() == IndexCounts.Num());
+	
+	OutNumVertices = 0;
+	OutNumIndices = 0;
+	for(int BatchIndex = 0; BatchIndex < VertexCounts.Num(); BatchIndex++)
+	{
+		if(VertexCounts[BatchIndex] == 0 || IndexCounts[BatchIndex] == 0)
+			continue;
+
+		FSDispatchCSSlice& Slice = OutSlices.AddDefaulted_GetRef();
+		Slice.BatchIndex = BatchIndex;
+		Slice.VertexOffset = OutNumVertices;
+		Slice.NumVertices = VertexCounts[BatchIndex];
+		Slice.IndexOffset = OutNumIndices;
+		Slice.NumIndices = IndexCounts[BatchIndex];
+
+		OutNumVertices += Slice.NumVertices;
+		OutNumIndices += Slice.NumIndices;
+	}
+}
+
+void FSDispatchCSBatching::GetGPUDrivenCapacity(int Size, int& OutNumVertices, int& OutNumIndices)
+{
+	int64 WorstVertices = 3 * int64(Size + 1) * (Size + 1) * (Size + 1);
+	int64 WorstIndices = 15 * int64(Size) * Size * Size;
+
+	//Never below one triangle so the ranges are valid
+	OutNumVertices = FMath::Max(3, int(WorstVertices * FSDispatchCSInterface::GPUDrivenCapacity));
+	OutNumIndices = FMath::Max(3, int(WorstIndices * FSDispatchCSInterface::GPUDrivenCapacity));
+}
+
+void FSDispatchCSBatching::SliceCollision(TConstArrayView<FVector3f> ChunkVertices, TConstArrayView<uint32> ChunkIndices, uint32 FirstVertex,
+	TArray<FVector3f>& OutVertices, TArray<FTriIndices>& OutIndices)
+{
+	OutVertices = TArray<FVector3f>(ChunkVertices);
+
+	OutIndices.Reserve(ChunkIndices.Num() / 3);
+	for (int32 TriIdx = 0; TriIdx < ChunkIndices.Num()/3; TriIdx++)
+	{
+		//Indices point into the pool vertex buffer
+		FTriIndices Triangle;
+		Triangle.v0 = ChunkIndices[TriIdx * 3 + 0] - FirstVertex;
+		Triangle.v1 = ChunkIndices[TriIdx * 3 + 1] - FirstVertex;
+		Triangle.v2 = ChunkIndices[TriIdx * 3 + 2] - FirstVertex;
+		OutIndices.Add(Triangle);
+	}
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Checks the batching and slicing against hand computed layouts, runs without a GPU
+static void CheckDispatchBatching()
+{
+	FSCheckSuite Checks(TEXT("Dispatch batching"));
+
+	FSDispatchCSParams Params = FSDispatchCSParams(FIntVector3(1000), 32, 0.0f, FVector3f::ZeroVector, 0, 1, 1337);
+	FSDispatchCSParams OtherSeed = Params;
+	OtherSeed.seed = 7;
+	FSDispatchCSParams OtherLOD = Params;
+	OtherLOD.LOD = 2;
+	OtherLOD.Position = FVector3f(100.0f);
+
+	{
+		TArray<TArray<int>> Batches;
+		FSDispatchCSBatching::BuildBatches({Params, OtherSeed, OtherLOD, Params, OtherSeed}, 2, Batches);
+		Checks.Check(Batches.Num() == 3, TEXT("batch count with mixed seeds"));
+		Checks.Check(Batches.Num() == 3 && Batches[0] == TArray<int>({0, 2}), TEXT("first batch keeps order and mixes LODs"));
+		Checks.Check(Batches.Num() == 3 && Batches[1] == TArray<int>({1, 4}), TEXT("incompatible chunks get their own batch"));
+		Checks.Check(Batches.Num() == 3 && Batches[2] == TArray<int>({3}), TEXT("full batches are closed"));
+	}
+	{
+		FSDispatchCSParams GPUDriven = Params;
+		GPUDriven.bGPUDriven = true;
+		
+		TArray<TArray<int>> Batches;
+		FSDispatchCSBatching::BuildBatches({Params, GPUDriven, Params}, 4, Batches);
+		Checks.Check(Batches.Num() == 2 && Batches[0] == TArray<int>({0, 2}), TEXT("GPU driven chunks are not batched with counted ones"));
+
+		int NumVertices = 0;
+		int NumIndices = 0;
+		FSDispatchCSBatching::GetGPUDrivenCapacity(32, NumVertices, NumIndices);
+		Checks.Check(NumVertices == int(3 * 33 * 33 * 33 * FSDispatchCSInterface::GPUDrivenCapacity), TEXT("GPU driven vertex capacity"));
+		Checks.Check(NumIndices == int(15 * 32 * 32 * 32 * FSDispatchCSInterface::GPUDrivenCapacity), TEXT("GPU driven index capacity"));
+	}
+	{
+		FSDispatchCSParams Deterministic = Params;
+		Deterministic.bDeterministic = true;
+		
+		TArray<TArray<int>> Batches;
+		FSDispatchCSBatching::BuildBatches({Deterministic, Params, Deterministic}, 4, Batches);
+		Checks.Check(Batches.Num() == 2 && Batches[0] == TArray<int>({0, 2}), TEXT("deterministic chunks are not batched with the others"));
+	}
+	{
+		TArray<TArray<int>> Batches;
+		FSDispatchCSBatching::BuildBatches({}, 4, Batches);
+		Checks.Check(Batches.Num() == 0, TEXT("no chunks, no batches"));
+	}
+	{
+		TArray<FSDispatchCSSlice> Slices;
+		int NumVertices = 0;
+		int NumIndices = 0;
+		FSDispatchCSBatching::BuildSlices(TArray<uint32>({4, 0, 3, 5}), TArray<uint32>({6, 0, 3, 0}), Slices, NumVertices, NumIndices);
+		Checks.Check(Slices.Num() == 2, TEXT("empty chunks get no slice"));
+		Checks.Check(NumVertices == 7 && NumIndices == 9, TEXT("totals cover the slices only"));
+		Checks.Check(Slices.Num() == 2 && Slices[1].BatchIndex == 2 && Slices[1].VertexOffset == 4 && Slices[1].IndexOffset == 6,
+			TEXT("slices are packed back to back"));
+
+		TArray<FVector3f> BatchVertices;
+		for(int Vertex = 0; Vertex < NumVertices; Vertex++)
+		{
+			BatchVertices.Add(FVector3f(Vertex));
+		}
+		TArray<uint32> BatchIndices = {0, 1, 2, 1, 2, 3, 6, 5, 4};
+		
+		const FSDispatchCSSlice& Slice = Slices.Last();
+		TArray<FVector3f> Vertices;
+		TArray<FTriIndices> Indices;
+		FSDispatchCSBatching::SliceCollision(MakeArrayView(BatchVertices).Slice(Slice.VertexOffset, Slice.NumVertices),
+			MakeArrayView(BatchIndices).Slice(Slice.IndexOffset, Slice.NumIndices), Slice.VertexOffset, Vertices, Indices);
+		Checks.Check(Vertices.Num() == 3 && Vertices[0] == FVector3f(4.0f), TEXT("collision vertices come from the slice"));
+		Checks.Check(Indices.Num() == 1 && Indices[0].v0 == 2 && Indices[0].v1 == 1 && Indices[0].v2 == 0, TEXT("collision indices are rebased"));
+	}
+
+	Checks.Finish();
+}
+
+static FAutoConsoleCommand CheckDispatchBatchingCommand(
+	TEXT("SVoxel.CheckDispatchBatching"),
+	TEXT("Runs the CPU checks of the batched dispatch layout"),
+	FConsoleCommandDelegate::CreateStatic(&CheckDispatchBatching));
+
+#endif
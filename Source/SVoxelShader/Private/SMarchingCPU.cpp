@@ -0,0 +1,994 @@
+﻿#include "SMarchingCPU.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "NoiseCS.h"
+#include "MCCountVertsCS.h"
+#include "MCAllocVertsCS.h"
+#include "MCScanCellsCS.h"
+#include "MarchingCS.h"
+#include "SDensityCPU.h"
+#include "SDispatchCSBatch.h"
+
+//casetonumpolys of MarchTables.ush
+static const uint8 CaseToNumPolys[256] =
+{
+	0, 1, 1, 2, 1, 2, 2, 3,  1, 2, 2, 3, 2, 3, 3, 2,  1, 2, 2, 3, 2, 3, 3, 4,  2, 3, 3, 4, 3, 4, 4, 3,
+	1, 2, 2, 3, 2, 3, 3, 4,  2, 3, 3, 4, 3, 4, 4, 3,  2, 3, 3, 2, 3, 4, 4, 3,  3, 4, 4, 3, 4, 5, 5, 2,
+	1, 2, 2, 3, 2, 3, 3, 4,  2, 3, 3, 4, 3, 4, 4, 3,  2, 3, 3, 4, 3, 4, 4, 5,  3, 4, 4, 5, 4, 5, 5, 4,
+	2, 3, 3, 4, 3, 4, 2, 3,  3, 4, 4, 5, 4, 5, 3, 2,  3, 4, 4, 3, 4, 5, 3, 2,  4, 5, 5, 4, 5, 2, 4, 1,
+	1, 2, 2, 3, 2, 3, 3, 4,  2, 3, 3, 4, 3, 4, 4, 3,  2, 3, 3, 4, 3, 4, 4, 5,  3, 2, 4, 3, 4, 3, 5, 2,
+	2, 3, 3, 4, 3, 4, 4, 5,  3, 4, 4, 5, 4, 5, 5, 4,  3, 4, 4, 3, 4, 5, 5, 4,  4, 3, 5, 2, 5, 4, 2, 1,
+	2, 3, 3, 4, 3, 4, 4, 5,  3, 4, 4, 5, 2, 3, 3, 2,  3, 4, 4, 5, 4, 5, 5, 2,  4, 3, 5, 4, 3, 2, 4, 1,
+	3, 4, 4, 5, 4, 5, 3, 4,  4, 5, 5, 2, 3, 4, 2, 1,  2, 3, 3, 2, 3, 4, 2, 1,  3, 2, 4, 1, 2, 1, 1, 0,
+};
+
+//TriTable of MarchTables.ush, the edges of every triangle of a case
+static const int8 TriTable[256][16] =
+{
+	{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 8, 3, 9, 8, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 3, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 2, 10, 0, 2, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{2, 8, 3, 2, 10, 8, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+	{3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 11, 2, 8, 11, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 9, 0, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 11, 2, 1, 9, 11, 9, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+	{3, 10, 1, 11, 10, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 10, 1, 0, 8, 10, 8, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+	{3, 9, 0, 3, 11, 9, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+	{9, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 3, 0, 7, 3, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 1, 9, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 1, 9, 4, 7, 1, 7, 3, 1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 10, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{3, 4, 7, 3, 0, 4, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1},
+	{9, 2, 10, 9, 0, 2, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1},
+	{2, 10, 9, 2, 9, 7, 2, 7, 3, 7, 9, 4, -1, -1, -1, -1},
+	{8, 4, 7, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{11, 4, 7, 11, 2, 4, 2, 0, 4, -1, -1, -1, -1, -1, -1, -1},
+	{9, 0, 1, 8, 4, 7, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1},
+	{4, 7, 11, 9, 4, 11, 9, 11, 2, 9, 2, 1, -1, -1, -1, -1},
+	{3, 10, 1, 3, 11, 10, 7, 8, 4, -1, -1, -1, -1, -1, -1, -1},
+	{1, 11, 10, 1, 4, 11, 1, 0, 4, 7, 11, 4, -1, -1, -1, -1},
+	{4, 7, 8, 9, 0, 11, 9, 11, 10, 11, 0, 3, -1, -1, -1, -1},
+	{4, 7, 11, 4, 11, 9, 9, 11, 10, -1, -1, -1, -1, -1, -1, -1},
+	{9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 5, 4, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 5, 4, 1, 5, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{8, 5, 4, 8, 3, 5, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 10, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{3, 0, 8, 1, 2, 10, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1},
+	{5, 2, 10, 5, 4, 2, 4, 0, 2, -1, -1, -1, -1, -1, -1, -1},
+	{2, 10, 5, 3, 2, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1},
+	{9, 5, 4, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 11, 2, 0, 8, 11, 4, 9, 5, -1, -1, -1, -1, -1, -1, -1},
+	{0, 5, 4, 0, 1, 5, 2, 3, 11, -1, -1, -1, -1, -1, -1, -1},
+	{2, 1, 5, 2, 5, 8, 2, 8, 11, 4, 8, 5, -1, -1, -1, -1},
+	{10, 3, 11, 10, 1, 3, 9, 5, 4, -1, -1, -1, -1, -1, -1, -1},
+	{4, 9, 5, 0, 8, 1, 8, 10, 1, 8, 11, 10, -1, -1, -1, -1},
+	{5, 4, 0, 5, 0, 11, 5, 11, 10, 11, 0, 3, -1, -1, -1, -1},
+	{5, 4, 8, 5, 8, 10, 10, 8, 11, -1, -1, -1, -1, -1, -1, -1},
+	{9, 7, 8, 5, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 3, 0, 9, 5, 3, 5, 7, 3, -1, -1, -1, -1, -1, -1, -1},
+	{0, 7, 8, 0, 1, 7, 1, 5, 7, -1, -1, -1, -1, -1, -1, -1},
+	{1, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 7, 8, 9, 5, 7, 10, 1, 2, -1, -1, -1, -1, -1, -1, -1},
+	{10, 1, 2, 9, 5, 0, 5, 3, 0, 5, 7, 3, -1, -1, -1, -1},
+	{8, 0, 2, 8, 2, 5, 8, 5, 7, 10, 5, 2, -1, -1, -1, -1},
+	{2, 10, 5, 2, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1},
+	{7, 9, 5, 7, 8, 9, 3, 11, 2, -1, -1, -1, -1, -1, -1, -1},
+	{9, 5, 7, 9, 7, 2, 9, 2, 0, 2, 7, 11, -1, -1, -1, -1},
+	{2, 3, 11, 0, 1, 8, 1, 7, 8, 1, 5, 7, -1, -1, -1, -1},
+	{11, 2, 1, 11, 1, 7, 7, 1, 5, -1, -1, -1, -1, -1, -1, -1},
+	{9, 5, 8, 8, 5, 7, 10, 1, 3, 10, 3, 11, -1, -1, -1, -1},
+	{5, 7, 0, 5, 0, 9, 7, 11, 0, 1, 0, 10, 11, 10, 0, -1},
+	{11, 10, 0, 11, 0, 3, 10, 5, 0, 8, 0, 7, 5, 7, 0, -1},
+	{11, 10, 5, 7, 11, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 3, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 0, 1, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 8, 3, 1, 9, 8, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1},
+	{1, 6, 5, 2, 6, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 6, 5, 1, 2, 6, 3, 0, 8, -1, -1, -1, -1, -1, -1, -1},
+	{9, 6, 5, 9, 0, 6, 0, 2, 6, -1, -1, -1, -1, -1, -1, -1},
+	{5, 9, 8, 5, 8, 2, 5, 2, 6, 3, 2, 8, -1, -1, -1, -1},
+	{2, 3, 11, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{11, 0, 8, 11, 2, 0, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1},
+	{0, 1, 9, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1, -1, -1, -1},
+	{5, 10, 6, 1, 9, 2, 9, 11, 2, 9, 8, 11, -1, -1, -1, -1},
+	{6, 3, 11, 6, 5, 3, 5, 1, 3, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 11, 0, 11, 5, 0, 5, 1, 5, 11, 6, -1, -1, -1, -1},
+	{3, 11, 6, 0, 3, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1},
+	{6, 5, 9, 6, 9, 11, 11, 9, 8, -1, -1, -1, -1, -1, -1, -1},
+	{5, 10, 6, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 3, 0, 4, 7, 3, 6, 5, 10, -1, -1, -1, -1, -1, -1, -1},
+	{1, 9, 0, 5, 10, 6, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1},
+	{10, 6, 5, 1, 9, 7, 1, 7, 3, 7, 9, 4, -1, -1, -1, -1},
+	{6, 1, 2, 6, 5, 1, 4, 7, 8, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 5, 5, 2, 6, 3, 0, 4, 3, 4, 7, -1, -1, -1, -1},
+	{8, 4, 7, 9, 0, 5, 0, 6, 5, 0, 2, 6, -1, -1, -1, -1},
+	{7, 3, 9, 7, 9, 4, 3, 2, 9, 5, 9, 6, 2, 6, 9, -1},
+	{3, 11, 2, 7, 8, 4, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1},
+	{5, 10, 6, 4, 7, 2, 4, 2, 0, 2, 7, 11, -1, -1, -1, -1},
+	{0, 1, 9, 4, 7, 8, 2, 3, 11, 5, 10, 6, -1, -1, -1, -1},
+	{9, 2, 1, 9, 11, 2, 9, 4, 11, 7, 11, 4, 5, 10, 6, -1},
+	{8, 4, 7, 3, 11, 5, 3, 5, 1, 5, 11, 6, -1, -1, -1, -1},
+	{5, 1, 11, 5, 11, 6, 1, 0, 11, 7, 11, 4, 0, 4, 11, -1},
+	{0, 5, 9, 0, 6, 5, 0, 3, 6, 11, 6, 3, 8, 4, 7, -1},
+	{6, 5, 9, 6, 9, 11, 4, 7, 9, 7, 11, 9, -1, -1, -1, -1},
+	{10, 4, 9, 6, 4, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 10, 6, 4, 9, 10, 0, 8, 3, -1, -1, -1, -1, -1, -1, -1},
+	{10, 0, 1, 10, 6, 0, 6, 4, 0, -1, -1, -1, -1, -1, -1, -1},
+	{8, 3, 1, 8, 1, 6, 8, 6, 4, 6, 1, 10, -1, -1, -1, -1},
+	{1, 4, 9, 1, 2, 4, 2, 6, 4, -1, -1, -1, -1, -1, -1, -1},
+	{3, 0, 8, 1, 2, 9, 2, 4, 9, 2, 6, 4, -1, -1, -1, -1},
+	{0, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{8, 3, 2, 8, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1},
+	{10, 4, 9, 10, 6, 4, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 2, 2, 8, 11, 4, 9, 10, 4, 10, 6, -1, -1, -1, -1},
+	{3, 11, 2, 0, 1, 6, 0, 6, 4, 6, 1, 10, -1, -1, -1, -1},
+	{6, 4, 1, 6, 1, 10, 4, 8, 1, 2, 1, 11, 8, 11, 1, -1},
+	{9, 6, 4, 9, 3, 6, 9, 1, 3, 11, 6, 3, -1, -1, -1, -1},
+	{8, 11, 1, 8, 1, 0, 11, 6, 1, 9, 1, 4, 6, 4, 1, -1},
+	{3, 11, 6, 3, 6, 0, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1},
+	{6, 4, 8, 11, 6, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{7, 10, 6, 7, 8, 10, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1},
+	{0, 7, 3, 0, 10, 7, 0, 9, 10, 6, 7, 10, -1, -1, -1, -1},
+	{10, 6, 7, 1, 10, 7, 1, 7, 8, 1, 8, 0, -1, -1, -1, -1},
+	{10, 6, 7, 10, 7, 1, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 6, 1, 6, 8, 1, 8, 9, 8, 6, 7, -1, -1, -1, -1},
+	{2, 6, 9, 2, 9, 1, 6, 7, 9, 0, 9, 3, 7, 3, 9, -1},
+	{7, 8, 0, 7, 0, 6, 6, 0, 2, -1, -1, -1, -1, -1, -1, -1},
+	{7, 3, 2, 6, 7, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{2, 3, 11, 10, 6, 8, 10, 8, 9, 8, 6, 7, -1, -1, -1, -1},
+	{2, 0, 7, 2, 7, 11, 0, 9, 7, 6, 7, 10, 9, 10, 7, -1},
+	{1, 8, 0, 1, 7, 8, 1, 10, 7, 6, 7, 10, 2, 3, 11, -1},
+	{11, 2, 1, 11, 1, 7, 10, 6, 1, 6, 7, 1, -1, -1, -1, -1},
+	{8, 9, 6, 8, 6, 7, 9, 1, 6, 11, 6, 3, 1, 3, 6, -1},
+	{0, 9, 1, 11, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{7, 8, 0, 7, 0, 6, 3, 11, 0, 11, 6, 0, -1, -1, -1, -1},
+	{7, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{3, 0, 8, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 1, 9, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{8, 1, 9, 8, 3, 1, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1},
+	{10, 1, 2, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 10, 3, 0, 8, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1},
+	{2, 9, 0, 2, 10, 9, 6, 11, 7, -1, -1, -1, -1, -1, -1, -1},
+	{6, 11, 7, 2, 10, 3, 10, 8, 3, 10, 9, 8, -1, -1, -1, -1},
+	{7, 2, 3, 6, 2, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{7, 0, 8, 7, 6, 0, 6, 2, 0, -1, -1, -1, -1, -1, -1, -1},
+	{2, 7, 6, 2, 3, 7, 0, 1, 9, -1, -1, -1, -1, -1, -1, -1},
+	{1, 6, 2, 1, 8, 6, 1, 9, 8, 8, 7, 6, -1, -1, -1, -1},
+	{10, 7, 6, 10, 1, 7, 1, 3, 7, -1, -1, -1, -1, -1, -1, -1},
+	{10, 7, 6, 1, 7, 10, 1, 8, 7, 1, 0, 8, -1, -1, -1, -1},
+	{0, 3, 7, 0, 7, 10, 0, 10, 9, 6, 10, 7, -1, -1, -1, -1},
+	{7, 6, 10, 7, 10, 8, 8, 10, 9, -1, -1, -1, -1, -1, -1, -1},
+	{6, 8, 4, 11, 8, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{3, 6, 11, 3, 0, 6, 0, 4, 6, -1, -1, -1, -1, -1, -1, -1},
+	{8, 6, 11, 8, 4, 6, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 4, 6, 9, 6, 3, 9, 3, 1, 11, 3, 6, -1, -1, -1, -1},
+	{6, 8, 4, 6, 11, 8, 2, 10, 1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 10, 3, 0, 11, 0, 6, 11, 0, 4, 6, -1, -1, -1, -1},
+	{4, 11, 8, 4, 6, 11, 0, 2, 9, 2, 10, 9, -1, -1, -1, -1},
+	{10, 9, 3, 10, 3, 2, 9, 4, 3, 11, 3, 6, 4, 6, 3, -1},
+	{8, 2, 3, 8, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1},
+	{0, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 9, 0, 2, 3, 4, 2, 4, 6, 4, 3, 8, -1, -1, -1, -1},
+	{1, 9, 4, 1, 4, 2, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1},
+	{8, 1, 3, 8, 6, 1, 8, 4, 6, 6, 10, 1, -1, -1, -1, -1},
+	{10, 1, 0, 10, 0, 6, 6, 0, 4, -1, -1, -1, -1, -1, -1, -1},
+	{4, 6, 3, 4, 3, 8, 6, 10, 3, 0, 3, 9, 10, 9, 3, -1},
+	{10, 9, 4, 6, 10, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 9, 5, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 3, 4, 9, 5, 11, 7, 6, -1, -1, -1, -1, -1, -1, -1},
+	{5, 0, 1, 5, 4, 0, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1},
+	{11, 7, 6, 8, 3, 4, 3, 5, 4, 3, 1, 5, -1, -1, -1, -1},
+	{9, 5, 4, 10, 1, 2, 7, 6, 11, -1, -1, -1, -1, -1, -1, -1},
+	{6, 11, 7, 1, 2, 10, 0, 8, 3, 4, 9, 5, -1, -1, -1, -1},
+	{7, 6, 11, 5, 4, 10, 4, 2, 10, 4, 0, 2, -1, -1, -1, -1},
+	{3, 4, 8, 3, 5, 4, 3, 2, 5, 10, 5, 2, 11, 7, 6, -1},
+	{7, 2, 3, 7, 6, 2, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1},
+	{9, 5, 4, 0, 8, 6, 0, 6, 2, 6, 8, 7, -1, -1, -1, -1},
+	{3, 6, 2, 3, 7, 6, 1, 5, 0, 5, 4, 0, -1, -1, -1, -1},
+	{6, 2, 8, 6, 8, 7, 2, 1, 8, 4, 8, 5, 1, 5, 8, -1},
+	{9, 5, 4, 10, 1, 6, 1, 7, 6, 1, 3, 7, -1, -1, -1, -1},
+	{1, 6, 10, 1, 7, 6, 1, 0, 7, 8, 7, 0, 9, 5, 4, -1},
+	{4, 0, 10, 4, 10, 5, 0, 3, 10, 6, 10, 7, 3, 7, 10, -1},
+	{7, 6, 10, 7, 10, 8, 5, 4, 10, 4, 8, 10, -1, -1, -1, -1},
+	{6, 9, 5, 6, 11, 9, 11, 8, 9, -1, -1, -1, -1, -1, -1, -1},
+	{3, 6, 11, 0, 6, 3, 0, 5, 6, 0, 9, 5, -1, -1, -1, -1},
+	{0, 11, 8, 0, 5, 11, 0, 1, 5, 5, 6, 11, -1, -1, -1, -1},
+	{6, 11, 3, 6, 3, 5, 5, 3, 1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 10, 9, 5, 11, 9, 11, 8, 11, 5, 6, -1, -1, -1, -1},
+	{0, 11, 3, 0, 6, 11, 0, 9, 6, 5, 6, 9, 1, 2, 10, -1},
+	{11, 8, 5, 11, 5, 6, 8, 0, 5, 10, 5, 2, 0, 2, 5, -1},
+	{6, 11, 3, 6, 3, 5, 2, 10, 3, 10, 5, 3, -1, -1, -1, -1},
+	{5, 8, 9, 5, 2, 8, 5, 6, 2, 3, 8, 2, -1, -1, -1, -1},
+	{9, 5, 6, 9, 6, 0, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1},
+	{1, 5, 8, 1, 8, 0, 5, 6, 8, 3, 8, 2, 6, 2, 8, -1},
+	{1, 5, 6, 2, 1, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 3, 6, 1, 6, 10, 3, 8, 6, 5, 6, 9, 8, 9, 6, -1},
+	{10, 1, 0, 10, 0, 6, 9, 5, 0, 5, 6, 0, -1, -1, -1, -1},
+	{0, 3, 8, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{10, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{11, 5, 10, 7, 5, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{11, 5, 10, 11, 7, 5, 8, 3, 0, -1, -1, -1, -1, -1, -1, -1},
+	{5, 11, 7, 5, 10, 11, 1, 9, 0, -1, -1, -1, -1, -1, -1, -1},
+	{10, 7, 5, 10, 11, 7, 9, 8, 1, 8, 3, 1, -1, -1, -1, -1},
+	{11, 1, 2, 11, 7, 1, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 3, 1, 2, 7, 1, 7, 5, 7, 2, 11, -1, -1, -1, -1},
+	{9, 7, 5, 9, 2, 7, 9, 0, 2, 2, 11, 7, -1, -1, -1, -1},
+	{7, 5, 2, 7, 2, 11, 5, 9, 2, 3, 2, 8, 9, 8, 2, -1},
+	{2, 5, 10, 2, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1},
+	{8, 2, 0, 8, 5, 2, 8, 7, 5, 10, 2, 5, -1, -1, -1, -1},
+	{9, 0, 1, 5, 10, 3, 5, 3, 7, 3, 10, 2, -1, -1, -1, -1},
+	{9, 8, 2, 9, 2, 1, 8, 7, 2, 10, 2, 5, 7, 5, 2, -1},
+	{1, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 7, 0, 7, 1, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1},
+	{9, 0, 3, 9, 3, 5, 5, 3, 7, -1, -1, -1, -1, -1, -1, -1},
+	{9, 8, 7, 5, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{5, 8, 4, 5, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1},
+	{5, 0, 4, 5, 11, 0, 5, 10, 11, 11, 3, 0, -1, -1, -1, -1},
+	{0, 1, 9, 8, 4, 10, 8, 10, 11, 10, 4, 5, -1, -1, -1, -1},
+	{10, 11, 4, 10, 4, 5, 11, 3, 4, 9, 4, 1, 3, 1, 4, -1},
+	{2, 5, 1, 2, 8, 5, 2, 11, 8, 4, 5, 8, -1, -1, -1, -1},
+	{0, 4, 11, 0, 11, 3, 4, 5, 11, 2, 11, 1, 5, 1, 11, -1},
+	{0, 2, 5, 0, 5, 9, 2, 11, 5, 4, 5, 8, 11, 8, 5, -1},
+	{9, 4, 5, 2, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{2, 5, 10, 3, 5, 2, 3, 4, 5, 3, 8, 4, -1, -1, -1, -1},
+	{5, 10, 2, 5, 2, 4, 4, 2, 0, -1, -1, -1, -1, -1, -1, -1},
+	{3, 10, 2, 3, 5, 10, 3, 8, 5, 4, 5, 8, 0, 1, 9, -1},
+	{5, 10, 2, 5, 2, 4, 1, 9, 2, 9, 4, 2, -1, -1, -1, -1},
+	{8, 4, 5, 8, 5, 3, 3, 5, 1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 4, 5, 1, 0, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{8, 4, 5, 8, 5, 3, 9, 0, 5, 0, 3, 5, -1, -1, -1, -1},
+	{9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 11, 7, 4, 9, 11, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1},
+	{0, 8, 3, 4, 9, 7, 9, 11, 7, 9, 10, 11, -1, -1, -1, -1},
+	{1, 10, 11, 1, 11, 4, 1, 4, 0, 7, 4, 11, -1, -1, -1, -1},
+	{3, 1, 4, 3, 4, 8, 1, 10, 4, 7, 4, 11, 10, 11, 4, -1},
+	{4, 11, 7, 9, 11, 4, 9, 2, 11, 9, 1, 2, -1, -1, -1, -1},
+	{9, 7, 4, 9, 11, 7, 9, 1, 11, 2, 11, 1, 0, 8, 3, -1},
+	{11, 7, 4, 11, 4, 2, 2, 4, 0, -1, -1, -1, -1, -1, -1, -1},
+	{11, 7, 4, 11, 4, 2, 8, 3, 4, 3, 2, 4, -1, -1, -1, -1},
+	{2, 9, 10, 2, 7, 9, 2, 3, 7, 7, 4, 9, -1, -1, -1, -1},
+	{9, 10, 7, 9, 7, 4, 10, 2, 7, 8, 7, 0, 2, 0, 7, -1},
+	{3, 7, 10, 3, 10, 2, 7, 4, 10, 1, 10, 0, 4, 0, 10, -1},
+	{1, 10, 2, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 9, 1, 4, 1, 7, 7, 1, 3, -1, -1, -1, -1, -1, -1, -1},
+	{4, 9, 1, 4, 1, 7, 0, 8, 1, 8, 7, 1, -1, -1, -1, -1},
+	{4, 0, 3, 7, 4, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{9, 10, 8, 10, 11, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{3, 0, 9, 3, 9, 11, 11, 9, 10, -1, -1, -1, -1, -1, -1, -1},
+	{0, 1, 10, 0, 10, 8, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1},
+	{3, 1, 10, 11, 3, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 2, 11, 1, 11, 9, 9, 11, 8, -1, -1, -1, -1, -1, -1, -1},
+	{3, 0, 9, 3, 9, 11, 1, 2, 9, 2, 11, 9, -1, -1, -1, -1},
+	{0, 2, 11, 8, 0, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{2, 3, 8, 2, 8, 10, 10, 8, 9, -1, -1, -1, -1, -1, -1, -1},
+	{9, 10, 2, 0, 9, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{2, 3, 8, 2, 8, 10, 0, 1, 8, 1, 10, 8, -1, -1, -1, -1},
+	{1, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{1, 3, 8, 9, 1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+	{-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+};
+
+//mask[] of MCCountVertsCS.usf, the flag an edge sets on the cell that owns its vertex
+static const uint32 EdgeMasks[12] =
+{
+	0x40000000, 0x20000000, 0x40000000, 0x20000000, 0x40000000, 0x20000000,
+	0x40000000, 0x20000000, 0x10000000, 0x10000000, 0x10000000, 0x10000000
+};
+
+//Step from a cell to the cell that owns the vertex of an edge, VertexIDToVoxelAddr
+static const FIntVector EdgeOwnerSteps[12] =
+{
+	FIntVector(0, 0, 0), FIntVector(0, 1, 0), FIntVector(1, 0, 0), FIntVector(0, 0, 0),
+	FIntVector(0, 0, 1), FIntVector(0, 1, 1), FIntVector(1, 0, 1), FIntVector(0, 0, 1),
+	FIntVector(0, 0, 0), FIntVector(0, 1, 0), FIntVector(1, 1, 0), FIntVector(1, 0, 0)
+};
+
+//Cube corners in nvidia's coordinate system, like the cube and cubepos arrays of the shaders
+static const FIntVector CornerOffsets[8] =
+{
+	FIntVector(0, 0, 0), FIntVector(0, 1, 0), FIntVector(1, 1, 0), FIntVector(1, 0, 0),
+	FIntVector(0, 0, 1), FIntVector(0, 1, 1), FIntVector(1, 1, 1), FIntVector(1, 0, 1)
+};
+
+static constexpr uint32 CellFlagsMask = 0x70000000;
+static constexpr uint32 CellIndexMask = 0xFFFFFF;
+
+// Vertices of a cell in the order they are emitted, the flag and the corners of the edge
+struct FSOwnedEdge
+{
+	uint32 Flag;
+	int32 Corner;
+};
+static const FSOwnedEdge OwnedEdges[3] =
+{
+	{0x40000000, 1}, //Edge 0
+	{0x20000000, 3}, //Edge 3
+	{0x10000000, 4}  //Edge 8
+};
+
+// Voxels and cells of one chunk with the index math of the shaders
+struct FSMarchingGrid
+{
+	int32 Size;
+	float Isolevel;
+	TConstArrayView<float> Voxels;
+
+	int32 GetVoxelIndex(int32 X, int32 Y, int32 Z) const
+	{
+		return Z * (Size + 4) * (Size + 4) + Y * (Size + 4) + X;
+	}
+
+	//Normals of the vertices cells at Size own sample one past the margin, that wraps into the next row or reads past the
+	//buffer, which gives 0 on the GPU
+	float GetVoxel(const FIntVector& Voxel) const
+	{
+		int32 Index = GetVoxelIndex(Voxel.X, Voxel.Y, Voxel.Z);
+		return Index < Voxels.Num() ? Voxels[Index] : 0.0f;
+	}
+
+	int32 GetNumCells() const
+	{
+		return (Size + 1) * (Size + 1) * (Size + 1);
+	}
+
+	//Unlike the cell, the address may fall outside the chunk, the shader drops those writes
+	int64 GetCellAddr(const FIntVector& Cell) const
+	{
+		return Cell.X + int64(Cell.Y) * (Size + 1) + int64(Cell.Z) * (Size + 1) * (Size + 1);
+	}
+
+	uint32 GetCode(const FIntVector& Cell) const
+	{
+		uint32 Code = 0;
+		for (int32 Corner = 7; Corner >= 0; Corner--)
+		{
+			Code = (Code << 1) | (GetVoxel(Cell + CornerOffsets[Corner] + FIntVector(2)) >= Isolevel ? 1 : 0);
+		}
+		return Code;
+	}
+
+	//GetVoxelNormal, Voxel is already inside the margin
+	FVector3f GetVoxelNormal(const FIntVector& Voxel) const
+	{
+		FVector3f Normal = FVector3f(
+			GetVoxel(Voxel + FIntVector(1, 0, 0)) - GetVoxel(Voxel - FIntVector(1, 0, 0)),
+			GetVoxel(Voxel + FIntVector(0, 1, 0)) - GetVoxel(Voxel - FIntVector(0, 1, 0)),
+			GetVoxel(Voxel + FIntVector(0, 0, 1)) - GetVoxel(Voxel - FIntVector(0, 0, 1)));
+		return Normalize(Normal);
+	}
+
+	//normalize of HLSL, a zero vector is not guarded against either
+	static FVector3f Normalize(const FVector3f& Vector)
+	{
+		return Vector * (1.0f / FMath::Sqrt(Vector.SizeSquared()));
+	}
+
+	//VertexInterp and NormalInterp
+	FVector3f Interp(const FVector3f& P1, const FVector3f& P2, float ValP1, float ValP2) const
+	{
+		float Delta = (Isolevel - ValP1) / (ValP2 - ValP1);
+		if (FMath::Abs(Isolevel - ValP1) < 0.00001f)
+			return P1;
+		if (FMath::Abs(Isolevel - ValP2) < 0.00001f)
+			return P2;
+		if (FMath::Abs(ValP1 - ValP2) < 0.00001f)
+			return P1;
+
+		return FVector3f(P1.X + Delta * (P2.X - P1.X), P1.Y + Delta * (P2.Y - P1.Y), P1.Z + Delta * (P2.Z - P1.Z));
+	}
+};
+
+// VertexToIndex, the index of the vertex of an edge relative to the first vertex of the chunk
+static uint32 VertexToIndex(uint32 CellMask, int32 Edge)
+{
+	uint32 Flag = EdgeMasks[Edge];
+	uint32 RelativeID = 0;
+	for (const FSOwnedEdge& OwnedEdge : OwnedEdges)
+	{
+		if (OwnedEdge.Flag == Flag)
+			break;
+		RelativeID += (CellMask & OwnedEdge.Flag) ? 1 : 0;
+	}
+	return (CellMask & CellIndexMask) + RelativeID;
+}
+
+void FSMarchingCPU::March(const FSDispatchCSParams& Params, TConstArrayView<float> Voxels, FSMarchingCPUOutput& Output, bool bAttributes)
+{
+	const int32 Size = Params.Size;
+	const FSMarchingGrid Grid = {Size, Params.isolevel, Voxels};
+	const int32 NumCells = Grid.GetNumCells();
+	const int32 NumSlices = Size + 1;
+	check(Voxels.Num() == (Size + 4) * (Size + 4) * (Size + 4));
+
+	//Every pass runs over slices of constant z in parallel, like the thread groups of the shaders
+	TArray<uint8> Codes;
+	Codes.SetNumUninitialized(NumCells);
+	Output.CellMasks.SetNumZeroed(NumCells);
+	TArray<int32> SliceIndices;
+	SliceIndices.SetNumZeroed(NumSlices + 1);
+	uint32* CellMasks = Output.CellMasks.GetData();
+
+	// Count, flags the cells owning the vertices of every triangle. Cells at Size only flag, they are the margin other cells
+	// take vertices from. Their steps can leave the chunk, or wrap into the next row, both as the shader does.
+	ParallelFor(NumSlices, [&](int32 Z)
+	{
+		int32 NumIndices = 0;
+		for (int32 Y = 0; Y <= Size; Y++)
+		{
+			for (int32 X = 0; X <= Size; X++)
+			{
+				const FIntVector Cell = FIntVector(X, Y, Z);
+				const int64 Addr = Grid.GetCellAddr(Cell);
+				const uint32 Code = Grid.GetCode(Cell);
+				Codes[Addr] = Code;
+				
+				const int32 NumPolys = CaseToNumPolys[Code];
+				for (int32 Index = 0; Index < NumPolys * 3; Index++)
+				{
+					const int32 Edge = TriTable[Code][Index];
+					const FIntVector Step = EdgeOwnerSteps[Edge];
+					const int64 OwnerAddr = Addr + Step.X + int64(Step.Y) * (Size + 1) + int64(Step.Z) * (Size + 1) * (Size + 1);
+					if (OwnerAddr < NumCells)
+					{
+						FPlatformAtomics::InterlockedOr((volatile int32*)&CellMasks[OwnerAddr], (int32)EdgeMasks[Edge]);
+					}
+				}
+				if (X < Size && Y < Size && Z < Size)
+				{
+					NumIndices += NumPolys * 3;
+				}
+			}
+		}
+		SliceIndices[Z + 1] = NumIndices;
+	});
+
+	// Alloc, gives every flagged vertex a slot. The slots follow the cells instead of the order atomics hand them out in.
+	TArray<int32> SliceVertices;
+	SliceVertices.SetNumZeroed(NumSlices + 1);
+	const int32 CellsPerSlice = (Size + 1) * (Size + 1);
+	ParallelFor(NumSlices, [&](int32 Z)
+	{
+		int32 NumVertices = 0;
+		for (int32 Addr = Z * CellsPerSlice; Addr < (Z + 1) * CellsPerSlice; Addr++)
+		{
+			NumVertices += FMath::CountBits(CellMasks[Addr] & CellFlagsMask);
+		}
+		SliceVertices[Z + 1] = NumVertices;
+	});
+	for (int32 Slice = 0; Slice < NumSlices; Slice++)
+	{
+		SliceVertices[Slice + 1] += SliceVertices[Slice];
+		SliceIndices[Slice + 1] += SliceIndices[Slice];
+	}
+	const int32 NumVertices = SliceVertices[NumSlices];
+	const int32 NumIndices = SliceIndices[NumSlices];
+	checkf(NumVertices <= (int32)CellIndexMask, TEXT("%d vertices do not fit the 24 bit index of the cell masks"), NumVertices);
+	
+	ParallelFor(NumSlices, [&](int32 Z)
+	{
+		uint32 StartIndex = SliceVertices[Z];
+		for (int32 Addr = Z * CellsPerSlice; Addr < (Z + 1) * CellsPerSlice; Addr++)
+		{
+			if (CellMasks[Addr] & CellFlagsMask)
+			{
+				CellMasks[Addr] |= StartIndex;
+				StartIndex += FMath::CountBits(CellMasks[Addr] & CellFlagsMask);
+			}
+		}
+	});
+
+	// March, every cell emits the vertices it owns in the order 0, 3, 8 and the triangles of cells below Size
+	Output.Vertices.SetNumUninitialized(NumVertices);
+	Output.Normals.SetNumUninitialized(bAttributes ? NumVertices : 0);
+	Output.Colors.SetNumUninitialized(bAttributes ? NumVertices : 0);
+	Output.Indices.SetNumUninitialized(NumIndices);
+	const float VertexScale = float(1 << Params.LOD);
+	
+	ParallelFor(NumSlices, [&](int32 Z)
+	{
+		uint32* Indices = Output.Indices.GetData() + SliceIndices[Z];
+		for (int32 Y = 0; Y <= Size; Y++)
+		{
+			for (int32 X = 0; X <= Size; X++)
+			{
+				const FIntVector Cell = FIntVector(X, Y, Z);
+				const int64 Addr = Grid.GetCellAddr(Cell);
+				const uint32 Mask = CellMasks[Addr];
+				const FIntVector Voxel = Cell + FIntVector(2);
+				const float Value = Grid.GetVoxel(Voxel);
+				
+				uint32 VertexIndex = Mask & CellIndexMask;
+				for (const FSOwnedEdge& OwnedEdge : OwnedEdges)
+				{
+					if (!(Mask & OwnedEdge.Flag))
+						continue;
+
+					const FIntVector OtherCell = Cell + CornerOffsets[OwnedEdge.Corner];
+					const FIntVector OtherVoxel = Voxel + CornerOffsets[OwnedEdge.Corner];
+					const float OtherValue = Grid.GetVoxel(OtherVoxel);
+					const FVector3f EdgePos = Grid.Interp(FVector3f(Cell), FVector3f(OtherCell), Value, OtherValue);
+					
+					Output.Vertices[VertexIndex] = EdgePos * 100 * VertexScale * Params.Scale;
+					if (bAttributes)
+					{
+						FVector3f Normal = Grid.Interp(Grid.GetVoxelNormal(Voxel), Grid.GetVoxelNormal(OtherVoxel), Value, OtherValue);
+						Output.Normals[VertexIndex] = FSMarchingGrid::Normalize(Normal);
+						Output.Colors[VertexIndex] = FSDensityCPU::GetBiomeColor(Params.WorldSize, Params.seed,
+							EdgePos * VertexScale * Params.Scale + Params.Position);
+					}
+					VertexIndex++;
+				}
+
+				if (X >= Size || Y >= Size || Z >= Size)
+					continue;
+
+				const uint32 Code = Codes[Addr];
+				for (int32 Index = 0; Index < CaseToNumPolys[Code] * 3; Index++)
+				{
+					const int32 Edge = TriTable[Code][Index];
+					const FIntVector Step = EdgeOwnerSteps[Edge];
+					*Indices++ = VertexToIndex(CellMasks[Grid.GetCellAddr(Cell + Step)], Edge);
+				}
+			}
+		}
+	});
+}
+
+void FSMarchingCPU::Generate(const FSDispatchCSParams& Params, FSMarchingCPUOutput& Output, bool bAttributes)
+{
+	TArray<float> Voxels;
+	Voxels.SetNumUninitialized((Params.Size + 4) * (Params.Size + 4) * (Params.Size + 4));
+	FSDensityCPU::GetChunkDensity(Params.WorldSize, Params.seed, Params.Size, Params.Scale, Params.LOD, Params.Position, Voxels);
+	March(Params, Voxels, Output, bAttributes);
+}
+
+void FSMarchingCPU::GetCanonicalTriangles(TConstArrayView<uint32> CellMasks, TConstArrayView<uint32> Indices, TArray<FIntVector>& OutTriangles)
+{
+	int32 NumVertices = 0;
+	for (uint32 CellMask : CellMasks)
+	{
+		NumVertices = FMath::Max<int32>(NumVertices, (CellMask & CellIndexMask) + FMath::CountBits(CellMask & CellFlagsMask));
+	}
+	
+	TArray<int32> VertexIds;
+	VertexIds.Init(INDEX_NONE, NumVertices);
+	for (int32 Addr = 0; Addr < CellMasks.Num(); Addr++)
+	{
+		uint32 VertexIndex = CellMasks[Addr] & CellIndexMask;
+		for (int32 Slot = 0; Slot < 3; Slot++)
+		{
+			if (CellMasks[Addr] & OwnedEdges[Slot].Flag)
+			{
+				VertexIds[VertexIndex++] = Addr * 3 + Slot;
+			}
+		}
+	}
+
+	OutTriangles.Reset(Indices.Num() / 3);
+	for (int32 Index = 0; Index + 2 < Indices.Num(); Index += 3)
+	{
+		int32 Ids[3];
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			Ids[Corner] = VertexIds.IsValidIndex(Indices[Index + Corner]) ? VertexIds[Indices[Index + Corner]] : INDEX_NONE;
+		}
+		int32 First = Ids[0] <= Ids[1] && Ids[0] <= Ids[2] ? 0 : (Ids[1] <= Ids[2] ? 1 : 2);
+		OutTriangles.Add(FIntVector(Ids[First], Ids[(First + 1) % 3], Ids[(First + 2) % 3]));
+	}
+	OutTriangles.Sort([](const FIntVector& A, const FIntVector& B)
+	{
+		return A.X != B.X ? A.X < B.X : (A.Y != B.Y ? A.Y < B.Y : A.Z < B.Z);
+	});
+}
+
+void FSMarchingCPU::GroupScan(TConstArrayView<uint32> Counts, int32 GroupSize, TArray<uint32>& OutOffsets, TArray<uint32>& OutGroupTotals)
+{
+	OutOffsets.SetNumUninitialized(Counts.Num());
+	OutGroupTotals.Reset(FMath::DivideAndRoundUp(Counts.Num(), GroupSize));
+	for (int32 GroupStart = 0; GroupStart < Counts.Num(); GroupStart += GroupSize)
+	{
+		uint32 Sum = 0;
+		for (int32 Index = GroupStart; Index < FMath::Min(GroupStart + GroupSize, Counts.Num()); Index++)
+		{
+			OutOffsets[Index] = Sum;
+			Sum += Counts[Index];
+		}
+		OutGroupTotals.Add(Sum);
+	}
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+static const FIntVector3 CheckWorldSize = FIntVector3(200000, 200000, 3000);
+
+static FSDispatchCSParams GetCheckParams(int32 Size, const FVector3f& Position)
+{
+	FSDispatchCSParams Params;
+	Params.WorldSize = CheckWorldSize;
+	Params.Size = Size;
+	Params.isolevel = 0.0f;
+	Params.Position = Position;
+	Params.LOD = 0;
+	Params.Scale = 1;
+	Params.seed = 1337;
+	return Params;
+}
+
+template<typename T>
+static TArray<T> ReadBack(FRHIGPUBufferReadback& Readback, int32 Num)
+{
+	TArray<T> Values;
+	Values.SetNumUninitialized(Num);
+	FMemory::Memcpy(Values.GetData(), Readback.Lock(Num * sizeof(T)), Num * sizeof(T));
+	Readback.Unlock();
+	return Values;
+}
+
+// Largest distance between the vertices of the same cell and slot, in cell units
+static float GetMaxVertexError(const FSMarchingCPUOutput& Output, TConstArrayView<uint32> GPUCellMasks, TConstArrayView<FVector3f> GPUVertices)
+{
+	float MaxError = 0.0f;
+	for (int32 Addr = 0; Addr < GPUCellMasks.Num(); Addr++)
+	{
+		int32 NumVertices = FMath::CountBits(Output.CellMasks[Addr] & CellFlagsMask);
+		for (int32 Slot = 0; Slot < NumVertices; Slot++)
+		{
+			const FVector3f& Vertex = Output.Vertices[(Output.CellMasks[Addr] & CellIndexMask) + Slot];
+			const FVector3f& GPUVertex = GPUVertices[(GPUCellMasks[Addr] & CellIndexMask) + Slot];
+			MaxError = FMath::Max(MaxError, FVector3f::Dist(Vertex, GPUVertex) / 100.0f);
+		}
+	}
+	return MaxError;
+}
+
+// Cell addresses in the order the threads of the dense alloc pass run, group after group. INDEX_NONE for the threads past the chunk.
+static TArray<int32> GetGroupCellOrder(int32 Size)
+{
+	const int32 GroupsPerAxis = FMath::DivideAndRoundUp(Size + 1, 8);
+	TArray<int32> CellOrder;
+	for (int32 Group = 0; Group < GroupsPerAxis * GroupsPerAxis * GroupsPerAxis; Group++)
+	{
+		FIntVector GroupId = FIntVector(Group % GroupsPerAxis, (Group / GroupsPerAxis) % GroupsPerAxis, Group / (GroupsPerAxis * GroupsPerAxis));
+		for (int32 Thread = 0; Thread < 8 * 8 * 8; Thread++)
+		{
+			FIntVector Id = GroupId * 8 + FIntVector(Thread % 8, (Thread / 8) % 8, Thread / 64);
+			bool bCell = Id.X <= Size && Id.Y <= Size && Id.Z <= Size;
+			CellOrder.Add(bCell ? Id.X + Id.Y * (Size + 1) + Id.Z * (Size + 1) * (Size + 1) : INDEX_NONE);
+		}
+	}
+	return CellOrder;
+}
+
+// Checks the vertex slots of the GPU against FSMarchingCPU::GroupScan. Within every group of CellOrder the slots have to be
+// the reference offsets over one base, and the runs of the groups have to tile the vertices of the chunk without gaps.
+static bool CheckVertexRuns(TConstArrayView<int32> CellOrder, int32 GroupSize, TConstArrayView<uint32> GPUCellMasks, int32 GPUNumVertices)
+{
+	TArray<uint32> Counts;
+	for (int32 Addr : CellOrder)
+	{
+		Counts.Add(Addr != INDEX_NONE ? FMath::CountBits(GPUCellMasks[Addr] & CellFlagsMask) : 0);
+	}
+	TArray<uint32> Offsets;
+	TArray<uint32> GroupTotals;
+	FSMarchingCPU::GroupScan(Counts, GroupSize, Offsets, GroupTotals);
+
+	TArray<FIntPoint> Runs;
+	for (int32 Group = 0; Group < GroupTotals.Num(); Group++)
+	{
+		int64 Base = INDEX_NONE;
+		for (int32 Index = Group * GroupSize; Index < FMath::Min((Group + 1) * GroupSize, Counts.Num()); Index++)
+		{
+			if (Counts[Index] == 0)
+			{
+				continue;
+			}
+			int64 CellBase = int64(GPUCellMasks[CellOrder[Index]] & CellIndexMask) - Offsets[Index];
+			if (Base != INDEX_NONE && CellBase != Base)
+			{
+				return false;
+			}
+			Base = CellBase;
+		}
+		if (GroupTotals[Group] > 0)
+		{
+			Runs.Add(FIntPoint(int32(Base), int32(GroupTotals[Group])));
+		}
+	}
+
+	Runs.Sort([](const FIntPoint& A, const FIntPoint& B) { return A.X < B.X; });
+	int32 NextVertex = 0;
+	for (const FIntPoint& Run : Runs)
+	{
+		if (Run.X != NextVertex)
+		{
+			return false;
+		}
+		NextVertex += Run.Y;
+	}
+	return NextVertex == GPUNumVertices;
+}
+
+// Marches a chunk on the GPU and marches its voxels on the CPU, the flags and triangles have to match exactly
+static void CheckMarching()
+{
+	const FSDispatchCSParams Params = GetCheckParams(32, FVector3f(1234.0f, -5678.0f, -300.0f));
+	
+	ENQUEUE_RENDER_COMMAND(CheckMarching)([Params](FRHICommandListImmediate& RHICmdList)
+	{
+		const int32 Size = Params.Size;
+		const int32 NumVoxels = (Size + 4) * (Size + 4) * (Size + 4);
+		const int32 NumCells = (Size + 1) * (Size + 1) * (Size + 1);
+		const int32 MaxVertices = NumCells * 3;
+		const int32 MaxIndices = Size * Size * Size * 15;
+		
+		//Every cell with groupshared tiles, then only the active cells
+		for (bool bActiveCells : {false, true})
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+
+			FSChunkDispatchData ChunkData = FSChunkDispatchData(Params.Position, Params.LOD, 0, 0, 0);
+			FRDGBufferRef ChunksBuffer = CreateStructuredBuffer(GraphBuilder, TEXT("CheckMarchingChunks"), sizeof(FSChunkDispatchData), 1,
+				&ChunkData, sizeof(FSChunkDispatchData));
+			FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, FNoiseCSDispatchParams(Params.WorldSize, Size, Params.Scale,
+				Params.seed, ChunksBuffer, 1));
+			FMCCountVertsCSOutput MCCountVertsCSOutput = FMCCountVertsCSInterface::AddPass(GraphBuilder, FMCCountVertsCSDispatchParams(Size,
+				Params.isolevel, NoiseCSOutput.OutVoxels, ChunksBuffer, 1));
+			FMCAllocVertsCSDispatchParams MCAllocVertsCSDispatchParams = FMCAllocVertsCSDispatchParams(Size, MCCountVertsCSOutput.OutCellMasks, ChunksBuffer, 1);
+			MCAllocVertsCSDispatchParams.ActiveCells = bActiveCells ? MCCountVertsCSOutput.ActiveCells : FMCActiveCells();
+			FMCAllocVertsCSOutput MCAllocVertsCSOutput = FMCAllocVertsCSInterface::AddPass(GraphBuilder, MCAllocVertsCSDispatchParams);
+
+			//Worst case buffers instead of a page of the pool, the counts are only known once the check is done
+			FRDGBufferRef Vertices = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), MaxVertices), TEXT("CheckMarchingVertices"));
+			FRDGBufferRef Normals = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), MaxVertices), TEXT("CheckMarchingNormals"));
+			FRDGBufferRef Colors = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector4f), MaxVertices), TEXT("CheckMarchingColors"));
+			FRDGBufferRef Tris = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), MaxIndices), TEXT("CheckMarchingTris"));
+			FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(Params.WorldSize, Size, Params.isolevel, Params.Scale, Params.seed,
+				NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, ChunksBuffer, 1, Vertices, Tris, Normals, Colors);
+			MarchingCSDispatchParams.ActiveCells = MCAllocVertsCSDispatchParams.ActiveCells;
+			FMarchingCSInterface::AddPass(GraphBuilder, MarchingCSDispatchParams);
+
+			FRHIGPUBufferReadback VoxelsReadback(TEXT("CheckMarchingVoxels"));
+			FRHIGPUBufferReadback CellMasksReadback(TEXT("CheckMarchingCellMasks"));
+			FRHIGPUBufferReadback IndicesCountReadback(TEXT("CheckMarchingIndicesCount"));
+			FRHIGPUBufferReadback NumAllocatedVertsReadback(TEXT("CheckMarchingNumAllocatedVerts"));
+			FRHIGPUBufferReadback VerticesReadback(TEXT("CheckMarchingVertices"));
+			FRHIGPUBufferReadback TrisReadback(TEXT("CheckMarchingTris"));
+			AddEnqueueCopyPass(GraphBuilder, &VoxelsReadback, NoiseCSOutput.OutVoxels, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &CellMasksReadback, MCCountVertsCSOutput.OutCellMasks, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &IndicesCountReadback, MCCountVertsCSOutput.OutIndicesCount, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &NumAllocatedVertsReadback, MCAllocVertsCSOutput.OutNumAllocatedVerts, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &VerticesReadback, Vertices, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &TrisReadback, Tris, 0u);
+			FRHIGPUBufferReadback ActiveCellsReadback(TEXT("CheckMarchingActiveCells"));
+			FRHIGPUBufferReadback NumActiveCellsReadback(TEXT("CheckMarchingNumActiveCells"));
+			if (bActiveCells)
+			{
+				AddEnqueueCopyPass(GraphBuilder, &ActiveCellsReadback, MCCountVertsCSOutput.ActiveCells.Cells, 0u);
+				AddEnqueueCopyPass(GraphBuilder, &NumActiveCellsReadback, MCCountVertsCSOutput.ActiveCells.NumCells, 0u);
+			}
+			GraphBuilder.Execute();
+
+			//Only a console check, stalling is fine
+			RHICmdList.SubmitCommandsAndFlushGPU();
+			RHICmdList.BlockUntilGPUIdle();
+
+			TArray<float> Voxels = ReadBack<float>(VoxelsReadback, NumVoxels);
+			TArray<uint32> GPUCellMasks = ReadBack<uint32>(CellMasksReadback, NumCells);
+			int32 GPUNumIndices = ReadBack<uint32>(IndicesCountReadback, 1)[0];
+			int32 GPUNumVertices = ReadBack<uint32>(NumAllocatedVertsReadback, 1)[0];
+			TArray<FVector3f> GPUVertices = ReadBack<FVector3f>(VerticesReadback, GPUNumVertices);
+			TArray<uint32> GPUIndices = ReadBack<uint32>(TrisReadback, GPUNumIndices);
+
+			//The alloc pass runs over the cells in groups of 8^3, or over the active cells in the order of their list
+			TArray<int32> CellOrder;
+			if (bActiveCells)
+			{
+				for (uint32 ActiveCell : ReadBack<uint32>(ActiveCellsReadback, ReadBack<uint32>(NumActiveCellsReadback, 1)[0]))
+				{
+					CellOrder.Add(ActiveCell & 0xFFFFFF);
+				}
+			}
+			else
+			{
+				CellOrder = GetGroupCellOrder(Size);
+			}
+			bool bVertexRuns = CheckVertexRuns(CellOrder, bActiveCells ? FMCActiveCells::GroupSize : 8 * 8 * 8, GPUCellMasks, GPUNumVertices);
+
+			//The same voxels, so float differences in the noise cannot flip a corner
+			FSMarchingCPUOutput Output;
+			FSMarchingCPU::March(Params, Voxels, Output, false);
+		
+			bool bSameFlags = true;
+			for (int32 Addr = 0; Addr < NumCells; Addr++)
+			{
+				bSameFlags &= (Output.CellMasks[Addr] & CellFlagsMask) == (GPUCellMasks[Addr] & CellFlagsMask);
+			}
+			TArray<FIntVector> Triangles;
+			TArray<FIntVector> GPUTriangles;
+			FSMarchingCPU::GetCanonicalTriangles(Output.CellMasks, Output.Indices, Triangles);
+			FSMarchingCPU::GetCanonicalTriangles(GPUCellMasks, GPUIndices, GPUTriangles);
+			bool bSameTriangles = Triangles == GPUTriangles;
+			float MaxError = bSameFlags ? GetMaxVertexError(Output, GPUCellMasks, GPUVertices) : 0.0f;
+		
+			UE_LOG(LogTemp, Log, TEXT("CPU marching: %d vertices and %d indices, the march pass over %s %d and %d. Cell flags %s, triangles %s, max vertex error %g cells, vertex runs %s, %s"),
+				Output.Vertices.Num(), Output.Indices.Num(), bActiveCells ? TEXT("the active cells") : TEXT("every cell"), GPUNumVertices, GPUNumIndices, bSameFlags ? TEXT("match") : TEXT("differ"),
+				bSameTriangles ? TEXT("match") : TEXT("differ"), MaxError, bVertexRuns ? TEXT("match the group scan") : TEXT("differ"),
+				bSameFlags && bSameTriangles && bVertexRuns && MaxError <= 1e-3f ? TEXT("ok") : TEXT("FAILED"));
+		}
+	});
+}
+
+static FAutoConsoleCommand CheckMarchingCommand(
+	TEXT("SVoxel.CheckMarching"),
+	TEXT("Compares the CPU mesher with the count, alloc and march passes on the same voxels"),
+	FConsoleCommandDelegate::CreateStatic(&CheckMarching));
+
+// Marches a chunk with the deterministic scan over every cell and over the active cells. Both have to give the same content hash,
+// the one of their buffers on the CPU, and the same cell masks and indices as the CPU mesher on the same voxels.
+static void CheckDeterministic()
+{
+	const FSDispatchCSParams Params = GetCheckParams(32, FVector3f(1234.0f, -5678.0f, -300.0f));
+	
+	ENQUEUE_RENDER_COMMAND(CheckDeterministic)([Params](FRHICommandListImmediate& RHICmdList)
+	{
+		const int32 Size = Params.Size;
+		const int32 NumVoxels = (Size + 4) * (Size + 4) * (Size + 4);
+		const int32 NumCells = (Size + 1) * (Size + 1) * (Size + 1);
+		const int32 MaxVertices = NumCells * 3;
+		const int32 MaxIndices = Size * Size * Size * 15;
+
+		uint64 ContentHashes[2] = {};
+		bool bBufferHashes = true;
+		bool bSameSlots = true;
+		bool bSameIndices = true;
+		int32 GPUNumVertices = 0;
+		int32 GPUNumIndices = 0;
+		for (bool bActiveCells : {false, true})
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+
+			FSChunkDispatchData ChunkData = FSChunkDispatchData(Params.Position, Params.LOD, 0, 0, 0);
+			FRDGBufferRef ChunksBuffer = CreateStructuredBuffer(GraphBuilder, TEXT("CheckDeterministicChunks"), sizeof(FSChunkDispatchData), 1,
+				&ChunkData, sizeof(FSChunkDispatchData));
+			FNoiseCSOutput NoiseCSOutput = FNoiseCSInterface::AddPass(GraphBuilder, FNoiseCSDispatchParams(Params.WorldSize, Size, Params.Scale,
+				Params.seed, ChunksBuffer, 1));
+			FMCCountVertsCSOutput MCCountVertsCSOutput = FMCCountVertsCSInterface::AddPass(GraphBuilder, FMCCountVertsCSDispatchParams(Size,
+				Params.isolevel, NoiseCSOutput.OutVoxels, ChunksBuffer, 1));
+			FMCScanCellsCSOutput MCScanCellsCSOutput = FMCScanCellsCSInterface::AddPass(GraphBuilder, FMCScanCellsCSDispatchParams(Size,
+				Params.isolevel, NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, ChunksBuffer, 1));
+
+			FRDGBufferRef Vertices = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), MaxVertices), TEXT("CheckDeterministicVertices"));
+			FRDGBufferRef Normals = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), MaxVertices), TEXT("CheckDeterministicNormals"));
+			FRDGBufferRef Colors = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector4f), MaxVertices), TEXT("CheckDeterministicColors"));
+			FRDGBufferRef Tris = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), MaxIndices), TEXT("CheckDeterministicTris"));
+			FMarchingCSDispatchParams MarchingCSDispatchParams = FMarchingCSDispatchParams(Params.WorldSize, Size, Params.isolevel, Params.Scale, Params.seed,
+				NoiseCSOutput.OutVoxels, MCCountVertsCSOutput.OutCellMasks, ChunksBuffer, 1, Vertices, Tris, Normals, Colors);
+			MarchingCSDispatchParams.ActiveCells = bActiveCells ? MCCountVertsCSOutput.ActiveCells : FMCActiveCells();
+			MarchingCSDispatchParams.InCellIndexStarts = MCScanCellsCSOutput.OutCellIndexStarts;
+			FMarchingCSOutput MarchingCSOutput = FMarchingCSInterface::AddPass(GraphBuilder, MarchingCSDispatchParams);
+
+			FRHIGPUBufferReadback VoxelsReadback(TEXT("CheckDeterministicVoxels"));
+			FRHIGPUBufferReadback CellMasksReadback(TEXT("CheckDeterministicCellMasks"));
+			FRHIGPUBufferReadback NumIndicesReadback(TEXT("CheckDeterministicNumIndices"));
+			FRHIGPUBufferReadback NumAllocatedVertsReadback(TEXT("CheckDeterministicNumAllocatedVerts"));
+			FRHIGPUBufferReadback VerticesReadback(TEXT("CheckDeterministicVertices"));
+			FRHIGPUBufferReadback NormalsReadback(TEXT("CheckDeterministicNormals"));
+			FRHIGPUBufferReadback ColorsReadback(TEXT("CheckDeterministicColors"));
+			FRHIGPUBufferReadback TrisReadback(TEXT("CheckDeterministicTris"));
+			FRHIGPUBufferReadback ContentHashReadback(TEXT("CheckDeterministicContentHash"));
+			AddEnqueueCopyPass(GraphBuilder, &VoxelsReadback, NoiseCSOutput.OutVoxels, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &CellMasksReadback, MCCountVertsCSOutput.OutCellMasks, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &NumIndicesReadback, MCScanCellsCSOutput.OutNumIndices, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &NumAllocatedVertsReadback, MCScanCellsCSOutput.OutNumAllocatedVerts, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &VerticesReadback, Vertices, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &NormalsReadback, Normals, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &ColorsReadback, Colors, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &TrisReadback, Tris, 0u);
+			AddEnqueueCopyPass(GraphBuilder, &ContentHashReadback, MarchingCSOutput.OutContentHashes, 0u);
+			GraphBuilder.Execute();
+
+			//Only a console check, stalling is fine
+			RHICmdList.SubmitCommandsAndFlushGPU();
+			RHICmdList.BlockUntilGPUIdle();
+
+			TArray<float> Voxels = ReadBack<float>(VoxelsReadback, NumVoxels);
+			TArray<uint32> GPUCellMasks = ReadBack<uint32>(CellMasksReadback, NumCells);
+			GPUNumIndices = ReadBack<uint32>(NumIndicesReadback, 1)[0];
+			GPUNumVertices = ReadBack<uint32>(NumAllocatedVertsReadback, 1)[0];
+			TArray<FVector3f> GPUVertices = ReadBack<FVector3f>(VerticesReadback, GPUNumVertices);
+			TArray<FVector3f> GPUNormals = ReadBack<FVector3f>(NormalsReadback, GPUNumVertices);
+			TArray<FVector4f> GPUColors = ReadBack<FVector4f>(ColorsReadback, GPUNumVertices);
+			//The chunk is at offset 0, the indices already start at its first vertex
+			TArray<uint32> GPUIndices = ReadBack<uint32>(TrisReadback, GPUNumIndices);
+			TArray<uint32> GPUContentHash = ReadBack<uint32>(ContentHashReadback, 2);
+			
+			uint64& ContentHash = ContentHashes[bActiveCells];
+			ContentHash = (uint64(GPUContentHash[0]) << 32) | GPUContentHash[1];
+			bBufferHashes &= ContentHash == FSDispatchCSOutput::GetContentHash(GPUVertices, GPUNormals, GPUColors, GPUIndices);
+
+			//The same voxels, so float differences in the noise cannot flip a corner
+			FSMarchingCPUOutput Output;
+			FSMarchingCPU::March(Params, Voxels, Output, false);
+
+			//Cells without vertices get no slot, their index bits are not compared
+			for (int32 Addr = 0; Addr < NumCells; Addr++)
+			{
+				if (Output.CellMasks[Addr] & CellFlagsMask)
+				{
+					bSameSlots &= (Output.CellMasks[Addr] & (CellFlagsMask | CellIndexMask)) == (GPUCellMasks[Addr] & (CellFlagsMask | CellIndexMask));
+				}
+			}
+			bSameIndices &= Output.Indices == GPUIndices;
+		}
+
+		bool bSameHashes = ContentHashes[0] == ContentHashes[1] && (GPUNumIndices == 0 || ContentHashes[0] != 0);
+		UE_LOG(LogTemp, Log, TEXT("Deterministic marching: %d vertices and %d indices, content hash %016llx over every cell and %016llx over the active cells. Hashes %s, buffer hashes %s, cell slots %s, indices %s, %s"),
+			GPUNumVertices, GPUNumIndices, ContentHashes[0], ContentHashes[1], bSameHashes ? TEXT("match") : TEXT("differ"),
+			bBufferHashes ? TEXT("match") : TEXT("differ"), bSameSlots ? TEXT("match the CPU") : TEXT("differ"),
+			bSameIndices ? TEXT("match the CPU") : TEXT("differ"), bSameHashes && bBufferHashes && bSameSlots && bSameIndices ? TEXT("ok") : TEXT("FAILED"));
+	});
+}
+
+static FAutoConsoleCommand CheckDeterministicCommand(
+	TEXT("SVoxel.CheckDeterministic"),
+	TEXT("Marches a chunk with the deterministic scan over every cell and over the active cells, compares the content hashes and the layout with the CPU mesher"),
+	FConsoleCommandDelegate::CreateStatic(&CheckDeterministic));
+
+static void BenchmarkMarching(const TArray<FString>& Args)
+{
+	int32 NumChunks = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 16;
+	int32 Size = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 32;
+
+	double DensityTime = 0.0;
+	double MarchTime = 0.0;
+	double CollisionTime = 0.0;
+	int64 NumIndices = 0;
+	TArray<float> Voxels;
+	Voxels.SetNumUninitialized((Size + 4) * (Size + 4) * (Size + 4));
+	FSMarchingCPUOutput Output;
+	for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+	{
+		//Along the surface, so every chunk has geometry
+		FSDispatchCSParams Params = GetCheckParams(Size, FVector3f(Chunk * Size * 100.0f, 0.0f, -Size * 50.0f));
+		
+		double StartTime = FPlatformTime::Seconds();
+		FSDensityCPU::GetChunkDensity(Params.WorldSize, Params.seed, Size, Params.Scale, Params.LOD, Params.Position, Voxels);
+		double DensityEndTime = FPlatformTime::Seconds();
+		FSMarchingCPU::March(Params, Voxels, Output, true);
+		double MarchEndTime = FPlatformTime::Seconds();
+		FSMarchingCPU::March(Params, Voxels, Output, false);
+		double CollisionEndTime = FPlatformTime::Seconds();
+		
+		DensityTime += DensityEndTime - StartTime;
+		MarchTime += MarchEndTime - DensityEndTime;
+		CollisionTime += CollisionEndTime - MarchEndTime;
+		NumIndices += Output.Indices.Num();
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("CPU marching of %d chunks of size %d, %lld triangles: density %.2f ms, march %.2f ms, march without normals and colors %.2f ms per chunk"),
+		NumChunks, Size, NumIndices / 3, DensityTime * 1000.0 / NumChunks, MarchTime * 1000.0 / NumChunks, CollisionTime * 1000.0 / NumChunks);
+}
+
+static FAutoConsoleCommand BenchmarkMarchingCommand(
+	TEXT("SVoxel.BenchmarkMarching"),
+	TEXT("Measures the CPU mesher per chunk on all cores, takes the number of chunks and their size"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkMarching));
+
+#endif
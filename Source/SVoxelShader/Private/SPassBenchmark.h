@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "SDispatchCSBatch.h"
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+/**
+ * One iteration of a GPU pass benchmark of a dev console command. Run sets up the chunks and the graph, the passes mark the timestamps they are timed between.
+ */
+class FSPassBenchmark
+{
+public:
+	FRDGBuilder& GraphBuilder;
+	int32 Iteration;
+
+	//Row of chunks along x, the same every iteration
+	FRDGBufferRef Chunks = nullptr;
+
+	//Worst case ranges for every chunk so none overflows without reading the counts back, null unless Run was asked for outputs
+	FRDGBufferRef Vertices = nullptr;
+	FRDGBufferRef Normals = nullptr;
+	FRDGBufferRef Colors = nullptr;
+	FRDGBufferRef Indices = nullptr;
+
+	//Writes the GPU time at this point of the graph into timestamp Index, the passes around it have to run on the graphics pipe
+	void AddTimestamp(int32 Index)
+	{
+		if (Queries.Num() <= Index)
+		{
+			Queries.SetNum(Index + 1);
+		}
+		FRHIRenderQuery* Query = Queries[Index].Add_GetRef(QueryPool.AllocateQuery()).GetQuery();
+		GraphBuilder.AddPass(RDG_EVENT_NAME("Timestamp"), ERDGPassFlags::NeverCull, [Query](FRHICommandListImmediate& RHICmdList)
+		{
+			RHICmdList.EndRenderQuery(Query);
+		});
+	}
+
+	//Adds the passes to a graph of their own Iterations times, over NumChunks chunks of Size placed Spacing apart at Height.
+	//Returns the average milliseconds between timestamps 0 and 1, 2 and 3 and so on. Stalls until the GPU is idle.
+	static TArray<double> Run(FRHICommandListImmediate& RHICmdList, int32 Size, int32 NumChunks, int32 Iterations, float Spacing, float Height,
+		bool bOutputs, TFunctionRef<void(FSPassBenchmark& Benchmark)> AddPasses)
+	{
+		//At least one iteration so the callers always get a time for every pair of timestamps
+		Iterations = FMath::Max(Iterations, 1);
+		int32 VertexCapacity = bOutputs ? 3 * (Size + 1) * (Size + 1) * (Size + 1) : 0;
+		int32 IndexCapacity = bOutputs ? 15 * Size * Size * Size : 0;
+
+		TArray<FSChunkDispatchData> ChunkData;
+		for (int32 Chunk = 0; Chunk < NumChunks; Chunk++)
+		{
+			ChunkData.Add(FSChunkDispatchData(FVector3f(Chunk * Spacing, 0.0f, Height), 0, Chunk, Chunk * VertexCapacity, Chunk * IndexCapacity));
+		}
+
+		TRefCountPtr<FRDGPooledBuffer> Vertices;
+		TRefCountPtr<FRDGPooledBuffer> Normals;
+		TRefCountPtr<FRDGPooledBuffer> Colors;
+		TRefCountPtr<FRDGPooledBuffer> Indices;
+		if (bOutputs)
+		{
+			Vertices = AllocatePooledBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), VertexCapacity * NumChunks), TEXT("BenchmarkVertices"));
+			Normals = AllocatePooledBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector3f), VertexCapacity * NumChunks), TEXT("BenchmarkNormals"));
+			Colors = AllocatePooledBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FVector4f), VertexCapacity * NumChunks), TEXT("BenchmarkColors"));
+			Indices = AllocatePooledBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), IndexCapacity * NumChunks), TEXT("BenchmarkIndices"));
+		}
+
+		FRenderQueryPoolRHIRef QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+		TArray<TArray<FRHIPooledRenderQuery>> Queries;
+		for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+			FSPassBenchmark Benchmark(GraphBuilder, Iteration, *QueryPool, Queries);
+			Benchmark.Chunks = CreateStructuredBuffer(GraphBuilder, TEXT("BenchmarkChunks"), sizeof(FSChunkDispatchData),
+				NumChunks, ChunkData.GetData(), sizeof(FSChunkDispatchData) * NumChunks);
+			if (bOutputs)
+			{
+				Benchmark.Vertices = GraphBuilder.RegisterExternalBuffer(Vertices);
+				Benchmark.Normals = GraphBuilder.RegisterExternalBuffer(Normals);
+				Benchmark.Colors = GraphBuilder.RegisterExternalBuffer(Colors);
+				Benchmark.Indices = GraphBuilder.RegisterExternalBuffer(Indices);
+			}
+			AddPasses(Benchmark);
+			GraphBuilder.Execute();
+		}
+
+		//Only a console benchmark, stalling is fine
+		RHICmdList.SubmitCommandsAndFlushGPU();
+		RHICmdList.BlockUntilGPUIdle();
+
+		TArray<double> Times;
+		for (int32 Index = 0; Index + 1 < Queries.Num(); Index += 2)
+		{
+			uint64 TotalMicroseconds = 0;
+			for (int32 Query = 0; Query < Queries[Index].Num(); Query++)
+			{
+				uint64 StartTime = 0;
+				uint64 EndTime = 0;
+				RHIGetRenderQueryResult(Queries[Index][Query].GetQuery(), StartTime, true);
+				RHIGetRenderQueryResult(Queries[Index + 1][Query].GetQuery(), EndTime, true);
+				TotalMicroseconds += EndTime - StartTime;
+			}
+			Times.Add(TotalMicroseconds / 1000.0 / FMath::Max(Queries[Index].Num(), 1));
+		}
+		return Times;
+	}
+
+private:
+	FSPassBenchmark(FRDGBuilder& InGraphBuilder, int32 InIteration, FRHIRenderQueryPool& InQueryPool, TArray<TArray<FRHIPooledRenderQuery>>& InQueries)
+		: GraphBuilder(InGraphBuilder)
+		, Iteration(InIteration)
+		, QueryPool(InQueryPool)
+		, Queries(InQueries)
+	{
+	}
+
+	FRHIRenderQueryPool& QueryPool;
+	TArray<TArray<FRHIPooledRenderQuery>>& Queries;
+};
+
+#endif
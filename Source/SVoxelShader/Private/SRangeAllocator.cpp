@@ -0,0 +1,260 @@
+﻿#include "SRangeAllocator.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "SCheckSuite.h"
+
+FSRangeAllocator::FSRangeAllocator(int32 InCapacity, ESRangeAllocatorFit InFit)
+	: Capacity(InCapacity)
+	, Fit(InFit)
+{
+	if (Capacity > 0)
+	{
+		FreeRanges.Add(FRange(0, Capacity));
+	}
+}
+
+int32 FSRangeAllocator::Allocate(int32 Size)
+{
+	if (Size <= 0)
+		return INDEX_NONE;
+	
+	int32 FoundIndex = INDEX_NONE;
+	for (int32 RangeIndex = 0; RangeIndex < FreeRanges.Num(); RangeIndex++)
+	{
+		const FRange& Range = FreeRanges[RangeIndex];
+		if (Range.Size < Size)
+			continue;
+
+		if (FoundIndex == INDEX_NONE || Range.Size < FreeRanges[FoundIndex].Size)
+		{
+			FoundIndex = RangeIndex;
+		}
+		if (Fit == ESRangeAllocatorFit::First || Range.Size == Size)
+			break;
+	}
+	if (FoundIndex == INDEX_NONE)
+		return INDEX_NONE;
+
+	FRange& Range = FreeRanges[FoundIndex];
+	int32 Offset = Range.Offset;
+	Range.Offset += Size;
+	Range.Size -= Size;
+	if (Range.Size == 0)
+	{
+		FreeRanges.RemoveAt(FoundIndex);
+	}
+	
+	Allocations.Add(Offset, Size);
+	UsedSize += Size;
+	return Offset;
+}
+
+void FSRangeAllocator::Free(int32 Offset)
+{
+	int32 Size = 0;
+	if (!ensureMsgf(Allocations.RemoveAndCopyValue(Offset, Size), TEXT("No allocation at %d"), Offset))
+		return;
+
+	UsedSize -= Size;
+	AddFreeRange(Offset, Size);
+}
+
+void FSRangeAllocator::Shrink(int32 Offset, int32 NewSize)
+{
+	int32* Size = Allocations.Find(Offset);
+	if (!ensureMsgf(Size && NewSize <= *Size, TEXT("Cannot shrink the allocation at %d to %d"), Offset, NewSize))
+		return;
+
+	if (NewSize <= 0)
+	{
+		Free(Offset);
+		return;
+	}
+	
+	int32 FreedSize = *Size - NewSize;
+	*Size = NewSize;
+	if (FreedSize > 0)
+	{
+		UsedSize -= FreedSize;
+		AddFreeRange(Offset + NewSize, FreedSize);
+	}
+}
+
+int32 FSRangeAllocator::GetAllocationSize(int32 Offset) const
+{
+	const int32* Size = Allocations.Find(Offset);
+	return Size ? *Size : 0;
+}
+
+int32 FSRangeAllocator::GetLargestFreeRange() const
+{
+	int32 Largest = 0;
+	for (const FRange& Range : FreeRanges)
+	{
+		Largest = FMath::Max(Largest, Range.Size);
+	}
+	return Largest;
+}
+
+float FSRangeAllocator::GetFragmentation() const
+{
+	int32 FreeSize = GetFreeSize();
+	if (FreeSize == 0)
+		return 0.0f;
+	
+	return 1.0f - float(GetLargestFreeRange()) / FreeSize;
+}
+
+void FSRangeAllocator::AddFreeRange(int32 Offset, int32 Size)
+{
+	//First free range after Offset
+	int32 Low = 0;
+	int32 High = FreeRanges.Num();
+	while (Low < High)
+	{
+		int32 Middle = (Low + High) / 2;
+		if (FreeRanges[Middle].Offset < Offset)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	int32 NextIndex = Low;
+
+	bool bMergePrevious = NextIndex > 0 && FreeRanges[NextIndex - 1].Offset + FreeRanges[NextIndex - 1].Size == Offset;
+	bool bMergeNext = NextIndex < FreeRanges.Num() && Offset + Size == FreeRanges[NextIndex].Offset;
+
+	if (bMergePrevious && bMergeNext)
+	{
+		FreeRanges[NextIndex - 1].Size += Size + FreeRanges[NextIndex].Size;
+		FreeRanges.RemoveAt(NextIndex);
+	}
+	else if (bMergePrevious)
+	{
+		FreeRanges[NextIndex - 1].Size += Size;
+	}
+	else if (bMergeNext)
+	{
+		FreeRanges[NextIndex].Offset = Offset;
+		FreeRanges[NextIndex].Size += Size;
+	}
+	else
+	{
+		FreeRanges.Insert(FRange(Offset, Size), NextIndex);
+	}
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Checks the allocator against hand computed layouts, runs without an RHI
+static void CheckRangeAllocator()
+{
+	FSCheckSuite Checks(TEXT("Range allocator"));
+
+	{
+		FSRangeAllocator Allocator(100, ESRangeAllocatorFit::First);
+		int32 A = Allocator.Allocate(10);
+		int32 B = Allocator.Allocate(20);
+		int32 C = Allocator.Allocate(30);
+		Checks.Check(A == 0 && B == 10 && C == 30, TEXT("allocations are packed from the start"));
+		Checks.Check(Allocator.GetUsedSize() == 60 && Allocator.GetFreeSize() == 40, TEXT("used and free sizes"));
+		Checks.Check(Allocator.Allocate(41) == INDEX_NONE, TEXT("too big allocations fail"));
+		Checks.Check(Allocator.Allocate(0) == INDEX_NONE, TEXT("empty allocations fail"));
+
+		Allocator.Free(B);
+		Checks.Check(Allocator.GetNumFreeRanges() == 2, TEXT("a hole is its own free range"));
+		Checks.Check(Allocator.GetFragmentation() > 0.0f, TEXT("a hole fragments the free space"));
+		Checks.Check(Allocator.Allocate(5) == 10, TEXT("first fit takes the lowest hole"));
+		
+		Allocator.Free(A);
+		Allocator.Free(10);
+		Allocator.Free(C);
+		Checks.Check(Allocator.GetNumFreeRanges() == 1 && Allocator.GetLargestFreeRange() == 100, TEXT("freed ranges merge back together"));
+		Checks.Check(Allocator.GetFragmentation() == 0.0f && Allocator.GetNumAllocations() == 0, TEXT("nothing left once everything is freed"));
+	}
+	{
+		FSRangeAllocator Allocator(100, ESRangeAllocatorFit::Best);
+		int32 A = Allocator.Allocate(30);
+		Allocator.Allocate(10);
+		int32 C = Allocator.Allocate(10);
+		Allocator.Allocate(10);
+		Allocator.Free(A);
+		Allocator.Free(C);
+		Checks.Check(Allocator.Allocate(10) == C, TEXT("best fit takes the smallest hole that fits"));
+		Checks.Check(Allocator.Allocate(35) == 60, TEXT("best fit skips holes that are too small"));
+	}
+	{
+		FSRangeAllocator Allocator(100);
+		int32 A = Allocator.Allocate(50);
+		int32 B = Allocator.Allocate(50);
+		Allocator.Shrink(A, 20);
+		Checks.Check(Allocator.GetAllocationSize(A) == 20 && Allocator.GetUsedSize() == 70, TEXT("shrinking keeps the offset"));
+		Checks.Check(Allocator.Allocate(30) == 20, TEXT("the end of a shrunk range can be allocated"));
+		Allocator.Free(B);
+		Allocator.Shrink(A, 0);
+		Checks.Check(Allocator.GetNumAllocations() == 1 && Allocator.GetUsedSize() == 30, TEXT("shrinking to nothing frees"));
+	}
+
+	Checks.Finish();
+}
+
+static FAutoConsoleCommand CheckRangeAllocatorCommand(
+	TEXT("SVoxel.CheckRangeAllocator"),
+	TEXT("Runs the CPU checks of the chunk buffer range allocator"),
+	FConsoleCommandDelegate::CreateStatic(&CheckRangeAllocator));
+
+// Streams chunk sized allocations through a full allocator the way the chunk world does when the camera moves
+static void BenchmarkRangeAllocator(const TArray<FString>& Args)
+{
+	int32 Capacity = 1 << 22;
+	int32 NumOperations = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200000;
+	
+	for (ESRangeAllocatorFit Fit : {ESRangeAllocatorFit::First, ESRangeAllocatorFit::Best})
+	{
+		FRandomStream Random(1337);
+		FSRangeAllocator Allocator(Capacity, Fit);
+		TArray<int32> Offsets;
+		int NumFailed = 0;
+		float PeakFragmentation = 0.0f;
+
+		//Keep the allocator around 90% full, chunk sizes span a few LODs of terrain
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Operation = 0; Operation < NumOperations; Operation++)
+		{
+			bool bFree = Offsets.Num() > 0 && (Allocator.GetUsedSize() > Capacity * 0.9f || Random.FRand() < 0.5f);
+			if (bFree)
+			{
+				int32 Index = Random.RandHelper(Offsets.Num());
+				Allocator.Free(Offsets[Index]);
+				Offsets.RemoveAtSwap(Index);
+				continue;
+			}
+
+			int32 Offset = Allocator.Allocate(Random.RandRange(256, 24000));
+			if (Offset == INDEX_NONE)
+			{
+				NumFailed++;
+				continue;
+			}
+			Offsets.Add(Offset);
+			PeakFragmentation = FMath::Max(PeakFragmentation, Allocator.GetFragmentation());
+		}
+		double Time = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogTemp, Log, TEXT("%s fit: %d operations in %.2f ms (%.3f us each), %d failed allocations, %.1f%% used"),
+			Fit == ESRangeAllocatorFit::First ? TEXT("First") : TEXT("Best"), NumOperations, Time * 1000.0,
+			Time * 1000000.0 / NumOperations, NumFailed, 100.0f * Allocator.GetUsedSize() / Capacity);
+		UE_LOG(LogTemp, Log, TEXT("    %d free ranges, largest %d, fragmentation %.3f now and %.3f at peak"),
+			Allocator.GetNumFreeRanges(), Allocator.GetLargestFreeRange(), Allocator.GetFragmentation(), PeakFragmentation);
+	}
+}
+
+static FAutoConsoleCommand BenchmarkRangeAllocatorCommand(
+	TEXT("SVoxel.BenchmarkRangeAllocator"),
+	TEXT("Measures the speed and fragmentation of the chunk buffer range allocator, takes the number of operations"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRangeAllocator));
+
+#endif
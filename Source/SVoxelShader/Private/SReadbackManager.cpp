@@ -0,0 +1,123 @@
+﻿#include "SReadbackManager.h"
+#include "SVoxelStats.h"
+#include "Misc/CoreDelegates.h"
+#include "HAL/IConsoleManager.h"
+#include "SCheckSuite.h"
+
+static FSReadbackManager GSReadbackManager;
+
+FDelegateHandle FSReadbackManager::BeginFrameHandle;
+
+FSReadbackManager& FSReadbackManager::Get()
+{
+	check(IsInRenderingThread());
+	return GSReadbackManager;
+}
+
+void FSReadbackManager::Startup()
+{
+	BeginFrameHandle = FCoreDelegates::OnBeginFrameRT.AddStatic(&FSReadbackManager::OnBeginFrameRenderThread);
+}
+
+void FSReadbackManager::Shutdown()
+{
+	//Callbacks still pending own readbacks whose GPU work never finishes at this point, they are leaked on purpose
+	FCoreDelegates::OnBeginFrameRT.Remove(BeginFrameHandle);
+	BeginFrameHandle.Reset();
+}
+
+void FSReadbackManager::OnBeginFrameRenderThread()
+{
+	FSReadbackManager& Manager = Get();
+	if (Manager.Num() == 0)
+		return;
+	
+	SCOPE_CYCLE_COUNTER(STAT_SVoxel_ReadbackSweep);
+	int NumFired = Manager.Sweep();
+	
+	INC_DWORD_STAT_BY(STAT_SVoxel_ReadbackCallbacks, NumFired);
+	SET_DWORD_STAT(STAT_SVoxel_PendingReadbacks, Manager.Num());
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+// Checks the readback scheduling against mock readbacks, runs without a GPU
+static void CheckReadbackScheduler()
+{
+	FSCheckSuite Checks(TEXT("Readback scheduler"));
+
+	struct FMockReadback
+	{
+		bool bReady = false;
+		mutable int NumChecks = 0;
+		
+		bool IsReady() const
+		{
+			NumChecks++;
+			return bReady;
+		}
+	};
+	
+	{
+		TSReadbackScheduler<FMockReadback> Scheduler;
+		FMockReadback A, B, C;
+		TArray<int> Fired;
+		Scheduler.Add({&A, &B}, [&Fired]() { Fired.Add(0); });
+		Scheduler.Add({&C}, [&Fired]() { Fired.Add(1); });
+		Scheduler.Add({}, [&Fired]() { Fired.Add(2); });
+
+		Checks.Check(Scheduler.Sweep() == 1 && Fired == TArray<int>({2}), TEXT("a callback without readbacks fires on the next sweep"));
+		Checks.Check(A.NumChecks == 1 && B.NumChecks == 0, TEXT("readbacks after the first one that is not ready are not checked"));
+		
+		A.bReady = true;
+		Checks.Check(Scheduler.Sweep() == 0 && Scheduler.Num() == 2, TEXT("a callback waits for all of its readbacks"));
+		Checks.Check(A.NumChecks == 2 && B.NumChecks == 1, TEXT("every pending readback is checked once per sweep"));
+
+		B.bReady = true;
+		C.bReady = true;
+		Checks.Check(Scheduler.Sweep() == 2 && Fired == TArray<int>({2, 0, 1}), TEXT("ready callbacks fire together in the order they were added"));
+		Checks.Check(A.NumChecks == 2 && B.NumChecks == 2, TEXT("readbacks found ready are not checked again"));
+		Checks.Check(Scheduler.Num() == 0, TEXT("fired callbacks are removed"));
+	}
+	{
+		TSReadbackScheduler<FMockReadback> Scheduler;
+		FMockReadback A, B;
+		A.bReady = true;
+		B.bReady = true;
+		int NumFired = 0;
+		Scheduler.Add({&A}, [&Scheduler, &NumFired, &B]()
+		{
+			NumFired++;
+			Scheduler.Add({&B}, [&NumFired]() { NumFired++; });
+		});
+		
+		Checks.Check(Scheduler.Sweep() == 1 && NumFired == 1, TEXT("callbacks added while firing wait for the next sweep"));
+		Checks.Check(Scheduler.Sweep() == 1 && NumFired == 2 && Scheduler.Num() == 0, TEXT("the next sweep fires them"));
+	}
+	{
+		//Out of order completion keeps the order of the ones left behind
+		TSReadbackScheduler<FMockReadback> Scheduler;
+		FMockReadback Readbacks[4];
+		TArray<int> Fired;
+		for(int Index = 0; Index < 4; Index++)
+		{
+			Scheduler.Add({&Readbacks[Index]}, [&Fired, Index]() { Fired.Add(Index); });
+		}
+		Readbacks[1].bReady = true;
+		Readbacks[3].bReady = true;
+		Scheduler.Sweep();
+		Readbacks[0].bReady = true;
+		Readbacks[2].bReady = true;
+		Scheduler.Sweep();
+		Checks.Check(Fired == TArray<int>({1, 3, 0, 2}), TEXT("pending callbacks keep their order"));
+	}
+
+	Checks.Finish();
+}
+
+static FAutoConsoleCommand CheckReadbackSchedulerCommand(
+	TEXT("SVoxel.CheckReadbackScheduler"),
+	TEXT("Runs the CPU checks of the readback scheduling against mock readbacks"),
+	FConsoleCommandDelegate::CreateStatic(&CheckReadbackScheduler));
+
+#endif
@@ -1,4 +1,6 @@
 ﻿#include "SVoxelShader.h"
+#include "SVoxelStats.h"
+#include "SReadbackManager.h"
 
 #include "Misc/Paths.h"
 #include "Misc/FileHelper.h"
@@ -10,6 +12,44 @@
 #include "Runtime/Core/Public/Modules/ModuleManager.h"
 #include "Interfaces/IPluginManager.h"
 
+DEFINE_STAT(STAT_SVoxel_CancelledDispatches);
+DEFINE_STAT(STAT_SVoxel_SkippedPasses);
+DEFINE_STAT(STAT_SVoxel_WastedDispatches);
+DEFINE_STAT(STAT_SVoxel_GPUDrivenOverflows);
+DEFINE_STAT(STAT_SVoxel_DispatchLatencyMs);
+DEFINE_STAT(STAT_SVoxel_DispatchLatencyFrames);
+DEFINE_STAT(STAT_SVoxel_ChunkPoolMemory);
+DEFINE_STAT(STAT_SVoxel_ChunkPoolVertices);
+DEFINE_STAT(STAT_SVoxel_ChunkPoolIndices);
+DEFINE_STAT(STAT_SVoxel_UploadedBytes);
+DEFINE_STAT(STAT_SVoxel_UploadedBytesPerChunk);
+DEFINE_STAT(STAT_SVoxel_MeshCacheMemory);
+DEFINE_STAT(STAT_SVoxel_MeshCacheHits);
+DEFINE_STAT(STAT_SVoxel_MeshCacheMisses);
+DEFINE_STAT(STAT_SVoxel_MeshCacheEvictions);
+DEFINE_STAT(STAT_SVoxel_RegionArchiveHits);
+DEFINE_STAT(STAT_SVoxel_RegionArchiveMisses);
+DEFINE_STAT(STAT_SVoxel_RegionArchiveReadBytes);
+DEFINE_STAT(STAT_SVoxel_ChunkThrashes);
+DEFINE_STAT(STAT_SVoxel_SpawnChunkMesh);
+DEFINE_STAT(STAT_SVoxel_DeleteChunkMesh);
+DEFINE_STAT(STAT_SVoxel_PooledComponents);
+DEFINE_STAT(STAT_SVoxel_CreatedComponents);
+DEFINE_STAT(STAT_SVoxel_GarbageCollectionMs);
+DEFINE_STAT(STAT_SVoxel_CompletionQueueDepth);
+DEFINE_STAT(STAT_SVoxel_DrainCompletions);
+DEFINE_STAT(STAT_SVoxel_CompletionDrainMs);
+DEFINE_STAT(STAT_SVoxel_CoalescedCompletions);
+DEFINE_STAT(STAT_SVoxel_PendingReadbacks);
+DEFINE_STAT(STAT_SVoxel_ReadbackCallbacks);
+DEFINE_STAT(STAT_SVoxel_ReadbackSweep);
+DEFINE_STAT(STAT_SVoxel_CellOccupancy);
+DEFINE_STAT(STAT_SVoxel_PrefetchedChunks);
+DEFINE_STAT(STAT_SVoxel_CancelledPrefetches);
+DEFINE_STAT(STAT_SVoxel_PrefetchHits);
+DEFINE_STAT(STAT_SVoxel_HoleChunks);
+DEFINE_STAT(STAT_SVoxel_HoleFrames);
+
 #define LOCTEXT_NAMESPACE "FSVoxelShaderModule"
 
 void FSVoxelShaderModule::StartupModule()
@@ -18,12 +58,15 @@ void FSVoxelShaderModule::StartupModule()
 	
 	FString PluginShaderDir = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("SVoxelPlugin"))->GetBaseDir(), TEXT("Shaders"));
 	AddShaderSourceDirectoryMapping(TEXT("/Shaders"), PluginShaderDir);
+
+	FSReadbackManager::Startup();
 }
 
 void FSVoxelShaderModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FSReadbackManager::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -10,17 +10,27 @@
 #include "GlobalShader.h"
 #include "RHIGPUReadback.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
+#include "MCCountVertsCS.h"
 
 struct SVOXELSHADER_API FMCAllocVertsCSDispatchParams
 {
 	int Size;
-	TRefCountPtr<FRDGPooledBuffer> InCellMasks;
+	FRDGBufferRef InCellMasks;
+
+	//FSChunkDispatchData of every chunk in the batch
+	FRDGBufferRef InChunks;
+	int NumChunks;
+
+	//Set to only allocate for the active cells, every cell that owns a vertex is one
+	FMCActiveCells ActiveCells;
+	//See FMCCountVertsCSDispatchParams
+	bool bAsyncCompute = true;
 };
 
 struct SVOXELSHADER_API FMCAllocVertsCSOutput
 {
-	TRefCountPtr<FRDGPooledBuffer> OutCellMasks;
-	uint32_t NumAllocatedVerts;
+	//One count per chunk
+	FRDGBufferRef OutNumAllocatedVerts;
 };
 
 // This class carries our parameter declarations and acts as the bridge between cpp and HLSL.
@@ -30,12 +40,23 @@ public:
 	
 	DECLARE_GLOBAL_SHADER(FMCAllocVertsCS);
 	SHADER_USE_PARAMETER_STRUCT(FMCAllocVertsCS, FGlobalShader);
+
+	//Runs over the active cells of the count pass with an indirect dispatch instead of over every cell
+	class FActiveCellsDim : SHADER_PERMUTATION_BOOL("ACTIVE_CELLS");
+	using FPermutationDomain = TShaderPermutationDomain<FActiveCellsDim>;
 	
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 
 		SHADER_PARAMETER(int, Size) 
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, cellMasks)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, NumAllocatedVerts)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FSChunkDispatchData>, Chunks)
+		SHADER_PARAMETER(uint32, ChunkThreadsZ)
+		
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, ActiveCells)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, NumActiveCells)
+		SHADER_PARAMETER(uint32, NumChunks)
+		RDG_BUFFER_ACCESS(ActiveCellsArgs, ERHIAccess::IndirectArgs)
 
 	END_SHADER_PARAMETER_STRUCT()
 };
@@ -44,12 +65,8 @@ public:
 class SVOXELSHADER_API FMCAllocVertsCSInterface {
 public:
 	
-	// Executes this shader on the render thread
-	static void DispatchRenderThread(
-		FRHICommandListImmediate& RHICmdList,
-		FMCAllocVertsCSDispatchParams Params,
-		TFunction<void(FMCAllocVertsCSOutput Output)> AsyncCallback
-	);
+	// Adds the alloc pass of every chunk in the batch to GraphBuilder, the start index of each vertex is written into the cell masks
+	static FMCAllocVertsCSOutput AddPass(FRDGBuilder& GraphBuilder, const FMCAllocVertsCSDispatchParams& Params);
 };
 
 
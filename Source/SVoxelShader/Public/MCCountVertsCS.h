@@ -11,18 +11,48 @@
 #include "RHIGPUReadback.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 
+//Cells of every chunk of a batch that cross the isolevel, listed by the count pass so the passes after it only run over them
+struct SVOXELSHADER_API FMCActiveCells
+{
+	//Cell index | case code << 24, room for every cell of a chunk at its BatchIndex
+	FRDGBufferRef Cells = nullptr;
+	//One count per chunk
+	FRDGBufferRef NumCells = nullptr;
+	//FRHIDispatchIndirectParameters over the longest list of the batch in groups of GroupSize, one row of groups per chunk
+	FRDGBufferRef Args = nullptr;
+
+	//Matches ACTIVE_CELLS_GROUP_SIZE
+	static constexpr int GroupSize = 64;
+
+	bool IsValid() const
+	{
+		return Args != nullptr;
+	}
+};
+
 struct SVOXELSHADER_API FMCCountVertsCSDispatchParams
 {
 	int Size;
 	float isolevel;
 		
-	TRefCountPtr<FRDGPooledBuffer> InVoxels;
+	FRDGBufferRef InVoxels;
+
+	//FSChunkDispatchData of every chunk in the batch
+	FRDGBufferRef InChunks;
+	int NumChunks;
+
+	//Read the corners from a groupshared tile of the voxels instead of the voxel buffer
+	bool bVoxelTile = true;
+	//Off when the pass is timed with timestamps on the graphics pipe
+	bool bAsyncCompute = true;
 };
 
 struct SVOXELSHADER_API FMCCountVertsCSOutput
 {
-	TRefCountPtr<FRDGPooledBuffer> OutCellMasks;
-	uint32_t IndicesCount;
+	FRDGBufferRef OutCellMasks;
+	//One count per chunk
+	FRDGBufferRef OutIndicesCount;
+	FMCActiveCells ActiveCells;
 };
 
 // This class carries our parameter declarations and acts as the bridge between cpp and HLSL.
@@ -32,6 +62,10 @@ public:
 	
 	DECLARE_GLOBAL_SHADER(FMCCountVertsCS);
 	SHADER_USE_PARAMETER_STRUCT(FMCCountVertsCS, FGlobalShader);
+
+	//Reads the voxels of the group from groupshared memory, loaded once per group
+	class FVoxelTileDim : SHADER_PERMUTATION_BOOL("VOXEL_TILE");
+	using FPermutationDomain = TShaderPermutationDomain<FVoxelTileDim>;
 	
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER(int, Size) 
@@ -40,6 +74,11 @@ public:
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, cellMasks)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, VertexCount)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, IndicesCount)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, ActiveCells)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, NumActiveCells)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint32>, ActiveCellsArgs)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FSChunkDispatchData>, Chunks)
+		SHADER_PARAMETER(uint32, ChunkThreadsZ)
 	END_SHADER_PARAMETER_STRUCT()
 };
 
@@ -47,11 +86,8 @@ public:
 class SVOXELSHADER_API FMCCountVertsCSInterface {
 public:
 	
-	// Executes this shader on the render thread
-	static void DispatchRenderThread(
-		FRHICommandListImmediate& RHICmdList, FMCCountVertsCSDispatchParams Params,
-		TFunction<void(FMCCountVertsCSOutput Output)> AsyncCallback
-	);
+	// Adds the count pass of every chunk in the batch to GraphBuilder
+	static FMCCountVertsCSOutput AddPass(FRDGBuilder& GraphBuilder, const FMCCountVertsCSDispatchParams& Params);
 };
 
 
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformMisc.h"
+#include "PixelShaderUtils.h"
+#include "Runtime/RenderCore/Public/RenderGraphUtils.h"
+#include "MeshPassProcessor.inl"
+#include "StaticMeshResources.h"
+#include "RenderGraphResources.h"
+#include "GlobalShader.h"
+#include "RHIGPUReadback.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+
+struct SVOXELSHADER_API FMCScanCellsCSDispatchParams
+{
+	int Size;
+	float isolevel;
+
+	FRDGBufferRef InVoxels;
+	FRDGBufferRef InCellMasks;
+
+	//FSChunkDispatchData of every chunk in the batch
+	FRDGBufferRef InChunks;
+	int NumChunks;
+};
+
+struct SVOXELSHADER_API FMCScanCellsCSOutput
+{
+	//One count per chunk, like the ones of the count and alloc passes
+	FRDGBufferRef OutNumAllocatedVerts;
+	FRDGBufferRef OutNumIndices;
+
+	//First index slot of every cell, laid out like the cell masks, for FMarchingCSDispatchParams::InCellIndexStarts
+	FRDGBufferRef OutCellIndexStarts;
+};
+
+// This class carries our parameter declarations and acts as the bridge between cpp and HLSL.
+class SVOXELSHADER_API FMCScanCellsCS : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FMCScanCellsCS);
+	SHADER_USE_PARAMETER_STRUCT(FMCScanCellsCS, FGlobalShader);
+
+	//Second pass over the cells, writes their slots on top of the first slots of their row
+	class FApplyDim : SHADER_PERMUTATION_BOOL("SCAN_APPLY");
+	using FPermutationDomain = TShaderPermutationDomain<FApplyDim>;
+	
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+
+		SHADER_PARAMETER(int, Size)
+		SHADER_PARAMETER(float, isolevel)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FSChunkDispatchData>, Chunks)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InVoxels)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, cellMasks)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, GroupSums)
+		SHADER_PARAMETER(uint32, GroupsPerChunk)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, CellIndexStarts)
+
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+//Scans the sums of the rows of cells of every chunk into their first slots and writes the counts of the chunks
+class SVOXELSHADER_API FMCScanGroupsCS : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FMCScanGroupsCS);
+	SHADER_USE_PARAMETER_STRUCT(FMCScanGroupsCS, FGlobalShader);
+	
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, GroupSums)
+		SHADER_PARAMETER(uint32, GroupsPerChunk)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, NumAllocatedVerts)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, NumIndices)
+
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+// This is a public interface that we define so outside code can invoke our compute shader.
+class SVOXELSHADER_API FMCScanCellsCSInterface {
+public:
+	
+	// Adds the deterministic replacement of the alloc pass to GraphBuilder. The vertices and indices of every chunk get their
+	// slots in cell order, the start index of each vertex is written into the cell masks like the alloc pass does.
+	static FMCScanCellsCSOutput AddPass(FRDGBuilder& GraphBuilder, const FMCScanCellsCSDispatchParams& Params);
+
+	//Cells every group of the scan runs over, matches GROUP_SCAN_SIZE in MCScanCellsCS.usf
+	static constexpr int GroupSize = 512;
+};
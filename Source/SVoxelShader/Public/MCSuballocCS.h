@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformMisc.h"
+#include "PixelShaderUtils.h"
+#include "Runtime/RenderCore/Public/RenderGraphUtils.h"
+#include "MeshPassProcessor.inl"
+#include "StaticMeshResources.h"
+#include "RenderGraphResources.h"
+#include "GlobalShader.h"
+#include "RHIGPUReadback.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+
+struct SVOXELSHADER_API FMCSuballocCSDispatchParams
+{
+	//Per chunk counts of the count and alloc passes, by batch index
+	FRDGBufferRef InNumAllocatedVerts;
+	FRDGBufferRef InIndicesCount;
+
+	//FSChunkDispatchData of the chunks in one page with the ranges they were given, overflowing chunks are flagged in place
+	FRDGBufferRef InChunks;
+	int NumChunks;
+
+	//Size of the range of every chunk
+	int VertexCapacity;
+	int IndexCapacity;
+};
+
+struct SVOXELSHADER_API FMCSuballocCSOutput
+{
+	//One FRHIDrawIndexedIndirectParameters per chunk
+	FRDGBufferRef OutDrawArgs;
+};
+
+// This class carries our parameter declarations and acts as the bridge between cpp and HLSL.
+class SVOXELSHADER_API FMCSuballocCS: public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FMCSuballocCS);
+	SHADER_USE_PARAMETER_STRUCT(FMCSuballocCS, FGlobalShader);
+	
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+
+		SHADER_PARAMETER(uint32, NumChunks)
+		SHADER_PARAMETER(uint32, VertexCapacity)
+		SHADER_PARAMETER(uint32, IndexCapacity)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, NumAllocatedVerts)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, IndicesCount)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FSChunkDispatchData>, OutChunks)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint32>, OutDrawArgs)
+
+	END_SHADER_PARAMETER_STRUCT()
+};
+
+// This is a public interface that we define so outside code can invoke our compute shader.
+class SVOXELSHADER_API FMCSuballocCSInterface {
+public:
+	
+	// Adds the pass that checks every chunk of a GPU driven batch fits in its range and writes its draw arguments
+	static FMCSuballocCSOutput AddPass(FRDGBuilder& GraphBuilder, const FMCSuballocCSDispatchParams& Params);
+};
+
+
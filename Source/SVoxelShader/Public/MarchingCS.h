@@ -10,34 +10,46 @@
 #include "GlobalShader.h"
 #include "RHIGPUReadback.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
+#include "MCCountVertsCS.h"
 
 struct SVOXELSHADER_API FMarchingCSDispatchParams
 {
 	FIntVector3 WorldSize;
 	int Size;
 	float isolevel;
-	int LOD;
 	int Scale;
 
-	FVector3f Position;
 	int seed;
 	
-	TRefCountPtr<FRDGPooledBuffer>  InVoxels;
-	TRefCountPtr<FRDGPooledBuffer> InCellMasks;
-	int VertexCount;
-	int IndicesCount;
+	FRDGBufferRef InVoxels;
+	FRDGBufferRef InCellMasks;
+
+	//FSChunkDispatchData of the chunks to march, their offsets place them in the output buffers
+	FRDGBufferRef InChunks;
+	int NumChunks;
+	
+	//Page of the chunk buffer pool the chunks were allocated in
+	FRDGBufferRef OutputVertices;
+	FRDGBufferRef OutputTris;
+	FRDGBufferRef OutNormals;
+	FRDGBufferRef OutColor;
+
+	//Set to only march the active cells, the groupshared tiles need whole groups of neighbours and are not used then
+	FMCActiveCells ActiveCells;
+
+	//Load the voxels of every 8^3 group once into groupshared memory instead of per thread and corner
+	bool bVoxelTile = true;
+	//See FMCCountVertsCSDispatchParams
+	bool bAsyncCompute = true;
+
+	//Set to the output of the scan pass to emit the indices in cell order, the chunks then get a content hash
+	FRDGBufferRef InCellIndexStarts = nullptr;
 };
 
 struct SVOXELSHADER_API FMarchingCSOutput
 {
-	TRefCountPtr<FRDGPooledBuffer>  OutputVertices;
-	TRefCountPtr<FRDGPooledBuffer>  OutputTris;
-	TRefCountPtr<FRDGPooledBuffer>  OutNormals;
-	TRefCountPtr<FRDGPooledBuffer>  OutColor;
-
-	//For Collision
-	TArray<FVector3f> Vertices;
-	TArray<FTriIndices> Indices;
+	//Two 32 bit lanes per chunk, only set with InCellIndexStarts. See FSDispatchCSOutput::ContentHash.
+	FRDGBufferRef OutContentHashes = nullptr;
 };
 
 // This class carries our parameter declarations and acts as the bridge between cpp and HLSL.
@@ -47,16 +59,31 @@ public:
 	
 	DECLARE_GLOBAL_SHADER(FMarchingCS);
 	SHADER_USE_PARAMETER_STRUCT(FMarchingCS, FGlobalShader);
+
+	//Reads the voxels of the group from groupshared memory, loaded once per group
+	class FVoxelTileDim : SHADER_PERMUTATION_BOOL("VOXEL_TILE");
+	//Runs over the active cells of the count pass with an indirect dispatch instead of over every cell
+	class FActiveCellsDim : SHADER_PERMUTATION_BOOL("ACTIVE_CELLS");
+	//Takes the index slots of the cells from the scan pass and sums the content hash of every chunk
+	class FDeterministicDim : SHADER_PERMUTATION_BOOL("DETERMINISTIC");
+	using FPermutationDomain = TShaderPermutationDomain<FVoxelTileDim, FActiveCellsDim, FDeterministicDim>;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		//The active cells of a group are not neighbours, there is no tile to share
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		return !(PermutationVector.Get<FVoxelTileDim>() && PermutationVector.Get<FActiveCellsDim>());
+	}
 	
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 
 		SHADER_PARAMETER(FIntVector3, WorldSize) 
 		SHADER_PARAMETER(int, Size) 
 	    SHADER_PARAMETER(float, isolevel) 
-		SHADER_PARAMETER(int, LOD)
 		SHADER_PARAMETER(int, Scale)
-		SHADER_PARAMETER(FVector3f, Position)
 		SHADER_PARAMETER(int, seed)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FSChunkDispatchData>, Chunks)
+		SHADER_PARAMETER(uint32, ChunkThreadsZ)
 		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InVoxels)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, cellMasks)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, NumEmittedIndices)
@@ -64,6 +91,14 @@ public:
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint32>, OutTris)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FVector3f>, OutNormals)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FVector4f>, OutColor)
+		
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, ActiveCells)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, NumActiveCells)
+		SHADER_PARAMETER(uint32, NumChunks)
+		RDG_BUFFER_ACCESS(ActiveCellsArgs, ERHIAccess::IndirectArgs)
+
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint32_t>, CellIndexStarts)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint32_t>, ContentHashes)
 
 	END_SHADER_PARAMETER_STRUCT()
 };
@@ -73,12 +108,8 @@ public:
 class SVOXELSHADER_API FMarchingCSInterface {
 public:
 	
-	// Executes this shader on the render thread
-	static void DispatchRenderThread(
-		FRHICommandListImmediate& RHICmdList,
-		FMarchingCSDispatchParams Params,
-		TFunction<void(FMarchingCSOutput)> AsyncCallback
-	);
+	// Adds the march pass of every chunk in InChunks to GraphBuilder
+	static FMarchingCSOutput AddPass(FRDGBuilder& GraphBuilder, const FMarchingCSDispatchParams& Params);
 };
 
 
@@ -15,16 +15,23 @@ struct SVOXELSHADER_API FNoiseCSDispatchParams
 {
 	FIntVector3 WorldSize;
 	int Size;
-	FVector3f Position;
-	int LOD;
 	int Scale;
 
 	int seed;
+
+	//FSChunkDispatchData of every chunk in the batch
+	FRDGBufferRef InChunks;
+	int NumChunks;
+
+	//Evaluate the 2D noises once per column in a pass of their own instead of once per voxel
+	bool bColumnPass = true;
+	//Timing runs the passes on the graphics pipe so timestamps around the graph enclose them
+	bool bAsyncCompute = true;
 };
 
 struct SVOXELSHADER_API FNoiseCSOutput
 {
-	TRefCountPtr<FRDGPooledBuffer> OutVoxels;
+	FRDGBufferRef OutVoxels;
 };
 
 // This class carries our parameter declarations and acts as the bridge between cpp and HLSL.
@@ -34,29 +41,57 @@ public:
 	
 	DECLARE_GLOBAL_SHADER(FNoiseCS);
 	SHADER_USE_PARAMETER_STRUCT(FNoiseCS, FGlobalShader);
+
+	//Reads the 2D noises from the column pass
+	class FColumnsDim : SHADER_PERMUTATION_BOOL("NOISE_COLUMNS");
+	using FPermutationDomain = TShaderPermutationDomain<FColumnsDim>;
 	
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER(FIntVector3, WorldSize)
 		SHADER_PARAMETER(int, Size)
-		SHADER_PARAMETER(FVector3f, Position)
-		SHADER_PARAMETER(int, LOD)
 		SHADER_PARAMETER(int, Scale)
 	
 		SHADER_PARAMETER(int, seed)
+
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FSChunkDispatchData>, Chunks)
+		SHADER_PARAMETER(uint32, ChunkThreadsZ)
+	
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FVector2f>, Columns)
 	
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float>, OutVoxels)
 
 	END_SHADER_PARAMETER_STRUCT()
 };
 
+//Writes the height and chaos selector of every column of the chunks, the voxels of a column share them
+class SVOXELSHADER_API FNoiseColumnCS : public FGlobalShader
+{
+public:
+	
+	DECLARE_GLOBAL_SHADER(FNoiseColumnCS);
+	SHADER_USE_PARAMETER_STRUCT(FNoiseColumnCS, FGlobalShader);
+	
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(FIntVector3, WorldSize)
+		SHADER_PARAMETER(int, Size)
+		SHADER_PARAMETER(int, Scale)
+	
+		SHADER_PARAMETER(int, seed)
+
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FSChunkDispatchData>, Chunks)
+		SHADER_PARAMETER(uint32, ChunkThreadsZ)
+	
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FVector2f>, OutColumns)
+
+	END_SHADER_PARAMETER_STRUCT()
+};
+
 // This is a public interface that we define so outside code can invoke our compute shader.
 class SVOXELSHADER_API FNoiseCSInterface {
 public:
 
-	// Executes this shader on the render thread
-	static void DispatchRenderThread(FRHICommandListImmediate& RHICmdList, FNoiseCSDispatchParams Params,
-		TFunction<void(FNoiseCSOutput Output)> AsyncCallback
-	);
+	// Adds the noise pass of every chunk in the batch to GraphBuilder
+	static FNoiseCSOutput AddPass(FRDGBuilder& GraphBuilder, const FNoiseCSDispatchParams& Params);
 };
 
 
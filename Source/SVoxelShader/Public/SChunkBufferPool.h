@@ -0,0 +1,95 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+#include "RenderResource.h"
+#include "SRangeAllocator.h"
+
+class FSChunkBufferPage;
+
+//Vertex and index range of one chunk in the buffer pool, the ranges go back to the page when the last output holding it is released
+struct SVOXELSHADER_API FSChunkBufferAllocation
+{
+	~FSChunkBufferAllocation();
+
+	// Current size of the ranges, smaller than the reserved counts once a GPU driven chunk was shrunk. Any thread.
+	void GetSize(int& OutNumVertices, int& OutNumIndices) const;
+	
+	TSharedPtr<FSChunkBufferPage, ESPMode::ThreadSafe> Page;
+	
+	//Reserved counts, these do not change once the allocation is handed out
+	int VertexOffset = 0;
+	int NumVertices = 0;
+	int IndexOffset = 0;
+	int NumIndices = 0;
+};
+
+typedef TSharedPtr<FSChunkBufferAllocation, ESPMode::ThreadSafe> FSChunkBufferAllocationRef;
+
+/**
+ * Persistent vertex, normal, color and index buffers shared by the chunks, each chunk owns a range of them.
+ */
+class SVOXELSHADER_API FSChunkBufferPage
+{
+public:
+	FSChunkBufferPage(int InVertexCapacity, int InIndexCapacity);
+	~FSChunkBufferPage();
+
+	// Reserves the ranges of a chunk, false if the page has no room. Render thread only.
+	bool Allocate(int NumVertices, int NumIndices, int& OutVertexOffset, int& OutIndexOffset);
+	// Gives the unused end of the ranges of a chunk back once its real counts are known. Render thread only.
+	void Shrink(int VertexOffset, int NumVertices, int IndexOffset, int NumIndices);
+	// Queues the ranges of a chunk to be freed once the GPU is done drawing them. Any thread.
+	void DeferFree(int VertexOffset, int IndexOffset);
+	// Current size of the ranges of a chunk. Any thread.
+	void GetAllocationSize(int VertexOffset, int IndexOffset, int& OutNumVertices, int& OutNumIndices);
+
+	// True once every range was freed. Render thread only.
+	bool IsEmpty();
+	
+	TRefCountPtr<FRDGPooledBuffer> Vertices;
+	TRefCountPtr<FRDGPooledBuffer> Normals;
+	TRefCountPtr<FRDGPooledBuffer> Colors;
+	TRefCountPtr<FRDGPooledBuffer> Indices;
+
+private:
+	// Frees the ranges whose last draw is old enough
+	void ProcessDeferredFrees();
+	
+	FSRangeAllocator VertexAllocator;
+	FSRangeAllocator IndexAllocator;
+
+	struct FDeferredFree
+	{
+		int VertexOffset;
+		int IndexOffset;
+		uint64 Frame;
+	};
+	TArray<FDeferredFree> DeferredFrees;
+	//Guards the allocators and the deferred frees, the sizes are read from other threads
+	FCriticalSection Lock;
+};
+
+/**
+ * Hands out the ranges chunks are marched into. There is a single page unless it runs full, then pages are added as needed.
+ */
+class SVOXELSHADER_API FSChunkBufferPool : public FRenderResource
+{
+public:
+	static FSChunkBufferPool& Get();
+
+	virtual void ReleaseRHI() override;
+
+	// Reserves the ranges of a chunk, a page is added when none has room. Render thread only.
+	FSChunkBufferAllocationRef Allocate(int NumVertices, int NumIndices);
+
+	//Capacity of a page, bigger chunks get a page of their own size
+	static constexpr int PageVertices = 1 << 20;
+	static constexpr int PageIndices = 1 << 22;
+
+	//Frames a freed range waits before it is handed out again, the GPU may still be drawing the chunk
+	static constexpr uint64 FreeLatencyFrames = 3;
+
+private:
+	TArray<TSharedPtr<FSChunkBufferPage, ESPMode::ThreadSafe>> Pages;
+};
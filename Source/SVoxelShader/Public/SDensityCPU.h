@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+//Instruction sets the CPU density can be evaluated with
+enum class ESDensityKernel : uint8
+{
+	Scalar,
+	SSE4,
+	AVX2
+};
+
+/**
+ * CPU port of the density field NoiseCS.usf writes and the fnl.ush noise it samples, for collision, pathfinding and checks
+ * that have no GPU. The scalar kernel follows the shader line by line, the SIMD kernels evaluate a row of voxels at once and
+ * match it within float tolerance.
+ */
+class SVOXELSHADER_API FSDensityCPU
+{
+public:
+	// Density at a world position, like the shader, positive is air and negative is ground
+	static float GetDensity(const FIntVector3& WorldSize, int32 Seed, const FVector3f& Position);
+
+	// Vertex color the march pass gives a world position from its biome
+	static FVector4f GetBiomeColor(const FIntVector3& WorldSize, int32 Seed, const FVector3f& Position);
+
+	// Fills OutVoxels like the noise pass fills the voxels of one chunk, (Size + 4)^3 values starting at the chunk position.
+	// Kernels this CPU cannot run fall back to the best one it has.
+	static void GetChunkDensity(const FIntVector3& WorldSize, int32 Seed, int32 Size, int32 Scale, int32 LOD, const FVector3f& Position,
+		TArrayView<float> OutVoxels, ESDensityKernel Kernel = GetBestKernel());
+
+	// True if the kernel can run here. SSE4 needs a target whose minimum instruction set has it, AVX2 is checked on the CPU.
+	static bool IsKernelSupported(ESDensityKernel Kernel);
+	static ESDensityKernel GetBestKernel();
+	static const TCHAR* GetKernelName(ESDensityKernel Kernel);
+};
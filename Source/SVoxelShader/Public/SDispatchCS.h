@@ -4,6 +4,14 @@
 #include "GenericPlatform/GenericPlatformMisc.h"
 #include "Kismet/BlueprintAsyncActionBase.h"
 #include "RenderGraphResources.h"
+#include "HAL/ThreadSafeBool.h"
+#include "SChunkBufferPool.h"
+
+//Set to true by the owner once the chunk is not wanted anymore, the dispatch stops before its next pass
+typedef TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> FSDispatchCancelToken;
+
+//Callback of a batch with the indices into its params of the GPU driven chunks that did not fit their range
+typedef TFunction<void(TArray<int> OverflowIndices)> FSDispatchOverflowCallback;
 
 struct SVOXELSHADER_API FSDispatchCSParams
 {
@@ -15,6 +23,22 @@ struct SVOXELSHADER_API FSDispatchCSParams
 	int Scale;
 
 	int seed;
+
+	//Optional, the dispatch always runs to the end without one
+	FSDispatchCancelToken CancelToken;
+
+	//Keep the counts on the GPU and march into worst case ranges drawn with indirect args, the chunk is handed back
+	//as soon as its graph is submitted. The output has no collision geometry.
+	bool bGPUDriven = false;
+
+	//Hand out the vertices and indices of the chunk in cell order instead of by atomics, the same chunk then has the same
+	//buffers on every run and the output gets a ContentHash. Always takes the counted path, even with bGPUDriven.
+	bool bDeterministic = false;
+
+	bool IsCancelled() const
+	{
+		return CancelToken.IsValid() && *CancelToken;
+	}
 };
 
 struct SVOXELSHADER_API FSDispatchCSOutput
@@ -24,23 +48,77 @@ struct SVOXELSHADER_API FSDispatchCSOutput
 	TRefCountPtr<FRDGPooledBuffer>  OutNormals;
 	TRefCountPtr<FRDGPooledBuffer>  OutColor;
 
-	int NumVertices;
-	int NumIndices;
+	int NumVertices = 0;
+	int NumIndices = 0;
+
+	//The output buffers are a page of the chunk buffer pool, these place the chunk inside them. Indices already include VertexOffset.
+	int VertexOffset = 0;
+	int IndexOffset = 0;
+
+	//Owns the ranges of the chunk, they are freed once every copy of the output was released
+	FSChunkBufferAllocationRef Allocation;
+
+	//Set by GPU driven dispatches, the draw arguments of the chunk are at DrawArgsIndex. NumIndices is 0 and
+	//NumVertices is the size of the chunk's range since the counts never come back.
+	TRefCountPtr<FRDGPooledBuffer> DrawArgs;
+	int DrawArgsIndex = INDEX_NONE;
 
+	//For Collision, indices start at the first vertex of the chunk
 	TArray<FVector3f> Vertices;
 	TArray<FTriIndices> Indices;
 
+	//Cells of the chunk that cross the isolevel, the only ones the passes after the count ran over.
+	//INDEX_NONE when the count was not read back, for GPU driven and uploaded chunks.
+	int NumActiveCells = INDEX_NONE;
+
+	//The dispatch was cancelled before its last pass, the output is empty
+	bool bCancelled = false;
+
+	//Set by GPU driven dispatches, the readback sets it once it finds the geometry of the chunk did not fit its range.
+	//The chunk then draws nothing and has to be generated again. Shared by every copy of the output.
+	TSharedPtr<FThreadSafeBool, ESPMode::ThreadSafe> OverflowFlag;
+
+	//Hash of the geometry of the chunk, see GetContentHash. Set by deterministic dispatches and uploads, 0 otherwise and for empty chunks.
+	uint64 ContentHash = 0;
+
+	// Hash of the vertices, normals, colors and indices of a chunk, indices start at its first vertex. The same as the march pass
+	// sums on the GPU, it only depends on the content and order of the arrays, not on where they are in the chunk buffer pool.
+	static uint64 GetContentHash(TConstArrayView<FVector3f> Vertices, TConstArrayView<FVector3f> Normals,
+		TConstArrayView<FVector4f> Colors, TConstArrayView<uint32> Indices);
+
+	bool HasOverflowed() const
+	{
+		return OverflowFlag.IsValid() && *OverflowFlag;
+	}
+
 	void ReleaseDispatch()
 	{
 		OutputVertices.SafeRelease();
 		OutputTris.SafeRelease();
 		OutNormals.SafeRelease();
 		OutColor.SafeRelease();
+		DrawArgs.SafeRelease();
+		Allocation.Reset();
 		Vertices.Reset();
 		Indices.Reset();
 	}
 };
 
+//Geometry of a chunk made on the CPU or loaded from disk, indices start at the first vertex of the chunk
+struct SVOXELSHADER_API FSChunkMeshData
+{
+	TArray<FVector3f> Vertices;
+	TArray<FVector3f> Normals;
+	TArray<FVector4f> Colors;
+	TArray<uint32> Indices;
+
+	//Also hand the geometry to the output for collision
+	bool bCollision = false;
+
+	//FSDispatchCSOutput::ContentHash of the geometry if it is known already, the upload computes it when 0
+	uint64 ContentHash = 0;
+};
+
 // This is a public interface that we define so outside code can invoke our compute shader.
 class SVOXELSHADER_API FSDispatchCSInterface {
 public:
@@ -78,6 +156,84 @@ public:
 			DispatchGameThread(Params, AsyncCallback);
 		}
 	}
+
+	// Executes the batch on the render thread, every stage runs once for all compatible chunks.
+	// The callback runs on CallbackThread with one output per params, in the same order.
+	// GPU driven chunks are handed back before their counts are read, OverflowCallback runs on CallbackThread once the counts of
+	// chunks that did not fit their range are back. Their outputs draw nothing and are flagged, see HasOverflowed.
+	static void DispatchBatchRenderThread(
+		FRHICommandListImmediate& RHICmdList,
+		TArray<FSDispatchCSParams> Params,
+		TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback,
+		ENamedThreads::Type CallbackThread = ENamedThreads::GameThread,
+		FSDispatchOverflowCallback OverflowCallback = nullptr
+	);
+
+	// Executes the batch on the render thread from the game thread via EnqueueRenderThreadCommand
+	static void DispatchBatchGameThread(
+		TArray<FSDispatchCSParams> Params,
+		TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback,
+		ENamedThreads::Type CallbackThread = ENamedThreads::GameThread,
+		FSDispatchOverflowCallback OverflowCallback = nullptr
+	)
+	{
+		ENQUEUE_RENDER_COMMAND(SceneDrawCompletion)(
+		[Params, AsyncCallback, CallbackThread, OverflowCallback](FRHICommandListImmediate& RHICmdList)
+		{
+			DispatchBatchRenderThread(RHICmdList, Params, AsyncCallback, CallbackThread, OverflowCallback);
+		});
+	}
+
+	// Dispatches a batch of chunks. Can be called from any thread
+	static void DispatchBatch(
+		TArray<FSDispatchCSParams> Params,
+		TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback,
+		ENamedThreads::Type CallbackThread = ENamedThreads::GameThread,
+		FSDispatchOverflowCallback OverflowCallback = nullptr
+	)
+	{
+		if (IsInRenderingThread())
+		{
+			DispatchBatchRenderThread(GetImmediateCommandList_ForRenderCommand(), Params, AsyncCallback, CallbackThread, OverflowCallback);
+		}else{
+			DispatchBatchGameThread(Params, AsyncCallback, CallbackThread, OverflowCallback);
+		}
+	}
+
+	// Uploads meshes made on the CPU into the chunk buffer pool on the render thread. The callback runs on CallbackThread
+	// with one output per mesh, in the same order, like the one of a dispatch.
+	static void UploadBatchRenderThread(
+		FRHICommandListImmediate& RHICmdList,
+		TArray<FSChunkMeshData> Meshes,
+		TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback,
+		ENamedThreads::Type CallbackThread = ENamedThreads::GameThread
+	);
+
+	// Uploads a batch of meshes. Can be called from any thread
+	static void UploadBatch(
+		TArray<FSChunkMeshData> Meshes,
+		TFunction<void(TArray<FSDispatchCSOutput> Outputs)> AsyncCallback,
+		ENamedThreads::Type CallbackThread = ENamedThreads::GameThread
+	)
+	{
+		if (IsInRenderingThread())
+		{
+			UploadBatchRenderThread(GetImmediateCommandList_ForRenderCommand(), MoveTemp(Meshes), AsyncCallback, CallbackThread);
+		}else{
+			ENQUEUE_RENDER_COMMAND(SceneDrawCompletion)(
+			[Meshes = MoveTemp(Meshes), AsyncCallback, CallbackThread](FRHICommandListImmediate& RHICmdList) mutable
+			{
+				UploadBatchRenderThread(RHICmdList, MoveTemp(Meshes), AsyncCallback, CallbackThread);
+			});
+		}
+	}
+
+	//Chunks generated by the same dispatches, bigger batches need more transient memory for voxels and cell masks
+	static constexpr int MaxBatchSize = 16;
+
+	//Share of the worst case geometry a GPU driven chunk gets from the chunk buffer pool. Chunks that do not fit draw nothing and
+	//are reported to the OverflowCallback of their batch, to be generated again on the counted path.
+	static constexpr float GPUDrivenCapacity = 0.25f;
 };
 
 
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SDispatchCS.h"
+
+//Per chunk data of a batched dispatch, matches FChunkData in ChunkBatch.ush
+struct SVOXELSHADER_API FSChunkDispatchData
+{
+	FVector3f Position;
+	int32 LOD;
+	//Slot of the chunk in the voxel and cell mask buffers
+	uint32 BatchIndex;
+	//First vertex and index of the chunk in the output buffers
+	uint32 VertexOffset;
+	uint32 IndexOffset;
+};
+
+//Where the geometry of one chunk lives when the chunks of a batch are packed back to back
+struct SVOXELSHADER_API FSDispatchCSSlice
+{
+	//Slot of the chunk in the batch
+	int BatchIndex = 0;
+	
+	int VertexOffset = 0;
+	int NumVertices = 0;
+	int IndexOffset = 0;
+	int NumIndices = 0;
+};
+
+/**
+ * CPU side of the batched dispatch, groups chunks into batches and lays out the geometry read back for collision.
+ * Nothing in here touches the RHI.
+ */
+class SVOXELSHADER_API FSDispatchCSBatching
+{
+public:
+	// True if both chunks can be generated by the same dispatches, only the position, LOD and cancel token may differ
+	static bool CanBatch(const FSDispatchCSParams& A, const FSDispatchCSParams& B);
+
+	// Splits Params into batches of at most MaxBatchSize compatible chunks. Each batch holds indices into Params in their original order.
+	static void BuildBatches(const TArray<FSDispatchCSParams>& Params, int MaxBatchSize, TArray<TArray<int>>& OutBatches);
+
+	// Packs the chunks that have geometry back to back from their vertex and index counts, empty chunks get no slice.
+	static void BuildSlices(TConstArrayView<uint32> VertexCounts, TConstArrayView<uint32> IndexCounts,
+		TArray<FSDispatchCSSlice>& OutSlices, int& OutNumVertices, int& OutNumIndices);
+
+	// Range a GPU driven chunk gets in the chunk buffer pool, the worst case is 3 vertices per cell corner and 5 triangles per cell
+	static void GetGPUDrivenCapacity(int Size, int& OutNumVertices, int& OutNumIndices);
+
+	// Copies the geometry of one chunk for collision, indices are rebased from FirstVertex to 0
+	static void SliceCollision(TConstArrayView<FVector3f> ChunkVertices, TConstArrayView<uint32> ChunkIndices, uint32 FirstVertex,
+		TArray<FVector3f>& OutVertices, TArray<FTriIndices>& OutIndices);
+};
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SDispatchCS.h"
+
+struct SVOXELSHADER_API FSMarchingCPUOutput
+{
+	//Laid out like the output buffers of one chunk, indices start at the first vertex of the chunk
+	TArray<FVector3f> Vertices;
+	TArray<FVector3f> Normals;
+	TArray<FVector4f> Colors;
+	TArray<uint32> Indices;
+
+	//(Size + 1)^3 cell masks as the march pass reads them, the 0, 3 and 8 flags over the 24 bit index of the first vertex of the cell
+	TArray<uint32> CellMasks;
+};
+
+/**
+ * CPU port of the count, alloc and march passes, for chunks that need geometry without a GPU and to check the shaders against.
+ * Vertices are owned and flagged like on the GPU, so it emits the same vertices and triangles. The GPU hands out vertex and
+ * index slots as one run per group in the order of its threads, the runs in whatever order the groups' atomics run. This hands
+ * them out in cell order, so outputs are compared through GetCanonicalTriangles. Deterministic dispatches hand them out in cell
+ * order too, their cell masks and indices are the same as these.
+ */
+class SVOXELSHADER_API FSMarchingCPU
+{
+public:
+	// Marches (Size + 4)^3 voxels laid out like the noise pass output, WorldSize, Size, isolevel, Position, LOD, Scale and seed
+	// of Params are used. Normals and colors are skipped without bAttributes, which is all collision needs.
+	static void March(const FSDispatchCSParams& Params, TConstArrayView<float> Voxels, FSMarchingCPUOutput& Output, bool bAttributes = true);
+
+	// Samples the density of the chunk with FSDensityCPU and marches it
+	static void Generate(const FSDispatchCSParams& Params, FSMarchingCPUOutput& Output, bool bAttributes = true);
+
+	// Triangles as vertex ids that do not depend on the slot order, cell address * 3 + the 0, 3, 8 slot of the vertex. Each triangle
+	// keeps its winding and starts at its smallest id, the list is sorted. Indices start at the first vertex of the chunk.
+	static void GetCanonicalTriangles(TConstArrayView<uint32> CellMasks, TConstArrayView<uint32> Indices, TArray<FIntVector>& OutTriangles);
+
+	// Reference of the group scan of the alloc and march passes. OutOffsets is the exclusive prefix sum of Counts within every
+	// run of GroupSize counts, OutGroupTotals the sum of every run. The last run may be shorter.
+	static void GroupScan(TConstArrayView<uint32> Counts, int32 GroupSize, TArray<uint32>& OutOffsets, TArray<uint32>& OutGroupTotals);
+};
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+enum class ESRangeAllocatorFit : uint8
+{
+	//Lowest free range that fits, keeps allocations packed at the start
+	First,
+	//Smallest free range that fits, leaves the big ranges for big chunks
+	Best,
+};
+
+/**
+ * Hands out ranges of a fixed capacity, freed ranges are merged back with their free neighbours.
+ * Plain cpp with no RHI, the buffers the ranges index into are owned by the caller.
+ */
+class SVOXELSHADER_API FSRangeAllocator
+{
+public:
+	FSRangeAllocator(int32 InCapacity = 0, ESRangeAllocatorFit InFit = ESRangeAllocatorFit::Best);
+	
+	// Returns the offset of a range of Size elements, INDEX_NONE if no free range is big enough
+	int32 Allocate(int32 Size);
+	// Gives the range starting at Offset back
+	void Free(int32 Offset);
+	// Gives the end of the range starting at Offset back, the range keeps its offset
+	void Shrink(int32 Offset, int32 NewSize);
+
+	int32 GetAllocationSize(int32 Offset) const;
+	
+	int32 GetCapacity() const { return Capacity; }
+	int32 GetUsedSize() const { return UsedSize; }
+	int32 GetFreeSize() const { return Capacity - UsedSize; }
+	int32 GetNumAllocations() const { return Allocations.Num(); }
+	int32 GetNumFreeRanges() const { return FreeRanges.Num(); }
+	int32 GetLargestFreeRange() const;
+	
+	// 0 while the free space is a single range, closer to 1 the more it is split up
+	float GetFragmentation() const;
+
+private:
+	struct FRange
+	{
+		int32 Offset;
+		int32 Size;
+	};
+
+	// Adds a free range and merges it with the free ranges it touches
+	void AddFreeRange(int32 Offset, int32 Size);
+	
+	int32 Capacity;
+	int32 UsedSize = 0;
+	ESRangeAllocatorFit Fit;
+
+	//Sorted by offset, two free ranges never touch
+	TArray<FRange> FreeRanges;
+	//Size of every allocation by offset
+	TMap<int32, int32> Allocations;
+};
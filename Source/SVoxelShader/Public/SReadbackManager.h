@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RHIGPUReadback.h"
+
+/**
+ * Callbacks waiting on GPU readbacks. A sweep checks every pending readback once, then fires the callbacks whose readbacks
+ * are all ready together, in the order they were added. Callbacks added while firing wait for the next sweep.
+ * ReadbackType only needs IsReady(), so the scheduling also runs against mock readbacks. Not thread safe.
+ */
+template<typename ReadbackType>
+class TSReadbackScheduler
+{
+public:
+	// Fires OnReady in the first sweep that finds every readback ready, the callback owns the readbacks
+	void Add(TArray<ReadbackType*> Readbacks, TFunction<void()> OnReady)
+	{
+		Pending.Add({MoveTemp(Readbacks), MoveTemp(OnReady)});
+	}
+	
+	// Returns the number of callbacks fired
+	int Sweep()
+	{
+		TArray<TFunction<void()>> Ready;
+		int NumKept = 0;
+		for (int Index = 0; Index < Pending.Num(); Index++)
+		{
+			FEntry& Entry = Pending[Index];
+			
+			//Readbacks found ready by an earlier sweep are not checked again, neither are the ones after the first that is not
+			while (Entry.NumReady < Entry.Readbacks.Num() && Entry.Readbacks[Entry.NumReady]->IsReady())
+			{
+				Entry.NumReady++;
+			}
+			
+			if (Entry.NumReady == Entry.Readbacks.Num())
+			{
+				Ready.Add(MoveTemp(Entry.OnReady));
+			}
+			else
+			{
+				if (NumKept != Index)
+				{
+					Pending[NumKept] = MoveTemp(Entry);
+				}
+				NumKept++;
+			}
+		}
+		Pending.SetNum(NumKept, false);
+
+		for (TFunction<void()>& OnReady : Ready)
+		{
+			OnReady();
+		}
+		return Ready.Num();
+	}
+
+	int Num() const { return Pending.Num(); }
+
+private:
+	struct FEntry
+	{
+		TArray<ReadbackType*> Readbacks;
+		TFunction<void()> OnReady;
+		int NumReady = 0;
+	};
+	TArray<FEntry> Pending;
+};
+
+/**
+ * Readbacks of the dispatches, swept once at the beginning of every render thread frame instead of each one polling itself.
+ * Render thread only.
+ */
+class SVOXELSHADER_API FSReadbackManager : public TSReadbackScheduler<FRHIGPUBufferReadback>
+{
+public:
+	static FSReadbackManager& Get();
+
+	// Hooks the sweep into the render thread frame, called by the module
+	static void Startup();
+	static void Shutdown();
+
+private:
+	static void OnBeginFrameRenderThread();
+	
+	static FDelegateHandle BeginFrameHandle;
+};
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("SVoxel"), STATGROUP_SVoxel, STATCAT_Advanced);
+
+//Dispatches stopped between two passes because their chunk left the view set
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Cancelled Dispatches"), STAT_SVoxel_CancelledDispatches, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Compute passes the cancelled dispatches did not issue
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Skipped Passes"), STAT_SVoxel_SkippedPasses, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Dispatches that ran every pass but were cancelled before their mesh was spawned
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Wasted Dispatches"), STAT_SVoxel_WastedDispatches, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Chunks of GPU driven batches that did not fit in the suballocated buffers and were not drawn
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("GPU Driven Overflows"), STAT_SVoxel_GPUDrivenOverflows, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Time from the dispatch of the last batch to its outputs being handed to the game thread
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Dispatch Latency (ms)"), STAT_SVoxel_DispatchLatencyMs, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Last Dispatch Latency (frames)"), STAT_SVoxel_DispatchLatencyFrames, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Persistent chunk buffers and how much of them is handed out
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Chunk Pool Memory"), STAT_SVoxel_ChunkPoolMemory, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Chunk Pool Vertices"), STAT_SVoxel_ChunkPoolVertices, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Chunk Pool Indices"), STAT_SVoxel_ChunkPoolIndices, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Bytes the dispatches uploaded from the CPU since startup, and per chunk for the last dispatch
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Uploaded Bytes"), STAT_SVoxel_UploadedBytes, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Last Uploaded Bytes Per Chunk"), STAT_SVoxel_UploadedBytesPerChunk, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Meshes of deleted chunks kept to spawn them again, and how often a dispatched chunk was found in there
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Mesh Cache Memory"), STAT_SVoxel_MeshCacheMemory, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Mesh Cache Hits"), STAT_SVoxel_MeshCacheHits, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Mesh Cache Misses"), STAT_SVoxel_MeshCacheMisses, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Mesh Cache Evictions"), STAT_SVoxel_MeshCacheEvictions, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Chunks loaded from the baked region archive instead of being generated, the ones it did not have, and the bytes read from it
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Region Archive Hits"), STAT_SVoxel_RegionArchiveHits, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Region Archive Misses"), STAT_SVoxel_RegionArchiveMisses, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Region Archive Read Bytes"), STAT_SVoxel_RegionArchiveReadBytes, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Chunks generated again shortly after their delete, the chunk set moved back and forth over a border
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Chunk Thrashes"), STAT_SVoxel_ChunkThrashes, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Game thread cost of spawning and deleting chunk components, the components waiting in the pool and the ones created
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Chunk Mesh"), STAT_SVoxel_SpawnChunkMesh, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Delete Chunk Mesh"), STAT_SVoxel_DeleteChunkMesh, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled Components"), STAT_SVoxel_PooledComponents, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Created Components"), STAT_SVoxel_CreatedComponents, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Duration of the last garbage collection while a chunk world was playing
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Garbage Collection (ms)"), STAT_SVoxel_GarbageCollectionMs, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Chunk spawns and deletes waiting for the game thread, the time spent applying them this frame and the spawns dropped by a later delete
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Completion Queue Depth"), STAT_SVoxel_CompletionQueueDepth, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drain Completions"), STAT_SVoxel_DrainCompletions, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Completion Drain Time (ms)"), STAT_SVoxel_CompletionDrainMs, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Coalesced Completions"), STAT_SVoxel_CoalescedCompletions, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Callbacks waiting on GPU readbacks, the ones fired since startup and the time of the sweep that checks them once per frame
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pending Readbacks"), STAT_SVoxel_PendingReadbacks, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Readback Callbacks"), STAT_SVoxel_ReadbackCallbacks, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Readback Sweep"), STAT_SVoxel_ReadbackSweep, STATGROUP_SVoxel, SVOXELSHADER_API);
+//Share of the cells of the last counted batch that cross the isolevel, the passes after the count only run over those
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Last Cell Occupancy (%)"), STAT_SVoxel_CellOccupancy, STATGROUP_SVoxel, SVOXELSHADER_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Prefetched Chunks"), STAT_SVoxel_PrefetchedChunks, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Cancelled Prefetches"), STAT_SVoxel_CancelledPrefetches, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Prefetch Hits"), STAT_SVoxel_PrefetchHits, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Hole Chunks"), STAT_SVoxel_HoleChunks, STATGROUP_SVoxel, SVOXELSHADER_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Hole Frames"), STAT_SVoxel_HoleFrames, STATGROUP_SVoxel, SVOXELSHADER_API);